@@ -0,0 +1,301 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+#include "cyclops/jobs.h"
+
+//------------------------------------------------------------------------------
+JobRunner::JobRunner(gui::App & a,gui::ProgressBar & b,gui::Label & s)
+:app(a),bar(b),status(s),current(null<Job*>()),drop(false),quit(false),
+fresh(false),showing(null<time::Progress*>())
+{
+ prog.self = this;
+ worker.self = this;
+ worker.Run();
+
+ app.SetTimer(100,MakeCB(this,&JobRunner::Tick));
+}
+
+JobRunner::~JobRunner()
+{
+ app.SetTimer(0,null<gui::Callback*>());
+
+ // Tell the worker to stop, cancelling whatever it is doing...
+  lock.Lock();
+   quit = true;
+   drop = true;
+   if (current) prog.Cancel();
+   while (queue.Size()!=0)
+   {
+    delete queue.Front();
+    queue.RemFront();
+   }
+  lock.Unlock();
+  wake.Add();
+  worker.Wait();
+
+ // Clean up anything that finished but never got to Done...
+  while (finished.Size()!=0)
+  {
+   delete finished.Front().job;
+   finished.RemFront();
+  }
+}
+
+void JobRunner::Add(Job * job)
+{
+ lock.Lock();
+  queue.AddBack(job);
+ lock.Unlock();
+ wake.Add();
+}
+
+bit JobRunner::Busy(void * owner)
+{
+ bit ret = false;
+ lock.Lock();
+  if (current&&(current->Owner()==owner)&&(drop==false)) ret = true;
+
+  ds::List<Job*>::Cursor targ = queue.FrontPtr();
+  while ((!ret)&&(!targ.Bad()))
+  {
+   if ((*targ)->Owner()==owner) ret = true;
+   ++targ;
+  }
+
+  ds::List<Finished>::Cursor targ2 = finished.FrontPtr();
+  while ((!ret)&&(!targ2.Bad()))
+  {
+   if (targ2->job->Owner()==owner) ret = true;
+   ++targ2;
+  }
+ lock.Unlock();
+ return ret;
+}
+
+void JobRunner::Remove(void * owner)
+{
+ lock.Lock();
+  // Delete waiting jobs...
+   ds::List<Job*>::Cursor targ = queue.FrontPtr();
+   while (!targ.Bad())
+   {
+    if ((*targ)->Owner()==owner)
+    {
+     delete *targ;
+     targ.RemNext();
+    }
+    else ++targ;
+   }
+
+   ds::List<Finished>::Cursor targ2 = finished.FrontPtr();
+   while (!targ2.Bad())
+   {
+    if (targ2->job->Owner()==owner)
+    {
+     delete targ2->job;
+     targ2.RemNext();
+    }
+    else ++targ2;
+   }
+
+  // Cancel the running job, leaving the worker to delete it when it stops, so
+  // the gui is not held up by a long stage...
+   if (current&&(current->Owner()==owner))
+   {
+    drop = true;
+    prog.Cancel();
+   }
+ lock.Unlock();
+}
+
+void JobRunner::Cancel(gui::Base * obj,gui::Event * event)
+{
+ lock.Lock();
+  if (current) prog.Cancel();
+ lock.Unlock();
+}
+
+void JobRunner::Tick(gui::Base * obj,gui::Event * event)
+{
+ // Get the state, taking a copy of the progress so the gui can be updated
+ // without holding the lock...
+  time::Progress local;
+  lock.Lock();
+   bit running = current!=null<Job*>();
+   bit update = fresh;
+   fresh = false;
+   if (update) local.CopyFrom(snapshot);
+
+   str::String s;
+   if (running)
+   {
+    s << "Running " << current->Name();
+    if (prog.Cancelling()) s << " (cancelling)";
+   }
+   if (queue.Size()!=0)
+   {
+    if (running) s << ", ";
+    s << queue.Size() << " waiting";
+   }
+  lock.Unlock();
+
+ // Update the gui...
+  if (s!=lastStatus)
+  {
+   status.Set(s);
+   lastStatus = s;
+  }
+
+  if (running)
+  {
+   if (showing==null<time::Progress*>()) showing = bar.Begin();
+   if (update) showing->CopyFrom(local);
+  }
+  else
+  {
+   if (showing) bar.End();
+   showing = null<time::Progress*>();
+  }
+
+ // Hand back finished jobs, one at a time as Done can do anything, including
+ // removing other jobs...
+  while (true)
+  {
+   lock.Lock();
+    if (finished.Size()==0)
+    {
+     lock.Unlock();
+     break;
+    }
+    Finished fin = finished.Front();
+    finished.RemFront();
+   lock.Unlock();
+
+   if (fin.failed)
+   {
+    str::String msg;
+    msg << fin.job->Name() << " failed, see the log for details.";
+    cstr ts = msg.ToStr();
+    app.MessageDialog(gui::App::MsgErr,ts);
+    mem::Free(ts);
+   }
+
+   fin.job->Done(!(fin.cancelled||fin.failed));
+   delete fin.job;
+  }
+}
+
+//------------------------------------------------------------------------------
+void JobRunner::JobProgress::OnChange()
+{
+ self->lock.Lock();
+  self->snapshot.CopyFrom(*this);
+  self->fresh = true;
+ self->lock.Unlock();
+}
+
+//------------------------------------------------------------------------------
+void JobRunner::Worker::Execute()
+{
+ while (true)
+ {
+  self->wake.Get();
+
+  // Get the next job, if there is one - it might of been removed...
+   self->lock.Lock();
+    if (self->quit)
+    {
+     self->lock.Unlock();
+     break;
+    }
+
+    if (self->queue.Size()==0)
+    {
+     self->lock.Unlock();
+     continue;
+    }
+
+    Job * job = self->queue.Front();
+    self->queue.RemFront();
+    self->current = job;
+    self->drop = false;
+    self->prog.Reset();
+    self->snapshot.Reset();
+    self->fresh = true;
+   self->lock.Unlock();
+
+  // Run it - cancelling does not throw, so anything caught here is a real
+  // failure, such as running out of memory, and is logged as such...
+   bit failed = false;
+   try
+   {
+    job->Run(&self->prog);
+   }
+   catch (...)
+   {
+    LogAlways("[cyclops.jobs] Job failed with an exception {name}" << LogDiv() << job->Name());
+    failed = true;
+   }
+
+  // Hand it back to the gui thread, or delete it if nobody wants it...
+   self->lock.Lock();
+    if (self->drop) delete job;
+    else
+    {
+     Finished fin;
+     fin.job = job;
+     fin.cancelled = self->prog.Cancelling();
+     fin.failed = failed;
+     self->finished.AddBack(fin);
+    }
+    self->current = null<Job*>();
+   self->lock.Unlock();
+ }
+}
+
+//------------------------------------------------------------------------------
+svt::Var * CopyVar(svt::Core & core,svt::Var * var)
+{
+ str::TokenTable & fromTT = var->GetCore().GetTT();
+ str::TokenTable & toTT = core.GetTT();
+
+ svt::Var * ret = new svt::Var(core);
+ ret->Setup(var->Dims(),var->Sizes());
+ for (nat32 i=0;i<var->Fields();i++)
+ {
+  ret->Add(toTT(fromTT.Str(var->FieldName(i))),toTT(fromTT.Str(var->FieldType(i))),
+           var->FieldSize(i),var->FieldDef(i));
+ }
+ ret->Commit(false);
+
+ for (nat32 i=0;i<var->Fields();i++)
+ {
+  nat32 j;
+  ret->GetIndex(toTT(fromTT.Str(var->FieldName(i))),j);
+  nat32 size = var->FieldSize(i);
+  for (nat32 e=0;e<var->Count();e++)
+  {
+   mem::Copy((byte*)ret->Ptr(j,e),(byte*)var->Ptr(i,e),size);
+  }
+ }
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,148 @@
+#ifndef CYCLOPS_JOBS_H
+#define CYCLOPS_JOBS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+#include "eos.h"
+
+using namespace eos;
+
+//------------------------------------------------------------------------------
+// A slow operation for the JobRunner, to be inherited from. Run is called in
+// the worker thread and must not touch the gui, or any svt::Core the gui is
+// using - the job should be given copies of its inputs, in a core of its own,
+// and hand its results back in Done. See CopyVar.
+class Job
+{
+ public:
+  // owner identifies whoever made the job, so they can remove it when they go.
+   Job(void * owner):owner(owner) {}
+   virtual ~Job() {}
+
+  // The name shown on the progress bar whilst it waits in the queue.
+   virtual cstrconst Name() const = 0;
+
+  // Does the work, in the worker thread. Should pass prog to everything it
+  // calls, and poll prog->Cancelling() where it can stop early, tidying up and
+  // returning - nothing is thrown to stop it. Must not touch its owner, as a
+  // removed job is left to finish after the owner has gone.
+   virtual void Run(time::Progress * prog) = 0;
+
+  // Called in the gui thread once the job has finished. ok is false if it was
+  // cancelled, or if it failed by throwing, in which case the failure has
+  // allready been logged and shown to the user. The job is deleted immediatly
+  // afterwards.
+   virtual void Done(bit ok) = 0;
+
+  void * Owner() const {return owner;}
+
+
+ private:
+  void * owner;
+};
+
+//------------------------------------------------------------------------------
+// Runs Jobs one at a time, in order, on a worker thread, so the gui remains
+// responsive. Progress is shown on a progress bar, and the number of waiting
+// jobs on a label, both updated from a timer in the gui thread.
+class JobRunner
+{
+ public:
+  // The app is used for its timer, which the runner takes over.
+   JobRunner(gui::App & app,gui::ProgressBar & bar,gui::Label & status);
+
+  // Cancels the running job, deletes the queued ones, without calling Done.
+  ~JobRunner();
+
+
+  // Adds a job to the end of the queue, taking ownership.
+   void Add(Job * job);
+
+  // Returns true if the given owner has a job that has not had Done called yet.
+   bit Busy(void * owner);
+
+  // Deletes all jobs belonging to the given owner without calling Done. If
+  // the running one belongs to them it is cancelled and left for the worker to
+  // delete when it stops, rather than waited for. For calling from the owners
+  // destructor.
+   void Remove(void * owner);
+
+  // Cancels the job currently running, as a gui handler for a cancel button.
+   void Cancel(gui::Base * obj,gui::Event * event);
+
+
+ private:
+  gui::App & app;
+  gui::ProgressBar & bar;
+  gui::Label & status;
+
+  // The progress object handed to running jobs, which copies itself into a
+  // snapshot for the gui thread to display...
+   class JobProgress : public time::Progress
+   {
+    public:
+     JobRunner * self;
+     void OnChange();
+   };
+
+  // The worker thread...
+   class Worker : public mt::Thread
+   {
+    public:
+     JobRunner * self;
+     void Execute();
+   };
+
+  // Everything below is protected by lock...
+   mt::OwnedLock lock;
+   mt::EventLock wake; // Signalled once per job added, and to quit.
+
+   ds::List<Job*> queue;
+   Job * current;
+   bit drop; // Set if current has been removed, so the worker deletes it rather than finishing it.
+
+   struct Finished
+   {
+    Job * job;
+    bit cancelled;
+    bit failed; // It threw.
+   };
+   ds::List<Finished> finished; // Waiting for Done.
+   bit quit;
+
+   JobProgress prog;
+   time::Progress snapshot;
+   bit fresh; // true if the snapshot has changed since it was shown.
+
+  Worker worker;
+
+  // Gui thread only...
+   time::Progress * showing; // From bar.Begin(), null if the bar is idle.
+   str::String lastStatus;
+
+  void Tick(gui::Base * obj,gui::Event * event);
+};
+
+//------------------------------------------------------------------------------
+// Makes a copy of a Var in another core, so data can be moved between the gui
+// and a jobs private core. The fields are matched up by name.
+svt::Var * CopyVar(svt::Core & core,svt::Var * var);
+
+//------------------------------------------------------------------------------
+#endif
@@ -17,6 +17,7 @@
 
 
 #include "cyclops/main.h"
+#include "cyclops/jobs.h"
 #include "cyclops/intrinsic.h"
 #include "cyclops/protractor.h"
 #include "cyclops/fundamental.h"
@@ -61,7 +62,8 @@
 //------------------------------------------------------------------------------
 // Code for cyclops class...
 Cyclops::Cyclops()
-:tokTab(),core(tokTab),guiFact(tokTab),app(null<gui::App*>()),win(null<gui::Window*>())
+:tokTab(),core(tokTab),guiFact(tokTab),app(null<gui::App*>()),win(null<gui::Window*>()),
+jobs(null<JobRunner*>())
 {
  if (guiFact.Active()==false) return;
 
@@ -74,7 +76,7 @@ Cyclops::Cyclops()
 
   gui::Grid * grid = static_cast<gui::Grid*>(guiFact.Make("Grid"));
   win->SetChild(grid);
-  grid->SetDims(6,3);
+  grid->SetDims(6,4);
 
 
   prog = static_cast<gui::ProgressBar*>(guiFact.Make("ProgressBar"));
@@ -108,6 +110,21 @@ Cyclops::Cyclops()
   grid->Attach(5,2,vert11);
 
 
+ // The background job runner, with its own progress bar...
+  gui::Horizontal * horiz1 = static_cast<gui::Horizontal*>(guiFact.Make("Horizontal"));
+  grid->Attach(0,3,horiz1,6);
+
+  gui::Label * jobStatus = static_cast<gui::Label*>(guiFact.Make("Label"));
+  gui::ProgressBar * jobProg = static_cast<gui::ProgressBar*>(guiFact.Make("ProgressBar"));
+  gui::Button * jobCancel = static_cast<gui::Button*>(guiFact.Make("Button"));
+  gui::Label * jobLab = static_cast<gui::Label*>(guiFact.Make("Label"));
+  jobProg->SetSize(128,24);
+  jobCancel->SetChild(jobLab); jobLab->Set("Cancel");
+  horiz1->AttachRight(jobProg);
+  horiz1->AttachRight(jobCancel,false);
+  horiz1->AttachRight(jobStatus,false);
+
+
   gui::Button * but1 = static_cast<gui::Button*>(guiFact.Make("Button"));
   gui::Button * but2 = static_cast<gui::Button*>(guiFact.Make("Button"));
   gui::Button * but3 = static_cast<gui::Button*>(guiFact.Make("Button"));
@@ -381,12 +398,16 @@ Cyclops::Cyclops()
   but49->OnClick(MakeCB(this,&Cyclops::StartStereoSfS));
   but50->OnClick(MakeCB(this,&Cyclops::StartAlbedoEst));
 
+  jobs = new JobRunner(*app,*jobProg,*jobStatus);
+  jobCancel->OnClick(MakeCB(jobs,&JobRunner::Cancel));
+
  // Enter the message pump...
   app->Go();
 }
 
 Cyclops::~Cyclops()
 {
+ delete jobs;
  delete app;
 }
 
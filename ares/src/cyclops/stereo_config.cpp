@@ -0,0 +1,667 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "cyclops/stereo_config.h"
+
+//------------------------------------------------------------------------------
+StereoConfig::StereoConfig()
+:alg(2),post(1),augGaussian(false),altAugG(true),augFisher(false),calibration(""),
+occCost(5.0),vertCost(0.25),vertMult(0.75),errLim(1),matchLim(10.0),
+bpOccCostHigh(16.0),bpOccCostLow(8.0),bpOccLimMult(2.0),bpMatchLim(36.0),bpOccLim(6.0),bpIters(6),bpOutput(1),
+dcUseHalfX(true),dcUseHalfY(true),dcUseCorners(true),dcHalfHeight(true),
+dcDistMult(0.01),dcDiffSteps(5),dcMinimaLimit(2),dcBaseDistCap(64.0),dcDistCapMult(1.414),
+dcDistCapThreshold(0.4),dcDispRange(1),dcDoLR(true),dcDistCapDifference(0.2),
+smoothStrength(16.0),smoothCutoff(16.0),smoothWidth(2.0),smoothIters(256),
+planeRadius(0.6),planeBailOut(12),planeOcc(0.078),planeDisc(0.01),
+segSpatial(7.0),segRange(4.5),segMin(20),segRad(2),segMix(0.3),segEdge(0.9),
+polyUseHalfX(true),polyUseHalfY(true),polyUseCorners(true),
+polyDistMult(0.01),polyDiffSteps(7),polyDistCap(64.0),polyPrune(0.25),
+gaussianRadius(1),gaussianFalloff(0.25),gaussianRange(64),gaussianMult(0.4),gaussianSdMult(2.0),
+gaussianMin(0.1),gaussianMax(16.0),gaussianMinK(2.0),gaussianMaxK(32.0),gaussianIters(1000),
+agSd(7.0),agCostMult(1.0),agMin(0.1),agMax(16.0),agSdMult(3.0),
+fisherProb(0.1),fisherMult(0.1),fisherMin(0.0),fisherMax(16.0)
+{}
+
+void StereoConfig::Load(const bs::Element & root)
+{
+ StereoConfig def;
+
+ alg = root.GrabInt(":stages.alg",def.alg);
+ post = root.GrabInt(":stages.post",def.post);
+ augGaussian = root.GrabBit(":stages.gaussian",def.augGaussian);
+ altAugG = root.GrabBit(":stages.alt_gaussian",def.altAugG);
+ augFisher = root.GrabBit(":stages.fisher",def.augFisher);
+ calibration = root.GrabString(":stages.calibration",def.calibration);
+
+ occCost = root.GrabReal(":dp.occ_cost",def.occCost);
+ vertCost = root.GrabReal(":dp.vert_cost",def.vertCost);
+ vertMult = root.GrabReal(":dp.vert_mult",def.vertMult);
+ errLim = root.GrabInt(":dp.err_lim",def.errLim);
+ matchLim = root.GrabReal(":dp.match_lim",def.matchLim);
+
+ bpOccCostHigh = root.GrabReal(":bp.occ_cost_high",def.bpOccCostHigh);
+ bpOccCostLow = root.GrabReal(":bp.occ_cost_low",def.bpOccCostLow);
+ bpOccLimMult = root.GrabReal(":bp.occ_lim_mult",def.bpOccLimMult);
+ bpMatchLim = root.GrabReal(":bp.match_lim",def.bpMatchLim);
+ bpOccLim = root.GrabReal(":bp.occ_lim",def.bpOccLim);
+ bpIters = root.GrabInt(":bp.iters",def.bpIters);
+ bpOutput = root.GrabInt(":bp.output",def.bpOutput);
+
+ dcUseHalfX = root.GrabBit(":diff_corr.half_x",def.dcUseHalfX);
+ dcUseHalfY = root.GrabBit(":diff_corr.half_y",def.dcUseHalfY);
+ dcUseCorners = root.GrabBit(":diff_corr.corners",def.dcUseCorners);
+ dcHalfHeight = root.GrabBit(":diff_corr.half_height",def.dcHalfHeight);
+ dcDistMult = root.GrabReal(":diff_corr.dist_mult",def.dcDistMult);
+ dcDiffSteps = root.GrabInt(":diff_corr.diff_steps",def.dcDiffSteps);
+ dcMinimaLimit = root.GrabInt(":diff_corr.minima_limit",def.dcMinimaLimit);
+ dcBaseDistCap = root.GrabReal(":diff_corr.base_dist_cap",def.dcBaseDistCap);
+ dcDistCapMult = root.GrabReal(":diff_corr.dist_cap_mult",def.dcDistCapMult);
+ dcDistCapThreshold = root.GrabReal(":diff_corr.dist_cap_threshold",def.dcDistCapThreshold);
+ dcDispRange = root.GrabInt(":diff_corr.disp_range",def.dcDispRange);
+ dcDoLR = root.GrabBit(":diff_corr.lr",def.dcDoLR);
+ dcDistCapDifference = root.GrabReal(":diff_corr.dist_cap_difference",def.dcDistCapDifference);
+
+ smoothStrength = root.GrabReal(":smooth.strength",def.smoothStrength);
+ smoothCutoff = root.GrabReal(":smooth.cutoff",def.smoothCutoff);
+ smoothWidth = root.GrabReal(":smooth.width",def.smoothWidth);
+ smoothIters = root.GrabInt(":smooth.iters",def.smoothIters);
+
+ planeRadius = root.GrabReal(":plane.radius",def.planeRadius);
+ planeBailOut = root.GrabInt(":plane.bail_out",def.planeBailOut);
+ planeOcc = root.GrabReal(":plane.occ",def.planeOcc);
+ planeDisc = root.GrabReal(":plane.disc",def.planeDisc);
+
+ segSpatial = root.GrabReal(":seg.spatial",def.segSpatial);
+ segRange = root.GrabReal(":seg.range",def.segRange);
+ segMin = root.GrabInt(":seg.min",def.segMin);
+ segRad = root.GrabInt(":seg.radius",def.segRad);
+ segMix = root.GrabReal(":seg.mix",def.segMix);
+ segEdge = root.GrabReal(":seg.edge",def.segEdge);
+
+ polyUseHalfX = root.GrabBit(":poly.half_x",def.polyUseHalfX);
+ polyUseHalfY = root.GrabBit(":poly.half_y",def.polyUseHalfY);
+ polyUseCorners = root.GrabBit(":poly.corners",def.polyUseCorners);
+ polyDistMult = root.GrabReal(":poly.dist_mult",def.polyDistMult);
+ polyDiffSteps = root.GrabInt(":poly.diff_steps",def.polyDiffSteps);
+ polyDistCap = root.GrabReal(":poly.dist_cap",def.polyDistCap);
+ polyPrune = root.GrabReal(":poly.prune",def.polyPrune);
+
+ gaussianRadius = root.GrabInt(":gaussian.radius",def.gaussianRadius);
+ gaussianFalloff = root.GrabReal(":gaussian.falloff",def.gaussianFalloff);
+ gaussianRange = root.GrabInt(":gaussian.range",def.gaussianRange);
+ gaussianMult = root.GrabReal(":gaussian.mult",def.gaussianMult);
+ gaussianSdMult = root.GrabReal(":gaussian.sd_mult",def.gaussianSdMult);
+ gaussianMin = root.GrabReal(":gaussian.min_sd",def.gaussianMin);
+ gaussianMax = root.GrabReal(":gaussian.max_sd",def.gaussianMax);
+ gaussianMinK = root.GrabReal(":gaussian.min_k",def.gaussianMinK);
+ gaussianMaxK = root.GrabReal(":gaussian.max_k",def.gaussianMaxK);
+ gaussianIters = root.GrabInt(":gaussian.iters",def.gaussianIters);
+
+ agSd = root.GrabReal(":alt_gaussian.sd",def.agSd);
+ agCostMult = root.GrabReal(":alt_gaussian.cost_mult",def.agCostMult);
+ agMin = root.GrabReal(":alt_gaussian.min_sd",def.agMin);
+ agMax = root.GrabReal(":alt_gaussian.max_sd",def.agMax);
+ agSdMult = root.GrabReal(":alt_gaussian.sd_mult",def.agSdMult);
+
+ fisherProb = root.GrabReal(":fisher.prob",def.fisherProb);
+ fisherMult = root.GrabReal(":fisher.mult",def.fisherMult);
+ fisherMin = root.GrabReal(":fisher.min_k",def.fisherMin);
+ fisherMax = root.GrabReal(":fisher.max_k",def.fisherMax);
+}
+
+bit StereoConfig::Load(cstrconst fn)
+{
+ str::TokenTable tt;
+ bs::Element * root = file::LoadXML(tt,fn);
+ if (root==null<bs::Element*>()) return false;
+
+ Load(*root);
+ delete root;
+
+ return true;
+}
+
+void StereoConfig::Save(bs::Element & root) const
+{
+ bs::Element * stages = root.NewChild("stages");
+  stages->SetAttribute("alg",int32(alg));
+  stages->SetAttribute("post",int32(post));
+  stages->SetAttribute("gaussian",augGaussian);
+  stages->SetAttribute("alt_gaussian",altAugG);
+  stages->SetAttribute("fisher",augFisher);
+  stages->SetAttribute("calibration",calibration);
+
+ bs::Element * dp = root.NewChild("dp");
+  dp->SetAttribute("occ_cost",occCost);
+  dp->SetAttribute("vert_cost",vertCost);
+  dp->SetAttribute("vert_mult",vertMult);
+  dp->SetAttribute("err_lim",int32(errLim));
+  dp->SetAttribute("match_lim",matchLim);
+
+ bs::Element * bp = root.NewChild("bp");
+  bp->SetAttribute("occ_cost_high",bpOccCostHigh);
+  bp->SetAttribute("occ_cost_low",bpOccCostLow);
+  bp->SetAttribute("occ_lim_mult",bpOccLimMult);
+  bp->SetAttribute("match_lim",bpMatchLim);
+  bp->SetAttribute("occ_lim",bpOccLim);
+  bp->SetAttribute("iters",int32(bpIters));
+  bp->SetAttribute("output",int32(bpOutput));
+
+ bs::Element * dc = root.NewChild("diff_corr");
+  dc->SetAttribute("half_x",dcUseHalfX);
+  dc->SetAttribute("half_y",dcUseHalfY);
+  dc->SetAttribute("corners",dcUseCorners);
+  dc->SetAttribute("half_height",dcHalfHeight);
+  dc->SetAttribute("dist_mult",dcDistMult);
+  dc->SetAttribute("diff_steps",int32(dcDiffSteps));
+  dc->SetAttribute("minima_limit",int32(dcMinimaLimit));
+  dc->SetAttribute("base_dist_cap",dcBaseDistCap);
+  dc->SetAttribute("dist_cap_mult",dcDistCapMult);
+  dc->SetAttribute("dist_cap_threshold",dcDistCapThreshold);
+  dc->SetAttribute("disp_range",int32(dcDispRange));
+  dc->SetAttribute("lr",dcDoLR);
+  dc->SetAttribute("dist_cap_difference",dcDistCapDifference);
+
+ bs::Element * smooth = root.NewChild("smooth");
+  smooth->SetAttribute("strength",smoothStrength);
+  smooth->SetAttribute("cutoff",smoothCutoff);
+  smooth->SetAttribute("width",smoothWidth);
+  smooth->SetAttribute("iters",int32(smoothIters));
+
+ bs::Element * plane = root.NewChild("plane");
+  plane->SetAttribute("radius",planeRadius);
+  plane->SetAttribute("bail_out",int32(planeBailOut));
+  plane->SetAttribute("occ",planeOcc);
+  plane->SetAttribute("disc",planeDisc);
+
+ bs::Element * seg = root.NewChild("seg");
+  seg->SetAttribute("spatial",segSpatial);
+  seg->SetAttribute("range",segRange);
+  seg->SetAttribute("min",int32(segMin));
+  seg->SetAttribute("radius",int32(segRad));
+  seg->SetAttribute("mix",segMix);
+  seg->SetAttribute("edge",segEdge);
+
+ bs::Element * poly = root.NewChild("poly");
+  poly->SetAttribute("half_x",polyUseHalfX);
+  poly->SetAttribute("half_y",polyUseHalfY);
+  poly->SetAttribute("corners",polyUseCorners);
+  poly->SetAttribute("dist_mult",polyDistMult);
+  poly->SetAttribute("diff_steps",int32(polyDiffSteps));
+  poly->SetAttribute("dist_cap",polyDistCap);
+  poly->SetAttribute("prune",polyPrune);
+
+ bs::Element * gaussian = root.NewChild("gaussian");
+  gaussian->SetAttribute("radius",int32(gaussianRadius));
+  gaussian->SetAttribute("falloff",gaussianFalloff);
+  gaussian->SetAttribute("range",int32(gaussianRange));
+  gaussian->SetAttribute("mult",gaussianMult);
+  gaussian->SetAttribute("sd_mult",gaussianSdMult);
+  gaussian->SetAttribute("min_sd",gaussianMin);
+  gaussian->SetAttribute("max_sd",gaussianMax);
+  gaussian->SetAttribute("min_k",gaussianMinK);
+  gaussian->SetAttribute("max_k",gaussianMaxK);
+  gaussian->SetAttribute("iters",int32(gaussianIters));
+
+ bs::Element * ag = root.NewChild("alt_gaussian");
+  ag->SetAttribute("sd",agSd);
+  ag->SetAttribute("cost_mult",agCostMult);
+  ag->SetAttribute("min_sd",agMin);
+  ag->SetAttribute("max_sd",agMax);
+  ag->SetAttribute("sd_mult",agSdMult);
+
+ bs::Element * fisher = root.NewChild("fisher");
+  fisher->SetAttribute("prob",fisherProb);
+  fisher->SetAttribute("mult",fisherMult);
+  fisher->SetAttribute("min_k",fisherMin);
+  fisher->SetAttribute("max_k",fisherMax);
+}
+
+bit StereoConfig::Save(cstrconst fn,bit overwrite) const
+{
+ str::TokenTable tt;
+ bs::Element root(tt,"stereopsis");
+
+ Save(root);
+
+ return file::SaveXML(&root,fn,overwrite);
+}
+
+//------------------------------------------------------------------------------
+svt::Var * LoadStereoImage(svt::Core & core,cstrconst fn)
+{
+ svt::Var * ret = filter::LoadImageRGB(core,fn);
+ if (ret==null<svt::Var*>()) return null<svt::Var*>();
+
+ bit maskIni = true;
+ ret->Add("mask",maskIni);
+ ret->Commit();
+
+ svt::Field<bs::ColourRGB> image(ret,"rgb");
+ svt::Field<bit> mask(ret,"mask");
+ for (nat32 y=0;y<mask.Size(1);y++)
+ {
+  for (nat32 x=0;x<mask.Size(0);x++)
+  {
+   if (math::Equal(image.Get(x,y).r,real32(1.0))&&
+       math::Equal(image.Get(x,y).g,real32(0.0))&&
+       math::Equal(image.Get(x,y).b,real32(1.0)))
+   {
+    mask.Get(x,y) = false;
+   }
+  }
+ }
+
+ return ret;
+}
+
+//------------------------------------------------------------------------------
+// Fills in disp and mask with the lowest cost match of each pixel in a DSI. If
+// single is true only pixels with exactly one match are used...
+static void StereoBest(stereo::DSI * dsi,svt::Field<real32> & disp,svt::Field<bit> & mask,bit single = false)
+{
+ for (nat32 y=0;y<disp.Size(1);y++)
+ {
+  for (nat32 x=0;x<disp.Size(0);x++)
+  {
+   if ((single==false)?(dsi->Size(x,y)!=0):(dsi->Size(x,y)==1))
+   {
+    real32 bestCost = dsi->Cost(x,y,0);
+    disp.Get(x,y) = dsi->Disp(x,y,0);
+    for (nat32 i=1;i<dsi->Size(x,y);i++)
+    {
+     if (dsi->Cost(x,y,i)<bestCost)
+     {
+      bestCost = dsi->Cost(x,y,i);
+      disp.Get(x,y) = dsi->Disp(x,y,i);
+     }
+    }
+    mask.Get(x,y) = true;
+   }
+   else
+   {
+    disp.Get(x,y) = 0.0;
+    mask.Get(x,y) = false;
+   }
+  }
+ }
+}
+
+// Fits standard deviations to a disparity map, with whichever Gaussian fitter
+// is configured...
+static void StereoGaussian(const StereoConfig & cfg,svt::Field<bs::ColourLuv> & leftLuv,svt::Field<bs::ColourLuv> & rightLuv,
+                           svt::Field<real32> & disp,svt::Field<bit> & mask,svt::Field<real32> & sd,time::Progress * prog)
+{
+ stereo::LuvDSC luvDSC(leftLuv,rightLuv);
+ stereo::RegionDSC regionDSC(&luvDSC,cfg.gaussianRadius,cfg.gaussianFalloff);
+
+ if (cfg.altAugG)
+ {
+  fit::LaplaceDispNorm laplaceDispNorm;
+  laplaceDispNorm.Set(disp,regionDSC,cfg.agCostMult);
+  laplaceDispNorm.SetMask(mask);
+  laplaceDispNorm.SetParam(cfg.agSd,cfg.agMin,cfg.agMax,cfg.agSdMult);
+
+  laplaceDispNorm.Run(prog);
+
+  laplaceDispNorm.Get(sd);
+ }
+ else
+ {
+  fit::DispNorm dispNorm;
+  dispNorm.Set(disp,regionDSC,cfg.gaussianMult);
+  dispNorm.SetMask(mask);
+  dispNorm.SetRange(cfg.gaussianRange,cfg.gaussianSdMult);
+  dispNorm.SetClampK(cfg.gaussianMinK,cfg.gaussianMaxK);
+  dispNorm.SetClamp(cfg.gaussianMin,cfg.gaussianMax);
+  dispNorm.SetMaxIters(cfg.gaussianIters);
+
+  dispNorm.Run(prog);
+
+  dispNorm.Get(sd);
+ }
+}
+
+svt::Var * RunStereo(svt::Core & core,const StereoConfig & cfg,
+                     svt::Var * leftImg,svt::Var * rightImg,
+                     svt::Var * existing,svt::Var * segmentation,
+                     const cam::CameraPair & pair,time::Progress * prog,
+                     StereoTiming * timing)
+{
+ StereoTiming dummy;
+ if (timing==null<StereoTiming*>()) timing = &dummy;
+ timing->luv = 0.0;
+ timing->dsi = 0.0;
+ timing->post = 0.0;
+ timing->gaussian = 0.0;
+ timing->fisher = 0.0;
+
+ if ((cfg.alg==0)&&(existing==null<svt::Var*>())) return null<svt::Var*>();
+ real64 start = time::UltraTime();
+
+
+ // Create luv fields for both images, as needed...
+  if (!leftImg->Exists("luv"))
+  {
+   bs::ColourLuv luvIni(0.0,0.0,0.0);
+   leftImg->Add("luv",luvIni);
+   leftImg->Commit();
+   filter::RGBtoLuv(leftImg);
+  }
+
+  if (!rightImg->Exists("luv"))
+  {
+   bs::ColourLuv luvIni(0.0,0.0,0.0);
+   rightImg->Add("luv",luvIni);
+   rightImg->Commit();
+   filter::RGBtoLuv(rightImg);
+  }
+
+  real64 end = time::UltraTime();
+  timing->luv = end - start;
+  start = end;
+  if (prog->Cancelling()) return null<svt::Var*>();
+
+
+ // Create the result to extract into...
+  bit aGaussian = cfg.augGaussian;
+  bit aFisher = cfg.augFisher;
+  if (aFisher) aGaussian = true; // Need Gaussian as input - might as well force it as storage is cheap.
+
+  svt::Var * result = new svt::Var(core);
+  result->Setup2D(leftImg->Size(0),leftImg->Size(1));
+  real32 dispIni = 0.0;
+  bit maskIni = true;
+  math::Fisher fishIni;
+  result->Add("disp",dispIni);
+  result->Add("mask",maskIni);
+  if (aGaussian) result->Add("sd",dispIni);
+  if (aFisher) result->Add("fish",fishIni);
+  result->Commit(false);
+
+  svt::Field<real32> disp(result,"disp");
+  svt::Field<bit> mask(result,"mask");
+  svt::Field<real32> sd(result,"sd");
+  svt::Field<math::Fisher> fish(result,"fish");
+
+
+ // Prep progress bar...
+  nat32 step = 0;
+  nat32 steps = 0;
+  if (cfg.alg!=0) steps += 1;
+  switch (cfg.post)
+  {
+   case 1: steps += 2; break; // Smoothing. (Has sd fitting step.)
+   case 2: steps += 1; break; // Plane fit + Seg
+   case 3: steps += 1; break; // Poly fitting
+  }
+  if (aGaussian) steps += 1;
+  if (aFisher) steps += 1;
+
+
+ // Run the algorithm...
+  stereo::DSC * dsc = null<stereo::DSC*>();
+  stereo::DSI * dsi = null<stereo::DSI*>();
+
+  svt::Field<bs::ColourLuv> leftLuv(leftImg,"luv");
+  svt::Field<bs::ColourLuv> rightLuv(rightImg,"luv");
+  svt::Field<bit> leftMask(leftImg,"mask");
+  svt::Field<bit> rightMask(rightImg,"mask");
+
+  switch (cfg.alg)
+  {
+   case 0: // Existing...
+   {
+    // Create a dsi to expose the existing disparity map correctly...
+     svt::Field<real32> dispEx(existing,"disp");
+     svt::Field<bit> maskEx(existing,"mask");
+
+     dsi = new stereo::DummyDSI(dispEx,&maskEx);
+   }
+   break;
+   case 1: // Hierachical DP...
+   {
+    prog->Report(step++,steps);
+
+    stereo::SparseDSI2 * sdsi = new stereo::SparseDSI2();
+    dsi = sdsi;
+
+    sdsi->Set(cfg.occCost,cfg.vertCost,cfg.vertMult,cfg.errLim);
+    dsc = new stereo::HalfBoundLuvDSC(leftLuv,rightLuv,1.0,cfg.matchLim);
+    sdsi->Set(dsc);
+    sdsi->Set(leftMask,rightMask);
+
+    sdsi->Run(prog);
+   }
+   break;
+   case 2: // Hierachical BP...
+   {
+    prog->Report(step++,steps);
+
+    stereo::HEBP * sdsi = new stereo::HEBP();
+    dsi = sdsi;
+
+    real32 costCap = cfg.bpOccLim;
+    real32 occCostBase = cfg.bpOccCostHigh;
+    real32 occCostMult = (cfg.bpOccCostLow-occCostBase) / costCap;
+
+    sdsi->Set(occCostBase,occCostMult,cfg.bpOccLimMult,cfg.bpIters,cfg.bpOutput);
+    dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,cfg.bpMatchLim);
+    sdsi->Set(dsc);
+    stereo::LuvDSC dscOcc(leftLuv,rightLuv,1.0,costCap);
+    sdsi->SetOcc(&dscOcc);
+    sdsi->Set(leftMask,rightMask);
+
+    sdsi->Run(prog);
+   }
+   break;
+   case 3: // Diffusion correlation
+   {
+    prog->Report(step++,steps);
+
+    stereo::DiffCorrStereo * dcs = new stereo::DiffCorrStereo();
+    dsi = dcs;
+
+    dcs->SetImages(leftLuv,rightLuv);
+    dcs->SetMasks(leftMask,rightMask);
+    dcs->SetPyramid(cfg.dcUseHalfX,cfg.dcUseHalfY,cfg.dcUseCorners,cfg.dcHalfHeight);
+    dcs->SetDiff(cfg.dcDistMult,cfg.dcDiffSteps);
+    dcs->SetCorr(cfg.dcMinimaLimit,cfg.dcBaseDistCap,cfg.dcDistCapMult,cfg.dcDistCapThreshold,cfg.dcDispRange);
+    dcs->SetRefine(cfg.dcDoLR,cfg.dcDistCapDifference);
+
+    dcs->Run(prog);
+   }
+   break;
+  }
+
+  end = time::UltraTime();
+  timing->dsi = end - start;
+  start = end;
+
+ // Cancellation is checked for between stages, everything made so far being
+ // deleted...
+  if (prog->Cancelling())
+  {
+   delete dsc;
+   delete dsi;
+   delete result;
+   return null<svt::Var*>();
+  }
+
+
+ // Run the post-proccessor...
+  switch (cfg.post)
+  {
+   case 0: // None - simply select the best...
+   {
+    StereoBest(dsi,disp,mask);
+   }
+   break;
+   case 1: // Smoothing...
+   {
+    prog->Report(step++,steps);
+
+    // Extract a disparity map...
+     StereoBest(dsi,disp,mask);
+
+    // Create tempory standard deviation storage...
+     svt::Var sdTemp(leftLuv);
+     {
+      real32 realIni = 0.0;
+      sdTemp.Add("sd",realIni);
+      sdTemp.Commit();
+     }
+     svt::Field<real32> sdOR(&sdTemp,"sd");
+
+    // Calculate standard deviations for the disparity values...
+     StereoGaussian(cfg,leftLuv,rightLuv,disp,leftMask,sdOR,prog);
+
+    // Smooth it...
+     prog->Report(step++,steps);
+     stereo::CleanDSI cdsi;
+     cdsi.Set(leftLuv);
+     cdsi.Set(*dsi);
+     cdsi.SetMask(leftMask);
+     cdsi.SetSD(sdOR);
+     cdsi.Set(cfg.smoothStrength,cfg.smoothCutoff,cfg.smoothWidth,cfg.smoothIters);
+
+     cdsi.Run(prog);
+
+     cdsi.GetMap(disp);
+
+     for (nat32 y=0;y<disp.Size(1);y++)
+     {
+      for (nat32 x=0;x<disp.Size(0);x++)
+      {
+       mask.Get(x,y) = math::IsFinite(disp.Get(x,y))&&leftMask.Get(x,y);
+      }
+     }
+   }
+   break;
+   case 2: // Plane fitting...
+   {
+    prog->Report(step++,steps);
+    // First fill in the disparity map and mask from the result, so we can pass
+    // them to the Bleyer04 algorithm as overrides...
+     StereoBest(dsi,disp,mask);
+
+    // Create the Bleyers04 object, set parameters...
+     svt::Field<bs::ColourRGB> leftRGB(leftImg,"rgb");
+     svt::Field<bs::ColourRGB> rightRGB(rightImg,"rgb");
+
+     stereo::Bleyer04 bleyer;
+     bleyer.SetImages(leftRGB,rightRGB);
+     bleyer.BootOverride(disp,mask);
+     bleyer.SetMasks(leftMask,rightMask);
+     bleyer.SetPlaneRadius(cfg.planeRadius);
+     bleyer.SetWarpCost(cfg.planeOcc,cfg.planeDisc);
+     bleyer.SetBailOut(cfg.planeBailOut);
+     bleyer.SetSegment(cfg.segSpatial,cfg.segRange,cfg.segMin);
+     bleyer.SetSegmentExtra(cfg.segRad,cfg.segMix,cfg.segEdge);
+
+     if ((segmentation!=null<svt::Var*>())&&
+         (segmentation->Size(0)==leftImg->Size(0))&&
+         (segmentation->Size(1)==leftImg->Size(1)))
+     {
+      svt::Field<nat32> segs(segmentation,"seg");
+      bleyer.SegmentOverride(segs);
+     }
+
+    // Run...
+     bleyer.Run(prog);
+
+    // Extract the results...
+     bleyer.GetDisparity(disp);
+     mask.CopyFrom(leftMask);
+   }
+   break;
+   case 3: // Polynomial fitting...
+   {
+    prog->Report(step++,steps);
+
+    // First run the selection of best code, but drop any where there is more than 1 match...
+     StereoBest(dsi,disp,mask,true);
+
+    // Now do the refinement...
+     stereo::DiffCorrRefine dcr;
+     dcr.SetImages(leftLuv,rightLuv);
+     dcr.SetMasks(leftMask,rightMask);
+     dcr.SetDisparity(disp);
+     dcr.SetDisparityMask(mask);
+     dcr.SetFlags(cfg.polyUseHalfX,cfg.polyUseHalfY,cfg.polyUseCorners);
+     dcr.SetDiff(cfg.polyDistMult,cfg.polyDiffSteps);
+     dcr.SetDist(cfg.polyDistCap,cfg.polyPrune);
+
+     dcr.Run(prog);
+
+     dcr.GetDisp(disp);
+     dcr.GetMask(mask);
+   }
+   break;
+  }
+
+  delete dsc;
+  delete dsi;
+
+  end = time::UltraTime();
+  timing->post = end - start;
+  start = end;
+  if (prog->Cancelling()) {delete result; return null<svt::Var*>();}
+
+
+ // If needed augment with standard deviations...
+  if (aGaussian)
+  {
+   prog->Report(step++,steps);
+   // The alternate fitter has allways been given the image mask rather than
+   // the disparity mask...
+    if (cfg.altAugG) StereoGaussian(cfg,leftLuv,rightLuv,disp,leftMask,sd,prog);
+                else StereoGaussian(cfg,leftLuv,rightLuv,disp,mask,sd,prog);
+
+   end = time::UltraTime();
+   timing->gaussian = end - start;
+   start = end;
+   if (prog->Cancelling()) {delete result; return null<svt::Var*>();}
+  }
+
+
+ // If needed augment with Fisher distributions...
+  if (aFisher)
+  {
+   prog->Report(step++,steps);
+
+   fit::DispNormFish dnf;
+   dnf.Set(disp,sd);
+   dnf.SetMask(mask);
+   dnf.SetPair(pair);
+   dnf.SetRegion(cfg.fisherProb,cfg.fisherMult);
+   dnf.SetRange(cfg.fisherMin,cfg.fisherMax);
+
+   dnf.Run(prog);
+
+   dnf.Get(fish);
+
+   end = time::UltraTime();
+   timing->fisher = end - start;
+   if (prog->Cancelling()) {delete result; return null<svt::Var*>();}
+  }
+
+ return result;
+}
+
+//------------------------------------------------------------------------------
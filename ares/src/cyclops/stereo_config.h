@@ -0,0 +1,164 @@
+#ifndef CYCLOPS_STEREO_CONFIG_H
+#define CYCLOPS_STEREO_CONFIG_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos.h"
+
+using namespace eos;
+
+//------------------------------------------------------------------------------
+// All the parameters of the stereopsis tool, seperated from the gui so the
+// stereo_batch tool can run exactly the same stages. Defaults match the values
+// the gui starts with. Saved as xml, with an element per group of parameters.
+class StereoConfig
+{
+ public:
+   StereoConfig();
+
+  void Load(const bs::Element & root);
+  bit Load(cstrconst fn);
+  void Save(bs::Element & root) const;
+  bit Save(cstrconst fn,bit overwrite = false) const;
+
+
+  // Which stages to run...
+   nat32 alg; // 0 = existing, 1 = hierarchical DP, 2 = hierarchical BP, 3 = diffusion correlation.
+   nat32 post; // 0 = none, 1 = smoothing, 2 = seg & plane fit, 3 = poly diffusion.
+   bit augGaussian;
+   bit altAugG;
+   bit augFisher;
+   str::String calibration; // .pcc file for the Fisher augmentation, can be empty.
+
+  // Hierarchical DP...
+   real32 occCost;
+   real32 vertCost;
+   real32 vertMult;
+   nat32 errLim;
+   real32 matchLim;
+
+  // Hierarchical BP...
+   real32 bpOccCostHigh;
+   real32 bpOccCostLow;
+   real32 bpOccLimMult;
+   real32 bpMatchLim;
+   real32 bpOccLim;
+   nat32 bpIters;
+   nat32 bpOutput;
+
+  // Diffusion correlation...
+   bit dcUseHalfX;
+   bit dcUseHalfY;
+   bit dcUseCorners;
+   bit dcHalfHeight;
+   real32 dcDistMult;
+   nat32 dcDiffSteps;
+   nat32 dcMinimaLimit;
+   real32 dcBaseDistCap;
+   real32 dcDistCapMult;
+   real32 dcDistCapThreshold;
+   nat32 dcDispRange;
+   bit dcDoLR;
+   real32 dcDistCapDifference;
+
+  // Smoothing...
+   real32 smoothStrength;
+   real32 smoothCutoff;
+   real32 smoothWidth;
+   nat32 smoothIters;
+
+  // Seg & plane fit...
+   real32 planeRadius;
+   nat32 planeBailOut;
+   real32 planeOcc;
+   real32 planeDisc;
+
+   real32 segSpatial;
+   real32 segRange;
+   nat32 segMin;
+   nat32 segRad;
+   real32 segMix;
+   real32 segEdge;
+
+  // Poly diffusion...
+   bit polyUseHalfX;
+   bit polyUseHalfY;
+   bit polyUseCorners;
+   real32 polyDistMult;
+   nat32 polyDiffSteps;
+   real32 polyDistCap;
+   real32 polyPrune;
+
+  // Gaussian fitting...
+   nat32 gaussianRadius;
+   real32 gaussianFalloff;
+   nat32 gaussianRange;
+   real32 gaussianMult;
+   real32 gaussianSdMult;
+   real32 gaussianMin;
+   real32 gaussianMax;
+   real32 gaussianMinK;
+   real32 gaussianMaxK;
+   nat32 gaussianIters;
+
+  // Alternate Gaussian fitting...
+   real32 agSd;
+   real32 agCostMult;
+   real32 agMin;
+   real32 agMax;
+   real32 agSdMult;
+
+  // Fisher augmentation...
+   real32 fisherProb;
+   real32 fisherMult;
+   real32 fisherMin;
+   real32 fisherMax;
+};
+
+//------------------------------------------------------------------------------
+// Seconds spent in each stage of RunStereo, 0 for stages not run.
+struct StereoTiming
+{
+ real32 luv;
+ real32 dsi;
+ real32 post;
+ real32 gaussian;
+ real32 fisher;
+};
+
+//------------------------------------------------------------------------------
+// Loads an image for stereopsis, with an rgb field and a mask field that is
+// false wherever the image is magenta. Returns null on failure.
+svt::Var * LoadStereoImage(svt::Core & core,cstrconst fn);
+
+// Runs stereopsis as configured on a pair of images from LoadStereoImage, adding
+// luv fields to them if they do not allready have them. existing is only used
+// when alg is 0, segmentation only by the plane fit, and may be null in which
+// case the plane fit segments itself. pair is only used by the Fisher
+// augmentation. Returns a new Var with fields disp and mask, plus sd and fish
+// when augmented, or null if alg is 0 without an existing disparity map, or if
+// prog is cancelled, which is checked for between stages. If timing is provided
+// it is filled in.
+svt::Var * RunStereo(svt::Core & core,const StereoConfig & cfg,
+                     svt::Var * leftImg,svt::Var * rightImg,
+                     svt::Var * existing,svt::Var * segmentation,
+                     const cam::CameraPair & pair,time::Progress * prog,
+                     StereoTiming * timing = null<StereoTiming*>());
+
+//------------------------------------------------------------------------------
+#endif
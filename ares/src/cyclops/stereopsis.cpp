@@ -23,7 +23,7 @@ Stereopsis::Stereopsis(Cyclops & cyc)
 :cyclops(cyc),win(null<gui::Window*>()),
 leftVar(null<svt::Var*>()),rightVar(null<svt::Var*>()),
 leftImg(null<svt::Var*>()),rightImg(null<svt::Var*>()),existing(null<svt::Var*>()),
-result(null<svt::Var*>()),segmentation(null<svt::Var*>())
+result(null<svt::Var*>()),segmentation(null<svt::Var*>()),imageGen(0)
 {
  // Create default images...
   leftVar = new svt::Var(cyclops.Core());
@@ -84,6 +84,11 @@ result(null<svt::Var*>()),segmentation(null<svt::Var*>())
    but4->SetChild(lab4); lab4->Set("Save Disparity...");
    horiz1->AttachRight(but4,false);
 
+   gui::Button * but8 = static_cast<gui::Button*>(cyclops.Fact().Make("Button"));
+   gui::Label * lab8b = static_cast<gui::Label*>(cyclops.Fact().Make("Label"));
+   but8->SetChild(lab8b); lab8b->Set("Save Settings...");
+   horiz1->AttachRight(but8,false);
+
    
    gui::Horizontal * horiz6 = static_cast<gui::Horizontal*>(cyclops.Fact().Make("Horizontal"));
    vert1->AttachBottom(horiz6,false);
@@ -804,10 +809,12 @@ result(null<svt::Var*>()),segmentation(null<svt::Var*>())
   but5->OnClick(MakeCB(this,&Stereopsis::LoadCalibration));
   but6->OnClick(MakeCB(this,&Stereopsis::LoadSeg));
   but7->OnClick(MakeCB(this,&Stereopsis::LoadExisting));
+  but8->OnClick(MakeCB(this,&Stereopsis::SaveConfig));
 }
 
 Stereopsis::~Stereopsis()
 {
+ cyclops.Jobs().Remove(this);
  delete win;
  delete leftVar;
  delete rightVar;
@@ -861,33 +868,15 @@ void Stereopsis::LoadLeft(gui::Base * obj,gui::Event * event)
   // Load image into memory...
    cstr filename = fn.ToStr();
    delete leftImg;
-   leftImg = filter::LoadImageRGB(cyclops.Core(),filename);
+   leftImg = LoadStereoImage(cyclops.Core(),filename);
    mem::Free(filename);
+   ++imageGen;
    if (leftImg==null<svt::Var*>())
    {
     cyclops.App().MessageDialog(gui::App::MsgErr,"Failed to load image");
     return;
    }
-
-  // Create a mask for the image...
-   bit maskIni = true;
-   leftImg->Add("mask",maskIni);
-   leftImg->Commit();
-
    svt::Field<bs::ColourRGB> floatImage(leftImg,"rgb");
-   svt::Field<bit> floatMask(leftImg,"mask");
-   for (nat32 y=0;y<floatMask.Size(1);y++)
-   {
-    for (nat32 x=0;x<floatMask.Size(0);x++)
-    {
-     if (math::Equal(floatImage.Get(x,y).r,real32(1.0))&&
-         math::Equal(floatImage.Get(x,y).g,real32(0.0))&&
-         math::Equal(floatImage.Get(x,y).b,real32(1.0)))
-     {
-      floatMask.Get(x,y) = false;
-     }
-    }
-   }
 
 
   // Image loaded, but its not in a format suitable for fast display - convert...
@@ -922,34 +911,15 @@ void Stereopsis::LoadRight(gui::Base * obj,gui::Event * event)
   // Load image into memory...
    cstr filename = fn.ToStr();
    delete rightImg;
-   rightImg = filter::LoadImageRGB(cyclops.Core(),filename);
+   rightImg = LoadStereoImage(cyclops.Core(),filename);
    mem::Free(filename);
+   ++imageGen;
    if (rightImg==null<svt::Var*>())
    {
     cyclops.App().MessageDialog(gui::App::MsgErr,"Failed to load image");
     return;
    }
-
-
-  // Create a mask for the image...
-   bit maskIni = true;
-   rightImg->Add("mask",maskIni);
-   rightImg->Commit();
-
    svt::Field<bs::ColourRGB> floatImage(rightImg,"rgb");
-   svt::Field<bit> floatMask(rightImg,"mask");
-   for (nat32 y=0;y<floatMask.Size(1);y++)
-   {
-    for (nat32 x=0;x<floatMask.Size(0);x++)
-    {
-     if (math::Equal(floatImage.Get(x,y).r,real32(1.0))&&
-         math::Equal(floatImage.Get(x,y).g,real32(0.0))&&
-         math::Equal(floatImage.Get(x,y).b,real32(1.0)))
-     {
-      floatMask.Get(x,y) = false;
-     }
-    }
-   }
 
 
   // Image loaded, but its not in a format suitable for fast display - convert...
@@ -985,6 +955,7 @@ void Stereopsis::LoadCalibration(gui::Base * obj,gui::Event * event)
   {
    cyclops.App().MessageDialog(gui::App::MsgErr,"Failed to load pcc file");
   }
+  else pairFn = fn;
   pair.LeftToDefault();
  }
 }
@@ -1150,535 +1121,221 @@ void Stereopsis::SwitchFisher(gui::Base * obj,gui::Event * event)
  ChangePost(obj,event);
 }
 
+void Stereopsis::GetConfig(StereoConfig & out)
+{
+ out.alg = whichAlg->Get();
+ out.post = whichPost->Get();
+ out.augGaussian = augGaussian->Ticked();
+ out.altAugG = altAugG->Ticked();
+ out.augFisher = augFisher->Ticked();
+ out.calibration = pairFn;
+
+ out.occCost = occCost->GetReal(out.occCost);
+ out.vertCost = vertCost->GetReal(out.vertCost);
+ out.vertMult = vertMult->GetReal(out.vertMult);
+ out.errLim = errLim->GetInt(out.errLim);
+ out.matchLim = matchLim->GetReal(out.matchLim);
+
+ out.bpOccCostHigh = bpOccCostHigh->GetReal(out.bpOccCostHigh);
+ out.bpOccCostLow = bpOccCostLow->GetReal(out.bpOccCostLow);
+ out.bpOccLimMult = bpOccLimMult->GetReal(out.bpOccLimMult);
+ out.bpMatchLim = bpMatchLim->GetReal(out.bpMatchLim);
+ out.bpOccLim = bpOccLim->GetReal(out.bpOccLim);
+ out.bpIters = bpIters->GetInt(out.bpIters);
+ out.bpOutput = bpOutput->GetInt(out.bpOutput);
+
+ out.dcUseHalfX = dcUseHalfX->Ticked();
+ out.dcUseHalfY = dcUseHalfY->Ticked();
+ out.dcUseCorners = dcUseCorners->Ticked();
+ out.dcHalfHeight = dcHalfHeight->Ticked();
+ out.dcDistMult = dcDistMult->GetReal(out.dcDistMult);
+ out.dcDiffSteps = dcDiffSteps->GetInt(out.dcDiffSteps);
+ out.dcMinimaLimit = dcMinimaLimit->GetInt(out.dcMinimaLimit);
+ out.dcBaseDistCap = dcBaseDistCap->GetReal(out.dcBaseDistCap);
+ out.dcDistCapMult = dcDistCapMult->GetReal(out.dcDistCapMult);
+ out.dcDistCapThreshold = dcDistCapThreshold->GetReal(out.dcDistCapThreshold);
+ out.dcDispRange = dcDispRange->GetInt(out.dcDispRange);
+ out.dcDoLR = dcDoLR->Ticked();
+ out.dcDistCapDifference = dcDistCapDifference->GetReal(out.dcDistCapDifference);
+
+ out.smoothStrength = smoothStrength->GetReal(out.smoothStrength);
+ out.smoothCutoff = smoothCutoff->GetReal(out.smoothCutoff);
+ out.smoothWidth = smoothWidth->GetReal(out.smoothWidth);
+ out.smoothIters = smoothIters->GetInt(out.smoothIters);
+
+ out.planeRadius = planeRadius->GetReal(out.planeRadius);
+ out.planeBailOut = planeBailOut->GetInt(out.planeBailOut);
+ out.planeOcc = planeOcc->GetReal(out.planeOcc);
+ out.planeDisc = planeDisc->GetReal(out.planeDisc);
+
+ out.segSpatial = segSpatial->GetReal(out.segSpatial);
+ out.segRange = segRange->GetReal(out.segRange);
+ out.segMin = segMin->GetInt(out.segMin);
+ out.segRad = segRad->GetInt(out.segRad);
+ out.segMix = segMix->GetReal(out.segMix);
+ out.segEdge = segEdge->GetReal(out.segEdge);
+
+ out.polyUseHalfX = polyUseHalfX->Ticked();
+ out.polyUseHalfY = polyUseHalfY->Ticked();
+ out.polyUseCorners = polyUseCorners->Ticked();
+ out.polyDistMult = polyDistMult->GetReal(out.polyDistMult);
+ out.polyDiffSteps = polyDiffSteps->GetInt(out.polyDiffSteps);
+ out.polyDistCap = polyDistCap->GetReal(out.polyDistCap);
+ out.polyPrune = polyPrune->GetReal(out.polyPrune);
+
+ out.gaussianRadius = gaussianRadius->GetInt(out.gaussianRadius);
+ out.gaussianFalloff = gaussianFalloff->GetReal(out.gaussianFalloff);
+ out.gaussianRange = gaussianRange->GetInt(out.gaussianRange);
+ out.gaussianMult = gaussianMult->GetReal(out.gaussianMult);
+ out.gaussianSdMult = gaussianSdMult->GetReal(out.gaussianSdMult);
+ out.gaussianMin = gaussianMin->GetReal(out.gaussianMin);
+ out.gaussianMax = gaussianMax->GetReal(out.gaussianMax);
+ out.gaussianMinK = gaussianMinK->GetReal(out.gaussianMinK);
+ out.gaussianMaxK = gaussianMaxK->GetReal(out.gaussianMaxK);
+ out.gaussianIters = gaussianIters->GetInt(out.gaussianIters);
+
+ out.agSd = agSd->GetReal(out.agSd);
+ out.agCostMult = agCostMult->GetReal(out.agCostMult);
+ out.agMin = agMin->GetReal(out.agMin);
+ out.agMax = agMax->GetReal(out.agMax);
+ out.agSdMult = agSdMult->GetReal(out.agSdMult);
+
+ out.fisherProb = fisherProb->GetReal(out.fisherProb);
+ out.fisherMult = fisherMult->GetReal(out.fisherMult);
+ out.fisherMin = fisherMin->GetReal(out.fisherMin);
+ out.fisherMax = fisherMax->GetReal(out.fisherMax);
+}
+
 void Stereopsis::Run(gui::Base * obj,gui::Event * event)
 {
  if ((leftImg==null<svt::Var*>())||(rightImg==null<svt::Var*>()))
  {
   cyclops.App().MessageDialog(gui::App::MsgErr,"You are a slug.");
+  return;
  }
- else
- {
-  // Create luv fields for both images, as needed...
-   if (!leftImg->Exists("luv"))
-   {
-    bs::ColourLuv luvIni(0.0,0.0,0.0);
-    leftImg->Add("luv",luvIni);
-    leftImg->Commit();
-    filter::RGBtoLuv(leftImg);
-   }
 
-   if (!rightImg->Exists("luv"))
-   {
-    bs::ColourLuv luvIni(0.0,0.0,0.0);
-    rightImg->Add("luv",luvIni);
-    rightImg->Commit();
-    filter::RGBtoLuv(rightImg);
-   }
+ // Run it all in the background, with the parameters from the interface and
+ // copies of the data...
+  StereoJob * job = new StereoJob(*this);
+  GetConfig(job->cfg);
+  if ((job->cfg.alg==0)&&(existing==null<svt::Var*>()))
+  {
+   delete job;
+   cyclops.App().MessageDialog(gui::App::MsgErr,"You need to load an existing disparity map first!");
+   return;
+  }
 
+  job->pair = pair;
+  job->leftImg = CopyVar(job->core,leftImg);
+  job->rightImg = CopyVar(job->core,rightImg);
+  if (existing) job->existing = CopyVar(job->core,existing);
+  if (segmentation) job->segmentation = CopyVar(job->core,segmentation);
 
-  // Create the result to extract into...
-   bit aGaussian = augGaussian->Ticked();
-   bit aFisher = augFisher->Ticked();
-   if (aFisher) aGaussian = true; // Need Gaussian as input - might as well force it as storage is cheap.
-  
-   delete result;
-   result = new svt::Var(cyclops.Core());
-   result->Setup2D(leftImg->Size(0),leftImg->Size(1));
-   real32 dispIni = 0.0;
-   bit maskIni = true;
-   math::Fisher fishIni;
-   result->Add("disp",dispIni);
-   result->Add("mask",maskIni);
-   if (aGaussian) result->Add("sd",dispIni);
-   if (aFisher) result->Add("fish",fishIni);
-   result->Commit(false);
-
-   svt::Field<real32> disp(result,"disp");
-   svt::Field<bit> mask(result,"mask");
-   svt::Field<real32> sd(result,"sd");
-   svt::Field<math::Fisher> fish(result,"fish");
-
-
-  // Prep progress bar...
-   time::Progress * prog = cyclops.BeginProg();
-   nat32 step = 0;
-   nat32 steps = 0;
-   switch (whichAlg->Get())
-   {
-    case 0: break; // Existing
-    case 1: steps += 1; break; // Dynamic Programming
-    case 2: steps += 1; break; // Belief Propagation
-    case 3: steps += 1; break; // Diffusion Correlation
-   }
-   switch (whichPost->Get())
-   {
-    case 1: steps += 2; break; // Smoothing. (Has sd fitting step.)
-    case 2: steps += 1; break; // Plane fit + Seg
-    case 3: steps += 1; break; // Poly fitting
-   }
-   
-   if (aGaussian) steps += 1;
-   if (aFisher) steps += 1;
+  cyclops.Jobs().Add(job);
+}
+
+void Stereopsis::Finished(StereoJob & job)
+{
+ // Ignore results for images that have since been replaced...
+  if ((job.imageGen!=imageGen)||(job.result==null<svt::Var*>())) return;
 
+  delete result;
+  result = CopyVar(cyclops.Core(),job.result);
 
-  // Run the algorithm...
-   stereo::DSC * dsc = null<stereo::DSC*>();
-   stereo::DSI * dsi = null<stereo::DSI*>();
+  svt::Field<real32> disp(result,"disp");
+  svt::Field<bit> mask(result,"mask");
 
-   svt::Field<bs::ColourLuv> leftLuv(leftImg,"luv");
-   svt::Field<bs::ColourLuv> rightLuv(rightImg,"luv");
-   svt::Field<bit> leftMask(leftImg,"mask");
-   svt::Field<bit> rightMask(rightImg,"mask");
 
-   switch (whichAlg->Get())
+ // Update the visualisation of the left image, so as to represent the disparity map...
+  real32 minDisp = 0.0;
+  real32 maxDisp = 0.0;
+  for (nat32 y=0;y<disp.Size(1);y++)
+  {
+   for (nat32 x=0;x<disp.Size(0);x++)
    {
-    case 0: // Existing...
-    {     
-     // Create a dsi to expose the existing disparity map correctly...
-      svt::Field<real32> dispEx(existing,"disp");
-      svt::Field<bit> maskEx(existing,"mask");
-     
-      dsi = new stereo::DummyDSI(dispEx,&maskEx);
-    }
-    break;
-    case 1: // Hierachical DP...
-    {
-     prog->Report(step++,steps);
-     
-     stereo::SparseDSI2 * sdsi = new stereo::SparseDSI2();
-     dsi = sdsi;
-
-     sdsi->Set(occCost->GetReal(1.0),vertCost->GetReal(0.0),
-              vertMult->GetReal(0.33),errLim->GetInt(1));
-     dsc = new stereo::HalfBoundLuvDSC(leftLuv,rightLuv,1.0,matchLim->GetReal(10.0));
-     sdsi->Set(dsc);
-     sdsi->Set(leftMask,rightMask);
-
-     sdsi->Run(prog);
-    }
-    break;
-    case 2: // Hierachical BP...
-    {
-     prog->Report(step++,steps);
-     
-     stereo::HEBP * sdsi = new stereo::HEBP();
-     dsi = sdsi;
-
-     real32 costCap = bpOccLim->GetReal(6.0);
-     real32 occCostBase = bpOccCostHigh->GetReal(16.0);
-     real32 occCostMult = (bpOccCostLow->GetReal(8.0)-occCostBase) / costCap;
-
-     sdsi->Set(occCostBase,occCostMult,bpOccLimMult->GetReal(2.0),bpIters->GetInt(6),bpOutput->GetInt(1));
-     dsc = new stereo::SqrBoundLuvDSC(leftLuv,rightLuv,1.0,bpMatchLim->GetReal(36.0));
-     sdsi->Set(dsc);
-     stereo::LuvDSC dscOcc(leftLuv,rightLuv,1.0,costCap);
-     sdsi->SetOcc(&dscOcc);
-     sdsi->Set(leftMask,rightMask);
-
-     sdsi->Run(prog);
-    }
-    break;
-    case 3: // Diffusion correlation
+    if (mask.Get(x,y))
     {
-     prog->Report(step++,steps);
-     
-     stereo::DiffCorrStereo * dcs = new stereo::DiffCorrStereo();
-     dsi = dcs;
-     
-     dcs->SetImages(leftLuv,rightLuv);
-     dcs->SetMasks(leftMask,rightMask);
-     
-     bit useHalfX = dcUseHalfX->Ticked();
-     bit useHalfY = dcUseHalfY->Ticked();
-     bit useCorners = dcUseCorners->Ticked();
-     bit halfHeight = dcHalfHeight->Ticked();
-     real32 distMult = dcDistMult->GetReal(0.1);
-     nat32 diffSteps = dcDiffSteps->GetInt(5);
-     nat32 minimaLimit = dcMinimaLimit->GetInt(8);
-     real32 baseDistCap = dcBaseDistCap->GetReal(4.0);
-     real32 distCapMult = dcDistCapMult->GetReal(2.0);
-     real32 distCapThreshold = dcDistCapThreshold->GetReal(0.5);
-     nat32 dispRange = dcDispRange->GetInt(2);
-     bit doLR = dcDoLR->Ticked();
-     real32 distCapDifference = dcDistCapDifference->GetReal(0.25);
-     
-     dcs->SetPyramid(useHalfX,useHalfY,useCorners,halfHeight);
-     dcs->SetDiff(distMult,diffSteps);
-     dcs->SetCorr(minimaLimit,baseDistCap,distCapMult,distCapThreshold,dispRange);
-     dcs->SetRefine(doLR,distCapDifference);
-     
-     dcs->Run(prog);
+     minDisp = math::Min(minDisp,disp.Get(x,y));
+     maxDisp = math::Max(maxDisp,disp.Get(x,y));
     }
-    break;
    }
+  }
 
-
-  // Run the post-proccessor...
-   switch (whichPost->Get())
+  for (nat32 y=0;y<leftImage.Size(1);y++)
+  {
+   for (nat32 x=0;x<leftImage.Size(0);x++)
    {
-    case 0: // None - simply select the best...
+    bs::ColRGB & targ = leftImage.Get(x,y);
+    if (mask.Get(x,y))
     {
-     for (nat32 y=0;y<disp.Size(1);y++)
+     real32 rxc = real32(x) + disp.Get(x,y);
+     targ.r = byte(math::Clamp<real32>(255.0*(disp.Get(x,y)-minDisp)/(maxDisp-minDisp),0,255));
+     if ((rxc>=0.0)&&(rxc<rightImage.Size(0)))
      {
-      for (nat32 x=0;x<disp.Size(0);x++)
-      {
-       if (dsi->Size(x,y)!=0)
-       {
-        real32 bestCost = dsi->Cost(x,y,0);
-        disp.Get(x,y) = dsi->Disp(x,y,0);
-        for (nat32 i=1;i<dsi->Size(x,y);i++)
-        {
-         if (dsi->Cost(x,y,i)<bestCost)
-         {
-          bestCost = dsi->Cost(x,y,i);
-          disp.Get(x,y) = dsi->Disp(x,y,i);
-         }
-        }
-        mask.Get(x,y) = true;
-       }
-       else
-       {
-        disp.Get(x,y) = 0.0;
-        mask.Get(x,y) = false;
-       }
-      }
+      targ.g = targ.r;
+      targ.b = targ.r;
+     }
+     else
+     {
+      targ.g = 127;
+      targ.b = 0;
      }
-    }
-    break;
-    case 1: // Smoothing...
-    {
-     prog->Report(step++,steps);
-     
-     // Extract a disparity map...
-      for (nat32 y=0;y<disp.Size(1);y++)
-      {
-       for (nat32 x=0;x<disp.Size(0);x++)
-       {
-        if (dsi->Size(x,y)!=0)
-        {
-         real32 bestCost = dsi->Cost(x,y,0);
-         disp.Get(x,y) = dsi->Disp(x,y,0);
-         for (nat32 i=1;i<dsi->Size(x,y);i++)
-         {
-          if (dsi->Cost(x,y,i)<bestCost)
-          {
-           bestCost = dsi->Cost(x,y,i);
-           disp.Get(x,y) = dsi->Disp(x,y,i);
-          }
-         }
-         mask.Get(x,y) = true;
-        }
-        else
-        {
-         disp.Get(x,y) = 0.0;
-         mask.Get(x,y) = false;
-        }
-       }
-      }
-
-     // Create tempory standard deviation storage...
-      svt::Var sdTemp(leftLuv);
-      {
-       real32 realIni = 0.0;
-       sdTemp.Add("sd",realIni);
-       sdTemp.Commit();
-      }
-      svt::Field<real32> sdOR(&sdTemp,"sd");
-
-
-     // Calculate standard deviations for the disparity values...
-      stereo::LuvDSC luvDSC(leftLuv,rightLuv);
-      stereo::RegionDSC regionDSC(&luvDSC,gaussianRadius->GetInt(4),gaussianFalloff->GetReal(0.5));
-      
-      if (altAugG->Ticked())
-      {
-       fit::LaplaceDispNorm laplaceDispNorm;
-       laplaceDispNorm.Set(disp,regionDSC, agCostMult->GetReal(1.0));
-       laplaceDispNorm.SetMask(leftMask);
-       laplaceDispNorm.SetParam(agSd->GetReal(7.0), agMin->GetReal(0.1), agMax->GetReal(16.0), agSdMult->GetReal(3.0));
-     
-       laplaceDispNorm.Run(prog);
-    
-       laplaceDispNorm.Get(sdOR);      
-      }
-      else
-      {
-       fit::DispNorm dispNorm;
-       dispNorm.Set(disp,regionDSC,gaussianMult->GetReal(1.0));
-       dispNorm.SetMask(leftMask);
-       dispNorm.SetRange(gaussianRange->GetInt(20),gaussianSdMult->GetReal(2.0));
-       dispNorm.SetClampK(gaussianMinK->GetReal(2.5),gaussianMaxK->GetReal(10.0));
-       dispNorm.SetClamp(gaussianMin->GetReal(0.1),gaussianMax->GetReal(10.0));
-       dispNorm.SetMaxIters(gaussianIters->GetInt(1000));
-     
-       dispNorm.Run(prog);
-    
-       dispNorm.Get(sdOR);
-      }
-
-
-     // Smooth it...
-      prog->Report(step++,steps);
-      stereo::CleanDSI cdsi;
-      cdsi.Set(leftLuv);
-      cdsi.Set(*dsi);
-      cdsi.SetMask(leftMask);
-      cdsi.SetSD(sdOR);
-      cdsi.Set(smoothStrength->GetReal(16.0),smoothCutoff->GetReal(16.0),
-               smoothWidth->GetReal(2.0),smoothIters->GetInt(256));
-
-      cdsi.Run(prog);
-
-      cdsi.GetMap(disp);
-     
-      for (nat32 y=0;y<disp.Size(1);y++)
-      {
-       for (nat32 x=0;x<disp.Size(0);x++)
-       {
-        mask.Get(x,y) = math::IsFinite(disp.Get(x,y))&&leftMask.Get(x,y);
-       }
-      }
-    }
-    break;
-    case 2: // Plane fitting...
-    {
-     prog->Report(step++,steps);
-     // First fill in the disparity map and mask from the result, so we can pass
-     // them to the Bleyer04 algorithm as overrides...
-      for (nat32 y=0;y<disp.Size(1);y++)
-      {
-       for (nat32 x=0;x<disp.Size(0);x++)
-       {
-        if (dsi->Size(x,y)!=0)
-        {
-         real32 bestCost = dsi->Cost(x,y,0);
-         disp.Get(x,y) = dsi->Disp(x,y,0);
-         for (nat32 i=1;i<dsi->Size(x,y);i++)
-         {
-          if (dsi->Cost(x,y,i)<bestCost)
-          {
-           bestCost = dsi->Cost(x,y,i);
-           disp.Get(x,y) = dsi->Disp(x,y,i);
-          }
-         }
-         mask.Get(x,y) = true;
-        }
-        else
-        {
-         disp.Get(x,y) = 0.0;
-         mask.Get(x,y) = false;
-        }
-       }
-      }
-
-     // Create the Bleyers04 object, set parameters...
-      svt::Field<bs::ColourRGB> leftRGB(leftImg,"rgb");
-      svt::Field<bs::ColourRGB> rightRGB(rightImg,"rgb");
-
-      stereo::Bleyer04 bleyer;
-      bleyer.SetImages(leftRGB,rightRGB);
-      bleyer.BootOverride(disp,mask);
-      bleyer.SetMasks(leftMask,rightMask);
-      bleyer.SetPlaneRadius(planeRadius->GetReal(0.6));
-      bleyer.SetWarpCost(planeOcc->GetReal(0.078),planeDisc->GetReal(0.01));
-      bleyer.SetBailOut(planeBailOut->GetInt(12));
-      bleyer.SetSegment(segSpatial->GetReal(7.0),segRange->GetReal(4.5),segMin->GetInt(20));
-      bleyer.SetSegmentExtra(segRad->GetInt(2),segMix->GetReal(0.3),segEdge->GetReal(0.9));
-      
-      if ((segmentation!=null<svt::Var*>())&&
-          (segmentation->Size(0)==leftImg->Size(0))&&
-          (segmentation->Size(0)==leftImg->Size(1)))
-      {
-       svt::Field<nat32> segs(segmentation,"seg");
-       bleyer.SegmentOverride(segs);
-      }
-
-     // Run...
-      bleyer.Run(prog);
-
-     // Extract the results...
-      bleyer.GetDisparity(disp);
-      mask.CopyFrom(leftMask);
-    }
-    break;
-    case 3: // Polynomial fitting...
-    {
-     prog->Report(step++,steps);
-
-     // First run the selection of best code, but drop any where there is more than 1 match...
-      for (nat32 y=0;y<disp.Size(1);y++)
-      {
-       for (nat32 x=0;x<disp.Size(0);x++)
-       {
-        if (dsi->Size(x,y)==1)
-        {
-         real32 bestCost = dsi->Cost(x,y,0);
-         disp.Get(x,y) = dsi->Disp(x,y,0);
-         for (nat32 i=1;i<dsi->Size(x,y);i++)
-         {
-          if (dsi->Cost(x,y,i)<bestCost)
-          {
-           bestCost = dsi->Cost(x,y,i);
-           disp.Get(x,y) = dsi->Disp(x,y,i);
-          }
-         }
-         mask.Get(x,y) = true;
-        }
-        else
-        {
-         disp.Get(x,y) = 0.0;
-         mask.Get(x,y) = false;
-        }
-       }
-      }
-      
-     // Now do the refinement...
-      bit useHalfX = polyUseHalfX->Ticked();
-      bit useHalfY = polyUseHalfY->Ticked();
-      bit useCorners = polyUseCorners->Ticked();
-      real32 distMult = polyDistMult->GetReal(0.01);
-      nat32 diffSteps = polyDiffSteps->GetInt(7);
-      real32 distCap = polyDistCap->GetReal(64.0);
-      real32 prune = polyPrune->GetReal(0.25);
-  
-      stereo::DiffCorrRefine dcr;
-      dcr.SetImages(leftLuv,rightLuv);
-      dcr.SetMasks(leftMask,rightMask);
-      dcr.SetDisparity(disp);
-      dcr.SetDisparityMask(mask);
-      dcr.SetFlags(useHalfX,useHalfY,useCorners);
-      dcr.SetDiff(distMult,diffSteps);
-      dcr.SetDist(distCap,prune);
-      
-      dcr.Run(prog);
-      
-      dcr.GetDisp(disp);
-      dcr.GetMask(mask);
-    }
-    break;
-   }
-   
-   
-  // If needed augment with standard deviations...
-   if (aGaussian)
-   {
-    prog->Report(step++,steps);
-    
-    stereo::LuvDSC luvDSC(leftLuv,rightLuv);
-    stereo::RegionDSC regionDSC(&luvDSC,gaussianRadius->GetInt(4),gaussianFalloff->GetReal(0.5));
-    //stereo::LuvRegionDSC regionDSC(leftLuv,rightLuv,&luvDSC,gaussianRadius->GetInt(4),0.1,gaussianFalloff->GetReal(0.5));
-    
-    if (altAugG->Ticked())
-    {
-     fit::LaplaceDispNorm laplaceDispNorm;
-     laplaceDispNorm.Set(disp,regionDSC, agCostMult->GetReal(1.0));
-     laplaceDispNorm.SetMask(leftMask);
-     laplaceDispNorm.SetParam(agSd->GetReal(7.0), agMin->GetReal(0.1), agMax->GetReal(16.0), agSdMult->GetReal(3.0));
-     
-     laplaceDispNorm.Run(prog);
-    
-     laplaceDispNorm.Get(sd);      
     }
     else
     {
-     fit::DispNorm dispNorm;
-     dispNorm.Set(disp,regionDSC,gaussianMult->GetReal(1.0));
-     dispNorm.SetMask(mask);
-     dispNorm.SetRange(gaussianRange->GetInt(20),gaussianSdMult->GetReal(2.0));
-     dispNorm.SetClampK(gaussianMinK->GetReal(2.5),gaussianMaxK->GetReal(10.0));
-     dispNorm.SetClamp(gaussianMin->GetReal(0.1),gaussianMax->GetReal(10.0));
-     dispNorm.SetMaxIters(gaussianIters->GetInt(1000));
-    
-     dispNorm.Run(prog);
-    
-     dispNorm.Get(sd);
+     targ.r = 0;
+     targ.g = 0;
+     targ.b = 255;
     }
    }
-  
+  }
 
-  // If needed augment with Fisher distributions...
-   if (aFisher)
-   {
-    prog->Report(step++,steps);
-    
-    /*stereo::LuvDSC luvDSC(leftLuv,rightLuv);
-    
-    fit::DispFish dispFish;
-    dispFish.Set(disp,luvDSC);
-    dispFish.SetMask(mask);
-    dispFish.SetPair(pair);
-    dispFish.SetRange(fisherRange->GetInt(4));
-    dispFish.SetBias(fisherBias->GetReal(0.0));
-    dispFish.SetClamp(fisherMin->GetReal(0.0),fisherMax->GetReal(16.0));
-   
-    dispFish.Run(prog);
-    
-    dispFish.Get(fish);*/
-    
-    fit::DispNormFish dnf;
-    dnf.Set(disp,sd);
-    dnf.SetMask(mask);
-    dnf.SetPair(pair);
-    dnf.SetRegion(fisherProb->GetReal(0.1),fisherMult->GetReal(1.0));
-    dnf.SetRange(fisherMin->GetReal(0.0),fisherMax->GetReal(16.0));
-    
-    dnf.Run(prog);
-    
-    dnf.Get(fish);
-   }
+  left->Redraw();
+}
+
+//------------------------------------------------------------------------------
+Stereopsis::StereoJob::StereoJob(Stereopsis & s)
+:Job(&s),self(s),imageGen(s.imageGen),core(tt),
+leftImg(null<svt::Var*>()),rightImg(null<svt::Var*>()),existing(null<svt::Var*>()),
+segmentation(null<svt::Var*>()),result(null<svt::Var*>())
+{}
 
+Stereopsis::StereoJob::~StereoJob()
+{
+ delete leftImg;
+ delete rightImg;
+ delete existing;
+ delete segmentation;
+ delete result;
+}
 
-  // Clean up...
-   delete dsc;
-   delete dsi;
-   cyclops.EndProg();
+void Stereopsis::StereoJob::Run(time::Progress * prog)
+{
+ result = RunStereo(core,cfg,leftImg,rightImg,existing,segmentation,pair,prog);
+}
 
+void Stereopsis::StereoJob::Done(bit ok)
+{
+ if (ok) self.Finished(*this);
+}
 
-  // Update the visualisation of the left image, so as to represent the disparity map...
-   real32 minDisp = 0.0;
-   real32 maxDisp = 0.0;
-   for (nat32 y=0;y<disp.Size(1);y++)
-   {
-    for (nat32 x=0;x<disp.Size(0);x++)
-    {
-     if (mask.Get(x,y))
-     {
-      minDisp = math::Min(minDisp,disp.Get(x,y));
-      maxDisp = math::Max(maxDisp,disp.Get(x,y));
-     }
-    }
-   }
+//------------------------------------------------------------------------------
+void Stereopsis::SaveConfig(gui::Base * obj,gui::Event * event)
+{
+ str::String fn("");
+ if (cyclops.App().SaveFileDialog("Save Stereopsis Settings",fn))
+ {
+  if (!fn.EndsWith(".xml")) fn << ".xml";
 
-   for (nat32 y=0;y<leftImage.Size(1);y++)
-   {
-    for (nat32 x=0;x<leftImage.Size(0);x++)
-    {
-     bs::ColRGB & targ = leftImage.Get(x,y);
-     if (mask.Get(x,y))
-     {
-      real32 rxc = real32(x) + disp.Get(x,y);
-      targ.r = byte(math::Clamp<real32>(255.0*(disp.Get(x,y)-minDisp)/(maxDisp-minDisp),0,255));
-      if ((rxc>=0.0)&&(rxc<rightImage.Size(0)))
-      {
-       targ.g = targ.r;
-       targ.b = targ.r;
-      }
-      else
-      {
-       targ.g = 127;
-       targ.b = 0;
-      }
-     }
-     else
-     {
-      targ.r = 0;
-      targ.g = 0;
-      targ.b = 255;
-     }
-    }
-   }
+  StereoConfig cfg;
+  GetConfig(cfg);
 
-   left->Redraw();
+  cstr ts = fn.ToStr();
+  if (!cfg.Save(ts,true))
+  {
+   cyclops.App().MessageDialog(gui::App::MsgErr,"Error saving settings.");
+  }
+  mem::Free(ts);
  }
 }
 
@@ -19,6 +19,8 @@
 
 
 #include "cyclops/main.h"
+#include "cyclops/stereo_config.h"
+#include "cyclops/jobs.h"
 
 //------------------------------------------------------------------------------
 // Allows a user to apply various stereo algorithms to an image pair.
@@ -133,6 +135,7 @@ class Stereopsis
   gui::EditBox * fisherMax;
   //gui::EditBox * fisherBias;
   cam::CameraPair pair;
+  str::String pairFn;
 
 
   svt::Var * leftVar;
@@ -146,6 +149,34 @@ class Stereopsis
   svt::Var * result;
   
   svt::Var * segmentation;
+  
+  nat32 imageGen; // Incrimented whenever an image is loaded, so stale results can be ignored.
+
+  // Runs the stereopsis in the background, on copies of everything...
+   class StereoJob : public Job
+   {
+    public:
+      StereoJob(Stereopsis & self);
+     ~StereoJob();
+
+     cstrconst Name() const {return "Stereopsis";}
+     void Run(time::Progress * prog);
+     void Done(bit ok);
+
+     Stereopsis & self;
+     nat32 imageGen;
+
+     str::TokenTable tt;
+     svt::Core core;
+     StereoConfig cfg;
+     cam::CameraPair pair;
+
+     svt::Var * leftImg;
+     svt::Var * rightImg;
+     svt::Var * existing;
+     svt::Var * segmentation;
+     svt::Var * result;
+   };
 
   void Quit(gui::Base * obj,gui::Event * event);
 
@@ -165,8 +196,11 @@ class Stereopsis
   void SwitchAltGaussian(gui::Base * obj,gui::Event * event);
   void SwitchFisher(gui::Base * obj,gui::Event * event);
 
+  void GetConfig(StereoConfig & out);
   void Run(gui::Base * obj,gui::Event * event);
+  void Finished(StereoJob & job);
 
+  void SaveConfig(gui::Base * obj,gui::Event * event);
   void SaveSVT(gui::Base * obj,gui::Event * event);
 };
 
@@ -0,0 +1,287 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "stereo_batch/main.h"
+
+using namespace eos;
+
+//------------------------------------------------------------------------------
+class MyProg : public eos::time::Progress
+{
+ public:
+  MyProg():last(0) {}
+
+  void OnChange()
+  {
+   nat32 x,y;
+   Part(0,x,y);
+   if (x==last) return;
+   last = x;
+   std::cout << "[" << x << " of " << y << "]\n";
+  }
+
+ private:
+  nat32 last;
+};
+
+//------------------------------------------------------------------------------
+nat32 BatchJob::Need(nat32 width,nat32 height) const
+{
+ return math::Min(nat32((real64(width)*real64(height)*real64(pixelBytes))/1024.0)+1,budget);
+}
+
+void BatchJob::Do(nat32 unit,nat32)
+{
+ BatchPair & targ = (*pair)[unit];
+ real64 start = time::UltraTime();
+
+ targ.ok = false;
+ targ.width = 0;
+ targ.height = 0;
+ targ.wait = 0.0;
+ targ.load = 0.0;
+ targ.timing.luv = 0.0;
+ targ.timing.dsi = 0.0;
+ targ.timing.post = 0.0;
+ targ.timing.gaussian = 0.0;
+ targ.timing.fisher = 0.0;
+ targ.save = 0.0;
+
+ // Each pair gets its own core, so nothing is shared with the other threads...
+  str::TokenTable tt;
+  svt::Core core(tt);
+
+ // Reserve memory from the budget before loading anything, waiting till its
+ // available - the size comes from the header of the left image, and if that
+ // can not be read the whole budget is taken until it is loaded. A pair
+ // bigger than the whole budget is capped, so it runs when nothing else is...
+  cstr fn = targ.left.ToStr();
+  nat32 headWidth,headHeight;
+  nat32 need = budget;
+  if (file::ImageSize(fn,headWidth,headHeight)) need = Need(headWidth,headHeight);
+  mem::Free(fn);
+
+  real64 waitStart = time::UltraTime();
+  while (true)
+  {
+   nat32 cur = used;
+   if (cur+need<=budget)
+   {
+    if (mt::AtomicSet(used,cur,cur+need)) break;
+   }
+   else mt::Sleep(10);
+  }
+  real64 loadStart = time::UltraTime();
+  targ.wait = loadStart - waitStart;
+
+ // Load the images...
+  svt::Var * left;
+  svt::Var * right;
+  loadLock.Lock();
+   fn = targ.left.ToStr();
+   left = LoadStereoImage(core,fn);
+   mem::Free(fn);
+   fn = targ.right.ToStr();
+   right = LoadStereoImage(core,fn);
+   mem::Free(fn);
+  loadLock.Unlock();
+
+  real64 end = time::UltraTime();
+  targ.load = end - loadStart;
+
+  if ((left==null<svt::Var*>())||(right==null<svt::Var*>()))
+  {
+   delete left;
+   delete right;
+   mt::AtomicAdd(used,nat32(-int32(need)));
+   targ.total = end - start;
+   return;
+  }
+  targ.width = left->Size(0);
+  targ.height = left->Size(1);
+
+ // Correct the reservation to the loaded size, if it was a guess...
+  nat32 actual = Need(targ.width,targ.height);
+  if (actual<need)
+  {
+   mt::AtomicAdd(used,nat32(-int32(need-actual)));
+   need = actual;
+  }
+
+ // Do the stereo...
+  svt::Var * result = RunStereo(core,*cfg,left,right,null<svt::Var*>(),null<svt::Var*>(),*camPair,null<time::Progress*>(),&targ.timing);
+  delete left;
+  delete right;
+
+ // Save the result...
+  if (result)
+  {
+   real64 saveStart = time::UltraTime();
+   fn = targ.out.ToStr();
+   targ.ok = svt::Save(fn,result,true);
+   mem::Free(fn);
+   targ.save = time::UltraTime() - saveStart;
+   delete result;
+  }
+
+ mt::AtomicAdd(used,nat32(-int32(need)));
+ targ.total = time::UltraTime() - start;
+}
+
+//------------------------------------------------------------------------------
+int main(int argc,char ** argv)
+{
+ if (argc<4)
+ {
+  std::cout << "Usage: stereo_batch [config.xml] [pairs.txt] [report.csv] <threads> <memory> <pixel bytes>\n";
+  std::cout << "config.xml is saved from the cyclops stereopsis window. pairs.txt has a\n";
+  std::cout << "line per pair, 'left right output.dis', blank lines and lines starting\n";
+  std::cout << "with # are ignored. threads defaults to the number of cores, memory is the\n";
+  std::cout << "budget in megabytes for pairs in flight, defaulting to 1024, and pixel bytes\n";
+  std::cout << "is the memory estimate for each pixel of a pair, defaulting to 2048.\n";
+  return 1;
+ }
+
+ // Load the configuration...
+  StereoConfig cfg;
+  if (cfg.Load(argv[1])==false)
+  {
+   std::cout << "Unable to load configuration.\n";
+   return 1;
+  }
+
+  if (cfg.alg==0)
+  {
+   std::cout << "Configuration uses an existing disparity map, which batch mode can not provide.\n";
+   return 1;
+  }
+
+  cam::CameraPair camPair;
+  if ((cfg.augFisher)&&(cfg.calibration.Size()!=0))
+  {
+   if (camPair.Load(cfg.calibration)==false)
+   {
+    std::cout << "Unable to load calibration.\n";
+    return 1;
+   }
+   camPair.LeftToDefault();
+  }
+
+ // Load the list of pairs...
+  ds::ArrayDel<BatchPair> pair;
+  {
+   std::ifstream pf(argv[2]);
+   if (!pf)
+   {
+    std::cout << "Unable to load pair list.\n";
+    return 1;
+   }
+
+   std::string line;
+   while (std::getline(pf,line))
+   {
+    std::istringstream ls(line);
+    std::string l,r,o;
+    if (!(ls >> l)) continue;
+    if (l[0]=='#') continue;
+    if (!(ls >> r >> o))
+    {
+     std::cout << "Bad line in pair list: " << line << "\n";
+     return 1;
+    }
+
+    pair.Size(pair.Size()+1);
+    BatchPair & targ = pair[pair.Size()-1];
+    targ.left = l.c_str();
+    targ.right = r.c_str();
+    targ.out = o.c_str();
+   }
+  }
+
+ // Setup the job...
+  nat32 threads = 0;
+  if (argc>4) threads = str::ToInt32(argv[4]);
+
+  nat32 memory = 1024;
+  if (argc>5) memory = str::ToInt32(argv[5]);
+
+  BatchJob job;
+  job.cfg = &cfg;
+  job.camPair = &camPair;
+  job.pair = &pair;
+  job.budget = math::Max<nat32>(memory,1)*1024;
+  job.pixelBytes = 2048;
+  if (argc>6) job.pixelBytes = str::ToInt32(argv[6]);
+  job.used = 0;
+
+ // Run it...
+  MyProg prog;
+  mt::Pool pool(threads);
+  std::cout << "Processing " << pair.Size() << " pairs with " << pool.Threads() << " threads.\n";
+
+  real64 start = time::UltraTime();
+  pool.Run(job,pair.Size(),&prog);
+  real64 total = time::UltraTime() - start;
+
+ // Write the report...
+  nat32 failed = 0;
+  {
+   file::Csv report(argv[3],true);
+   if (!report.Active())
+   {
+    std::cout << "Unable to write report.\n";
+    return 1;
+   }
+
+   report << "left" << file::EndField() << "right" << file::EndField()
+          << "output" << file::EndField() << "ok" << file::EndField()
+          << "width" << file::EndField() << "height" << file::EndField()
+          << "wait" << file::EndField() << "load" << file::EndField()
+          << "luv" << file::EndField() << "dsi" << file::EndField()
+          << "post" << file::EndField() << "gaussian" << file::EndField()
+          << "fisher" << file::EndField() << "save" << file::EndField()
+          << "total" << file::EndRow();
+
+   for (nat32 i=0;i<pair.Size();i++)
+   {
+    const BatchPair & targ = pair[i];
+    if (!targ.ok) ++failed;
+
+    report << targ.left << file::EndField() << targ.right << file::EndField()
+           << targ.out << file::EndField() << (targ.ok?1:0) << file::EndField()
+           << targ.width << file::EndField() << targ.height << file::EndField()
+           << targ.wait << file::EndField() << targ.load << file::EndField()
+           << targ.timing.luv << file::EndField() << targ.timing.dsi << file::EndField()
+           << targ.timing.post << file::EndField() << targ.timing.gaussian << file::EndField()
+           << targ.timing.fisher << file::EndField() << targ.save << file::EndField()
+           << targ.total << file::EndRow();
+   }
+  }
+
+  std::cout << "Done in " << total << " seconds, " << failed << " of " << pair.Size() << " pairs failed.\n";
+
+ return (failed==0)?0:1;
+}
+
+//------------------------------------------------------------------------------
@@ -0,0 +1,70 @@
+#ifndef STEREO_BATCH_MAIN_H
+#define STEREO_BATCH_MAIN_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "eos.h"
+#include "cyclops/stereo_config.h"
+
+//------------------------------------------------------------------------------
+// Runs the stereopsis of cyclops, configured by an xml file saved from its
+// Save Settings button, over a list of image pairs. Pairs are processed
+// concurrently, each in its own thread, whilst the pixels of the pairs in
+// flight are kept within a memory budget. Writes a csv report with the time
+// taken by each stage of each pair.
+
+//------------------------------------------------------------------------------
+// A pair to process, and how it went...
+struct BatchPair
+{
+ str::String left;
+ str::String right;
+ str::String out;
+
+ bit ok;
+ nat32 width;
+ nat32 height;
+ real32 wait; // Time waiting for memory.
+ real32 load;
+ StereoTiming timing;
+ real32 save;
+ real32 total;
+};
+
+//------------------------------------------------------------------------------
+// The job that does the pairs, one unit per pair...
+class BatchJob : public mt::Job
+{
+ public:
+  const StereoConfig * cfg;
+  const cam::CameraPair * camPair;
+  ds::ArrayDel<BatchPair> * pair;
+
+  nat32 budget; // In kilobytes.
+  nat32 pixelBytes; // Estimated memory use per pixel.
+  volatile nat32 used; // Kilobytes reserved by the pairs in flight.
+  mt::OwnedLock loadLock; // Image loading is not thread safe.
+
+  void Do(nat32 unit,nat32 thread);
+
+ private:
+  nat32 Need(nat32 width,nat32 height) const; // Kilobytes to reserve for a pair, capped to the budget.
+};
+
+//------------------------------------------------------------------------------
+#endif
@@ -137,10 +137,13 @@
 #include "eos/math/func.h"
 #include "eos/math/bessel.h"
 #include "eos/math/stats_dir.h"
+#include "eos/math/batch.h"
+#include "eos/math/fft.h"
 
 #include "eos/time/times.h"
 #include "eos/time/progress.h"
 #include "eos/time/format.h"
+#include "eos/time/profiler.h"
 
 #include "eos/data/blocks.h"
 #include "eos/data/buffers.h"
@@ -174,6 +177,7 @@
 #include "eos/svt/file.h"
 #include "eos/svt/calculation.h"
 #include "eos/svt/sample.h"
+#include "eos/svt/pipeline.h"
 
 #include "eos/alg/mean_shift.h"
 #include "eos/alg/fitting.h"
@@ -184,6 +188,7 @@
 #include "eos/alg/solvers.h"
 #include "eos/alg/nearest.h"
 #include "eos/alg/multigrid.h"
+#include "eos/alg/ransac.h"
 
 #include "eos/filter/image_io.h"
 #include "eos/filter/conversion.h"
@@ -211,6 +216,8 @@
 #include "eos/filter/smoothing.h"
 #include "eos/filter/mscr.h"
 #include "eos/filter/seg_k_mean_grid.h"
+#include "eos/filter/tiled.h"
+#include "eos/filter/seg_pixels.h"
 
 #include "eos/stereo/sad.h"
 #include "eos/stereo/sad_seg_stereo.h"
@@ -300,6 +307,7 @@
 
 #include "eos/mt/threads.h"
 #include "eos/mt/locks.h"
+#include "eos/mt/pool.h"
 
 #include "eos/sur/mesh.h"
 #include "eos/sur/mesh_iter.h"
@@ -23,7 +23,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 MeanShift::MeanShift()
-:cutoff(0.01),max_iter(100),passOpt(false),window(1.0),out(null<real32*>()),Distance(&DistDefault) 
+:cutoff(0.01),max_iter(100),passOpt(false),basinOpt(false),window(1.0),gridDims(0),out(null<real32*>()),Distance(&DistDefault) 
 {}
 
 MeanShift::~MeanShift() {mem::Free(out);}
@@ -72,6 +72,11 @@ void MeanShift::Passover(bit enabled)
  passOpt = enabled;
 }
 
+void MeanShift::Basin(bit enabled)
+{
+ basinOpt = enabled;
+}
+
 void MeanShift::SetWindowSize(real32 size)
 {
  window = size;
@@ -105,7 +110,7 @@ void MeanShift::Run(time::Progress * prog)
  // First initialise an array of vectors for every sample we have...
  // The vector structure is allways <weight, dimension features... , field features... >
   samples = sf[0].field.Count();
-  real32 * vect = mem::Malloc<real32>(samples*(fvSize+1));
+  vect = mem::Malloc<real32>(samples*(fvSize+1));
 
 
  // Now we calculate the initial vectors...
@@ -138,12 +143,13 @@ void MeanShift::Run(time::Progress * prog)
   mem::Copy<real32>(out,vect,samples*(fvSize+1));
 
 
- // Before the next step we need a load of malloced arrays, in addition to the pos array allready conceived...
-  nat32 * mi = mem::Malloc<nat32>(dim.Size());
-  nat32 * ma = mem::Malloc<nat32>(dim.Size());
-  nat32 * ipos = mem::Malloc<nat32>(dim.Size());
-  nat32 * stride = mem::Malloc<nat32>(dim.Size());
-  real32 * mean = mem::Malloc<real32>(fvSize);
+ // Before the next step we need a load of malloced arrays, per thread for the
+ // tempory ones...
+  mt::Pool & pool = mt::SharedPool();
+  nat32 threads = passOpt?1:pool.Threads();
+  temp = mem::Malloc<nat32>(threads*dim.Size()*3);
+  tempMean = mem::Malloc<real32>(threads*fvSize);
+  stride = mem::Malloc<nat32>(dim.Size());
 
   stride[0] = 1;
   for (nat32 i=1;i<dim.Size();i++) stride[i] = stride[i-1]*sf[0].field.Size(i-1);
@@ -151,86 +157,53 @@ void MeanShift::Run(time::Progress * prog)
  // If the passover optimisation has been enabled generate its data structure...
  // Simply an array of indexes for the parent of each sample, set to point to self
  // when it has no parent.
-  nat32 * pods = null<nat32*>();
+  pods = null<nat32*>();
   if (passOpt)
   {
    pods = new nat32[samples];
    for (nat32 i=0;i<samples;i++) pods[i] = i;
   }
-    
 
- // For each vector we apply the mean shift algorithm till convergance...
-  targ = out;
-  for (nat32 i=0;i<samples;i++,targ += fvSize+1)
+ // If the basin optimisation is on, and can work, create the converged flags...
+  state = null<volatile nat32*>();
+  if (basinOpt&&(diUsed==dim.Size()))
   {
-   prog->Report(i,samples);
-   // Run this particular node till convergence...
-    // Converge it, different code depending on if the passover optimisation
-    // is on or not...     
-     if ((!passOpt)||(pods[i]==i))
-     {
-      nat32 lastOver = i; // Used for a quick break out, saves a bit of pissing about.
-      for (nat32 k=0;k<max_iter;k++)
-      {
-       if (passOpt)
-       {
-        // Check if we are over a sample that has not converged, if so we become
-        // its parent, so it will be forced to converge to the same place this
-        // sample converges...
-         // Find the offset of the sample...
-          nat32 over = 0;
-          for (nat32 j=0;j<dim.Size();j++) over += nat32(math::Round(targ[j+1]/dim[j].scale))*stride[j];          
-         
-         // If its not us check if we can save some sampling...
-          if ((over!=lastOver)&&(over!=i))
-          { 
-	   lastOver = over;         
-           // We only concider matching to this pixel if the remainder of the
-           // feature vector, the non-dimensional features, eucledian distance
-           // in the scaled space is less than half.
-            real32 * ot = out + (fvSize+1)*over + 1 + dim.Size();
-            real32 dist = 0.0;
-            for (nat32 j=0;j<sf.Size();j++) dist += math::Sqr(ot[j]-targ[j+1+dim.Size()]);
-            if (dist<0.5)
-            {
-             // Two scenarios - either the node has not converged, and we arrange
-             // for it to converge to the same point we do, or it has converged 
-             // so we go where it is going...
-              if (pods[over]==over) pods[over] = i;
-              else
-              {
-               // Instead of doing any more mean shifting just head straight to the
-               // convergence point of the node found...
-                nat32 toUse = pods[over];
-                while (toUse!=pods[toUse]) toUse = pods[toUse];
-                
-                real32 * from = out + (fvSize+1)*toUse; 
-                for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
-              }
-            }
-          }
-       }
-       CalcShift(mi,ma,ipos,vect,stride,targ,mean);      
-       for (nat32 j=0;j<fvSize;j++) targ[j+1] += mean[j];
+   nat32 * st = mem::Malloc<nat32>(samples);
+   for (nat32 i=0;i<samples;i++) st[i] = 0;
+   state = st;
+  }
+
+ // If no dimensions are in use build the grid, otherwise every sample would
+ // be considered for every shift. (Only for the default distance, as a
+ // custom distance can accept anything.)...
+  gridDims = 0;
+  if ((diUsed==0)&&(Distance==&DistDefault)) BuildGrid(vect);
     
-       real32 shift = 0.0;
-       for (nat32 j=0;j<fvSize;j++)
-       {
-        shift += math::Sqr(mean[j]);
-        if (shift>=cutoff) break;
-       }
-       if (shift<cutoff) break;
-      }     
-     }
-     else
-     {
-      real32 * from = out + (fvSize+1)*pods[i]; 
-      for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
-     }
+
+ // For each vector we apply the mean shift algorithm till convergance, in
+ // parallel unless the passover optimisation makes that impossible...
+  if (passOpt)
+  {
+   for (nat32 i=0;i<samples;i++)
+   {
+    prog->Report(i,samples);
+    Converge(i,0);
+   }
+  }
+  else
+  {
+   ConvergeJob job;
+   job.self = this;
+   pool.Run(job,(samples+255)/256,prog);
   }
 
- // If the passover optimisation was used we need to clean up...
-  if (passOpt) delete[] pods;  
+ // Clean up the optimisation data structures...
+  if (passOpt) delete[] pods;
+  if (state) mem::Free(const_cast<nat32*>(state));
+  gridDims = 0;
+  gridKey.Size(0);
+  gridStart.Size(0);
+  gridIndex.Size(0);
 
  // Go through the output and remove the affect of the scaler...   
   real32 * scales = mem::Malloc<real32>(fvSize);
@@ -262,11 +235,9 @@ void MeanShift::Run(time::Progress * prog)
  // Clean up...
   mem::Free(scales);
 
-  mem::Free(mean);
   mem::Free(stride);
-  mem::Free(ipos);
-  mem::Free(ma);
-  mem::Free(mi);
+  mem::Free(tempMean);
+  mem::Free(temp);
 
   mem::Free(pos);
   mem::Free(vect);
@@ -274,6 +245,101 @@ void MeanShift::Run(time::Progress * prog)
  prog->Pop();
 }
 
+void MeanShift::Converge(nat32 i,nat32 thread)
+{
+ nat32 * mi = temp + thread*dim.Size()*3;
+ nat32 * ma = mi + dim.Size();
+ nat32 * ipos = ma + dim.Size();
+ real32 * mean = tempMean + thread*fvSize;
+ real32 * targ = out + i*(fvSize+1);
+
+ // Converge it, different code depending on if the passover optimisation
+ // is on or not...     
+  if ((!passOpt)||(pods[i]==i))
+  {
+   nat32 lastOver = i; // Used for a quick break out, saves a bit of pissing about.
+   for (nat32 k=0;k<max_iter;k++)
+   {
+    if (passOpt||state)
+    {
+     // Find the offset of the sample we are over...
+      nat32 over = 0;
+      for (nat32 j=0;j<dim.Size();j++) over += nat32(math::Round(targ[j+1]/dim[j].scale))*stride[j];
+
+     // Only concider it if its not us, and the remainder of the feature
+     // vector, the non-dimensional features, eucledian distance in the scaled
+     // space is less than half. (Without passover only converged samples are
+     // of interest, and they are the only ones safe to read in parallel.)
+      if ((over!=lastOver)&&(over!=i)&&(passOpt||(state[over]!=0)))
+      {
+       lastOver = over;
+       real32 * ot = out + (fvSize+1)*over + 1 + dim.Size();
+       real32 dist = 0.0;
+       for (nat32 j=0;j<sf.Size();j++) dist += math::Sqr(ot[j]-targ[j+1+dim.Size()]);
+       if (dist<0.5)
+       {
+        // Basin - if it has converged go to where it went and stop...
+         if (state&&(state[over]!=0))
+         {
+          real32 * from = out + (fvSize+1)*over;
+          for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
+          break;
+         }
+
+        if (passOpt)
+        {
+         // Passover - two scenarios - either the node has not converged, and
+         // we arrange for it to converge to the same point we do, or it has
+         // converged so we go where it is going...
+          if (pods[over]==over) pods[over] = i;
+          else
+          {
+           // Instead of doing any more mean shifting just head straight to the
+           // convergence point of the node found...
+            nat32 toUse = pods[over];
+            while (toUse!=pods[toUse]) toUse = pods[toUse];
+                
+            real32 * from = out + (fvSize+1)*toUse; 
+            for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
+          }
+        }
+       }
+      }
+    }
+
+    if (gridDims!=0) CalcShiftGrid(vect,targ,mean);
+                else CalcShift(mi,ma,ipos,vect,stride,targ,mean);
+    for (nat32 j=0;j<fvSize;j++) targ[j+1] += mean[j];
+    
+    real32 shift = 0.0;
+    for (nat32 j=0;j<fvSize;j++)
+    {
+     shift += math::Sqr(mean[j]);
+     if (shift>=cutoff) break;
+    }
+    if (shift<cutoff) break;
+   }     
+  }
+  else
+  {
+   real32 * from = out + (fvSize+1)*pods[i]; 
+   for (nat32 j=0;j<fvSize;j++) targ[j+1] = from[j+1];
+  }
+
+ // Let other threads know this sample has its final value...
+  if (state)
+  {
+   mt::Barrier();
+   state[i] = 1;
+  }
+}
+
+void MeanShift::ConvergeJob::Do(nat32 unit,nat32 thread)
+{
+ nat32 end = math::Min((unit+1)*256,self->samples);
+ for (nat32 i=unit*256;i<end;i++) self->Converge(i,thread);
+}
+
 bit MeanShift::Get(svt::Field<real32> & index,svt::Field<real32> & o)
 {
  // Calculate which index we will be returning...
@@ -366,7 +432,7 @@ void MeanShift::CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32
      for (nat32 i=0;i<dim.Size();i++) targ += pos[i]*stride[i]*(fvSize+1);
 
     // Calculate the distance of this vector from our vector, if its too far skip it...
-     if (Distance(fvSize,targ+1,vector+1,passThrough))
+     if (InRange(targ+1,vector+1))
      {
       // The distance multiplied by the points weight is now the weighting for the point,
       // sum this in...
@@ -397,6 +463,131 @@ void MeanShift::CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32
   }
 }
 
+// Helper for sorting samples into grid cells...
+struct MeanShiftCell
+{
+ nat64 key;
+ nat32 index;
+
+ bit operator < (const MeanShiftCell & rhs) const {return key<rhs.key;}
+};
+
+nat64 MeanShift::GridKey(int32 * cell) const
+{
+ // 21 bits per dimension, clamped - clamping merges far cells, which only
+ // adds candidates that the distance test then rejects...
+  nat64 ret = 0;
+  for (nat32 i=0;i<gridDims;i++)
+  {
+   ret = (ret<<21) | nat64(math::Clamp<int32>(cell[i],0,(1<<21)-1));
+  }
+ return ret;
+}
+
+void MeanShift::BuildGrid(real32 * data)
+{
+ gridDims = math::Min<nat32>(fvSize,3);
+
+ // Find the minimum of each dimension, so cell coordinates are positive...
+  for (nat32 d=0;d<gridDims;d++) gridMin[d] = data[1+d];
+  for (nat32 i=0;i<samples;i++)
+  {
+   real32 * targ = data + i*(fvSize+1);
+   for (nat32 d=0;d<gridDims;d++) gridMin[d] = math::Min(gridMin[d],targ[1+d]);
+  }
+  
+ // Calculate the key for every sample and sort...
+  ds::Array<MeanShiftCell> cell(samples);
+  for (nat32 i=0;i<samples;i++)
+  {
+   real32 * targ = data + i*(fvSize+1);
+   int32 c[3];
+   for (nat32 d=0;d<gridDims;d++) c[d] = int32(math::RoundDown(targ[1+d]-gridMin[d])) + 1;
+   cell[i].key = GridKey(c);
+   cell[i].index = i;
+  }
+  cell.SortNorm();
+
+ // Compress into the index...
+  nat32 cells = 0;
+  for (nat32 i=0;i<samples;i++)
+  {
+   if ((i==0)||(cell[i].key!=cell[i-1].key)) ++cells;
+  }
+
+  gridKey.Size(cells);
+  gridStart.Size(cells+1);
+  gridIndex.Size(samples);
+
+  nat32 c = 0;
+  for (nat32 i=0;i<samples;i++)
+  {
+   if ((i==0)||(cell[i].key!=cell[i-1].key))
+   {
+    gridKey[c] = cell[i].key;
+    gridStart[c] = i;
+    ++c;
+   }
+   gridIndex[i] = cell[i].index;
+  }
+  gridStart[cells] = samples;
+}
+
+void MeanShift::CalcShiftGrid(real32 * data,real32 * vector,real32 * mean)
+{
+ for (nat32 i=0;i<fvSize;i++) mean[i] = 0.0;
+ real32 weight = 0.0;
+
+ // The cell of the vector - the window is 1, so only the 3^gridDims cells
+ // arround it need to be checked...
+  int32 base[3];
+  for (nat32 d=0;d<gridDims;d++) base[d] = int32(math::RoundDown(vector[1+d]-gridMin[d])) + 1;
+
+  nat32 neighbours = 1;
+  for (nat32 d=0;d<gridDims;d++) neighbours *= 3;
+
+  for (nat32 n=0;n<neighbours;n++)
+  {
+   int32 c[3];
+   nat32 code = n;
+   for (nat32 d=0;d<gridDims;d++)
+   {
+    c[d] = base[d] + int32(code%3) - 1;
+    code /= 3;
+   }
+   nat64 key = GridKey(c);
+
+   // Binary search for the cell...
+    nat32 low = 0;
+    nat32 high = gridKey.Size();
+    while (low<high)
+    {
+     nat32 mid = (low+high)/2;
+     if (gridKey[mid]<key) low = mid+1;
+                      else high = mid;
+    }
+    if ((low==gridKey.Size())||(gridKey[low]!=key)) continue;
+
+   // Sum in the samples in range...
+    for (nat32 j=gridStart[low];j<gridStart[low+1];j++)
+    {
+     real32 * targ = data + gridIndex[j]*(fvSize+1);
+     if (InRange(targ+1,vector+1))
+     {
+      real32 we = targ[0];
+      weight += we;
+      for (nat32 i=0;i<fvSize;i++) mean[i] += we*(targ[i+1] - vector[i+1]);
+     }
+    }
+  }
+
+ if (weight>0.0)
+ {
+  weight = 1.0/weight;
+  for (nat32 i=0;i<fvSize;i++) mean[i] = mean[i]*weight;
+ }
+}
+
 bit MeanShift::DistDefault(nat32 fvSize,real32 * fv1,real32 * fv2,real32)
 {
  real32 ret = 0.0;
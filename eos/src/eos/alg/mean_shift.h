@@ -31,6 +31,7 @@
 #include "eos/ds/arrays.h"
 #include "eos/ds/lists.h"
 #include "eos/time/progress.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -54,6 +55,14 @@ namespace eos
 /// each entry, so its a diagonal matrix in other words. As a note on optimisation, 
 /// the algorithm will work faster with the limited dimensions first in the input
 /// structure and the larger scale features given first.
+///
+/// Samples are converged in parallel, in blocks, using mt::SharedPool(), unless
+/// the passover optimisation is on, as that is inherently serial. When no
+/// dimensions are used as features and the default distance is in use a
+/// uniform grid, with cells of the window size, is built over the first three
+/// features, so only nearby samples are considered rather than every sample.
+/// The default eucledian distance is also inlined rather than called through
+/// the function pointer.
 class EOS_CLASS MeanShift
 {
  public:
@@ -108,6 +117,16 @@ class EOS_CLASS MeanShift
   /// behaviour for a mean shift image smoothing:-)
    void Passover(bit enabled);
 
+  /// The basin of attraction optimisation, like the passover optimisation
+  /// only works if all dimensions are used as features. Whilst converging a
+  /// sample the sample it is currently over is checked, if that sample has
+  /// already converged and its non-positional features are within half the
+  /// window it jumps straight to its mode and stops. Unlike the passover
+  /// optimisation this works in parallel, though the results then depend
+  /// slightly on the order samples happen to be converged in. Defaults to
+  /// false.
+   void Basin(bit enabled);
+
   /// A conveniance, allows you to set the window size independently of the scales set.
    void SetWindowSize(real32 size);
    
@@ -148,6 +167,7 @@ class EOS_CLASS MeanShift
    real32 cutoff; // When the shift eucledian distance is less than the square-root of this stop shifting.
    real32 max_iter; // Maximum number of iterations to do before giving up, assuming above is not reached.
    bit passOpt; // When true the pass-over optimisation is done.
+   bit basinOpt; // When true the basin of attraction optimisation is done.
 
   // Methods used during the calculation...
    // Calculates the starting vector for a particular entry.
@@ -156,6 +176,23 @@ class EOS_CLASS MeanShift
    // data is the array to get values from, stride is the offset for each dimension, vector as 
    // the vector+weight of the vector to calculate for and mean as the output mean value for the window.
     void CalcShift(nat32 * mi,nat32 * ma,nat32 * pos,real32 * data,nat32 * stride,real32 * vector,real32 * mean);
+   // Version of the above used when the grid exists...
+    void CalcShiftGrid(real32 * data,real32 * vector,real32 * mean);
+   // Returns true if two feature vectors are within range...
+    inline bit InRange(real32 * fv1,real32 * fv2)
+    {
+     if (Distance==&DistDefault)
+     {
+      real32 dist = 0.0;
+      for (nat32 i=0;i<fvSize;i++) dist += math::Sqr(fv1[i] - fv2[i]);
+      return dist<=1.0;
+     }
+     else return Distance(fvSize,fv1,fv2,passThrough);
+    }
+   // Builds the grid over the first features, for when no dimensions are used...
+    void BuildGrid(real32 * data);
+   // Converges a single sample, thread indexes the tempory storage...
+    void Converge(nat32 i,nat32 thread);
 
   // Inputs...
    real32 window; // Size of window.
@@ -182,6 +219,30 @@ class EOS_CLASS MeanShift
    nat32 fvSize; // Feature vector size.
 
 
+  // Shared state during Run...
+   real32 * vect; // Initial vectors, with weight at the front.
+   nat32 * stride; // Offset of each dimension in samples.
+   nat32 * pods; // Passover parents, only if passOpt.
+   volatile nat32 * state; // 1 when a sample has converged, only if basin optimisation is active.
+   nat32 * temp; // 3 arrays of dim.Size() per thread.
+   real32 * tempMean; // An array of fvSize per thread.
+
+  // The grid, cells are sorted by a key made from the cell coordinates...
+   nat32 gridDims; // 0 if there is no grid.
+   ds::Array<nat64> gridKey; // Key of each non-empty cell, sorted.
+   ds::Array<nat32> gridStart; // Offset into gridIndex for each cell, with an extra on the end.
+   ds::Array<nat32> gridIndex; // Sample indices, sorted by cell.
+   real32 gridMin[3]; // Minimum value in each grid dimension.
+   nat64 GridKey(int32 * cell) const;
+
+  // The job for converging blocks of samples...
+   class ConvergeJob : public mt::Job
+   {
+    public:
+     MeanShift * self;
+     void Do(nat32 unit,nat32 thread);
+   };
+
   // Outputs...
    real32 * out;
 
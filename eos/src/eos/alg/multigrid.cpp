@@ -25,7 +25,8 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Multigrid2D::Multigrid2D()
-:speed(0.5),tolerance(0.001),maxIters(1024)
+:speed(0.5),tolerance(0.001),maxIters(1024),
+cycle(CycleV),maxCycles(16),cycleResidual(1e-4),preSweeps(2),postSweeps(2),coarseCG(false),galerkin(false)
 {}
 
 Multigrid2D::~Multigrid2D()
@@ -78,6 +79,8 @@ void Multigrid2D::SetSize(nat32 width,nat32 height,nat32 stencilSize)
    }
   }  
  }
+ 
+ rowVal.Size(height);
 }
 
 nat32 Multigrid2D::Levels() const
@@ -112,6 +115,38 @@ void Multigrid2D::SpreadFirstStencil()
  }
 }
 
+void Multigrid2D::MakeGalerkin()
+{
+ LogTime("eos::alg::Multigrid2D::MakeGalerkin");
+ galerkin = true;
+ for (nat32 l=1;l<data.Size();l++)
+ {
+  // Build a table from offset to stencil entry for the coarse level...
+   int32 range = 0;
+   for (nat32 se=0;se<stencil[l].Size();se++)
+   {
+    range = math::Max(range,math::Abs(stencil[l][se].x));
+    range = math::Max(range,math::Abs(stencil[l][se].y));
+   }
+
+   nat32 side = range*2 + 1;
+   ds::Array<int32> lookup(side*side);
+   for (nat32 i=0;i<lookup.Size();i++) lookup[i] = -1;
+   for (nat32 se=0;se<stencil[l].Size();se++)
+   {
+    lookup[(stencil[l][se].y+range)*side + stencil[l][se].x+range] = se;
+   }
+
+  // Do each row of the coarse level...
+   GalerkinJob job;
+   job.self = this;
+   job.from = l-1;
+   job.range = range;
+   job.lookup = lookup.Ptr();
+   Rows(l,job);
+ }
+}
+
 void Multigrid2D::SetB(nat32 level,nat32 x,nat32 y,real32 val)
 {
  data[level].Get(x,y).b = val;
@@ -186,6 +221,20 @@ void Multigrid2D::SetIters(real32 t,nat32 mi)
  maxIters = mi;
 }
 
+void Multigrid2D::SetCycle(Cycle type,nat32 mc,real32 residual,nat32 pre,nat32 post)
+{
+ cycle = type;
+ maxCycles = mc;
+ cycleResidual = residual;
+ preSweeps = pre;
+ postSweeps = post;
+}
+
+void Multigrid2D::SetCoarseCG(bit enable)
+{
+ coarseCG = enable;
+}
+
 void Multigrid2D::Run(time::Progress * prog)
 {
  LogTime("eos::alg::Multigrid2D::Run");
@@ -290,6 +339,47 @@ void Multigrid2D::ReRun(time::Progress * prog)
  prog->Pop();
 }
 
+nat32 Multigrid2D::RunCycles(time::Progress * prog)
+{
+ LogTime("eos::alg::Multigrid2D::RunCycles");
+ prog->Push();
+ nat32 top = data.Size()-1;
+ 
+ real32 res = ResidualNorm(0);
+ real32 target = cycleResidual * res;
+ nat32 done = 0;
+ 
+ // For full multigrid restrict b to all levels, solve at the top and work
+ // down, doing a V cycle at each level...
+  if ((cycle==CycleFMG)&&(res>target)&&(done<maxCycles))
+  {
+   prog->Report(done,maxCycles);
+   for (nat32 l=0;l<top;l++) TransferUp(l,null<time::Progress*>(),true);
+   Coarse(top);
+   for (int32 l=int32(top)-1;l>=0;l--)
+   {
+    TransferDown(l,null<time::Progress*>(),true);
+    CycleLevel(l,1);
+   }
+   
+   ++done;
+   res = ResidualNorm(0);
+  }
+
+
+ // Cycle until the residual is small enough...
+  while ((res>target)&&(done<maxCycles))
+  {
+   prog->Report(done,maxCycles);
+   CycleLevel(0,(cycle==CycleW)?2:1);
+   ++done;
+   res = ResidualNorm(0);
+  }
+ 
+ prog->Pop();
+ return done;
+}
+
 void Multigrid2D::ZeroMean()
 {
  // Calculate the mean, incrimentally for stability...
@@ -343,129 +433,59 @@ real32 Multigrid2D::Residual(nat32 level,nat32 x,nat32 y)
  return ret;
 }
 
+real32 Multigrid2D::ResidualNorm(nat32 level)
+{
+ ResidualJob job;
+ job.self = this;
+ job.level = level;
+ Rows(level,job);
+ 
+ real64 sum = 0.0;
+ for (nat32 y=0;y<data[level].Height();y++) sum += rowVal[y];
+ return math::Sqrt(sum);
+}
+
 cstrconst Multigrid2D::TypeString() const
 {
 return "eos::alg::Multigrid2D";
 }
 
 //------------------------------------------------------------------------------
-void Multigrid2D::TransferUp(nat32 from,time::Progress * prog)
+void Multigrid2D::TransferUp(nat32 from,time::Progress * prog,bit useB)
 {
  LogTime("eos::alg::Multigrid2D::TransferUp");
  prog->Push();
  // First pass to calculate the residual...
   prog->Report(0,2);
-  prog->Push();
-  for (nat32 y=0;y<data[from].Height();y++)
+  if (!useB)
   {
-   prog->Report(y,data[from].Height());
-   for (nat32 x=0;x<data[from].Width();x++)
-   {
-    data[from].Get(x,y).r = data[from].Get(x,y).b;
-    
-    for (nat32 se=0;se<stencil[from].Size();se++)
-    {
-     if (!math::IsZero(data[from].Get(x,y).a[se]))
-     {
-      real32 rx = data[from].Get(x+stencil[from][se].x,y+stencil[from][se].y).x;
-      data[from].Get(x,y).r -= data[from].Get(x,y).a[se] * rx;
-     }
-    }
-   }
+   ResidualJob job;
+   job.self = this;
+   job.level = from;
+   Rows(from,job);
   }
-  prog->Pop();
 
  // Second pass to transfer the residual up into the b vector and zero the x's...
   prog->Report(1,2);
-  prog->Push();
-  for (nat32 y=0;y<data[from+1].Height();y++)
-  {
-   prog->Report(y,data[from+1].Height());
-   for (nat32 x=0;x<data[from+1].Width();x++)
-   {
-    // Zero the x, which is now an error vector...
-     data[from+1].Get(x,y).x = 0.0;
-  
-    // Calculate the b's as the residual from the previous layer, down sampled...
-     nat32 twX = x*2;
-     nat32 twY = y*2;
-    
-     bit incX = (twX+1)<data[from].Width();
-     bit decX = twX>0;
-     bit incY = (twY+1)<data[from].Height();
-     bit decY = twY>0;
-     
-     if (incX&&decX&&incY&&decY)
-     {
-      data[from+1].Get(x,y).b = 0.25 * data[from].Get(twX,twY).r;
-     
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX+1,twY).r;
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX-1,twY).r;
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX,twY+1).r;
-      data[from+1].Get(x,y).b += 0.125 * data[from].Get(twX,twY-1).r;
-     
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX+1,twY+1).r;
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX+1,twY-1).r;
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX-1,twY+1).r;
-      data[from+1].Get(x,y).b += 0.0625 * data[from].Get(twX-1,twY-1).r;
-     }
-     else
-     {
-      data[from+1].Get(x,y).b = data[from].Get(twX,twY).r;
-     }
-   }
-  }
-  prog->Pop();
+  RestrictJob job;
+  job.self = this;
+  job.from = from;
+  job.useB = useB;
+  Rows(from+1,job);
   
  prog->Pop();
 }
 
-void Multigrid2D::TransferDown(nat32 to,time::Progress * prog)
+void Multigrid2D::TransferDown(nat32 to,time::Progress * prog,bit replace)
 {
  LogTime("eos::alg::Multigrid2D::TransferDown");
  prog->Push();
  
- // Below uses simple linear interpolation.
-  for (nat32 y=0;y<data[to].Height();y++)
-  {
-   prog->Report(y,data[to].Height());
-   for (nat32 x=0;x<data[to].Width();x++)
-   {
-    nat32 halfX = x/2;
-    nat32 halfY = y/2;
-    bit oddX = (x%2)==1;
-    bit oddY = (y%2)==1;
-   
-    real32 offset = 0.0;
-     if (oddX)
-     {
-      if (oddY)
-      {
-       offset = data[to+1].Get(halfX,halfY).x + data[to+1].ClampGet(halfX+1,halfY).x +
-                data[to+1].ClampGet(halfX,halfY+1).x + data[to+1].ClampGet(halfX+1,halfY+1).x;
-       offset *= 0.25;
-      }
-      else
-      {
-       offset = data[to+1].Get(halfX,halfY).x + data[to+1].ClampGet(halfX+1,halfY).x;
-       offset *= 0.5;
-      }
-     }
-     else
-     {
-      if (oddY)
-      {
-       offset = data[to+1].Get(halfX,halfY).x + data[to+1].ClampGet(halfX,halfY+1).x;
-       offset *= 0.5;
-      }
-      else
-      {
-       offset = data[to+1].Get(halfX,halfY).x;
-      }
-     }
-    data[to].Get(x,y).x += offset;
-   }
-  }
+ ProlongJob job;
+ job.self = this;
+ job.to = to;
+ job.replace = replace;
+ Rows(to,job);
   
  prog->Pop();
 }
@@ -478,63 +498,180 @@ void Multigrid2D::Solve(nat32 level,time::Progress * prog)
  for (nat32 iter=0;iter<maxIters;iter++)
  {
   prog->Report(iter,maxIters);
-  real32 change = 0.0;
-  // Symmetric implimentation - direction depends on iter number...
-   if ((iter%2)==0)
+  // Symmetric implimentation - colour order depends on iter number...
+   real32 change;
+   if ((iter%2)==0) change = Sweep(level,true,1.0);
+               else change = Sweep(level,false,speed);
+
+  if (change<tolerance) break;
+  if (math::Abs(change-lastChange)<(math::Sqr(tolerance)*0.1)) break;
+  if (lastChange<change) break;
+  lastChange = change;
+ }
+ prog->Pop();
+}
+
+void Multigrid2D::Colouring(nat32 level,nat32 & colours,nat32 & skew) const
+{
+ // The largest offsets in the stencil give a colouring that is allways valid,
+ // an upper bound on the number of colours...
+  int32 maxX = 0;
+  int32 maxY = 0;
+  for (nat32 se=1;se<stencil[level].Size();se++)
+  {
+   maxX = math::Max(maxX,math::Abs(stencil[level][se].x));
+   maxY = math::Max(maxY,math::Abs(stencil[level][se].y));
+  }
+  nat32 limit = (2*maxX+1)*(2*maxY+1);
+  
+ // Search for the fewest colours, offsets of (0,0) being ignored as they are
+ // the node itself...
+  for (colours=2;colours<limit;colours++)
+  {
+   for (skew=0;skew<colours;skew++)
    {
-    for (int32 y=0;y<int32(data[level].Height());y++)
+    bit ok = true;
+    for (nat32 se=1;se<stencil[level].Size();se++)
     {
-     for (int32 x=0;x<int32(data[level].Width());x++)
-     {
-      real32 val = 0.0;
-      for (nat32 se=1;se<stencil[level].Size();se++)
-      {
-       if (!math::IsZero(data[level].Get(x,y).a[se]))
-       {
-        val += data[level].Get(x,y).a[se] * data[level].Get(x+stencil[level][se].x,y+stencil[level][se].y).x;
-       }
-      }
-      
-      real32 newX = (data[level].Get(x,y).b - val)/data[level].Get(x,y).a[0];
-      if (math::IsFinite(newX))
-      {
-       change += math::Abs(data[level].Get(x,y).x - newX);
-       data[level].Get(x,y).x = newX;
-      }
-     }
+     int32 v = stencil[level][se].x + int32(skew)*stencil[level][se].y;
+     if ((v!=0)&&((v%int32(colours))==0)) {ok = false; break;}
+     if ((v==0)&&(stencil[level][se].y!=0)) {ok = false; break;}
     }
+    if (ok) return;
    }
-   else
+  }
+  
+ colours = limit;
+ skew = 2*maxX+1;
+}
+
+real32 Multigrid2D::Sweep(nat32 level,bit forward,real32 weight)
+{
+ SweepJob job;
+ job.self = this;
+ job.level = level;
+ job.weight = weight;
+ Colouring(level,job.colours,job.skew);
+ 
+ for (nat32 y=0;y<data[level].Height();y++) rowVal[y] = 0.0;
+ for (nat32 c=0;c<job.colours;c++)
+ {
+  job.colour = forward?c:(job.colours-1-c);
+  Rows(level,job);
+ }
+ 
+ real32 ret = 0.0;
+ for (nat32 y=0;y<data[level].Height();y++) ret += rowVal[y];
+ return ret;
+}
+
+void Multigrid2D::Rows(nat32 level,mt::Job & job)
+{
+ // Small levels are not worth the overhead of the pool...
+  static const nat32 serialSize = 16384;
+  if (data[level].Width()*data[level].Height()<serialSize)
+  {
+   for (nat32 y=0;y<data[level].Height();y++) job.Do(y,0);
+  }
+  else mt::SharedPool().Run(job,data[level].Height());
+}
+
+void Multigrid2D::CycleLevel(nat32 level,nat32 gamma)
+{
+ if ((level+1)==data.Size())
+ {
+  Coarse(level);
+  return;
+ }
+
+ for (nat32 i=0;i<preSweeps;i++) Sweep(level,true,1.0);
+ 
+ TransferUp(level,null<time::Progress*>());
+ for (nat32 i=0;i<gamma;i++) CycleLevel(level+1,gamma);
+ TransferDown(level,null<time::Progress*>());
+ 
+ for (nat32 i=0;i<postSweeps;i++) Sweep(level,false,1.0);
+}
+
+void Multigrid2D::Coarse(nat32 level)
+{
+ if (coarseCG) SolveCG(level);
+ else
+ {
+  // Symmetric Gauss-Seidel till the change is below tolerance - unlike Solve
+  // this does not give up when the change grows, which a singular coarse
+  // level, as from Neumann boundaries, does as it drifts...
+   for (nat32 iter=0;iter<maxIters;iter++)
+   {
+    if (Sweep(level,(iter%2)==0,1.0)<tolerance) break;
+   }
+ }
+}
+
+void Multigrid2D::SolveCG(nat32 level)
+{
+ LogTime("eos::alg::Multigrid2D::SolveCG");
+ ds::Array2DRS<Node> & d = data[level];
+ const ds::Array<Offset> & st = stencil[level];
+ nat32 width = d.Width();
+ nat32 height = d.Height();
+ 
+ ds::Array<real32> r(width*height);
+ ds::Array<real32> p(width*height);
+ ds::Array<real32> ap(width*height);
+ 
+ // Initialise the residual and search direction...
+  real64 rr = 0.0;
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    nat32 i = y*width + x;
+    r[i] = Residual(level,x,y);
+    p[i] = r[i];
+    rr += math::Sqr(r[i]);
+   }
+  }
+  real64 stop = math::Sqr(tolerance)*rr;
+  
+ // Iterate...
+  for (nat32 iter=0;(iter<maxIters)&&(rr>stop);iter++)
+  {
+   real64 pap = 0.0;
+   for (nat32 y=0;y<height;y++)
    {
-    for (int32 y=int32(data[level].Height())-1;y>=0;y--)
+    for (nat32 x=0;x<width;x++)
     {
-     for (int32 x=int32(data[level].Width())-1;x>=0;x--)
+     nat32 i = y*width + x;
+     const Node & n = d.Get(x,y);
+     real32 val = 0.0;
+     for (nat32 se=0;se<st.Size();se++)
      {
-      real32 val = 0.0;
-      for (nat32 se=1;se<stencil[level].Size();se++)
-      {
-       if (!math::IsZero(data[level].Get(x,y).a[se]))
-       {
-        val += data[level].Get(x,y).a[se] * data[level].Get(x+stencil[level][se].x,y+stencil[level][se].y).x;
-       }
-      }
-      
-      real32 newX = (data[level].Get(x,y).b - val)/data[level].Get(x,y).a[0];
-      if (math::IsFinite(newX))
-      {
-       change += math::Abs(data[level].Get(x,y).x - newX);
-       data[level].Get(x,y).x = (1.0-speed)*data[level].Get(x,y).x + speed*newX;
-      }
+      if (!math::IsZero(n.a[se])) val += n.a[se] * p[i + st[se].x + st[se].y*int32(width)];
      }
+     ap[i] = val;
+     pap += p[i]*val;
     }
    }
-
-  if (change<tolerance) break;
-  if (math::Abs(change-lastChange)<(math::Sqr(tolerance)*0.1)) break;
-  if (lastChange<change) break;
-  lastChange = change;
- }
- prog->Pop();
+   if (!(pap>0.0)) break;
+   
+   real64 alpha = rr/pap;
+   real64 rrNew = 0.0;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++)
+    {
+     nat32 i = y*width + x;
+     d.Get(x,y).x += alpha*p[i];
+     r[i] -= alpha*ap[i];
+     rrNew += math::Sqr(r[i]);
+    }
+   }
+   
+   real64 beta = rrNew/rr;
+   for (nat32 i=0;i<p.Size();i++) p[i] = r[i] + beta*p[i];
+   rr = rrNew;
+  }
 }
 
 real32 Multigrid2D::TotalResidual(nat32 level)
@@ -560,6 +697,269 @@ real32 Multigrid2D::TotalResidual(nat32 level)
  return math::Pow<real32>(2.0,level)*math::Sqrt(residual);
 }
 
+//------------------------------------------------------------------------------
+void Multigrid2D::SweepJob::Do(nat32 y,nat32)
+{
+ ds::Array2DRS<Node> & d = self->data[level];
+ const ds::Array<Offset> & st = self->stencil[level];
+ 
+ real32 change = 0.0;
+ for (nat32 x=(colour+colours-((skew*y)%colours))%colours;x<d.Width();x+=colours)
+ {
+  Node & n = d.Get(x,y);
+  real32 val = 0.0;
+  for (nat32 se=1;se<st.Size();se++)
+  {
+   if (!math::IsZero(n.a[se])) val += n.a[se] * d.Get(int32(x)+st[se].x,int32(y)+st[se].y).x;
+  }
+  
+  real32 newX = (n.b - val)/n.a[0];
+  if (math::IsFinite(newX))
+  {
+   change += math::Abs(n.x - newX);
+   n.x = (1.0-weight)*n.x + weight*newX;
+  }
+ }
+ self->rowVal[y] += change;
+}
+
+void Multigrid2D::ResidualJob::Do(nat32 y,nat32)
+{
+ ds::Array2DRS<Node> & d = self->data[level];
+ const ds::Array<Offset> & st = self->stencil[level];
+ 
+ real32 sum = 0.0;
+ for (nat32 x=0;x<d.Width();x++)
+ {
+  Node & n = d.Get(x,y);
+  n.r = n.b;
+  for (nat32 se=0;se<st.Size();se++)
+  {
+   if (!math::IsZero(n.a[se])) n.r -= n.a[se] * d.Get(int32(x)+st[se].x,int32(y)+st[se].y).x;
+  }
+  sum += math::Sqr(n.r);
+ }
+ self->rowVal[y] = sum;
+}
+
+void Multigrid2D::RestrictJob::Do(nat32 y,nat32)
+{
+ ds::Array2DRS<Node> & d = self->data[from];
+ ds::Array2DRS<Node> & targ = self->data[from+1];
+ real32 Node::* src = useB?&Node::b:&Node::r;
+ 
+ for (nat32 x=0;x<targ.Width();x++)
+ {
+  // Zero the x, which is now an error vector...
+   targ.Get(x,y).x = 0.0;
+  
+  // Calculate the b's as the residual from the previous layer, down sampled
+  // with full weighting, renormalised at the edges where some of the
+  // neighbours do not exist. With Galerkin operators restriction is instead
+  // exactly a quarter of the transpose of prolongation, so the coarse levels
+  // stay symmetric and singular problems consistent - there is no
+  // renormalisation, and a fine node beyond the last coarse node gets full
+  // weight, as ProlongJob interpolates it from that node alone...
+   nat32 twX = x*2;
+   nat32 twY = y*2;
+    
+   bit incX = (twX+1)<d.Width();
+   bit decX = twX>0;
+   bit incY = (twY+1)<d.Height();
+   bit decY = twY>0;
+   bit edgeX = self->galerkin && ((x+1)==targ.Width());
+   bit edgeY = self->galerkin && ((y+1)==targ.Height());
+     
+   real32 & b = targ.Get(x,y).b;
+   if (incX&&decX&&incY&&decY&&(!edgeX)&&(!edgeY))
+   {
+    b = 0.25 * (d.Get(twX,twY).*src);
+     
+    b += 0.125 * (d.Get(twX+1,twY).*src);
+    b += 0.125 * (d.Get(twX-1,twY).*src);
+    b += 0.125 * (d.Get(twX,twY+1).*src);
+    b += 0.125 * (d.Get(twX,twY-1).*src);
+     
+    b += 0.0625 * (d.Get(twX+1,twY+1).*src);
+    b += 0.0625 * (d.Get(twX+1,twY-1).*src);
+    b += 0.0625 * (d.Get(twX-1,twY+1).*src);
+    b += 0.0625 * (d.Get(twX-1,twY-1).*src);
+   }
+   else
+   {
+    real32 sum = 0.0;
+    real32 weight = 0.0;
+    for (int32 v=(decY?-1:0);v<=(incY?1:0);v++)
+    {
+     for (int32 u=(decX?-1:0);u<=(incX?1:0);u++)
+     {
+      real32 w = ((u==0)?1.0:(((u==1)&&edgeX)?1.0:0.5)) * ((v==0)?1.0:(((v==1)&&edgeY)?1.0:0.5));
+      sum += w * (d.Get(int32(twX)+u,int32(twY)+v).*src);
+      weight += w;
+     }
+    }
+    b = self->galerkin?(0.25*sum):(sum/weight);
+   }
+ }
+}
+
+void Multigrid2D::ProlongJob::Do(nat32 y,nat32)
+{
+ ds::Array2DRS<Node> & d = self->data[to];
+ ds::Array2DRS<Node> & from = self->data[to+1];
+ 
+ // Below uses simple linear interpolation.
+  for (nat32 x=0;x<d.Width();x++)
+  {
+   nat32 halfX = x/2;
+   nat32 halfY = y/2;
+   bit oddX = (x%2)==1;
+   bit oddY = (y%2)==1;
+   
+   real32 offset = 0.0;
+    if (oddX)
+    {
+     if (oddY)
+     {
+      offset = from.Get(halfX,halfY).x + from.ClampGet(halfX+1,halfY).x +
+               from.ClampGet(halfX,halfY+1).x + from.ClampGet(halfX+1,halfY+1).x;
+      offset *= 0.25;
+     }
+     else
+     {
+      offset = from.Get(halfX,halfY).x + from.ClampGet(halfX+1,halfY).x;
+      offset *= 0.5;
+     }
+    }
+    else
+    {
+     if (oddY)
+     {
+      offset = from.Get(halfX,halfY).x + from.ClampGet(halfX,halfY+1).x;
+      offset *= 0.5;
+     }
+     else
+     {
+      offset = from.Get(halfX,halfY).x;
+     }
+    }
+   
+   if (replace) d.Get(x,y).x = offset;
+           else d.Get(x,y).x += offset;
+  }
+}
+
+void Multigrid2D::GalerkinJob::Do(nat32 y,nat32)
+{
+ ds::Array2DRS<Node> & fine = self->data[from];
+ ds::Array2DRS<Node> & coarse = self->data[from+1];
+ const ds::Array<Offset> & fst = self->stencil[from];
+ nat32 cse = self->stencil[from+1].Size();
+ nat32 side = range*2 + 1;
+
+ for (nat32 x=0;x<coarse.Width();x++)
+ {
+  Node & targ = coarse.Get(x,y);
+  for (nat32 se=0;se<cse;se++) targ.a[se] = 0.0;
+
+  // Iterate the fine nodes restricted into this one, with the weights used by
+  // RestrictJob once galerkin is set...
+   nat32 twX = x*2;
+   nat32 twY = y*2;
+   int32 minU = (twX>0)?-1:0;
+   int32 maxU = ((twX+1)<fine.Width())?1:0;
+   int32 minV = (twY>0)?-1:0;
+   int32 maxV = ((twY+1)<fine.Height())?1:0;
+
+   real64 rowSum = 0.0; // Of the restricted fine rows, which the coarse row must match.
+   real64 rowMag = 0.0; // Likewise, of the absolute values, to judge rounding by.
+   bit edgeX = (x+1)==coarse.Width();
+   bit edgeY = (y+1)==coarse.Height();
+
+   for (int32 v=minV;v<=maxV;v++)
+   {
+    for (int32 u=minU;u<=maxU;u++)
+    {
+     real32 r = 0.25 * ((u==0)?1.0:(((u==1)&&edgeX)?1.0:0.5)) * ((v==0)?1.0:(((v==1)&&edgeY)?1.0:0.5));
+     int32 fx = int32(twX) + u;
+     int32 fy = int32(twY) + v;
+     const Node & fn = fine.Get(fx,fy);
+
+     // Skip fixed nodes...
+      bit coupled = false;
+      for (nat32 se=1;se<fst.Size();se++)
+      {
+       if (!math::IsZero(fn.a[se])) {coupled = true; break;}
+      }
+      if (!coupled) continue;
+
+      real64 fineSum = 0.0;
+      real64 fineMag = 0.0;
+      for (nat32 se=0;se<fst.Size();se++)
+      {
+       fineSum += fn.a[se];
+       fineMag += math::Abs(fn.a[se]);
+      }
+      rowSum += r * fineSum;
+      rowMag += r * fineMag;
+
+     // Each stencil entry multiplied by the interpolation of its node from
+     // the coarse level, as done by ProlongJob...
+      for (nat32 se=0;se<fst.Size();se++)
+      {
+       if (math::IsZero(fn.a[se])) continue;
+       int32 jx = fx + fst[se].x;
+       int32 jy = fy + fst[se].y;
+
+       int32 cx[2];
+       int32 cy[2];
+       real32 px[2];
+       real32 py[2];
+       nat32 nx = 1;
+       nat32 ny = 1;
+       cx[0] = jx/2; px[0] = 1.0;
+       cy[0] = jy/2; py[0] = 1.0;
+       if (((jx%2)==1)&&((cx[0]+1)<int32(coarse.Width())))
+       {
+        cx[1] = cx[0]+1; px[0] = 0.5; px[1] = 0.5; nx = 2;
+       }
+       if (((jy%2)==1)&&((cy[0]+1)<int32(coarse.Height())))
+       {
+        cy[1] = cy[0]+1; py[0] = 0.5; py[1] = 0.5; ny = 2;
+       }
+
+       real32 ra = r * fn.a[se];
+       for (nat32 j=0;j<ny;j++)
+       {
+        for (nat32 i=0;i<nx;i++)
+        {
+         int32 ox = cx[i] - int32(x);
+         int32 oy = cy[j] - int32(y);
+         int32 ind = -1;
+         if ((math::Abs(ox)<=range)&&(math::Abs(oy)<=range)) ind = lookup[(oy+range)*side + ox+range];
+         if (ind<0) ind = 0;
+         targ.a[ind] += ra * px[i] * py[j];
+        }
+       }
+      }
+    }
+   }
+
+  // Recalculate entry 0 from the row sum, which interpolation preserves. Row
+  // sums that are zero bar rounding, as for Neumann boundaries, are made
+  // exactly zero, else the rounding grows relative to the entries, which
+  // shrink with each level, till coarse levels become indefinite...
+   real64 off = 0.0;
+   for (nat32 se=1;se<cse;se++) off += targ.a[se];
+   if (math::Abs(rowSum)<(1e-5*rowMag)) rowSum = 0.0;
+   targ.a[0] = rowSum - off;
+
+  // A node with nothing restricted into it, or a single node of a singular
+  // level, is left to sit at its b...
+   if (math::IsZero(targ.a[0])) targ.a[0] = 1.0;
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -27,6 +27,7 @@
 #include "eos/ds/arrays.h"
 #include "eos/ds/arrays2d.h"
 #include "eos/svt/field.h"
+#include "eos/mt/pool.h"
 
 
 namespace eos
@@ -45,8 +46,16 @@ namespace eos
 /// You have to fill in the A matrix for all hierachy levels, making that part 
 /// of the hierachy the users responsibility. The mapping of x between the 
 /// levels of the hierachy is implimented internally, using linear interpolation.
-/// Uses the FMG update scheme, for those who care, with symmetric
-/// Gauss-Seidel.
+/// Run uses the FMG update scheme, for those who care, with symmetric
+/// Gauss-Seidel, ReRun V cycles; both solve each level to convergence.
+/// RunCycles instead does proper multigrid cycles, a few smoothing sweeps per
+/// level with residual based stopping, which is what you want for large grids.
+///
+/// Gauss-Seidel is done in multi-colour order, the colouring chosen from the
+/// stencil so no node depends on another of its own colour - red-black for
+/// the usual 5 point stencil. This allows each colour to be done a row at a
+/// time on the shared thread pool, and makes the result independent of the
+/// number of threads.
 class EOS_CLASS Multigrid2D
 {
  public:
@@ -111,6 +120,26 @@ class EOS_CLASS Multigrid2D
   /// accordingly. Will have to fix the value on each level.
    void Fix(nat32 level,nat32 x,nat32 y,real32 val);
    
+  /// Fills in A for every level after the first as the Galerkin coarse grid
+  /// operator, R A P, where R and P are the restriction and interpolation used
+  /// to move between levels, so only level 0 of A need be set. Slower to set
+  /// up than providing A for every level, but convergence no longer depends on
+  /// the coarse levels solving the same approximate problem, which is hard to
+  /// arrange for irregular or masked domains and for Neumann boundaries, as
+  /// coarse nodes sit on every other fine node rather than spanning the same
+  /// area. The coarse stencils should include every offset in [-1,1]x[-1,1]
+  /// when level 0 is 4 or 8 way; any contribution to an offset a stencil lacks
+  /// is added to entry 0 instead, which keeps row sums. Rows of the finer
+  /// level with no off diagonal entries, i.e. nodes that are simply fixed,
+  /// are left out, and coarse nodes left without an entry 0, or with one that
+  /// has cancelled to rounding error, get 1. Also switches restriction to a
+  /// quarter of the transpose of interpolation, without renormalisation at
+  /// the edges, so the coarse levels of a symmetric A are symmetric, and a
+  /// cycle from x = 0 can precondition conjugate gradients. For singular
+  /// problems, such as pure Neumann, limit the coarse level iterations with
+  /// SetIters, as given long enough they drift.
+   void MakeGalerkin();
+
   /// For providing initialisation - optional, as defaults to 0.
   /// (Good for testing, as you can initialise to answer and see if 
   /// it distorts it.)
@@ -127,7 +156,29 @@ class EOS_CLASS Multigrid2D
   /// Sets the maximum iterations for solving each Ax = b equation, and the 
   /// tolerance under which to stop.
   /// Default tolerance is 0.001, maxIters is 1024.
+  /// Used by Run and ReRun for every level, and by RunCycles for the coarsest.
    void SetIters(real32 tolerance,nat32 maxIters);
+
+
+  /// The cycle shapes RunCycles can use.
+   enum Cycle {CycleV, ///< Down to the coarsest level and straight back up.
+               CycleW, ///< Visits each coarser level twice per visit to the level above, more robust but more work.
+               CycleFMG ///< Full multigrid, b is restricted to all levels and solved from the coarsest down, a V cycle per level, then V cycles follow. Ignores any initialisation of x, so repeated calls start afresh.
+              };
+
+  /// Configures RunCycles. It stops after maxCycles, or once the 2-norm of the
+  /// level 0 residual falls below residual times its value before the first
+  /// cycle. pre and post are the number of Gauss-Seidel sweeps done at each
+  /// level before going to the coarser level and after returning.
+  /// Defaults are CycleV, 16, 1e-4, 2 and 2.
+   void SetCycle(Cycle type,nat32 maxCycles = 16,real32 residual = 1e-4,nat32 pre = 2,nat32 post = 2);
+   
+  /// If set the coarsest level in RunCycles is solved with conjugate gradients
+  /// rather than Gauss-Seidel, using the tolerance, relative to the starting
+  /// residual, and iteration limit given to SetIters. Only valid if A is
+  /// symmetric positive definite at that level - note that Fix breaks symmetry.
+  /// Defaults to false.
+   void SetCoarseCG(bit enable);
   
   /// Runs the algorithm.
   /// Finds a set of x's such that each b is calculated from multiplication of
@@ -145,6 +196,11 @@ class EOS_CLASS Multigrid2D
   /// initialisation there.
   /// Can be called after a first call of Run, or without ever calling Run.
    void ReRun(time::Progress * prog = null<time::Progress*>());
+
+  /// Runs multigrid cycles, as configured by SetCycle and SetCoarseCG.
+  /// Like ReRun it uses all levels of the a matrix, only the first level of
+  /// b and x, and may be called repeatedly. Returns the number of cycles done.
+   nat32 RunCycles(time::Progress * prog = null<time::Progress*>());
    
   
   /// This zero means the x values - an be called between re-runs or before 
@@ -170,6 +226,9 @@ class EOS_CLASS Multigrid2D
   /// Returns the residual for a single location on a given level, primarilly 
   /// for debug and analysis stuff.
    real32 Residual(nat32 level,nat32 x,nat32 y);
+   
+  /// Returns the 2-norm of the residual for an entire level.
+   real32 ResidualNorm(nat32 level);
 
 
   /// &nbsp;
@@ -180,6 +239,14 @@ class EOS_CLASS Multigrid2D
   real32 speed;
   real32 tolerance;
   nat32 maxIters;
+  
+  Cycle cycle;
+  nat32 maxCycles;
+  real32 cycleResidual;
+  nat32 preSweeps;
+  nat32 postSweeps;
+  bit coarseCG;
+  bit galerkin; // Set by MakeGalerkin, makes RestrictJob a quarter of the transpose of ProlongJob.
  
   // Structure to store a stencil entry offste details...
    struct Offset
@@ -205,11 +272,72 @@ class EOS_CLASS Multigrid2D
   // Note that its partially trashed at run time.
    ds::ArrayDel<ds::Array2DRS<Node> > data; // Indexed as data[level].Get(x,y).<...>
    
+  // Per row values, summed after each parallel pass so the result does not
+  // depend on the order the rows were done in...
+   ds::Array<real32> rowVal;
+   
    
   // Helper methods...
-   void TransferUp(nat32 from,time::Progress * prog); // Fills in from+1 b's with the residual of from, zeroes from+1 x's.
-   void TransferDown(nat32 to,time::Progress * prog); // Offsets to's x's by the interpolated x's of to+1.
+   void TransferUp(nat32 from,time::Progress * prog,bit useB = false); // Fills in from+1 b's with the residual of from, zeroes from+1 x's. useB restricts b instead.
+   void TransferDown(nat32 to,time::Progress * prog,bit replace = false); // Offsets to's x's by the interpolated x's of to+1, or sets them if replace.
    void Solve(nat32 level,time::Progress * prog); // Runs symmetric Gauss-Seidel iterations on the given level till convergance.
+   
+   void Colouring(nat32 level,nat32 & colours,nat32 & skew) const; // Node (x,y) has colour (x + skew*y)%colours.
+   real32 Sweep(nat32 level,bit forward,real32 weight); // One Gauss-Seidel sweep, colours in forward or reverse order, returns the total change.
+   void Rows(nat32 level,mt::Job & job); // Runs a job with a unit per row of the given level, in parallel if its big enough.
+   
+   void CycleLevel(nat32 level,nat32 gamma); // A V cycle from the given level if gamma is 1, a W cycle if 2.
+   void Coarse(nat32 level); // Solves the coarsest level, by Solve or SolveCG.
+   void SolveCG(nat32 level); // Conjugate gradient solve of a level.
+   
+  // Jobs, each of which does a row of a level as a unit...
+   class SweepJob : public mt::Job
+   {
+    public:
+     Multigrid2D * self;
+     nat32 level;
+     nat32 colours;
+     nat32 skew;
+     nat32 colour;
+     real32 weight;
+     void Do(nat32 unit,nat32 thread);
+   };
+   
+   class ResidualJob : public mt::Job // Sets r, and rowVal to the sum of r squared for the row.
+   {
+    public:
+     Multigrid2D * self;
+     nat32 level;
+     void Do(nat32 unit,nat32 thread);
+   };
+   
+   class RestrictJob : public mt::Job
+   {
+    public:
+     Multigrid2D * self;
+     nat32 from;
+     bit useB;
+     void Do(nat32 unit,nat32 thread);
+   };
+   
+   class ProlongJob : public mt::Job
+   {
+    public:
+     Multigrid2D * self;
+     nat32 to;
+     bit replace;
+     void Do(nat32 unit,nat32 thread);
+   };
+
+   class GalerkinJob : public mt::Job // Fills in A for a row of level from+1.
+   {
+    public:
+     Multigrid2D * self;
+     nat32 from;
+     int32 range; // lookup covers offsets in [-range,range]^2.
+     const int32 * lookup; // Coarse stencil entry for each offset, -1 if none.
+     void Do(nat32 unit,nat32 thread);
+   };
 
 
   // Debugging methods...
@@ -0,0 +1,329 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/alg/ransac.h"
+
+#include "eos/math/functions.h"
+#include "eos/data/randoms.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace alg
+ {
+//------------------------------------------------------------------------------
+// Helper for PROSAC ordering...
+struct RansacQuality
+{
+ real32 quality;
+ nat32 index;
+
+ bit operator < (const RansacQuality & rhs) const {return quality<rhs.quality;}
+};
+
+//------------------------------------------------------------------------------
+Ransac::Ransac()
+:reliability(0.99),cap(10000),prosac(false),preemptive(true),sprt(true),
+pool(&mt::SharedPool()),bestInliers(0),hypotheses(0),rejected(0),
+model(null<RansacModel*>())
+{}
+
+Ransac::~Ransac()
+{}
+
+void Ransac::Set(real64 r,nat32 c)
+{
+ reliability = r;
+ cap = c;
+}
+
+bit Ransac::Run(RansacModel & m,time::Progress * prog)
+{
+ LogBlock("bit eos::alg::Ransac::Run(...)","{size,prosac,preemptive,sprt}" << LogDiv() << m.Size() << LogDiv() << prosac << LogDiv() << preemptive << LogDiv() << sprt);
+
+ bestInliers = 0;
+ hypotheses = 0;
+ rejected = 0;
+ model = &m;
+
+ nat32 n = model->Size();
+ nat32 ms = model->MinSample();
+ if ((ms==0)||(n<ms)) return false;
+
+ prog->Push();
+
+
+ // Storage for a batch of hypotheses...
+  nat32 batch = math::Max<nat32>(16,4*pool->Threads());
+  model->Slots(batch);
+  sample.Size(batch*ms);
+  hyp.Size(batch);
+  live.Size(batch);
+
+
+ // Random order for testing data points, and the order for sampling...
+  data::Random rand;
+  order.Size(n);
+  for (nat32 i=0;i<n;i++) order[i] = i;
+  for (nat32 i=n-1;i>0;i--) math::Swap(order[i],order[rand.Int(0,i)]);
+
+  ds::Array<nat32> sorted(n);
+  if (prosac)
+  {
+   ds::Array<RansacQuality> rq(n);
+   for (nat32 i=0;i<n;i++)
+   {
+    rq[i].quality = model->Quality(i);
+    rq[i].index = i;
+   }
+   rq.SortNorm();
+   for (nat32 i=0;i<n;i++) sorted[i] = rq[i].index;
+  }
+  else
+  {
+   for (nat32 i=0;i<n;i++) sorted[i] = i;
+  }
+
+
+ // Setup the probability ratio test...
+  real64 epsilon = 0.1;
+  real64 delta = 0.01;
+  real64 deltaIn = 0.0; // Inliers seen by rejected hypotheses.
+  real64 deltaTest = 0.0; // Tests made by rejected hypotheses.
+  Design(epsilon,delta,model->FitCost());
+
+
+ // PROSAC state...
+  real64 tn = cap;
+  for (nat32 i=0;i<ms;i++) tn *= real64(ms-i)/real64(n-i);
+  nat32 tnPrime = 1;
+  nat32 pn = prosac?ms:n; // Size of the sampled subset.
+
+
+ // Generate and test batches until we have enough confidence...
+  nat32 needed = cap;
+  bit found = false;
+  while (hypotheses<needed)
+  {
+   prog->Report(hypotheses,needed);
+   nat32 bs = math::Min(batch,needed-hypotheses);
+
+   // Draw the samples for the batch...
+    for (nat32 b=0;b<bs;b++)
+    {
+     ++hypotheses;
+     nat32 * s = &sample[b*ms];
+     nat32 from = n;
+     nat32 fixed = 0;
+
+     if (pn<n)
+     {
+      while ((pn<n)&&(hypotheses>tnPrime))
+      {
+       real64 tn1 = tn*real64(pn+1)/real64(pn+1-ms);
+       tnPrime += nat32(math::RoundUp(tn1-tn));
+       tn = tn1;
+       ++pn;
+      }
+      if (pn<n)
+      {
+       s[0] = sorted[pn-1];
+       fixed = 1;
+       from = pn-1;
+      }
+     }
+
+     for (nat32 j=fixed;j<ms;j++)
+     {
+      while (true)
+      {
+       s[j] = sorted[rand.Int(0,from-1)];
+       bit dup = false;
+       for (nat32 k=0;k<j;k++)
+       {
+        if (s[k]==s[j]) {dup = true; break;}
+       }
+       if (!dup) break;
+      }
+     }
+    }
+
+   // Fit the hypotheses...
+    FitJob fj;
+    fj.self = this;
+    pool->Run(fj,bs);
+
+    nat32 liveSize = 0;
+    for (nat32 b=0;b<bs;b++)
+    {
+     if (hyp[b].alive) {live[liveSize] = b; ++liveSize;}
+    }
+
+   // Score them, a block of data at a time, preempting as we go...
+    nat32 block = n;
+    if (preemptive) block = math::Max<nat32>(64,n/8);
+
+    blockStart = 0;
+    while ((blockStart<n)&&(liveSize!=0))
+    {
+     blockEnd = math::Min(n,blockStart+block);
+     ScoreJob sj;
+     sj.self = this;
+     pool->Run(sj,liveSize);
+
+     // Remove the rejected, updating the delta estimate...
+      nat32 nls = 0;
+      for (nat32 i=0;i<liveSize;i++)
+      {
+       Hyp & targ = hyp[live[i]];
+       if (targ.alive) {live[nls] = live[i]; ++nls;}
+       else
+       {
+        ++rejected;
+        deltaIn += targ.inliers;
+        deltaTest += targ.tested;
+       }
+      }
+      liveSize = nls;
+
+     // Preemption - sort by inliers so far and drop the worse half...
+      if ((preemptive)&&(blockEnd<n)&&(liveSize>1))
+      {
+       for (nat32 i=1;i<liveSize;i++)
+       {
+        for (nat32 j=i;j>0;j--)
+        {
+         if (hyp[live[j]].inliers<=hyp[live[j-1]].inliers) break;
+         math::Swap(live[j],live[j-1]);
+        }
+       }
+
+       nat32 keep = (liveSize+1)/2;
+       rejected += liveSize - keep;
+       liveSize = keep;
+      }
+
+     blockStart = blockEnd;
+    }
+
+   // Survivors have been tested against everything - find the best...
+    bit improved = false;
+    for (nat32 i=0;i<liveSize;i++)
+    {
+     if (hyp[live[i]].inliers>bestInliers)
+     {
+      bestInliers = hyp[live[i]].inliers;
+      model->Keep(live[i]);
+      found = true;
+      improved = true;
+     }
+    }
+
+   // Update the test design and stopping criterion...
+    bit redesign = false;
+    if (improved)
+    {
+     real64 eps = real64(bestInliers)/real64(n);
+     if (eps>epsilon) {epsilon = eps; redesign = true;}
+    }
+
+    if (deltaTest>real64(4*n))
+    {
+     real64 del = math::Max(deltaIn/deltaTest,1e-4);
+     if (math::Abs(del-delta)>0.1*delta) {delta = del; redesign = true;}
+    }
+
+    if (redesign) Design(epsilon,delta,model->FitCost());
+
+    if (improved)
+    {
+     real64 alpha = 0.0; // Probability of rejecting a good hypothesis.
+     if (sprt&&math::IsFinite(threshold)) alpha = 1.0/threshold;
+
+     real64 sr = math::Ln(1.0-reliability)/math::Ln(1.0-math::Pow(real64(bestInliers)/real64(n),real64(ms)));
+     sr /= 1.0-alpha;
+     if (math::IsFinite(sr)&&(sr<real64(cap))) needed = math::Max(hypotheses,nat32(sr)+1);
+    }
+  }
+
+ LogDebug("[alg.ransac] Done {hypotheses,rejected,inliers,epsilon,delta}" << LogDiv() << hypotheses << LogDiv() << rejected << LogDiv() << bestInliers << LogDiv() << epsilon << LogDiv() << delta);
+
+ prog->Pop();
+ return found;
+}
+
+void Ransac::Design(real64 epsilon,real64 delta,real64 fitCost)
+{
+ if ((!sprt)||(epsilon<=delta))
+ {
+  inlierMult = 1.0;
+  outlierMult = 1.0;
+  threshold = math::Infinity<real64>();
+  return;
+ }
+
+ inlierMult = delta/epsilon;
+ outlierMult = (1.0-delta)/(1.0-epsilon);
+
+ // The expected log ratio for a bad hypothesis, then iterate to find the
+ // optimal threshold...
+  real64 c = (1.0-delta)*math::Ln(outlierMult) + delta*math::Ln(inlierMult);
+  real64 base = fitCost*c + 1.0;
+  threshold = base;
+  for (nat32 i=0;i<10;i++) threshold = base + math::Ln(threshold);
+}
+
+//------------------------------------------------------------------------------
+void Ransac::FitJob::Do(nat32 unit,nat32)
+{
+ Hyp & targ = self->hyp[unit];
+ targ.alive = self->model->Fit(unit,&self->sample[unit*self->model->MinSample()]);
+ targ.rejected = false;
+ targ.inliers = 0;
+ targ.tested = 0;
+ targ.lambda = 1.0;
+}
+
+void Ransac::ScoreJob::Do(nat32 unit,nat32)
+{
+ nat32 slot = self->live[unit];
+ Hyp & targ = self->hyp[slot];
+
+ for (nat32 k=self->blockStart;k<self->blockEnd;k++)
+ {
+  ++targ.tested;
+  if (self->model->Inlier(slot,self->order[k]))
+  {
+   ++targ.inliers;
+   targ.lambda *= self->inlierMult;
+  }
+  else
+  {
+   targ.lambda *= self->outlierMult;
+   if (targ.lambda>self->threshold)
+   {
+    targ.alive = false;
+    targ.rejected = true;
+    break;
+   }
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,207 @@
+#ifndef EOS_ALG_RANSAC_H
+#define EOS_ALG_RANSAC_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file ransac.h
+/// Provides a generic, multi-threaded, implimentation of RANSAC with the
+/// various modern tricks for making it fast - PROSAC style ordered sampling,
+/// preemptive scoring and sequential probability ratio test early rejection.
+
+#include "eos/types.h"
+#include "eos/ds/arrays.h"
+#include "eos/time/progress.h"
+#include "eos/mt/pool.h"
+
+namespace eos
+{
+ namespace alg
+ {
+//------------------------------------------------------------------------------
+/// The interface a model must impliment to be fitted by the Ransac class.
+/// The model is responsible for storing the data and hypotheses - hypotheses
+/// are refered to by slot numbers, the model must have storage for as many
+/// slots as it is told to have by Slots(). Fit and Inlier will be called by
+/// multiple threads at once, always with different slots for Fit, so they
+/// must not modify any shared state.
+class EOS_CLASS RansacModel
+{
+ public:
+  /// &nbsp;
+   virtual ~RansacModel() {}
+
+
+  /// Returns how many data points there are.
+   virtual nat32 Size() const = 0;
+
+  /// Returns the minimal sample size, i.e. how many data points are needed to
+  /// fit a hypothesis.
+   virtual nat32 MinSample() const = 0;
+
+  /// Returns the cost of fitting a hypothesis relative to testing a single
+  /// data point against a hypothesis. Used to tune the early rejection test.
+   virtual real64 FitCost() const {return 100.0;}
+
+  /// Returns a quality score for a data point, lower is better. If PROSAC
+  /// ordering is enabled in Ransac data points with better quality are
+  /// sampled first. (e.g. The distance ratio of a feature match.)
+   virtual real32 Quality(nat32 i) const {return 0.0;}
+
+
+  /// Called before any calls to Fit, to indicate how many hypothesis slots are
+  /// required.
+   virtual void Slots(nat32 n) = 0;
+
+  /// Fits a hypothesis into the given slot, from MinSample() data indices.
+  /// Returns false if the sample was degenerate.
+   virtual bit Fit(nat32 slot,const nat32 * sample) = 0;
+
+  /// Returns true if the given data point is an inlier of the hypothesis in
+  /// the given slot.
+   virtual bit Inlier(nat32 slot,nat32 i) const = 0;
+
+  /// Called when the hypothesis in the given slot is the best found so far,
+  /// the model should copy it somewhere safe as the slot will be reused.
+   virtual void Keep(nat32 slot) = 0;
+};
+
+//------------------------------------------------------------------------------
+/// The RANSAC algorithm, made fast. Hypotheses are generated in batches,
+/// with the fitting and scoring of a batch split across a thread pool. Within
+/// a batch scoring is preemptive - hypotheses are all scored against the
+/// same block of data points, in a random order, after which the worse half
+/// are discarded and the remainder scored against the next block, and so on.
+/// Each hypothesis is also subjected to a sequential probability ratio test as
+/// its scored, so obviously bad hypotheses are dropped after a handful of
+/// data points. Optionally sampling can use PROSAC ordering, where hypotheses
+/// are initially generated only from the data points with the best quality,
+/// slowly widening to uniform sampling.
+///
+/// Based on 'Randomized RANSAC with Sequential Probability Ratio Test' by Matas
+/// and Chum, 'Preemptive RANSAC for Live Structure and Motion Estimation' by
+/// Nister and 'Matching with PROSAC - Progressive Sample Consensus' by Chum and
+/// Matas.
+class EOS_CLASS Ransac
+{
+ public:
+  /// &nbsp;
+   Ransac();
+
+  /// &nbsp;
+   ~Ransac();
+
+
+  /// Sets the stopping parameters.
+  /// \param reliability Probability of having found the correct answer at which to stop.
+  /// \param cap Maximum number of hypotheses to generate.
+   void Set(real64 reliability = 0.99,nat32 cap = 10000);
+
+  /// Enables/disables PROSAC ordering of samples, off by default.
+   void Prosac(bit enable) {prosac = enable;}
+
+  /// Enables/disables preemptive scoring of batches, on by default. If
+  /// disabled each hypothesis is scored against all data, subject only to
+  /// early rejection.
+   void Preemptive(bit enable) {preemptive = enable;}
+
+  /// Enables/disables the early rejection test, on by default.
+   void Sprt(bit enable) {sprt = enable;}
+
+  /// Sets the pool used to run in parallel, defaults to mt::SharedPool().
+   void SetPool(mt::Pool & p) {pool = &p;}
+
+
+  /// Runs the algorithm on the given model, returns true if a hypothesis was
+  /// found, in which case the model will have been given it via Keep.
+   bit Run(RansacModel & model,time::Progress * prog = null<time::Progress*>());
+
+
+  /// Returns the inlier count of the best hypothesis found.
+   nat32 Inliers() const {return bestInliers;}
+
+  /// Returns how many hypotheses were generated.
+   nat32 Hypotheses() const {return hypotheses;}
+
+  /// Returns how many hypotheses were rejected early, either by the
+  /// probability ratio test or preemption.
+   nat32 Rejected() const {return rejected;}
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::alg::Ransac";}
+
+
+ private:
+  // Parameters...
+   real64 reliability;
+   nat32 cap;
+   bit prosac;
+   bit preemptive;
+   bit sprt;
+   mt::Pool * pool;
+
+  // Results...
+   nat32 bestInliers;
+   nat32 hypotheses;
+   nat32 rejected;
+
+  // State of a hypothesis in the current batch...
+   struct Hyp
+   {
+    bit alive; // false if degenerate or rejected.
+    bit rejected; // true if rejected by the sprt, for updating delta.
+    nat32 inliers; // Inliers found so far.
+    nat32 tested; // Data points tested so far.
+    real64 lambda; // Likelihood ratio so far.
+   };
+
+  // Shared state for the jobs...
+   RansacModel * model;
+   ds::Array<nat32> sample; // batch*MinSample() indices.
+   ds::Array<Hyp> hyp; // batch hypotheses.
+   ds::Array<nat32> live; // Indices of live hypotheses, for scoring.
+   ds::Array<nat32> order; // Random order data points are tested in.
+   nat32 blockStart;
+   nat32 blockEnd;
+   real64 inlierMult; // Lambda multiplier for an inlier.
+   real64 outlierMult; // Lambda multiplier for an outlier.
+   real64 threshold; // Lambda value at which to reject.
+
+  // The jobs...
+   class FitJob : public mt::Job
+   {
+    public:
+     Ransac * self;
+     void Do(nat32 unit,nat32 thread);
+   };
+
+   class ScoreJob : public mt::Job
+   {
+    public:
+     Ransac * self;
+     void Do(nat32 unit,nat32 thread);
+   };
+
+  // Helpers...
+   void Design(real64 epsilon,real64 delta,real64 fitCost);
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
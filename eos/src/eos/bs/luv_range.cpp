@@ -246,6 +246,11 @@ const LuvRangeImage & LuvRangePyramid::Level(nat32 l) const
 LuvRangeDist::~LuvRangeDist()
 {}
 
+void LuvRangeDist::Run(const LuvRange & lhs,const LuvRange * rhs,nat32 count,real32 * out) const
+{
+ for (nat32 i=0;i<count;i++) out[i] = (*this)(lhs,rhs[i]);
+}
+
 //------------------------------------------------------------------------------
 BasicLRD::~BasicLRD()
 {}
@@ -254,6 +259,11 @@ real32 BasicLRD::operator () (const LuvRange & lhs,const LuvRange & rhs) const
 {
  return lhs ^ rhs;
 }
+
+void BasicLRD::Run(const LuvRange & lhs,const LuvRange * rhs,nat32 count,real32 * out) const
+{
+ for (nat32 i=0;i<count;i++) out[i] = lhs ^ rhs[i];
+}
    
 cstrconst BasicLRD::TypeString() const
 {
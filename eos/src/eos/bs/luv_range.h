@@ -205,6 +205,14 @@ class EOS_CLASS LuvRangeImage
    const LuvRange & Get(nat32 x,nat32 y) const;
 
 
+  /// Returns a pointer to the first range of a row, the rest following
+  /// contiguously, for inner loops.
+   const LuvRange * Row(nat32 y) const {return &data.Get(0,y);}
+
+  /// Returns a pointer to the first entry of a row of the mask, as for Row.
+   const bit * ValidRow(nat32 y) const {return &mask.Get(0,y);}
+
+
   /// &nbsp;
    inline cstrconst TypeString() const {return "eos::bs::LuvRangeImage";} 
   
@@ -272,6 +280,12 @@ class EOS_CLASS LuvRangeDist : public Deletable
   
   /// Given two LuvRanges this returns a distance between them.
    virtual real32 operator () (const LuvRange & lhs,const LuvRange & rhs) const = 0;
+
+  /// Calculates the distances from lhs to each of count contiguous ranges
+  /// starting at rhs, writing them into out. The default simply calls the
+  /// above, implimentations should override it with a loop the compiler can
+  /// vectorise.
+   virtual void Run(const LuvRange & lhs,const LuvRange * rhs,nat32 count,real32 * out) const;
    
   /// &nbsp;
    virtual cstrconst TypeString() const = 0;
@@ -287,6 +301,9 @@ class EOS_CLASS BasicLRD : public LuvRangeDist
    
   /// &nbsp;
    real32 operator () (const LuvRange & lhs,const LuvRange & rhs) const;
+
+  /// &nbsp;
+   void Run(const LuvRange & lhs,const LuvRange * rhs,nat32 count,real32 * out) const;
    
   /// &nbsp;
    cstrconst TypeString() const;
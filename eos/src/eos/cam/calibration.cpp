@@ -20,11 +20,475 @@
 #include "eos/ds/arrays.h"
 #include "eos/cam/homography.h"
 #include "eos/math/iter_min.h"
+#include "eos/math/svd.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
  namespace cam
  {
+//------------------------------------------------------------------------------
+// Levenberg-Marquardt for the calibration problem, the same algorithm as
+// math::LM but exploiting the block structure - the parameter vector is
+// [globals,6 * shots], where each shots residuals depend only on the globals
+// and that shots 6 extrinsic parameters. The normal equations are solved by
+// eliminating the per-shot blocks with the Schur complement, leaving a tiny
+// system in the globals. Jacobians are analytic and all per-shot work is
+// done in parallel. globals is 7 (Intrinsic + 2 radial, radial centre tied
+// to the principal point.) or 11 (Intrinsic, radial centre, 4 radial.), so
+// the parameter layouts of the two LM steps in Calculate are matched.
+class CalibRefine
+{
+ public:
+  CalibRefine(nat32 shots,Zhang98::Shot * sd,nat32 globals);
+
+  // Runs LM on the given parameter vector, returns the 2 norm of the final
+  // error vector, exactly as math::LM does...
+   real64 Run(math::Vector<real64> & pv);
+
+
+ private:
+  static const nat32 maxG = 11;
+
+  nat32 g;
+  ds::ArrayDel< ds::Array< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > > pnt;
+
+  // Per-shot blocks of the normal equations, plus the per-shot parts of the
+  // solve...
+   struct Block
+   {
+    real64 err; // Sum of squared residuals.
+    real64 u[maxG][maxG]; // J_g^T J_g contribution.
+    real64 w[maxG][6]; // J_g^T J_s.
+    math::Mat<6,6,real64> v; // J_s^T J_s.
+    real64 eg[maxG]; // J_g^T e contribution.
+    real64 es[6]; // J_s^T e.
+
+    math::Mat<6,6,real64> vInv; // Inverse of damped v.
+    real64 y[maxG][6]; // w * vInv.
+    bit ok;
+   };
+   ds::Array<Block> block;
+
+  // State shared with the jobs...
+   const math::Vector<real64> * in; // Parameter vector being evaluated.
+   math::Vector<real64> * out; // Used by the back substitution.
+   const real64 * dg; // Global update, for the back substitution.
+   real64 lambda;
+
+  // Evaluates a shot, optionally with its blocks of the normal equations...
+   void EvalShot(nat32 i,const math::Vector<real64> & pv,bit jac);
+
+  // The jobs...
+   class EvalJob : public mt::Job
+   {
+    public:
+     CalibRefine * self;
+     bit jac;
+     void Do(nat32 unit,nat32) {self->EvalShot(unit,*self->in,jac);}
+   };
+
+   class DampJob : public mt::Job
+   {
+    public:
+     CalibRefine * self;
+     void Do(nat32 unit,nat32);
+   };
+
+   class BackJob : public mt::Job
+   {
+    public:
+     CalibRefine * self;
+     void Do(nat32 unit,nat32);
+   };
+
+  real64 Error(const math::Vector<real64> & pv);
+};
+
+//------------------------------------------------------------------------------
+CalibRefine::CalibRefine(nat32 shots,Zhang98::Shot * sd,nat32 globals)
+:g(globals),in(null<const math::Vector<real64>*>()),out(null<math::Vector<real64>*>()),
+dg(null<const real64*>()),lambda(0.0)
+{
+ pnt.Size(shots);
+ block.Size(shots);
+ for (nat32 i=0;i<shots;i++)
+ {
+  pnt[i].Size(sd[i].data.Size());
+  ds::List<Zhang98::Node>::Cursor targ = sd[i].data.FrontPtr();
+  for (nat32 j=0;j<pnt[i].Size();j++)
+  {
+   pnt[i][j].first = targ->first;
+   pnt[i][j].second = targ->second;
+   ++targ;
+  }
+ }
+}
+
+real64 CalibRefine::Run(math::Vector<real64> & pv)
+{
+ LogTime("eos::cam::CalibRefine::Run");
+ mt::Pool & pool = mt::SharedPool();
+
+ math::Vector<real64> pvT(pv.Size());
+ math::Matrix<real64> lhs(g,g);
+ math::PseudoInverseTemp<real64> lhsPIT(g,g);
+ math::Vector<real64> rhs(g);
+ real64 step[maxG];
+
+ real64 errNorm = Error(pv);
+ lambda = 10e-3;
+
+ static const real64 maxLambda = 1e10;
+ for (nat32 k=0;k<1000;k++)
+ {
+  // Calculate the per-shot blocks of the normal equations...
+   EvalJob ej;
+   ej.self = this;
+   ej.jac = true;
+   in = &pv;
+   pool.Run(ej,block.Size());
+
+   while (lambda<=maxLambda)
+   {
+    // Damp and invert the per-shot blocks...
+     DampJob dj;
+     dj.self = this;
+     pool.Run(dj,block.Size());
+
+     bit ok = true;
+     for (nat32 i=0;i<block.Size();i++) ok &= block[i].ok;
+
+    if (ok)
+    {
+     // Build the reduced system, summing in shot order so the answer does
+     // not depend on the thread count...
+      for (nat32 r=0;r<g;r++)
+      {
+       for (nat32 c=0;c<g;c++) lhs[r][c] = 0.0;
+       rhs[r] = 0.0;
+      }
+
+      for (nat32 i=0;i<block.Size();i++)
+      {
+       Block & b = block[i];
+       for (nat32 r=0;r<g;r++)
+       {
+        for (nat32 c=0;c<g;c++)
+        {
+         real64 yw = 0.0;
+         for (nat32 j=0;j<6;j++) yw += b.y[r][j]*b.w[c][j];
+         lhs[r][c] += b.u[r][c] - yw;
+        }
+
+        real64 ye = 0.0;
+        for (nat32 j=0;j<6;j++) ye += b.y[r][j]*b.es[j];
+        rhs[r] += b.eg[r] - ye;
+       }
+      }
+
+      // Damp the diagonal of the global block, as math::LM damps the diagonal
+      // of the full system...
+       for (nat32 r=0;r<g;r++)
+       {
+        real64 ud = 0.0;
+        for (nat32 i=0;i<block.Size();i++) ud += block[i].u[r][r];
+        lhs[r][r] += lambda*ud;
+       }
+
+     // Solve it...
+      math::PseudoInverse(lhs,lhsPIT);
+      for (nat32 r=0;r<g;r++)
+      {
+       step[r] = 0.0;
+       for (nat32 c=0;c<g;c++) step[r] += lhs[r][c]*rhs[c];
+       pvT[r] = pv[r] - step[r];
+      }
+
+     // Back substitute for the per-shot updates...
+      BackJob bj;
+      bj.self = this;
+      in = &pv;
+      out = &pvT;
+      dg = step;
+      pool.Run(bj,block.Size());
+
+     // Test if the update improves things...
+      real64 errNormT = Error(pvT);
+      if (errNormT<errNorm)
+      {
+       errNorm = errNormT;
+       pv = pvT;
+       lambda *= 0.1;
+       if (math::Equal(lambda,0.0)) lambda = 0.000001;
+       break;
+      }
+    }
+
+    lambda *= 10.0;
+   }
+  if (lambda>maxLambda) break;
+ }
+
+ return math::Sqrt(errNorm);
+}
+
+real64 CalibRefine::Error(const math::Vector<real64> & pv)
+{
+ EvalJob ej;
+ ej.self = this;
+ ej.jac = false;
+ in = &pv;
+ mt::SharedPool().Run(ej,block.Size());
+
+ real64 ret = 0.0;
+ for (nat32 i=0;i<block.Size();i++) ret += block[i].err;
+ return ret;
+}
+
+void CalibRefine::EvalShot(nat32 i,const math::Vector<real64> & pv,bit jac)
+{
+ Block & b = block[i];
+
+ // Extract the global parameters...
+  real64 px = pv[0];
+  real64 py = pv[1];
+  real64 fx = pv[2];
+  real64 fy = pv[3];
+  real64 sk = pv[4];
+  real64 cx,cy;
+  real64 k[4];
+  if (g==11)
+  {
+   cx = pv[5];
+   cy = pv[6];
+   for (nat32 j=0;j<4;j++) k[j] = pv[7+j];
+  }
+  else
+  {
+   cx = px;
+   cy = py;
+   k[0] = pv[5];
+   k[1] = pv[6];
+   k[2] = 0.0;
+   k[3] = 0.0;
+  }
+  real64 ar = fy/fx;
+  nat32 kBase = (g==11)?7:5;
+  nat32 kCount = (g==11)?4:2;
+
+ // Extract the shots parameters...
+  nat32 base = g + i*6;
+  math::Vect<3,real64> aa;
+   aa[0] = pv[base+0];
+   aa[1] = pv[base+1];
+   aa[2] = pv[base+2];
+  math::Mat<3,3,real64> rot;
+  math::AngAxisToRotMat(aa,rot);
+  real64 theta2 = aa.LengthSqr();
+
+ // Clear the blocks...
+  b.err = 0.0;
+  if (jac)
+  {
+   for (nat32 r=0;r<g;r++)
+   {
+    for (nat32 c=0;c<g;c++) b.u[r][c] = 0.0;
+    for (nat32 c=0;c<6;c++) b.w[r][c] = 0.0;
+    b.eg[r] = 0.0;
+   }
+   math::Zero(b.v);
+   for (nat32 c=0;c<6;c++) b.es[c] = 0.0;
+  }
+
+ // Iterate the points...
+  for (nat32 j=0;j<pnt[i].Size();j++)
+  {
+   const math::Vect<2,real64> & m = pnt[i][j].first;
+   const math::Vect<2,real64> & obs = pnt[i][j].second;
+
+   // Project, in the same way as Intrinsic * [r1 r2 t] followed by Radial::Dis...
+    math::Vect<3,real64> a; // Rotated pattern point.
+    for (nat32 r=0;r<3;r++) a[r] = rot[r][0]*m[0] + rot[r][1]*m[1];
+    math::Vect<3,real64> p;
+    for (nat32 r=0;r<3;r++) p[r] = a[r] + pv[base+3+r];
+
+    real64 iz = 1.0/p[2];
+    real64 qx = p[0]*iz;
+    real64 qy = p[1]*iz;
+    real64 x = fx*qx + sk*qy + px;
+    real64 y = fy*qy + py;
+
+    real64 ox = x - cx;
+    real64 oy = y - cy;
+    real64 d = math::Sqrt(math::Sqr(ar*ox) + math::Sqr(oy));
+    real64 mult = 1.0 + (k[0] + (k[1] + (k[2] + k[3]*d)*d)*d)*d;
+
+    real64 e[2];
+    e[0] = cx + ox*mult - obs[0];
+    e[1] = cy + oy*mult - obs[1];
+    b.err += math::Sqr(e[0]) + math::Sqr(e[1]);
+    if (!jac) continue;
+
+   // Differentials of the distortion...
+    real64 dm = k[0] + (2.0*k[1] + (3.0*k[2] + 4.0*k[3]*d)*d)*d;
+    real64 ddx = 0.0; // dd/dox
+    real64 ddy = 0.0; // dd/doy
+    real64 dda = 0.0; // dd/dar
+    if (d>1e-12)
+    {
+     ddx = ar*ar*ox/d;
+     ddy = oy/d;
+     dda = ar*ox*ox/d;
+    }
+
+    real64 ea = mult + ox*dm*ddx; // dex/dox
+    real64 eb = ox*dm*ddy; // dex/doy
+    real64 ec = oy*dm*ddx; // dey/dox
+    real64 ed = mult + oy*dm*ddy; // dey/doy
+    real64 earx = ox*dm*dda; // dex/dar
+    real64 eary = oy*dm*dda; // dey/dar
+
+   // Jacobian rows for the globals...
+    real64 jg[2][maxG];
+     jg[0][0] = ea; jg[1][0] = ec; // px
+     jg[0][1] = eb; jg[1][1] = ed; // py
+     jg[0][2] = ea*qx - earx*ar/fx; jg[1][2] = ec*qx - eary*ar/fx; // fx
+     jg[0][3] = eb*qy + earx/fx;    jg[1][3] = ed*qy + eary/fx; // fy
+     jg[0][4] = ea*qy;              jg[1][4] = ec*qy; // skew
+     if (g==11)
+     {
+      jg[0][5] = 1.0 - ea; jg[1][5] = -ec; // cx
+      jg[0][6] = -eb;      jg[1][6] = 1.0 - ed; // cy
+     }
+     else
+     {
+      jg[0][0] += 1.0 - ea; jg[1][0] -= ec;
+      jg[0][1] -= eb;       jg[1][1] += 1.0 - ed;
+     }
+     real64 dp = d;
+     for (nat32 l=0;l<kCount;l++)
+     {
+      jg[0][kBase+l] = ox*dp;
+      jg[1][kBase+l] = oy*dp;
+      dp *= d;
+     }
+
+   // Jacobian rows for the shot, via the camera space point...
+    real64 jp[2][3];
+    {
+     real64 dxp[3];
+      dxp[0] = fx*iz;
+      dxp[1] = sk*iz;
+      dxp[2] = -(x-px)*iz;
+     real64 dyp[3];
+      dyp[0] = 0.0;
+      dyp[1] = fy*iz;
+      dyp[2] = -(y-py)*iz;
+     for (nat32 c=0;c<3;c++)
+     {
+      jp[0][c] = ea*dxp[c] + eb*dyp[c];
+      jp[1][c] = ec*dxp[c] + ed*dyp[c];
+     }
+    }
+
+    real64 js[2][6];
+    for (nat32 r=0;r<2;r++)
+    {
+     for (nat32 c=0;c<3;c++) js[r][3+c] = jp[r][c];
+    }
+
+    // Differential of the rotated point with respect to the angle-axis, from
+    // 'A compact formula for the derivative of a 3-D rotation in exponential
+    // coordinates' by Gallego and Yezzi...
+     for (nat32 l=0;l<3;l++)
+     {
+      math::Vect<3,real64> da; // d(a)/d(aa[l])
+      if (theta2<1e-20)
+      {
+       // e_l x a...
+        math::Vect<3,real64> el(0.0); el[l] = 1.0;
+        math::CrossProduct(el,a,da);
+      }
+      else
+      {
+       math::Vect<3,real64> va;
+       math::CrossProduct(aa,a,va);
+
+       math::Vect<3,real64> ir; // (I - R) e_l
+       for (nat32 r=0;r<3;r++) ir[r] = -rot[r][l];
+       ir[l] += 1.0;
+
+       math::Vect<3,real64> vir;
+       math::CrossProduct(aa,ir,vir);
+       math::Vect<3,real64> t;
+       math::CrossProduct(vir,a,t);
+
+       for (nat32 r=0;r<3;r++) da[r] = (aa[l]*va[r] + t[r])/theta2;
+      }
+
+      for (nat32 r=0;r<2;r++) js[r][l] = jp[r][0]*da[0] + jp[r][1]*da[1] + jp[r][2]*da[2];
+     }
+
+   // Accumulate...
+    for (nat32 r=0;r<2;r++)
+    {
+     for (nat32 u=0;u<g;u++)
+     {
+      real64 ju = jg[r][u];
+      for (nat32 v=0;v<g;v++) b.u[u][v] += ju*jg[r][v];
+      for (nat32 v=0;v<6;v++) b.w[u][v] += ju*js[r][v];
+      b.eg[u] += ju*e[r];
+     }
+
+     for (nat32 u=0;u<6;u++)
+     {
+      real64 ju = js[r][u];
+      for (nat32 v=0;v<6;v++) b.v[u][v] += ju*js[r][v];
+      b.es[u] += ju*e[r];
+     }
+    }
+  }
+}
+
+void CalibRefine::DampJob::Do(nat32 unit,nat32)
+{
+ Block & b = self->block[unit];
+
+ b.vInv = b.v;
+ for (nat32 i=0;i<6;i++) b.vInv[i][i] *= 1.0 + self->lambda;
+ b.ok = math::PseudoInverse(b.vInv);
+
+ for (nat32 r=0;r<self->g;r++)
+ {
+  for (nat32 c=0;c<6;c++)
+  {
+   b.y[r][c] = 0.0;
+   for (nat32 j=0;j<6;j++) b.y[r][c] += b.w[r][j]*b.vInv[j][c];
+  }
+ }
+}
+
+void CalibRefine::BackJob::Do(nat32 unit,nat32)
+{
+ Block & b = self->block[unit];
+ nat32 base = self->g + unit*6;
+
+ real64 rhs[6];
+ for (nat32 j=0;j<6;j++)
+ {
+  rhs[j] = b.es[j];
+  for (nat32 r=0;r<self->g;r++) rhs[j] -= b.w[r][j]*self->dg[r];
+ }
+
+ for (nat32 j=0;j<6;j++)
+ {
+  real64 step = 0.0;
+  for (nat32 c=0;c<6;c++) step += b.vInv[j][c]*rhs[c];
+  (*self->out)[base+j] = (*self->in)[base+j] - step;
+ }
+}
+
 //------------------------------------------------------------------------------
 Zhang98::Zhang98()
 :targQ(high)
@@ -453,15 +917,8 @@ void Zhang98::Calculate(time::Progress * prog)
 
 
   // Run LM...
-   LMdata lmd;
-    lmd.shots = shots;
-    lmd.sd = sd;
-    
-   nat32 evs = 0;
-   for (nat32 i=0;i<shots;i++) evs += sd[i].data.Size();
-   evs *= 2;
- 
-   residual = LM(evs,vec,lmd,&FirstLM);
+   CalibRefine refine(shots,sd,7);
+   residual = refine.Run(vec);
    LogDebug("[cam.calibration] Output of second steps LM. {vec}" << LogDiv() << vec);
 
 
@@ -569,15 +1026,8 @@ void Zhang98::Calculate(time::Progress * prog)
 
 
   // Run LM...
-   LMdata lmd;
-    lmd.shots = shots;
-    lmd.sd = sd;
-    
-   nat32 evs = 0;
-   for (nat32 i=0;i<shots;i++) evs += sd[i].data.Size();
-   evs *= 2;
- 
-   real64 nRes = LM(evs,vec,lmd,&SecondLM);
+   CalibRefine refine(shots,sd,11);
+   real64 nRes = refine.Run(vec);
 
 
   // if this has gone wrong we break on the ushall level of refinement.
@@ -637,134 +1087,6 @@ void Zhang98::Calculate(time::Progress * prog)
  prog->Pop();
 }
 
-void Zhang98::FirstLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi)
-{
- // Construct the intrinsic matrix object...
-  Intrinsic intrinsic;
-    intrinsic.PrincipalX() = pv[0];
-    intrinsic.PrincipalY() = pv[1];
-    intrinsic.FocalX() = pv[2];
-    intrinsic.FocalY() = pv[3];
-    intrinsic.Skew() = pv[4];
- 
- // Construct the radial distortion object...
-  Radial radial;
-   radial.aspectRatio = intrinsic.AspectRatio();
-   radial.centre[0] = intrinsic.PrincipalX();
-   radial.centre[1] = intrinsic.PrincipalY();
-   radial.k[0] = pv[5];
-   radial.k[1] = pv[6];
-   radial.k[2] = 0.0;
-   radial.k[3] = 0.0;
-    
- // For each shot calculate the relevent homography, then transform each point
- // and subtract the visualised point to get a mother of an error vector.
- nat32 ep = 0;
- for (nat32 i=0;i<oi.shots;i++)
- {
-  // Calculate the homography...
-   math::Mat<3,3,real64> hgo;
-   math::Vect<3,real64> aa;
-    aa[0] = pv[7 + i*6 + 0];
-    aa[1] = pv[7 + i*6 + 1];
-    aa[2] = pv[7 + i*6 + 2];
-   AngAxisToRotMat(aa,hgo);
-   
-   hgo[0][2] = pv[7 + i*6 + 3];
-   hgo[1][2] = pv[7 + i*6 + 4];
-   hgo[2][2] = pv[7 + i*6 + 5];
-   
-   math::Mat<3,3,real64> hg;
-   Mult(intrinsic,hgo,hg);
-
-      
-  // Iterate all points, for each one output the difference between our
-  // calculated and actual value in x and y seperatly...
-   ds::List<Node>::Cursor targ = oi.sd[i].data.FrontPtr();
-   while (!targ.Bad())
-   {
-    // Apply homography...
-     math::Vect<2,real64> t1;
-     MultVectEH(hg,targ->first,t1);
-     
-    // Apply radial...
-     math::Vect<2,real64> t2;
-     radial.Dis(t1,t2);
-    
-    // Output difference...   
-     err[ep]   = t2[0] - targ->second[0];
-     err[ep+1] = t2[1] - targ->second[1];
-    
-    ep += 2;
-    ++targ;	   
-   }
- }
-}
-
-void Zhang98::SecondLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi)
-{
- // Construct the intrinsic matrix object...
-  Intrinsic intrinsic;
-    intrinsic.PrincipalX() = pv[0];
-    intrinsic.PrincipalY() = pv[1];
-    intrinsic.FocalX() = pv[2];
-    intrinsic.FocalY() = pv[3];
-    intrinsic.Skew() = pv[4];
- 
- // Construct the radial distortion object...
-  Radial radial;
-   radial.aspectRatio = intrinsic.AspectRatio();
-   radial.centre[0] = pv[5];
-   radial.centre[1] = pv[6];
-   radial.k[0] = pv[7];
-   radial.k[1] = pv[8];
-   radial.k[2] = pv[9];
-   radial.k[3] = pv[10];
-    
- // For each shot calculate the relevent homography, then transform each point
- // and subtract the visualised point to get a mother of an error vector.
- nat32 ep = 0;
- for (nat32 i=0;i<oi.shots;i++)
- {
-  // Calculate the homography...
-   math::Mat<3,3,real64> hgo;
-   math::Vect<3,real64> aa;
-    aa[0] = pv[11 + i*6 + 0];
-    aa[1] = pv[11 + i*6 + 1];
-    aa[2] = pv[11 + i*6 + 2];
-   AngAxisToRotMat(aa,hgo);
-   
-   hgo[0][2] = pv[11 + i*6 + 3];
-   hgo[1][2] = pv[11 + i*6 + 4];
-   hgo[2][2] = pv[11 + i*6 + 5];
-      
-   math::Mat<3,3,real64> hg;
-   Mult(intrinsic,hgo,hg);   
-
-     
-  // Iterate all points, for each one output the difference between our
-  // calculated and actual value in x and y seperatly...
-   ds::List<Node>::Cursor targ = oi.sd[i].data.FrontPtr();
-   while (!targ.Bad())
-   {
-    // Apply homography...
-     math::Vect<2,real64> t1;
-     MultVectEH(hg,targ->first,t1);
-     
-    // Apply radial...
-     math::Vect<2,real64> t2;
-     radial.Dis(t1,t2);
-    
-    // Output difference...   
-     err[ep]   = t2[0] - targ->second[0];
-     err[ep+1] = t2[1] - targ->second[1];
-    
-    ep += 2;
-    ++targ;	   
-   }
- }
-}
-
 //------------------------------------------------------------------------------
  };
 };
@@ -52,6 +52,11 @@ namespace eos
 /// - First guess using SVD without distortion of intrinsic matrx.
 /// - LM refinement of guess including distortion, but only upto second term with distortion centre and principal point identical.
 /// - LM refinement of all parameters. (Without this stage we practically have the original Zhang98.)
+///
+/// The LM steps exploit the structure of the problem - each shots extrinsic
+/// parameters only effect that shots residuals, so the normal equations are
+/// solved via the Schur complement on the few global parameters, with
+/// analytic Jacobians and the shots processed in parallel by mt::SharedPool().
 class EOS_CLASS Zhang98
 {
  public:
@@ -149,12 +154,6 @@ class EOS_CLASS Zhang98
     real64 residual; // Just for logging purposes.
    };
      
-   struct LMdata
-   {
-    nat32 shots;
-    Shot * sd;
-   };
-   
   // Data for the actual results...
    ResQuality resQ;
    real64 residual;
@@ -163,9 +162,8 @@ class EOS_CLASS Zhang98
    ds::Array<Extrinsic> extrinsic;
 
 
-  // Error metrics for the two LM steps...
-   static void FirstLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi);
-   static void SecondLM(const math::Vector<real64> & pv,math::Vector<real64> & err,const LMdata & oi);
+  // The LM steps are done by a helper that exploits the problem structure...
+   friend class CalibRefine;
 };
 
 //------------------------------------------------------------------------------
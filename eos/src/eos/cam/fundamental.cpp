@@ -20,6 +20,7 @@
 #include "eos/math/iter_min.h"
 #include "eos/math/eigen.h"
 #include "eos/data/randoms.h"
+#include "eos/alg/ransac.h"
 #include "eos/file/csv.h"
 #include "eos/mem/safety.h"
 
@@ -380,8 +381,73 @@ real64 ManyPointFun(nat32 matchSize,FunMatch ** match,Fundamental & fun,real64 t
  return residual;
 }
 
+//------------------------------------------------------------------------------
+// The model given to alg::Ransac by FunCalc - reliable matches are always in
+// the sample, the rest of the sample is drawn from the unreliable matches...
+class FunRansac : public alg::RansacModel
+{
+ public:
+  FunRansac(ds::List<FunCalc::Match> & data,real64 t)
+  :rCount(0),tol(t)
+  {
+   math::Identity(best);
+   match.Size(data.Size());
+   quality.Size(data.Size());
+   nat32 mCount = 0;
+   ds::List<FunCalc::Match>::Cursor targ = data.FrontPtr();
+   while (!targ.Bad())
+   {
+    if (targ->reliable)
+    {
+     if (rCount<7) {reliable[rCount] = &(targ->norm); ++rCount;}
+    }
+    else
+    {
+     match[mCount] = &(targ->norm);
+     quality[mCount] = targ->quality;
+     ++mCount;
+    }
+    ++targ;
+   }
+   match.Size(mCount);
+   quality.Size(mCount);
+  }
+
+  nat32 Size() const {return match.Size();}
+  nat32 MinSample() const {return 7-rCount;}
+  real64 FitCost() const {return 200.0;}
+  real32 Quality(nat32 i) const {return quality[i];}
+
+  void Slots(nat32 n) {slot.Size(n);}
+
+  bit Fit(nat32 s,const nat32 * sample)
+  {
+   FunMatch * smp[7];
+   for (nat32 i=0;i<rCount;i++) smp[i] = reliable[i];
+   for (nat32 i=rCount;i<7;i++) smp[i] = match[sample[i-rCount]];
+   return SevenPointFun(smp,slot[s]);
+  }
+
+  bit Inlier(nat32 s,nat32 i) const {return match[i]->Dist(slot[s])<tol;}
+
+  void Keep(nat32 s) {best = slot[s];}
+
+  const Fundamental & Best() const {return best;}
+
+ private:
+  nat32 rCount;
+  FunMatch * reliable[7];
+  ds::Array<FunMatch*> match;
+  ds::Array<real32> quality;
+  real64 tol;
+
+  ds::Array<Fundamental> slot;
+  Fundamental best;
+};
+
 //------------------------------------------------------------------------------
 FunCalc::FunCalc()
+:prosac(false)
 {
  math::Identity(fun);
  residual = -1.0;
@@ -390,7 +456,7 @@ FunCalc::FunCalc()
 FunCalc::~FunCalc()
 {}
 
-nat32 FunCalc::AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable)
+nat32 FunCalc::AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable,real32 quality)
 {
  Match match;
   match.left[0] = left[0];
@@ -398,12 +464,13 @@ nat32 FunCalc::AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable)
   match.right[0] = right[0];
   match.right[1] = right[1];
   match.reliable = reliable;
+  match.quality = quality;
  nat32 ret = data.Size();
  data.AddBack(match);
  return ret;
 }
 
-nat32 FunCalc::AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable)
+nat32 FunCalc::AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable,real32 quality)
 {
  Match match;
   match.left[0] = left[0];
@@ -411,6 +478,7 @@ nat32 FunCalc::AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,rea
   match.right[0] = right[0];
   match.right[1] = right[1];
   match.reliable = reliable;
+  match.quality = quality;
  nat32 ret = data.Size();
  data.AddBack(match);
  return ret;
@@ -532,79 +600,13 @@ bit FunCalc::Run(time::Progress * prog,real64 reliability,nat32 cap)
   prog->Push();
   if (rCount<7)
   {
-   // Ransac...
-    // Create an array of matches, so we can select points efficiently,
-    // fill in the relible matches into our sampling array...
-     prog->Report(0,2);
-     nat32 rCount = 0;
-     FunMatch * smp[7];
-     targ = data.FrontPtr();
-     for (nat32 i=0,j=0;i<data.Size();i++)
-     {
-      if (targ->reliable)
-      {
-       smp[rCount] = &(targ->norm);
-       ++rCount;
-      }
-      else
-      {
-       fmp[j] = &(targ->norm);
-       ++j;
-      }
-      ++targ;
-     }
-     for (nat32 i=0;i<rCount;i++)
-     {
-      fmp[data.Size()-1-i] = smp[i];
-     }
-
-
-    // Now iterate trying random sets of matches, till we reach conditions
-    // that mean its time to stop this monkey business...
-     prog->Report(1,2);
-     prog->Push();
-     data::Random rand;
-     nat32 mostInliers = 1;
-     for (nat32 i=0;i<cap;i++)
-     {
-      // Fill in remaining match array with randomly selected matches...
-      // (Without duplication.)
-       for (nat32 j=rCount;j<7;j++)
-       {
-        nat32 ri = rand.Int(0,data.Size()-j-1);
-        smp[j] = fmp[ri];
-        math::Swap(fmp[ri],fmp[data.Size()-j-1]);
-       }
-
-      // Calculate the result...
-       Fundamental funTemp;
-       if (SevenPointFun(smp,funTemp)==false) continue;
-
-      // Count how many matches are within tolerance...
-       nat32 inlierCount = 0;
-       for (nat32 j=0;j<data.Size();j++)
-       {
-        if (fmp[j]->Dist(funTemp)<adjTol) ++inlierCount;
-       }
-
-      // If best so far, store it...
-       if (inlierCount>mostInliers)
-       {
-	mostInliers = inlierCount;
-	fun = funTemp;
-       }
-
-      // Check if we can break due to having done enough samples...
-       real64 sr = math::Ln(1.0-reliability)/math::Ln(1.0-math::Pow(real64(mostInliers)/real64(data.Size()),7.0));
-       if (math::IsFinite(sr))
-       {
-	if (sr<=real64(i)) break;
-	prog->Report(i,nat32(sr));
-       }
-     }
-     prog->Pop();
+   FunRansac model(data,adjTol);
+   alg::Ransac ransac;
+   ransac.Set(reliability,cap);
+   ransac.Prosac(prosac);
+   if (ransac.Run(model,prog)) fun = model.Best();
 
-     LogDebug("[fun.calculate] RANSAC result {fun,mostInliers}" << LogDiv() << fun << LogDiv() << mostInliers);
+   LogDebug("[fun.calculate] RANSAC result {fun,mostInliers,hypotheses,rejected}" << LogDiv() << fun << LogDiv() << ransac.Inliers() << LogDiv() << ransac.Hypotheses() << LogDiv() << ransac.Rejected());
   }
   prog->Pop();
 
@@ -128,21 +128,28 @@ class EOS_CLASS FunCalc
   /// \param left Coordinate in the left view.
   /// \param right Coordinate in te right view.
   /// \param reliable True if it should presume the pair to definatly be correct, false if it might be wrong.
+  /// \param quality Quality of the match, lower is better, only used if Prosac is enabled. (e.g. The distance ratio from the feature matcher.)
   /// \returns The index of the point, acts like a growing array so it will be one
   ///          greater than the last point entered/equal to the current point count.
-   nat32 AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable = false);
+   nat32 AddMatch(const bs::Pnt & left,const bs::Pnt & right,bit reliable = false,real32 quality = 0.0);
 
   /// Adds a matching point pair, returns its index.
   /// \param left Coordinate in the left view.
   /// \param right Coordinate in te right view.
   /// \param reliable True if it should presume the pair to definatly be correct, false if it might be wrong.
+  /// \param quality Quality of the match, lower is better, only used if Prosac is enabled. (e.g. The distance ratio from the feature matcher.)
   /// \returns The index of the point, acts like a growing array so it will be one
   ///          greater than the last point entered/equal to the current point count.
-   nat32 AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable = false);
+   nat32 AddMatch(const math::Vect<2,real64> & left,const math::Vect<2,real64> & right,bit reliable = false,real32 quality = 0.0);
 
   /// Returns how many matches are contained within.
    nat32 Matches() const;
 
+  /// Enables PROSAC ordered sampling during the RANSAC step, off by default.
+  /// When on matches with the best quality, as given to AddMatch, are sampled
+  /// first, which when the quality is meaningful finds the answer a lot faster.
+   void Prosac(bit enable) {prosac = enable;}
+
 
   /// This calculates the fundamental matrix.
   /// Requires at least 7 reliable matches, prefably a lot more to do a good job.
@@ -153,6 +160,8 @@ class EOS_CLASS FunCalc
   /// will complete.
   /// reliability sets how reliable a result ransac should produce, whilst cap is the
   /// maximum number of ransac runs to try before giving up and declaring failure.
+  /// The RANSAC step is run in parallel on the mt::SharedPool(), with early
+  /// rejection of bad hypotheses - see alg::Ransac.
    bit Run(time::Progress * prog = null<time::Progress*>(),real64 reliability = 0.99,nat32 cap = 10000);
 
 
@@ -185,16 +194,19 @@ class EOS_CLASS FunCalc
 
 
  private:
+  friend class FunRansac;
   static const real64 ransacTol = 2.5;
 
   struct Match : public FunMatch
   {
    bit reliable; // True if the match is to be assumed correct, false if not.
    bit used; // True if the match was used, false if it wasn't.
+   real32 quality; // Lower is better, for PROSAC.
    FunMatch norm; // Normalised version of the match, used during the calculation.
   };
 
   ds::List<Match> data;
+  bit prosac;
 
   Fundamental fun;
   real64 residual;
@@ -18,11 +18,153 @@
 #include "eos/cam/homography.h"
 
 #include "eos/math/iter_min.h"
+#include "eos/math/svd.h"
+#include "eos/alg/ransac.h"
 
 namespace eos
 {
  namespace cam
  {
+//------------------------------------------------------------------------------
+// The model given to alg::Ransac by Homography2D::RobustResult. Fits in a
+// normalised frame for stability, but stores de-normalised homographies so
+// inliers can be tested in the second points coordinate frame...
+class HomoRansac : public alg::RansacModel
+{
+ public:
+  HomoRansac(const ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > & data,real64 tol)
+  :tol2(math::Sqr(tol))
+  {
+   pair.Size(data.Size());
+   ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = data.FrontPtr();
+   for (nat32 i=0;i<pair.Size();i++)
+   {
+    pair[i] = *targ;
+    ++targ;
+   }
+
+   // Normalising transforms, zero mean and unit average distance...
+    math::Vect<2,real64> fM(0.0);
+    math::Vect<2,real64> sM(0.0);
+    for (nat32 i=0;i<pair.Size();i++)
+    {
+     fM += pair[i].first;
+     sM += pair[i].second;
+    }
+    fM /= real64(pair.Size());
+    sM /= real64(pair.Size());
+
+    real64 fS = 0.0;
+    real64 sS = 0.0;
+    for (nat32 i=0;i<pair.Size();i++)
+    {
+     fS += math::Abs(pair[i].first[0]-fM[0]) + math::Abs(pair[i].first[1]-fM[1]);
+     sS += math::Abs(pair[i].second[0]-sM[0]) + math::Abs(pair[i].second[1]-sM[1]);
+    }
+    fS = math::Max(fS/real64(2*pair.Size()),1e-6);
+    sS = math::Max(sS/real64(2*pair.Size()),1e-6);
+
+    math::Zero(fTra);
+    fTra[0][0] = 1.0/fS; fTra[0][2] = -fM[0]/fS;
+    fTra[1][1] = 1.0/fS; fTra[1][2] = -fM[1]/fS;
+    fTra[2][2] = 1.0;
+
+    math::Zero(sTraInv);
+    sTraInv[0][0] = sS; sTraInv[0][2] = sM[0];
+    sTraInv[1][1] = sS; sTraInv[1][2] = sM[1];
+    sTraInv[2][2] = 1.0;
+
+    math::Zero(sTra);
+    sTra[0][0] = 1.0/sS; sTra[0][2] = -sM[0]/sS;
+    sTra[1][1] = 1.0/sS; sTra[1][2] = -sM[1]/sS;
+    sTra[2][2] = 1.0;
+
+   math::Identity(best);
+  }
+
+  nat32 Size() const {return pair.Size();}
+  nat32 MinSample() const {return 4;}
+  real64 FitCost() const {return 50.0;}
+
+  void Slots(nat32 n) {slot.Size(n);}
+
+  bit Fit(nat32 sl,const nat32 * sample)
+  {
+   math::Mat<9,9,real64> mat;
+   for (nat32 i=0;i<4;i++)
+   {
+    math::Vect<2,real64> f;
+    math::Vect<2,real64> s;
+    math::MultVectEH(fTra,pair[sample[i]].first,f);
+    math::MultVectEH(sTra,pair[sample[i]].second,s);
+
+    mat[i*2][0] = f[0];
+    mat[i*2][1] = f[1];
+    mat[i*2][2] = 1.0;
+    mat[i*2][3] = 0.0;
+    mat[i*2][4] = 0.0;
+    mat[i*2][5] = 0.0;
+    mat[i*2][6] = -s[0]*f[0];
+    mat[i*2][7] = -s[0]*f[1];
+    mat[i*2][8] = -s[0];
+
+    mat[i*2+1][0] = 0.0;
+    mat[i*2+1][1] = 0.0;
+    mat[i*2+1][2] = 0.0;
+    mat[i*2+1][3] = f[0];
+    mat[i*2+1][4] = f[1];
+    mat[i*2+1][5] = 1.0;
+    mat[i*2+1][6] = -s[1]*f[0];
+    mat[i*2+1][7] = -s[1]*f[1];
+    mat[i*2+1][8] = -s[1];
+   }
+   for (nat32 c=0;c<9;c++) mat[8][c] = 0.0;
+
+   math::Vect<9,real64> ansV;
+   if (math::RightNullSpace(mat,ansV)==false) return false;
+
+   math::Mat<3,3,real64> t1;
+   math::Mat<3,3,real64> t2;
+   t1[0][0] = ansV[0]; t1[0][1] = ansV[1]; t1[0][2] = ansV[2];
+   t1[1][0] = ansV[3]; t1[1][1] = ansV[4]; t1[1][2] = ansV[5];
+   t1[2][0] = ansV[6]; t1[2][1] = ansV[7]; t1[2][2] = ansV[8];
+
+   math::Mult(sTraInv,t1,t2);
+   math::Mult(t2,fTra,slot[sl]);
+
+   real64 det = math::Determinant(slot[sl]);
+   return math::IsFinite(det)&&(math::Abs(det)>1e-12);
+  }
+
+  bit Inlier(nat32 sl,nat32 i) const {return Test(slot[sl],i);}
+
+  void Keep(nat32 sl) {best = slot[sl];}
+
+  const math::Mat<3,3,real64> & Best() const {return best;}
+
+  bit BestInlier(nat32 i) const {return Test(best,i);}
+
+ private:
+  bit Test(const math::Mat<3,3,real64> & h,nat32 i) const
+  {
+   const math::Vect<2,real64> & f = pair[i].first;
+   real64 tw = h[2][0]*f[0] + h[2][1]*f[1] + h[2][2];
+   if (math::Abs(tw)<1e-12) return false;
+   real64 tx = (h[0][0]*f[0] + h[0][1]*f[1] + h[0][2])/tw;
+   real64 ty = (h[1][0]*f[0] + h[1][1]*f[1] + h[1][2])/tw;
+   return (math::Sqr(tx-pair[i].second[0]) + math::Sqr(ty-pair[i].second[1]))<tol2;
+  }
+
+  real64 tol2;
+  ds::Array< Pair<math::Vect<2,real64>,math::Vect<2,real64> > > pair;
+  math::Mat<3,3,real64> fTra;
+  math::Mat<3,3,real64> sTra;
+  math::Mat<3,3,real64> sTraInv;
+
+  ds::Array< math::Mat<3,3,real64> > slot;
+  math::Mat<3,3,real64> best;
+};
+
 //------------------------------------------------------------------------------
 Homography2D::Homography2D()
 {}
@@ -221,6 +363,45 @@ real64 Homography2D::Result(math::Mat<3,3,real64> & out)
  return ret;
 }
 
+real64 Homography2D::RobustResult(math::Mat<3,3,real64> & out,real64 tol,ds::Array<bit> * inlier,
+                                  real64 reliability,nat32 cap,time::Progress * prog)
+{
+ LogBlock("eos::cam::Homography2D::RobustResult","{pairs,tol}" << LogDiv() << data.Size() << LogDiv() << tol);
+
+ prog->Push();
+ prog->Report(0,2);
+
+ // Find the inliers...
+  HomoRansac model(data,tol);
+  alg::Ransac ransac;
+  ransac.Set(reliability,cap);
+  if ((ransac.Run(model,prog)==false)||(ransac.Inliers()<4))
+  {
+   prog->Pop();
+   return -1.0;
+  }
+
+  LogDebug("[homography] RANSAC {inliers,hypotheses,rejected}" << LogDiv() << ransac.Inliers() << LogDiv() << ransac.Hypotheses() << LogDiv() << ransac.Rejected());
+
+ // Calculate the final answer from the inliers only...
+  prog->Report(1,2);
+  if (inlier) inlier->Size(data.Size());
+
+  Homography2D sub;
+  ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = data.FrontPtr();
+  for (nat32 i=0;i<data.Size();i++)
+  {
+   bit in = model.BestInlier(i);
+   if (in) sub.data.AddBack(*targ);
+   if (inlier) (*inlier)[i] = in;
+   ++targ;
+  }
+
+ real64 ret = sub.Result(out);
+ prog->Pop();
+ return ret;
+}
+
 void Homography2D::LMfunc(const math::Vector<real64> & pv,math::Vector<real64> & err,const Homography2D & self)
 {
  ds::List< Pair<math::Vect<2,real64>,math::Vect<2,real64> > >::Cursor targ = self.data.FrontPtr();
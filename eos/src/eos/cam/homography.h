@@ -26,6 +26,8 @@
 #include "eos/math/vectors.h"
 #include "eos/math/matrices.h"
 #include "eos/math/mat_ops.h"
+#include "eos/ds/arrays.h"
+#include "eos/time/progress.h"
 
 namespace eos
 {
@@ -80,6 +82,20 @@ class EOS_CLASS Homography2D
    real64 Result(math::Mat<3,3,real64> & out);
 
 
+  /// Robust version of Result, for when some of the pairs are wrong. Uses
+  /// alg::Ransac with the 4 point algorithm to find the pairs consistant with
+  /// a homography, then calculates the result as for Result using only those
+  /// pairs. Returns a negative if it could not find a homography.
+  /// \param out The resulting homography.
+  /// \param tol Maximum distance in the second coordinate frame between a transformed first point and its second point for a pair to be considered an inlier.
+  /// \param inlier If provided it is resized to the number of pairs and set to indicate which were used.
+  /// \param reliability Probability of having found the correct set of inliers at which RANSAC stops.
+  /// \param cap Maximum number of RANSAC hypotheses to try.
+  /// \param prog Optional progress bar.
+   real64 RobustResult(math::Mat<3,3,real64> & out,real64 tol,ds::Array<bit> * inlier = null<ds::Array<bit>*>(),
+                       real64 reliability = 0.99,nat32 cap = 10000,time::Progress * prog = null<time::Progress*>());
+
+
   /// &nbsp;
    static inline cstrconst TypeString() {return "eos::cam::Homography2D";}
 
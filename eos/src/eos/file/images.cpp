@@ -19,6 +19,8 @@
 #include "eos/file/images.h"
 #include "eos/file/devil_funcs.h"
 
+#include <stdio.h>
+
 namespace eos
 {
  namespace file
@@ -201,6 +203,116 @@ ImageRGB * ImageRGB::AsRGB() const
  return ret;
 }
 
+//------------------------------------------------------------------------------
+// Helpers for ImageSize...
+static nat32 ReadBig(FILE * f,nat32 bytes)
+{
+ nat32 ret = 0;
+ for (nat32 i=0;i<bytes;i++)
+ {
+  int c = fgetc(f);
+  if (c==EOF) return 0;
+  ret = (ret<<8) | nat32(c);
+ }
+ return ret;
+}
+
+static nat32 ReadLittle(FILE * f,nat32 bytes)
+{
+ nat32 ret = 0;
+ for (nat32 i=0;i<bytes;i++)
+ {
+  int c = fgetc(f);
+  if (c==EOF) return 0;
+  ret |= nat32(c)<<(8*i);
+ }
+ return ret;
+}
+
+// Reads a decimal number from a pnm header, skipping whitespace and comments...
+static nat32 ReadPnm(FILE * f)
+{
+ int c = fgetc(f);
+ while (true)
+ {
+  if (c=='#') {while ((c!='\n')&&(c!=EOF)) c = fgetc(f);}
+  else if ((c==' ')||(c=='\t')||(c=='\r')||(c=='\n')) c = fgetc(f);
+  else break;
+ }
+
+ nat32 ret = 0;
+ while ((c>='0')&&(c<='9'))
+ {
+  ret = ret*10 + nat32(c-'0');
+  c = fgetc(f);
+ }
+ return ret;
+}
+
+EOS_FUNC bit ImageSize(cstrconst filename,nat32 & width,nat32 & height)
+{
+ FILE * f = fopen(filename,"rb");
+ if (f==0) return false;
+
+ width = 0;
+ height = 0;
+ int c0 = fgetc(f);
+ int c1 = fgetc(f);
+ 
+ if ((c0==0x89)&&(c1=='P'))
+ {
+  // png - the IHDR chunk allways comes first, after the 8 byte signature...
+   if (fseek(f,16,SEEK_SET)==0)
+   {
+    width = ReadBig(f,4);
+    height = ReadBig(f,4);
+   }
+ }
+ else if ((c0==0xFF)&&(c1==0xD8))
+ {
+  // jpeg - walk the segments till a start of frame...
+   while (true)
+   {
+    int c = fgetc(f);
+    if (c!=0xFF) break;
+    int marker = fgetc(f);
+    while (marker==0xFF) marker = fgetc(f);
+    if ((marker==EOF)||(marker==0xD9)||(marker==0xDA)) break;
+    if ((marker==0x01)||((marker>=0xD0)&&(marker<=0xD7))) continue; // No length.
+
+    nat32 length = ReadBig(f,2);
+    if (length<2) break;
+    if ((marker>=0xC0)&&(marker<=0xCF)&&(marker!=0xC4)&&(marker!=0xC8)&&(marker!=0xCC))
+    {
+     fgetc(f); // Precision.
+     height = ReadBig(f,2);
+     width = ReadBig(f,2);
+     break;
+    }
+    if (fseek(f,length-2,SEEK_CUR)!=0) break;
+   }
+ }
+ else if ((c0=='B')&&(c1=='M'))
+ {
+  // bmp - height is negative for top down images...
+   if (fseek(f,18,SEEK_SET)==0)
+   {
+    width = ReadLittle(f,4);
+    int32 h = int32(ReadLittle(f,4));
+    height = (h<0)?nat32(-h):nat32(h);
+   }
+ }
+ else if ((c0=='P')&&(c1>='1')&&(c1<='6'))
+ {
+  // pnm...
+   width = ReadPnm(f);
+   height = ReadPnm(f);
+ }
+
+ fclose(f);
+ return (width!=0)&&(height!=0);
+}
+
 //------------------------------------------------------------------------------
  };
 };
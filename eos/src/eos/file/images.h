@@ -222,6 +222,13 @@ class EOS_CLASS ImageRGB : public Image
   bs::ColourRGB * data;
 };
 
+//------------------------------------------------------------------------------
+/// Reads the dimensions of an image from its header alone, without loading it,
+/// so the memory it will need can be known in advance. Understands png, jpeg,
+/// bmp and the pnm formats, returning false for anything else, or if the file
+/// can not be read.
+EOS_FUNC bit ImageSize(cstrconst filename,nat32 & width,nat32 & height);
+
 //------------------------------------------------------------------------------
  };
 };
@@ -18,67 +18,371 @@
 #include "eos/filter/conversion.h"
 
 #include "eos/str/tokens.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
  namespace filter
  {
 //------------------------------------------------------------------------------
-EOS_FUNC void LtoRGB(const svt::Field<bs::ColourL> & l,svt::Field<bs::ColourRGB> & rgb)
+// The bulk conversions work a band of rows at a time, each row being split
+// into arrays of channels so the maths runs down contiguous arrays, bands
+// being handed out by mt::SharedPool()...
+static const nat32 convBand = 8;
+
+// The constants of the conversions, as in bs/colours.h...
+static const real32 convUr = (4.0*0.950467)/(0.950467 + 15.0*0.9999996 + 3.0*1.088969);
+static const real32 convVr = (9.0)/(0.950467 + 15.0*0.9999996 + 3.0*1.088969);
+static const real32 convEpsilon = 216.0/24389.0;
+static const real32 convKappa = 24389.0/27.0;
+
+// Cube root over [0,1], as needed by the Luv conversion - linear
+// interpolation of a table followed by a Newton step gets it to within float
+// precision. Falls back to Pow outside the range...
+class CubeRoot
 {
- for (nat32 y=0;y<rgb.Size(1);y++)
- {
-  for (nat32 x=0;x<rgb.Size(0);x++)
+ public:
+  static const nat32 size = 1024;
+
+  CubeRoot()
   {
-   rgb.Get(x,y) = l.Get(x,y);
+   for (nat32 i=0;i<=size;i++) t[i] = math::Pow(real64(i)/real64(size),1.0/3.0);
+   t[size+1] = t[size];
   }
- }
-}
 
-EOS_FUNC void RGBtoL(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourL> & l)
+  real32 operator () (real32 v) const
+  {
+   if (!((v>=0.0)&&(v<=1.0))) return math::Pow(v,real32(1.0/3.0));
+   real32 p = v*real32(size);
+   nat32 i = nat32(p);
+   real32 c = t[i] + (p-real32(i))*(t[i+1]-t[i]);
+   return (2.0/3.0)*c + (1.0/3.0)*v/(c*c);
+  }
+
+ private:
+  real32 t[size+2];
+};
+
+// Converts rows of XYZ into Luv, in place...
+inline void XYZtoLuvRow(real32 * x,real32 * y,real32 * z,nat32 n,const CubeRoot & cr)
 {
- for (nat32 y=0;y<l.Size(1);y++)
+ for (nat32 i=0;i<n;i++)
  {
-  for (nat32 x=0;x<l.Size(0);x++)
+  real32 xx = x[i];
+  real32 yy = y[i];
+  real32 yr = yy/0.9999996;
+  real32 div = xx + 15.0*yy + 3.0*z[i];
+  if (math::Abs(div)>1e-37)
+  {
+   real32 l = (yr>convEpsilon)?(116.0*cr(yr) - 16.0):(yr*convKappa);
+   real32 inv = 1.0/div;
+   x[i] = l;
+   y[i] = 13.0*l*(4.0*xx*inv - convUr);
+   z[i] = 13.0*l*(9.0*yy*inv - convVr);
+  }
+  else
   {
-   l.Get(x,y) = rgb.Get(x,y);
+   x[i] = 0.0;
+   y[i] = 0.0;
+   z[i] = 0.0;
   }
  }
 }
 
-EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourLuv> & luv)
+//------------------------------------------------------------------------------
+// Rgb, floating point or bytes, to Luv or l...
+class RGBtoLuvJob : public mt::Job
 {
- for (nat32 y=0;y<luv.Size(1);y++)
- {
-  for (nat32 x=0;x<luv.Size(0);x++)
+ public:
+  const svt::Field<bs::ColourRGB> * rgb; // One of these is null.
+  const svt::Field<bs::ColRGB> * bytes; // "
+  svt::Field<bs::ColourLuv> * luv; // One of these is null.
+  svt::Field<bs::ColourL> * l; // "
+
+  const CubeRoot * cr;
+  const real64 * tab; // 9*256, for bytes - each matrix entry multiplied by each byte value, as a double.
+  real32 * buf; // 3*width per thread.
+  nat32 width;
+  nat32 height;
+
+  void Do(nat32 unit,nat32 thread)
   {
-   luv.Get(x,y) = rgb.Get(x,y);
+   real32 * x = buf + thread*3*width;
+   real32 * y = x + width;
+   real32 * z = y + width;
+
+   nat32 end = math::Min(height,(unit+1)*convBand);
+   for (nat32 row=unit*convBand;row<end;row++)
+   {
+    // Gather into channel arrays...
+     if (rgb)
+     {
+      const byte * from = (const byte*)&rgb->Get(0,row);
+      nat32 step = rgb->Stride(0);
+      for (nat32 i=0;i<width;i++)
+      {
+       const bs::ColourRGB & c = *(const bs::ColourRGB*)from;
+       x[i] = c.r; y[i] = c.g; z[i] = c.b;
+       from += step;
+      }
+     }
+     else
+     {
+      // Bytes go straight to XYZ or l via the tables, summed in double in
+      // the same order as the per-pixel conversion so the result is exact...
+       const byte * from = (const byte*)&bytes->Get(0,row);
+       nat32 step = bytes->Stride(0);
+       for (nat32 i=0;i<width;i++)
+       {
+        const bs::ColRGB & c = *(const bs::ColRGB*)from;
+        x[i] = tab[c.r] + tab[256+c.g] + tab[512+c.b];
+        y[i] = tab[768+c.r] + tab[1024+c.g] + tab[1280+c.b];
+        z[i] = tab[1536+c.r] + tab[1792+c.g] + tab[2048+c.b];
+        from += step;
+       }
+     }
+
+    // Convert...
+     if (l)
+     {
+      if (rgb)
+      {
+       for (nat32 i=0;i<width;i++) x[i] = 0.299*x[i] + 0.587*y[i] + 0.114*z[i];
+      }
+
+      byte * to = (byte*)&l->Get(0,row);
+      nat32 step = l->Stride(0);
+      for (nat32 i=0;i<width;i++) {((bs::ColourL*)to)->l = x[i]; to += step;}
+     }
+     else
+     {
+      if (rgb)
+      {
+       for (nat32 i=0;i<width;i++)
+       {
+        real32 r = x[i];
+        real32 g = y[i];
+        real32 b = z[i];
+        x[i] = r*0.412424 + g*0.357579 + b*0.180464;
+        y[i] = r*0.212656 + g*0.715158 + b*0.0721856;
+        z[i] = r*0.0193324 + g*0.119193 + b*0.950444;
+       }
+      }
+
+      XYZtoLuvRow(x,y,z,width,*cr);
+
+      byte * to = (byte*)&luv->Get(0,row);
+      nat32 step = luv->Stride(0);
+      for (nat32 i=0;i<width;i++)
+      {
+       bs::ColourLuv & c = *(bs::ColourLuv*)to;
+       c.l = x[i]; c.u = y[i]; c.v = z[i];
+       to += step;
+      }
+     }
+   }
   }
- }
-}
+};
 
-EOS_FUNC void LuvtoL(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourL> & l)
+// Luv to rgb or l...
+class LuvtoRGBJob : public mt::Job
 {
- for (nat32 y=0;y<l.Size(1);y++)
- {
-  for (nat32 x=0;x<l.Size(0);x++)
+ public:
+  const svt::Field<bs::ColourLuv> * luv;
+  svt::Field<bs::ColourRGB> * rgb; // One of these is null.
+  svt::Field<bs::ColourL> * l; // "
+
+  real32 * buf; // 3*width per thread.
+  nat32 width;
+  nat32 height;
+
+  void Do(nat32 unit,nat32 thread)
   {
-   l.Get(x,y) = luv.Get(x,y);
+   real32 * x = buf + thread*3*width;
+   real32 * y = x + width;
+   real32 * z = y + width;
+
+   nat32 end = math::Min(height,(unit+1)*convBand);
+   for (nat32 row=unit*convBand;row<end;row++)
+   {
+    // Gather...
+     const byte * from = (const byte*)&luv->Get(0,row);
+     nat32 step = luv->Stride(0);
+     for (nat32 i=0;i<width;i++)
+     {
+      const bs::ColourLuv & c = *(const bs::ColourLuv*)from;
+      x[i] = c.l; y[i] = c.u; z[i] = c.v;
+      from += step;
+     }
+
+    // To XYZ then rgb...
+     for (nat32 i=0;i<width;i++)
+     {
+      real32 ll = x[i];
+      real32 r = 0.0;
+      real32 g = 0.0;
+      real32 b = 0.0;
+      if (!math::Equal(ll,real32(0.0)))
+      {
+       real32 f = (ll+16.0)*real32(1.0/116.0);
+       real32 yy = (ll>(convEpsilon*convKappa))?(f*f*f):(ll*real32(1.0/convKappa));
+
+       real32 ca = (1.0/3.0)*(((52.0*ll)/(y[i] + 13.0*ll*convUr))-1.0);
+       real32 cb = -5.0*yy;
+       real32 cd = yy*(((39.0*ll)/(z[i] + 13.0*ll*convVr))-5.0);
+
+       real32 xx = (cd - cb)/(ca + real32(1.0/3.0));
+       real32 zz = xx*ca + cb;
+
+       r = xx*3.24071   + yy*-1.53726 +  zz*-0.498571;
+       g = xx*-0.969258 + yy*1.87599 +   zz*0.0415557;
+       b = xx*0.0556352 + yy*-0.203996 + zz*1.05707;
+      }
+      x[i] = r; y[i] = g; z[i] = b;
+     }
+
+    // Out...
+     if (l)
+     {
+      byte * to = (byte*)&l->Get(0,row);
+      nat32 step = l->Stride(0);
+      for (nat32 i=0;i<width;i++)
+      {
+       ((bs::ColourL*)to)->l = 0.299*x[i] + 0.587*y[i] + 0.114*z[i];
+       to += step;
+      }
+     }
+     else
+     {
+      byte * to = (byte*)&rgb->Get(0,row);
+      nat32 step = rgb->Stride(0);
+      for (nat32 i=0;i<width;i++)
+      {
+       bs::ColourRGB & c = *(bs::ColourRGB*)to;
+       c.r = x[i]; c.g = y[i]; c.b = z[i];
+       to += step;
+      }
+     }
+   }
   }
+};
+
+// Runs one of the above...
+template <typename J>
+inline void ConvRun(J & job,nat32 width,nat32 height)
+{
+ mt::Pool & pool = mt::SharedPool();
+ job.buf = new real32[pool.Threads()*3*width];
+ job.width = width;
+ job.height = height;
+ pool.Run(job,(height+convBand-1)/convBand);
+ delete[] job.buf;
+}
+
+// Fills in the table for byte conversion - the 3x3 matrix to XYZ, or for l
+// just the first row used...
+inline void ConvTable(real64 * tab,bit lum)
+{
+ static const real64 toXYZ[9] = {0.412424,0.357579,0.180464,
+                                 0.212656,0.715158,0.0721856,
+                                 0.0193324,0.119193,0.950444};
+ static const real64 toL[9] = {0.299,0.587,0.114, 0.0,0.0,0.0, 0.0,0.0,0.0};
+ const real64 * m = lum?toL:toXYZ;
+
+ for (nat32 i=0;i<256;i++)
+ {
+  real32 v = real32(i)/255.0; // As ColourRGB::operator = (const ColRGB &).
+  for (nat32 j=0;j<9;j++) tab[j*256 + i] = m[j]*real64(v);
  }
 }
 
-EOS_FUNC void LuvtoRGB(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourRGB> & rgb)
+//------------------------------------------------------------------------------
+EOS_FUNC void LtoRGB(const svt::Field<bs::ColourL> & l,svt::Field<bs::ColourRGB> & rgb)
 {
  for (nat32 y=0;y<rgb.Size(1);y++)
  {
   for (nat32 x=0;x<rgb.Size(0);x++)
   {
-   rgb.Get(x,y) = luv.Get(x,y);
+   rgb.Get(x,y) = l.Get(x,y);
   }
  }
 }
 
+EOS_FUNC void RGBtoL(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourL> & l)
+{
+ RGBtoLuvJob job;
+  job.rgb = &rgb;
+  job.bytes = null<const svt::Field<bs::ColRGB>*>();
+  job.luv = null<svt::Field<bs::ColourLuv>*>();
+  job.l = &l;
+  job.cr = null<const CubeRoot*>();
+  job.tab = null<const real64*>();
+ ConvRun(job,l.Size(0),l.Size(1));
+}
+
+EOS_FUNC void RGBtoL(const svt::Field<bs::ColRGB> & rgb,svt::Field<bs::ColourL> & l)
+{
+ real64 tab[9*256];
+ ConvTable(tab,true);
+
+ RGBtoLuvJob job;
+  job.rgb = null<const svt::Field<bs::ColourRGB>*>();
+  job.bytes = &rgb;
+  job.luv = null<svt::Field<bs::ColourLuv>*>();
+  job.l = &l;
+  job.cr = null<const CubeRoot*>();
+  job.tab = tab;
+ ConvRun(job,l.Size(0),l.Size(1));
+}
+
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourLuv> & luv)
+{
+ CubeRoot cr;
+
+ RGBtoLuvJob job;
+  job.rgb = &rgb;
+  job.bytes = null<const svt::Field<bs::ColRGB>*>();
+  job.luv = &luv;
+  job.l = null<svt::Field<bs::ColourL>*>();
+  job.cr = &cr;
+  job.tab = null<const real64*>();
+ ConvRun(job,luv.Size(0),luv.Size(1));
+}
+
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColRGB> & rgb,svt::Field<bs::ColourLuv> & luv)
+{
+ CubeRoot cr;
+ real64 tab[9*256];
+ ConvTable(tab,false);
+
+ RGBtoLuvJob job;
+  job.rgb = null<const svt::Field<bs::ColourRGB>*>();
+  job.bytes = &rgb;
+  job.luv = &luv;
+  job.l = null<svt::Field<bs::ColourL>*>();
+  job.cr = &cr;
+  job.tab = tab;
+ ConvRun(job,luv.Size(0),luv.Size(1));
+}
+
+EOS_FUNC void LuvtoL(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourL> & l)
+{
+ LuvtoRGBJob job;
+  job.luv = &luv;
+  job.rgb = null<svt::Field<bs::ColourRGB>*>();
+  job.l = &l;
+ ConvRun(job,l.Size(0),l.Size(1));
+}
+
+EOS_FUNC void LuvtoRGB(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourRGB> & rgb)
+{
+ LuvtoRGBJob job;
+  job.luv = &luv;
+  job.rgb = &rgb;
+  job.l = null<svt::Field<bs::ColourL>*>();
+ ConvRun(job,rgb.Size(0),rgb.Size(1));
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC void LtoRGB(svt::Var * var,cstrconst l,cstrconst rgb)
 {
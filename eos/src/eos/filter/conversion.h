@@ -23,6 +23,10 @@
 /// are provided for each, one which is a simple field to field mode and another
 /// which you give an image and it does the conversion. The pass-an-image form
 /// does not delete the field it is converting from, so its more of an expansion.
+/// The conversions to and from Luv and to l work on whole rows at a time and
+/// run in parallel on mt::SharedPool(), matching the per-pixel conversions of
+/// bs/colours.h to within float rounding. Byte rgb input has its own versions,
+/// which look up the linear part in tables rather than calculating it.
 
 #include "eos/types.h"
 #include "eos/svt/var.h"
@@ -42,10 +46,20 @@ EOS_FUNC void LtoRGB(const svt::Field<bs::ColourL> & l,svt::Field<bs::ColourRGB>
 /// dimensionality and size.
 EOS_FUNC void RGBtoL(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourL> & l);
 
+/// Byte rgb version of the above, identical to converting to bs::ColourRGB 
+/// first and then calling it, but faster, as its just a few table lookups per
+/// pixel.
+EOS_FUNC void RGBtoL(const svt::Field<bs::ColRGB> & rgb,svt::Field<bs::ColourL> & l);
+
 /// This converts the given rgb field to a luv field, given two fields of the same
 /// dimensionality and size.
 EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColourRGB> & rgb,svt::Field<bs::ColourLuv> & luv);
 
+/// Byte rgb version of the above, equivalent to converting to bs::ColourRGB 
+/// first and then calling it. The conversion to XYZ is exact table lookup, 
+/// leaving only the non-linear part to be calculated.
+EOS_FUNC void RGBtoLuv(const svt::Field<bs::ColRGB> & rgb,svt::Field<bs::ColourLuv> & luv);
+
 /// This converts the given luv field to a l field, given two fields of the same
 /// dimensionality and size.
 EOS_FUNC void LuvtoL(const svt::Field<bs::ColourLuv> & luv,svt::Field<bs::ColourL> & rgb);
@@ -19,11 +19,364 @@
 
 #include "eos/math/constants.h"
 #include "eos/math/functions.h"
+#include "eos/math/fft.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
  namespace filter
  {
+//-----------------------------------------------------------------------------
+// Rows are handed to the pool in bands of this many...
+static const nat32 kernelBand = 8;
+
+// Copies a row of a field into a contiguous buffer, and back again...
+inline void KernelGather(const svt::Field<real32> & in,nat32 y,nat32 width,real32 * to)
+{
+ const byte * from = (const byte*)&in.Get(0,y);
+ nat32 step = in.Stride(0);
+ for (nat32 x=0;x<width;x++) {to[x] = *(const real32*)from; from += step;}
+}
+
+inline void KernelScatter(svt::Field<real32> & out,nat32 y,nat32 width,const real32 * from)
+{
+ byte * to = (byte*)&out.Get(0,y);
+ nat32 step = out.Stride(0);
+ for (nat32 x=0;x<width;x++) {*(real32*)to = from[x]; to += step;}
+}
+
+// Copies a field into a contiguous row-major buffer, a unit per band, with
+// stride floats between rows...
+class KernelCopyJob : public mt::Job
+{
+ public:
+  const svt::Field<real32> * in;
+  real32 * im;
+  nat32 stride;
+  nat32 width;
+  nat32 height;
+
+  void Do(nat32 unit,nat32)
+  {
+   nat32 end = math::Min(height,(unit+1)*kernelBand);
+   for (nat32 y=unit*kernelBand;y<end;y++) KernelGather(*in,y,width,im + y*stride);
+  }
+};
+
+// Copies the valid region of a frequency domain convolution into a field,
+// zeroing the border as KernelMatJob does...
+class KernelFftOutJob : public mt::Job
+{
+ public:
+  const real32 * im;
+  nat32 stride;
+  svt::Field<real32> * out;
+  real32 * acc; // width per thread.
+  nat32 width;
+  nat32 height;
+  nat32 half;
+
+  void Do(nat32 unit,nat32 thread)
+  {
+   real32 * o = acc + thread*width;
+   nat32 end = math::Min(height,(unit+1)*kernelBand);
+   for (nat32 y=unit*kernelBand;y<end;y++)
+   {
+    for (nat32 x=0;x<width;x++) o[x] = 0.0;
+    if ((y>=half)&&(y+half<height)&&(width>half*2))
+    {
+     const real32 * src = im + y*stride;
+     for (nat32 x=half;x<width-half;x++) o[x] = src[x];
+    }
+    KernelScatter(*out,y,width,o);
+   }
+  }
+};
+
+// Brute force 2D convolution of a contiguous buffer into a field...
+class KernelMatJob : public mt::Job
+{
+ public:
+  const real32 * im;
+  svt::Field<real32> * out;
+  const real32 * data;
+  real32 * acc; // width per thread.
+  nat32 width;
+  nat32 height;
+  nat32 half;
+
+  void Do(nat32 unit,nat32 thread)
+  {
+   nat32 kw = half*2 + 1;
+   real32 * o = acc + thread*width;
+   nat32 end = math::Min(height,(unit+1)*kernelBand);
+   for (nat32 y=unit*kernelBand;y<end;y++)
+   {
+    for (nat32 x=0;x<width;x++) o[x] = 0.0;
+    if ((y>=half)&&(y+half<height)&&(width>half*2))
+    {
+     nat32 span = width - half*2;
+     real32 * oc = o + half;
+     for (nat32 v=0;v<kw;v++)
+     {
+      const real32 * src = im + (y+v-half)*width;
+      for (nat32 u=0;u<kw;u++)
+      {
+       real32 w = data[v*kw + u];
+       const real32 * s = src + u;
+       for (nat32 x=0;x<span;x++) oc[x] += w*s[x];
+      }
+     }
+    }
+    KernelScatter(*out,y,width,o);
+   }
+  }
+};
+
+// Horizontal pass of a separable convolution, from a field into a contiguous
+// buffer...
+class KernelRowJob : public mt::Job
+{
+ public:
+  const svt::Field<real32> * in;
+  real32 * im;
+  const real32 * t;
+  real32 * buf; // width + half*2 per thread.
+  nat32 width;
+  nat32 height;
+  nat32 half;
+  bit repeat;
+
+  void Do(nat32 unit,nat32 thread)
+  {
+   nat32 kw = half*2 + 1;
+   nat32 pad = width + half*2;
+   real32 * row = buf + thread*pad;
+   nat32 end = math::Min(height,(unit+1)*kernelBand);
+   for (nat32 y=unit*kernelBand;y<end;y++)
+   {
+    KernelGather(*in,y,width,row + half);
+    real32 * o = im + y*width;
+    for (nat32 x=0;x<width;x++) o[x] = 0.0;
+
+    // Output x reads row[x..x+half*2], which is in[x-half..x+half]...
+     if (repeat)
+     {
+      for (nat32 i=0;i<half;i++)
+      {
+       row[i] = row[half];
+       row[half+width+i] = row[half+width-1];
+      }
+      for (nat32 i=0;i<kw;i++)
+      {
+       real32 w = t[i];
+       const real32 * s = row + i;
+       for (nat32 x=0;x<width;x++) o[x] += w*s[x];
+      }
+     }
+     else
+     {
+      if (width>half*2)
+      {
+       for (nat32 i=0;i<kw;i++)
+       {
+        real32 w = t[i];
+        const real32 * s = row + i;
+        for (nat32 x=half;x<width-half;x++) o[x] += w*s[x];
+       }
+      }
+     }
+   }
+  }
+};
+
+// Vertical pass of a separable convolution, from a contiguous buffer into a
+// field. Works a row at a time, so the inner loop runs along rows...
+class KernelColJob : public mt::Job
+{
+ public:
+  const real32 * im;
+  svt::Field<real32> * out;
+  const real32 * t;
+  real32 * buf; // At least width per thread.
+  nat32 pad;
+  nat32 width;
+  nat32 height;
+  nat32 half;
+  bit repeat;
+
+  void Do(nat32 unit,nat32 thread)
+  {
+   nat32 kw = half*2 + 1;
+   real32 * o = buf + thread*pad;
+   nat32 end = math::Min(height,(unit+1)*kernelBand);
+   for (nat32 y=unit*kernelBand;y<end;y++)
+   {
+    for (nat32 x=0;x<width;x++) o[x] = 0.0;
+    if (repeat)
+    {
+     for (nat32 i=0;i<kw;i++)
+     {
+      int32 yy = math::Clamp<int32>(int32(y+i)-int32(half),0,int32(height)-1);
+      real32 w = t[i];
+      const real32 * s = im + yy*width;
+      for (nat32 x=0;x<width;x++) o[x] += w*s[x];
+     }
+    }
+    else
+    {
+     if ((y>=half)&&(y+half<height))
+     {
+      for (nat32 i=0;i<kw;i++)
+      {
+       real32 w = t[i];
+       const real32 * s = im + (y+i-half)*width;
+       for (nat32 x=0;x<width;x++) o[x] += w*s[x];
+      }
+     }
+    }
+    KernelScatter(*out,y,width,o);
+   }
+  }
+};
+
+// The coefficients of the Young and van Vliet recursive gaussian...
+struct GaussIIR
+{
+ GaussIIR(real32 sd)
+ {
+  real64 s = math::Max<real64>(sd,0.5);
+  real64 q;
+  if (s>=2.5) q = 0.98711*s - 0.96330;
+         else q = 3.97156 - 4.14554*math::Sqrt(1.0 - 0.26891*s);
+  real64 q2 = q*q;
+  real64 q3 = q2*q;
+
+  real64 b0 = 1.57825 + 2.44413*q + 1.4281*q2 + 0.422205*q3;
+  real64 b1 = 2.44413*q + 2.85619*q2 + 1.26661*q3;
+  real64 b2 = -(1.4281*q2 + 1.26661*q3);
+  real64 b3 = 0.422205*q3;
+
+  c1 = b1/b0;
+  c2 = b2/b0;
+  c3 = b3/b0;
+  c0 = 1.0 - (c1 + c2 + c3);
+ }
+
+ real32 c0; // Multiplier of the input.
+ real32 c1; // Multiplier of the previous output, and so on...
+ real32 c2;
+ real32 c3;
+};
+
+// Horizontal pass of the recursive gaussian, from a field into a contiguous
+// buffer...
+class GaussRowJob : public mt::Job
+{
+ public:
+  const svt::Field<real32> * in;
+  real32 * im;
+  const GaussIIR * g;
+  real32 * buf; // width per thread.
+  nat32 width;
+  nat32 height;
+
+  void Do(nat32 unit,nat32 thread)
+  {
+   real32 * row = buf + thread*width;
+   nat32 end = math::Min(height,(unit+1)*kernelBand);
+   for (nat32 y=unit*kernelBand;y<end;y++)
+   {
+    KernelGather(*in,y,width,row);
+    real32 * o = im + y*width;
+
+    // Causal, initialised as though the first value repeats forever...
+     real32 p1 = row[0];
+     real32 p2 = p1;
+     real32 p3 = p1;
+     for (nat32 x=0;x<width;x++)
+     {
+      real32 v = g->c0*row[x] + g->c1*p1 + g->c2*p2 + g->c3*p3;
+      o[x] = v;
+      p3 = p2; p2 = p1; p1 = v;
+     }
+
+    // Anti-causal, likewise for the last value...
+     p1 = row[width-1];
+     p2 = p1;
+     p3 = p1;
+     for (int32 x=int32(width)-1;x>=0;x--)
+     {
+      real32 v = g->c0*o[x] + g->c1*p1 + g->c2*p2 + g->c3*p3;
+      o[x] = v;
+      p3 = p2; p2 = p1; p1 = v;
+     }
+   }
+  }
+};
+
+// Vertical pass of the recursive gaussian, in place on a contiguous buffer
+// then out to a field. Each unit is a block of columns, which are run down
+// together so the inner loop is along a row...
+class GaussColJob : public mt::Job
+{
+ public:
+  static const nat32 block = 64;
+
+  real32 * im;
+  svt::Field<real32> * out;
+  const GaussIIR * g;
+  nat32 width;
+  nat32 height;
+
+  void Do(nat32 unit,nat32)
+  {
+   nat32 x0 = unit*block;
+   nat32 bw = math::Min(block,width-x0);
+   real32 c0 = g->c0;
+   real32 c1 = g->c1;
+   real32 c2 = g->c2;
+   real32 c3 = g->c3;
+
+   real32 first[block];
+   real32 last[block];
+   for (nat32 x=0;x<bw;x++)
+   {
+    first[x] = im[x0 + x];
+    last[x] = im[(height-1)*width + x0 + x];
+   }
+
+   // Causal...
+    for (nat32 y=0;y<height;y++)
+    {
+     real32 * o = im + y*width + x0;
+     const real32 * p1 = (y>0)?(o-width):first;
+     const real32 * p2 = (y>1)?(o-2*width):first;
+     const real32 * p3 = (y>2)?(o-3*width):first;
+     for (nat32 x=0;x<bw;x++) o[x] = c0*o[x] + c1*p1[x] + c2*p2[x] + c3*p3[x];
+    }
+
+   // Anti-causal...
+    for (int32 y=int32(height)-1;y>=0;y--)
+    {
+     real32 * o = im + y*width + x0;
+     const real32 * p1 = (y+1<int32(height))?(o+width):last;
+     const real32 * p2 = (y+2<int32(height))?(o+2*width):last;
+     const real32 * p3 = (y+3<int32(height))?(o+3*width):last;
+     for (nat32 x=0;x<bw;x++) o[x] = c0*o[x] + c1*p1[x] + c2*p2[x] + c3*p3[x];
+    }
+
+   // Out...
+    nat32 step = out->Stride(0);
+    for (nat32 y=0;y<height;y++)
+    {
+     byte * to = (byte*)&out->Get(x0,y);
+     const real32 * from = im + y*width + x0;
+     for (nat32 x=0;x<bw;x++) {*(real32*)to = from[x]; to += step;}
+    }
+  }
+};
+
 //-----------------------------------------------------------------------------
 KernelMat & KernelMat::operator = (const KernelMat & rhs)
 {
@@ -60,42 +413,125 @@ real32 & KernelMat::Val(int32 x,int32 y)
 
 void KernelMat::Apply(const svt::Field<real32> & in,svt::Field<real32> & out) const
 {
- // First do the borders, set them all to zero...
-  for (nat32 y=0;y<half;y++)
-  {
-   for (nat32 x=0;x<out.Size(0);x++) out.Get(x,y) = 0.0;
-  }
-  for (nat32 y=out.Size(1)-half;y<out.Size(1);y++)
+ if (half>=fftHalf) {ApplyFft(in,out); return;}
+
+ nat32 width = out.Size(0);
+ nat32 height = out.Size(1);
+ mt::Pool & pool = mt::SharedPool();
+ nat32 bands = (height+kernelBand-1)/kernelBand;
+
+ // Copy the input somewhere contiguous, so rows can be streamed through and
+ // the output can overwrite the input...
+  real32 * im = new real32[width*height];
+  KernelCopyJob cj;
+   cj.in = &in;
+   cj.im = im;
+   cj.stride = width;
+   cj.width = width;
+   cj.height = height;
+  pool.Run(cj,bands);
+
+ // Then the hard work, brute force the soft juicy centre, zeroing the
+ // borders as we go...
+  real32 * acc = new real32[pool.Threads()*width];
+  KernelMatJob mj;
+   mj.im = im;
+   mj.out = &out;
+   mj.data = data;
+   mj.acc = acc;
+   mj.width = width;
+   mj.height = height;
+   mj.half = half;
+  pool.Run(mj,bands);
+
+ // Clean up...
+  delete[] acc;
+  delete[] im;
+}
+
+void KernelMat::ApplyFft(const svt::Field<real32> & in,svt::Field<real32> & out) const
+{
+ nat32 width = out.Size(0);
+ nat32 height = out.Size(1);
+ mt::Pool & pool = mt::SharedPool();
+ nat32 bands = (height+kernelBand-1)/kernelBand;
+ nat32 kw = half*2 + 1;
+
+ // If the kernel doesn't fit there is no valid region, and the wrapped kernel
+ // below would overlap itself...
+  if ((width<kw)||(height<kw))
   {
-   for (nat32 x=0;x<out.Size(0);x++) out.Get(x,y) = 0.0;
+   for (nat32 y=0;y<height;y++)
+   {
+    for (nat32 x=0;x<width;x++) out.Get(x,y) = 0.0;
+   }
+   return;
   }
-  for (nat32 y=half;y<out.Size(1)-half;y++)
+
+ // Pad up to a size the transform is fast for - the convolution wraps around,
+ // but never far enough to reach the pixels we keep...
+  math::Fft2D fft(math::FftSize(width),math::FftSize(height));
+  nat32 pw = fft.Width();
+  nat32 ph = fft.Height();
+  nat32 specSize = fft.SpecWidth()*ph;
+
+ // Copy the input, zero padded...
+  real32 * im = new real32[pw*ph];
+  for (nat32 i=0;i<pw*ph;i++) im[i] = 0.0;
+  KernelCopyJob cj;
+   cj.in = &in;
+   cj.im = im;
+   cj.stride = pw;
+   cj.width = width;
+   cj.height = height;
+  pool.Run(cj,bands);
+
+ // Make the kernel the same size, wrapped so its centre is at the origin...
+  real32 * kern = new real32[pw*ph];
+  for (nat32 i=0;i<pw*ph;i++) kern[i] = 0.0;
+  for (nat32 v=0;v<kw;v++)
   {
-   for (nat32 x=0;x<half;x++) out.Get(x,y) = 0.0;
-   for (nat32 x=out.Size(0)-half;x<out.Size(0);x++) out.Get(x,y) = 0.0;
+   real32 * row = kern + ((v+ph-half)%ph)*pw;
+   for (nat32 u=0;u<kw;u++) row[(u+pw-half)%pw] = data[v*kw + u];
   }
 
- // Some values...
-  int32 width = half*2 + 1;
-  real32 * centre = data + (width+1)*half;
+ // Transform both, multiply the image by the conjugate of the kernel, as
+ // Apply correlates rather than convolves, and transform back...
+  math::Complex<real32> * specIm = new math::Complex<real32>[specSize];
+  math::Complex<real32> * specKern = new math::Complex<real32>[specSize];
+  fft.Forward(im,pw,specIm);
+  fft.Forward(kern,pw,specKern);
 
- // Then the hard work, calculate with brute force the solution for the soft
- // juicy centre...
-  for (nat32 y=half;y<out.Size(1)-half;y++)
+  for (nat32 i=0;i<specSize;i++)
   {
-   for (nat32 x=half;x<out.Size(0)-half;x++)
-   {
-    real32 o = 0.0;
-     for (int32 v = -half;v<=int32(half);v++)
-     {
-      for (int32 u = -half;u<=int32(half);u++)
-      {
-       o += centre[width*v + u]*in.Get(x+u,y+v);
-      }
-     }
-    out.Get(x,y) = o;
-   }
+   const math::Complex<real32> & a = specIm[i];
+   const math::Complex<real32> & b = specKern[i];
+   real32 rx = a.x*b.x + a.y*b.y;
+   real32 ry = a.y*b.x - a.x*b.y;
+   specIm[i].x = rx;
+   specIm[i].y = ry;
   }
+
+  fft.Inverse(specIm,im,pw);
+
+ // Write out the valid region, zeroing the border...
+  real32 * acc = new real32[pool.Threads()*width];
+  KernelFftOutJob oj;
+   oj.im = im;
+   oj.stride = pw;
+   oj.out = &out;
+   oj.acc = acc;
+   oj.width = width;
+   oj.height = height;
+   oj.half = half;
+  pool.Run(oj,bands);
+
+ // Clean up...
+  delete[] acc;
+  delete[] specKern;
+  delete[] specIm;
+  delete[] kern;
+  delete[] im;
 }
 
 void KernelMat::MakeIdeal(real32 angle)
@@ -252,100 +688,12 @@ void KernelVect::ConvertTo(KernelMat & out) const
 
 void KernelVect::Apply(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose) const
 {
- nat32 width = out.Size(0);
- nat32 height = out.Size(1); // Now create the intermediate data structure...
- // We transpose the data when writting out to it, reading back from it, as this
- // creates for better cache access behaviour.
-  real32 * im = new real32[width*height];
-
- // Do the first pass - calculate on the x...
-  real32 * t = a;
-  if (transpose) t = b;
-  for (nat32 y=0;y<height;y++)
-  {
-   for (nat32 x=0;x<half;x++) im[x*height + y] = 0.0;
-   for (nat32 x=half;x<width-half;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += in.Get(x+i,y)*t[i+half];
-    }
-    im[x*height + y] = o;
-   }
-   for (nat32 x=width-half;x<width;x++) im[x*height + y] = 0.0;
-  }
-
- // Do the second pass - calculate on the y, except its the x because of the transpose...
-  t = b;
-  if (transpose) t = a;
-  for (nat32 y=0;y<half;y++)
-  {
-   for (nat32 x=0;x<width;x++) out.Get(x,y) = 0.0;
-  }
-  for (nat32 y=half;y<height-half;y++)
-  {
-   for (nat32 x=0;x<width;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += im[x*height + y+i]*t[i+half];
-    }
-    out.Get(x,y) = o;
-   }
-  }
-  for (nat32 y=height-half;y<height;y++)
-  {
-   for (nat32 x=0;x<width;x++) out.Get(x,y) = 0.0;
-  }  
-
- // Clean up...
-  delete[] im;
+ Convolve(in,out,transpose,false);
 }
 
 void KernelVect::ApplyRepeat(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose) const
 {
- int32 width = out.Size(0);
- int32 height = out.Size(1); // Now create the intermediate data structure...
- // We transpose the data when writting out to it, reading back from it, as this
- // creates for better cache access behaviour.
-  real32 * im = new real32[width*height];
-
- // Do the first pass - calculate on the x...
-  real32 * t = a;
-  if (transpose) t = b;
-  for (int32 y=0;y<height;y++)
-  {
-   for (int32 x=0;x<width;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += in.Get(math::Clamp<int32>(x+i,0,width),y)*t[i+half];
-    }
-    im[x*height + y] = o;
-   }
-  }
-
- // Do the second pass - calculate on the y, except its the x because of the transpose...
-  t = b;
-  if (transpose) t = a;
-  for (int32 y=0;y<height;y++)
-  {
-   for (int32 x=0;x<width;x++)
-   {
-    real32 o = 0.0;
-    for (int32 i=-half;i<=int32(half);i++)
-    {
-     o += im[x*height + math::Clamp<int32>(y+i,0,height)]*t[i+half];
-    }
-    out.Get(x,y) = o;
-   }
-  }
-
- // Clean up...
-  delete[] im;
+ Convolve(in,out,transpose,true);
 }
 
 void KernelVect::MakeGaussian(real32 sd)
@@ -365,6 +713,101 @@ void KernelVect::MakeGaussian(real32 sd)
  } 
 }
 
+void KernelVect::Convolve(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose,bit repeat) const
+{
+ nat32 width = out.Size(0);
+ nat32 height = out.Size(1);
+ mt::Pool & pool = mt::SharedPool();
+ nat32 bands = (height+kernelBand-1)/kernelBand;
+
+ // The intermediate, row-major, and per-thread row buffers with room for the
+ // border...
+  nat32 pad = width + half*2;
+  real32 * im = new real32[width*height];
+  real32 * buf = new real32[pool.Threads()*pad];
+
+ // Do the first pass - calculate on the x...
+  KernelRowJob rj;
+   rj.in = &in;
+   rj.im = im;
+   rj.t = transpose?b:a;
+   rj.buf = buf;
+   rj.width = width;
+   rj.height = height;
+   rj.half = half;
+   rj.repeat = repeat;
+  pool.Run(rj,bands);
+
+ // Do the second pass - calculate on the y...
+  KernelColJob cj;
+   cj.im = im;
+   cj.out = &out;
+   cj.t = transpose?a:b;
+   cj.buf = buf;
+   cj.pad = pad;
+   cj.width = width;
+   cj.height = height;
+   cj.half = half;
+   cj.repeat = repeat;
+  pool.Run(cj,bands);
+
+ // Clean up...
+  delete[] buf;
+  delete[] im;
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void GaussianIIR(const svt::Field<real32> & in,svt::Field<real32> & out,real32 sd)
+{
+ nat32 width = out.Size(0);
+ nat32 height = out.Size(1);
+ if ((width==0)||(height==0)) return;
+ mt::Pool & pool = mt::SharedPool();
+ GaussIIR g(sd);
+
+ real32 * im = new real32[width*height];
+ real32 * buf = new real32[pool.Threads()*width];
+
+ // Rows...
+  GaussRowJob rj;
+   rj.in = &in;
+   rj.im = im;
+   rj.g = &g;
+   rj.buf = buf;
+   rj.width = width;
+   rj.height = height;
+  pool.Run(rj,(height+kernelBand-1)/kernelBand);
+
+ // Columns...
+  GaussColJob cj;
+   cj.im = im;
+   cj.out = &out;
+   cj.g = &g;
+   cj.width = width;
+   cj.height = height;
+  pool.Run(cj,(width+GaussColJob::block-1)/GaussColJob::block);
+
+ delete[] buf;
+ delete[] im;
+}
+
+EOS_FUNC void GaussianBlur(const svt::Field<real32> & in,svt::Field<real32> & out,real32 sd)
+{
+ if (sd<=0.0)
+ {
+  if (!(out==in)) out.CopyFrom(in);
+  return;
+ }
+
+ if (sd<2.0)
+ {
+  KernelVect kernel(math::Max<nat32>(1,nat32(math::RoundUp(3.0*sd))));
+  kernel.MakeGaussian(sd);
+  kernel.ApplyRepeat(in,out);
+ }
+ else GaussianIIR(in,out,sd);
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -33,7 +33,8 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 /// This represents a kernel as an arbitary matrix, with the ability to apply 
-/// it. Quite slow.
+/// it. Quite slow, as its brute force, though the work is split into row bands
+/// across mt::SharedPool().
 class EOS_CLASS KernelMat
 {
  public:
@@ -69,9 +70,20 @@ class EOS_CLASS KernelMat
 
 
   /// Applys the kernel to the 2D input and writes it to the same-property output,
-  /// all values within half of the edge will be set to 0. The input and output 
-  /// fields must not be identical.
+  /// all values within half of the edge will be set to 0. The input is copied
+  /// to a contiguous buffer first, so the input and output fields can be
+  /// identical. Kernels with a half size of fftHalf or more are applied with
+  /// ApplyFft, as brute force costs the kernel area per pixel.
    void Apply(const svt::Field<real32> & in,svt::Field<real32> & out) const;
+
+  /// Same as Apply, but always done by multiplication in the frequency domain,
+  /// using math::Fft2D on the image padded up to a size the transform is fast
+  /// for. Costs about the same whatever the kernel size, but results differ
+  /// from brute force by rounding.
+   void ApplyFft(const svt::Field<real32> & in,svt::Field<real32> & out) const;
+
+  /// The half size at which Apply switches to ApplyFft.
+   static const nat32 fftHalf = 8;
    
    
   /// Replaces the current kernel with an ideal kernel, defined as a a kernel where one
@@ -99,7 +111,12 @@ class EOS_CLASS KernelMat
 //------------------------------------------------------------------------------
 /// This represents a kernel as two vectors, a and b, where b * a^T is the 
 /// kernel itself. Does the obvious optimisation during calculation and is 
-/// highly recomended for speed.
+/// highly recomended for speed. Both passes run over contiguous row buffers,
+/// with the taps as the outer loop so the inner loop is a straight multiply-add
+/// along a row that the compiler can vectorise; the vertical pass works a whole
+/// row of the intermediate at a time rather than walking down columns. Row 
+/// bands are split across mt::SharedPool(). Results are identical to the naive
+/// calculation, as the order of summation per pixel is unchanged.
 class EOS_CLASS KernelVect
 {
  public:
@@ -171,8 +188,30 @@ class EOS_CLASS KernelVect
   nat32 half;
   real32 * a; // half*2+1 in length.
   real32 * b; // "
+  
+  // Does the actual work for Apply and ApplyRepeat...
+   void Convolve(const svt::Field<real32> & in,svt::Field<real32> & out,bit transpose,bit repeat) const;
 };
 
+//------------------------------------------------------------------------------
+/// Applies a gaussian blur with the given standard deviation, using the 
+/// recursive filter of 'Recursive implementation of the Gaussian filter' by
+/// Young and van Vliet. A causal and an anti-causal third order filter are run
+/// along each row then each column, so the cost per pixel is constant
+/// regardless of the standard deviation - it beats KernelVect once the
+/// standard deviation exceeds 2 or so. Its an approximation - close for smooth
+/// images but off by a few percent for high frequency content at small 
+/// standard deviations, and unreliable under 0.5. Borders are 
+/// handled by repetition, as for KernelVect::ApplyRepeat. The input and output
+/// can be identical. Runs in parallel, rows and then blocks of columns being 
+/// split across mt::SharedPool().
+EOS_FUNC void GaussianIIR(const svt::Field<real32> & in,svt::Field<real32> & out,real32 sd);
+
+/// Applies a gaussian blur with border repetition, choosing between
+/// a KernelVect with a half size of 3 standard deviations for small blurs and
+/// GaussianIIR for large blurs. The input and output can be identical.
+EOS_FUNC void GaussianBlur(const svt::Field<real32> & in,svt::Field<real32> & out,real32 sd);
+
 //------------------------------------------------------------------------------
  };
 };
@@ -18,6 +18,7 @@
 #include "eos/filter/matching.h"
 
 #include "eos/filter/conversion.h"
+#include "eos/math/fft.h"
 #include "eos/file/csv.h"
 
 namespace eos
@@ -182,6 +183,136 @@ EOS_FUNC void MatchNCC(const svt::Field<bs::ColourRGB> & imgA,const ds::Array<Co
  prog->Pop();
 }
 
+//------------------------------------------------------------------------------
+EOS_FUNC void MatchTemplateNCC(const svt::Field<real32> & img,const svt::Field<real32> & temp,
+                               svt::Field<real32> & out,time::Progress * prog)
+{
+ LogBlock("eos::filter::MatchTemplateNCC","-");
+ prog->Push();
+
+ nat32 iw = img.Size(0);
+ nat32 ih = img.Size(1);
+ nat32 tw = temp.Size(0);
+ nat32 th = temp.Size(1);
+
+ for (nat32 y=0;y<ih;y++)
+ {
+  for (nat32 x=0;x<iw;x++) out.Get(x,y) = 0.0;
+ }
+ if ((tw>iw)||(th>ih)||(tw*th==0)) {prog->Pop(); return;}
+
+
+ // Zero mean the template, remembering its energy...
+  prog->Report(0,4);
+  nat32 tSize = tw*th;
+  real64 tMean = 0.0;
+  for (nat32 y=0;y<th;y++)
+  {
+   for (nat32 x=0;x<tw;x++) tMean += temp.Get(x,y);
+  }
+  tMean /= real64(tSize);
+
+  real64 tEnergy = 0.0;
+  for (nat32 y=0;y<th;y++)
+  {
+   for (nat32 x=0;x<tw;x++) tEnergy += math::Sqr(real64(temp.Get(x,y)) - tMean);
+  }
+  if (math::IsZero(tEnergy)) {prog->Pop(); return;}
+
+
+ // Summed area tables of the image and its square, for the window means and
+ // variances. The image mean is removed as well, which doesn't change the
+ // ncc but keeps the frequency domain correlation accurate...
+  prog->Report(1,4);
+  real64 iMean = 0.0;
+  for (nat32 y=0;y<ih;y++)
+  {
+   for (nat32 x=0;x<iw;x++) iMean += img.Get(x,y);
+  }
+  iMean /= real64(iw*ih);
+
+  nat32 sw = iw+1;
+  ds::Array<real64> sum(sw*(ih+1));
+  ds::Array<real64> sum2(sw*(ih+1));
+  for (nat32 x=0;x<sw;x++) {sum[x] = 0.0; sum2[x] = 0.0;}
+  for (nat32 y=0;y<ih;y++)
+  {
+   real64 rs = 0.0;
+   real64 rs2 = 0.0;
+   sum[(y+1)*sw] = 0.0;
+   sum2[(y+1)*sw] = 0.0;
+   for (nat32 x=0;x<iw;x++)
+   {
+    real64 v = real64(img.Get(x,y)) - iMean;
+    rs += v;
+    rs2 += v*v;
+    sum[(y+1)*sw + x+1] = sum[y*sw + x+1] + rs;
+    sum2[(y+1)*sw + x+1] = sum2[y*sw + x+1] + rs2;
+   }
+  }
+
+
+ // Correlate in the frequency domain, padding to a fast size - as the
+ // template is anchored at its top left corner and only positions where it
+ // fits are kept nothing wraps around...
+  prog->Report(2,4);
+  math::Fft2D fft(math::FftSize(iw),math::FftSize(ih));
+  nat32 pw = fft.Width();
+  nat32 ph = fft.Height();
+  nat32 specSize = fft.SpecWidth()*ph;
+
+  ds::Array<real32> im(pw*ph);
+  ds::Array<real32> tm(pw*ph);
+  for (nat32 i=0;i<pw*ph;i++) {im[i] = 0.0; tm[i] = 0.0;}
+  for (nat32 y=0;y<ih;y++)
+  {
+   for (nat32 x=0;x<iw;x++) im[y*pw + x] = real64(img.Get(x,y)) - iMean;
+  }
+  for (nat32 y=0;y<th;y++)
+  {
+   for (nat32 x=0;x<tw;x++) tm[y*pw + x] = real64(temp.Get(x,y)) - tMean;
+  }
+
+  ds::Array<math::Complex<real32> > specIm(specSize);
+  ds::Array<math::Complex<real32> > specTm(specSize);
+  fft.Forward(im.Ptr(),pw,specIm.Ptr());
+  fft.Forward(tm.Ptr(),pw,specTm.Ptr());
+  for (nat32 i=0;i<specSize;i++)
+  {
+   const math::Complex<real32> & a = specIm[i];
+   const math::Complex<real32> & b = specTm[i];
+   real32 rx = a.x*b.x + a.y*b.y;
+   real32 ry = a.y*b.x - a.x*b.y;
+   specIm[i].x = rx;
+   specIm[i].y = ry;
+  }
+  fft.Inverse(specIm.Ptr(),im.Ptr(),pw);
+
+
+ // Combine into the ncc at every position where the template fits...
+  prog->Report(3,4);
+  real64 tMult = 1.0/real64(tSize);
+  for (nat32 y=0;y+th<=ih;y++)
+  {
+   for (nat32 x=0;x+tw<=iw;x++)
+   {
+    real64 s = sum[(y+th)*sw + x+tw] - sum[y*sw + x+tw] - sum[(y+th)*sw + x] + sum[y*sw + x];
+    real64 s2 = sum2[(y+th)*sw + x+tw] - sum2[y*sw + x+tw] - sum2[(y+th)*sw + x] + sum2[y*sw + x];
+    real64 var = s2 - s*s*tMult;
+
+    real64 div = var*tEnergy;
+    real32 ncc = 0.0;
+    if ((var>1e-6*s2)&&(!math::IsZero(div)))
+    {
+     ncc = math::Clamp<real64>(im[y*pw + x]*math::InvSqrt(div),-1.0,1.0);
+    }
+    out.Get(x+tw/2,y+th/2) = ncc;
+   }
+  }
+
+ prog->Pop();
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC void MatchSelect(const svt::Field<real32> & simMat,ds::Array<bs::Pos> & out,real32 ratio)
 {
@@ -66,6 +66,23 @@ EOS_FUNC void MatchNCC(const svt::Field<bs::ColourRGB> & imgA,const ds::Array<Co
                        svt::Field<real32> & out,nat32 half,
                        time::Progress * prog = null<time::Progress*>());
 
+//------------------------------------------------------------------------------
+/// Dense template matching by normalised cross correlation, i.e. the ncc of the
+/// template against the window of the image centred on every pixel. The
+/// correlation is done in the frequency domain with math::Fft2D and the window
+/// means and variances with summed area tables, so the cost does not depend on
+/// the template size.
+/// \param img The image to search.
+/// \param temp The template, must be no bigger than the image.
+/// \param out Same size as img, set to the ncc with the template centred at
+///            each pixel, i.e. temp's (width/2,height/2) at the pixel. Where
+///            the template would not fit entirely in the image, or the image
+///            window has no variance, it is set to 0.
+/// \param prog Progress bar, as ushall.
+EOS_FUNC void MatchTemplateNCC(const svt::Field<real32> & img,const svt::Field<real32> & temp,
+                               svt::Field<real32> & out,
+                               time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
 /// Given a similarity matrix this inteligently selects likelly matching corners.
 /// Only considers a match if its the highest scoring match for both corners and
@@ -19,6 +19,8 @@
 
 #include "eos/ds/lists.h"
 #include "eos/rend/functions.h"
+#include "eos/math/eigen.h"
+#include "eos/math/distance.h"
 
 namespace eos
 {
@@ -784,6 +786,262 @@ svt::Var * MserKeys::KeyImage(svt::Core & core) const
   return ret;
 }
 
+//------------------------------------------------------------------------------
+// Helper for the below - dot product with multiple accumulators...
+inline real32 MserDot(nat32 d,const real32 * a,const real32 * b)
+{
+ real32 acc[4] = {0.0,0.0,0.0,0.0};
+ nat32 i = 0;
+ for (;i+4<=d;i+=4)
+ {
+  acc[0] += a[i]*b[i];
+  acc[1] += a[i+1]*b[i+1];
+  acc[2] += a[i+2]*b[i+2];
+  acc[3] += a[i+3]*b[i+3];
+ }
+ for (;i<d;i++) acc[0] += a[i]*b[i];
+ return (acc[0]+acc[1]) + (acc[2]+acc[3]);
+}
+
+//------------------------------------------------------------------------------
+MserKeyPca::MserKeyPca()
+:samples(0),dims(0),kept(0.0),quantMult(1.0)
+{}
+
+MserKeyPca::~MserKeyPca()
+{}
+
+void MserKeyPca::Reset()
+{
+ samples = 0;
+ sum.Size(0);
+ scatter.Size(0);
+}
+
+void MserKeyPca::Add(const MserKey & key)
+{
+ static const nat32 kd = 1323;
+ if (samples==0)
+ {
+  sum.Size(kd);
+  scatter.Size(kd*(kd+1)/2);
+  for (nat32 i=0;i<sum.Size();i++) sum[i] = 0.0;
+  for (nat32 i=0;i<scatter.Size();i++) scatter[i] = 0.0;
+ }
+ 
+ samples += 1;
+ real64 * row = &scatter[0];
+ for (nat32 r=0;r<kd;r++)
+ {
+  real64 vr = key[r];
+  sum[r] += vr;
+  for (nat32 c=0;c<=r;c++) row[c] += vr*key[c];
+  row += r+1;
+ }
+}
+
+void MserKeyPca::Add(const MserKeys & keys)
+{
+ for (nat32 i=0;i<keys.Size();i++) Add(keys.Key(i));
+}
+
+bit MserKeyPca::Learn(nat32 d)
+{
+ LogBlock("bit eos::filter::MserKeyPca::Learn(nat32 d)","{d,samples}" << LogDiv() << d << LogDiv() << samples);
+ static const nat32 kd = 1323;
+ if ((samples<2)||(d==0)||(d>maxDims)) return false;
+
+ // Build the covariance matrix...
+  real64 n = samples;
+  math::Matrix<real64> a(kd,kd);
+  {
+   const real64 * row = &scatter[0];
+   for (nat32 r=0;r<kd;r++)
+   {
+    real64 mr = sum[r]/n;
+    for (nat32 c=0;c<=r;c++)
+    {
+     a[r][c] = row[c]/n - mr*(sum[c]/n);
+     a[c][r] = a[r][c];
+    }
+    row += r+1;
+   }
+  }
+
+ // Eigen-decompose...
+  math::Matrix<real64> q(kd,kd);
+  math::Vector<real64> ev(kd);
+  if (math::SymEigen(a,q,ev)==false) return false;
+
+ // Select the largest d eigenvalues, storing the relevant eigenvectors as the
+ // rows of the basis...
+  dims = d;
+  mean.Size(kd);
+  basis.Size(dims*kd);
+  for (nat32 i=0;i<kd;i++) mean[i] = sum[i]/n;
+
+  real64 total = 0.0;
+  for (nat32 i=0;i<kd;i++) total += math::Max(ev[i],0.0);
+  
+  real64 keptSum = 0.0;
+  real64 largest = 0.0;
+  for (nat32 k=0;k<dims;k++)
+  {
+   nat32 best = 0;
+   for (nat32 i=1;i<kd;i++)
+   {
+    if (ev[i]>ev[best]) best = i;
+   }
+   
+   if (k==0) largest = ev[best];
+   keptSum += math::Max(ev[best],0.0);
+   for (nat32 i=0;i<kd;i++) basis[k*kd + i] = q[i][best];
+   ev[best] = -math::Infinity<real64>();
+  }
+
+  kept = (total>0.0)?(keptSum/total):1.0;
+  
+ // Quantisation multiplier - 4 standard deviations of the first component
+ // maps to the end of the int8 range...
+  if (largest>0.0) quantMult = 127.0/(4.0*math::Sqrt(largest));
+              else quantMult = 1.0;
+ 
+ return true;
+}
+
+void MserKeyPca::Project(const MserKey & in,real32 * out) const
+{
+ static const nat32 kd = 1323;
+ real32 centred[kd];
+ for (nat32 i=0;i<kd;i++) centred[i] = in[i] - mean[i];
+ 
+ for (nat32 k=0;k<dims;k++) out[k] = MserDot(kd,&basis[k*kd],centred);
+}
+
+void MserKeyPca::Project(const MserKey & in,int8 * out) const
+{
+ real32 temp[maxDims];
+ Project(in,temp);
+ for (nat32 k=0;k<dims;k++)
+ {
+  out[k] = int8(math::Clamp<real32>(math::Round(temp[k]*quantMult),-127.0,127.0));
+ }
+}
+
+//------------------------------------------------------------------------------
+MserCompactKeys::MserCompactKeys()
+:size(0),dims(0),quant(false),quantMult(1.0)
+{}
+
+MserCompactKeys::~MserCompactKeys()
+{}
+
+void MserCompactKeys::Set(const MserKeyPca & pca,const MserKeys & keys,bit quantise)
+{
+ LogBlock("void eos::filter::MserCompactKeys::Set(...)","-");
+ log::Assert(pca.Dims()!=0,"MserCompactKeys::Set called with unlearned projection");
+ 
+ size = keys.Size();
+ dims = pca.Dims();
+ quant = quantise;
+ quantMult = pca.QuantMult();
+ 
+ if (quant)
+ {
+  data.Size(0);
+  qdata.Size(size*dims);
+  for (nat32 i=0;i<size;i++) pca.Project(keys.Key(i),&qdata[i*dims]);
+ }
+ else
+ {
+  qdata.Size(0);
+  data.Size(size*dims);
+  for (nat32 i=0;i<size;i++) pca.Project(keys.Key(i),&data[i*dims]);
+ }
+}
+
+nat32 MserCompactKeys::Memory() const
+{
+ return data.Size()*sizeof(real32) + qdata.Size()*sizeof(int8);
+}
+
+real32 MserCompactKeys::Distance(nat32 i,const MserCompactKeys & other,nat32 j) const
+{
+ log::Assert((dims==other.dims)&&(quant==other.quant));
+ if (quant) return real32(math::SqrEuclidean(dims,QuantKey(i),other.QuantKey(j)))/math::Sqr(quantMult);
+       else return math::SqrEuclidean(dims,Key(i),other.Key(j));
+}
+
+nat32 MserCompactKeys::Nearest(const MserCompactKeys & other,nat32 j,real32 * dist) const
+{
+ log::Assert((dims==other.dims)&&(quant==other.quant));
+ nat32 ret = 0;
+ if (quant)
+ {
+  const int8 * targ = other.QuantKey(j);
+  int32 best = math::max_int_32;
+  for (nat32 i=0;i<size;i++)
+  {
+   int32 d = math::SqrEuclidean(dims,QuantKey(i),targ);
+   if (d<best) {best = d; ret = i;}
+  }
+  if (dist) *dist = real32(best)/math::Sqr(quantMult);
+ }
+ else
+ {
+  const real32 * targ = other.Key(j);
+  real32 best = math::Infinity<real32>();
+  for (nat32 i=0;i<size;i++)
+  {
+   real32 d = math::SqrEuclideanLimit(dims,Key(i),targ,best);
+   if (d<best) {best = d; ret = i;}
+  }
+  if (dist) *dist = best;
+ }
+ return ret;
+}
+
+nat32 MserCompactKeys::Match(const MserCompactKeys & other,ds::Array< Pair<nat32,nat32> > & out,time::Progress * prog) const
+{
+ LogBlock("nat32 eos::filter::MserCompactKeys::Match(...)","{size,other.size}" << LogDiv() << size << LogDiv() << other.size);
+
+ // Nothing can match if either set is empty, and Nearest would return 0...
+  if ((size==0)||(other.size==0))
+  {
+   out.Size(0);
+   return 0;
+  }
+
+ prog->Push();
+ 
+ // Find the nearest neighbour in other of every key in this...
+  ds::Array<nat32> forward(size);
+  for (nat32 i=0;i<size;i++)
+  {
+   prog->Report(i,size+other.size);
+   forward[i] = other.Nearest(*this,i);
+  }
+
+ // Find the nearest in this of every key in other, store mutual matches...
+  nat32 count = 0;
+  out.Size(math::Min(size,other.size));
+  for (nat32 j=0;j<other.size;j++)
+  {
+   prog->Report(size+j,size+other.size);
+   nat32 i = Nearest(other,j);
+   if (forward[i]==j)
+   {
+    out[count].first = i;
+    out[count].second = j;
+    ++count;
+   }
+  }
+  out.Size(count);
+
+ prog->Pop();
+ return count;
+}
+
 //------------------------------------------------------------------------------
  };
 };
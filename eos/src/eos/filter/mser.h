@@ -385,6 +385,157 @@ class EOS_CLASS MserKeys : public Mser
   ds::Array<MserKey> key;
 };
 
+//------------------------------------------------------------------------------
+/// A MserKey is 1323 real32's, over 5KB, which makes matching thousands of them
+/// painfully slow and memory hungry. This learns a PCA projection from a 
+/// training set of keys, so they can be reduced to a much smaller number of
+/// dimensions, see MserCompactKeys for the storage/matching of such reduced
+/// keys. Training accumulates the scatter matrix, so you can feed it keys from
+/// as many images as you like before calling Learn. A few thousand keys is 
+/// plenty - the eigen-decomposition of the 1323x1323 covariance is the
+/// expensive bit, and only happens once.
+class EOS_CLASS MserKeyPca
+{
+ public:
+  /// &nbsp;
+   MserKeyPca();
+   
+  /// &nbsp;
+   ~MserKeyPca();
+   
+  /// Empties the training set, does not effect any previously learned projection.
+   void Reset();
+
+
+  /// Adds a key to the training set.
+   void Add(const MserKey & key);
+   
+  /// Adds all the keys from a MserKeys object to the training set.
+   void Add(const MserKeys & keys);
+   
+  /// Returns how many keys have been added to the training set.
+   nat32 Samples() const {return samples;}
+
+
+  /// Learns the projection from the training set, keeping the given number of
+  /// dimensions, which should be between 1 and maxDims inclusive. 64 
+  /// dimensions keeps most of the information. Returns true on success, false
+  /// on failure. (Too few samples or the eigen decomposition failing.)
+   bit Learn(nat32 dims = 64);
+   
+  /// Returns how many dimensions the learned projection has, 0 if Learn has
+  /// not been called successfully.
+   nat32 Dims() const {return dims;}
+   
+  /// Returns the fraction of the training sets variance kept by the projection.
+   real32 Kept() const {return kept;}
+
+  /// Returns the multiplier applied to projected values to quantise them into
+  /// int8's. Its chosen to be identical for all dimensions, so squared 
+  /// distances between quantised keys divided by its square approximate the
+  /// squared distances between unquantised keys.
+   real32 QuantMult() const {return quantMult;}
+
+
+  /// Projects a key, outputing Dims() values into out.
+   void Project(const MserKey & in,real32 * out) const;
+   
+  /// Projects a key and quantises the result, outputing Dims() values into out.
+   void Project(const MserKey & in,int8 * out) const;
+
+
+  /// The maximum number of dimensions a projection can keep.
+   static const nat32 maxDims = 128;
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::filter::MserKeyPca";}
+
+
+ private:
+  // Training set...
+   nat32 samples;
+   ds::Array<real64> sum; // 1323 long.
+   ds::Array<real64> scatter; // Lower triangle of the 1323x1323 scatter matrix, packed by row.
+
+  // Learned projection...
+   nat32 dims;
+   real32 kept;
+   real32 quantMult;
+   ds::Array<real32> mean; // 1323 long.
+   ds::Array<real32> basis; // dims rows of 1323, each a unit length eigenvector.
+};
+
+//------------------------------------------------------------------------------
+/// Stores a set of MserKeys after projection by a MserKeyPca, either as real32
+/// vectors or quantised to int8 vectors. Each key is stored contiguously in a
+/// single array, at a fixed stride, so matching streams through memory, and the
+/// distance kernels in eos::math are used to compare them. Two sets must be 
+/// constructed from the same MserKeyPca, with the same quantisation setting,
+/// to be matched against each other.
+class EOS_CLASS MserCompactKeys
+{
+ public:
+  /// &nbsp;
+   MserCompactKeys();
+   
+  /// &nbsp;
+   ~MserCompactKeys();
+
+
+  /// Fills the set from the given keys using the given projection, which must
+  /// have been learned. The indices of the keys are maintained, so index i
+  /// in this corresponds to index i in keys.
+   void Set(const MserKeyPca & pca,const MserKeys & keys,bit quantise = false);
+
+
+  /// &nbsp;
+   nat32 Size() const {return size;}
+   
+  /// &nbsp;
+   nat32 Dims() const {return dims;}
+   
+  /// &nbsp;
+   bit Quantised() const {return quant;}
+   
+  /// Returns how many bytes the key data is consuming.
+   nat32 Memory() const;
+
+
+  /// Returns a pointer to the given key, only valid if not Quantised().
+   const real32 * Key(nat32 i) const {return &data[i*dims];}
+
+  /// Returns a pointer to the given key, only valid if Quantised().
+   const int8 * QuantKey(nat32 i) const {return &qdata[i*dims];}
+
+
+  /// Returns the squared distance between key i in this and key j in other,
+  /// in the units of the unquantised projection.
+   real32 Distance(nat32 i,const MserCompactKeys & other,nat32 j) const;
+
+  /// Brute force finds the key in this set nearest to key j in the other set,
+  /// returning its index. Optionally outputs the squared distance.
+   nat32 Nearest(const MserCompactKeys & other,nat32 j,real32 * dist = null<real32*>()) const;
+
+
+  /// Finds all pairs of mutual nearest neighbours between this and the other
+  /// set, as pairs of (this index, other index). Returns how many were found.
+   nat32 Match(const MserCompactKeys & other,ds::Array< Pair<nat32,nat32> > & out,time::Progress * prog = null<time::Progress*>()) const;
+
+
+  /// &nbsp;
+   static cstrconst TypeString() {return "eos::filter::MserCompactKeys";}
+
+
+ private:
+  nat32 size;
+  nat32 dims;
+  bit quant;
+  real32 quantMult;
+  
+  ds::Array<real32> data;
+  ds::Array<int8> qdata;
+};
+
 //------------------------------------------------------------------------------
  };
 };
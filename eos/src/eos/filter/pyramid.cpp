@@ -72,7 +72,6 @@ void Pyramid::Construct(const svt::Field<real32> & image)
 
  // Declare kernels...
   KernelVect gaussVect(3);
-  KernelMat gauss(3);
 
 
  // Make a pass buffer to store the data for when moving between octaves,
@@ -114,12 +113,11 @@ void Pyramid::Construct(const svt::Field<real32> & image)
             sigma *= math::Pow<real32>(math::Pow(2.0,1.0/scales),j-1);
      gaussVect.SetSize(nat32(2.0*sigma));
      gaussVect.MakeGaussian(sigma);    
-     gaussVect.ConvertTo(gauss);	    
 	    
      octave[i]->ByName(str::Token(j),a);
      octave[i]->ByName(str::Token(j+1),b);
      
-     gauss.Apply(a,b);
+     gaussVect.Apply(a,b);
     }
 
 
@@ -23,7 +23,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 MeanGridSeg::MeanGridSeg()
-:dim(12),minSize(32),colMult(2.0),spatialMult(1.0),maxIters(1000),segments(0)
+:dim(12),minSize(32),colMult(2.0),spatialMult(1.0),maxIters(1000),slic(false),segments(0)
 {}
 
 MeanGridSeg::~MeanGridSeg()
@@ -55,8 +55,19 @@ void MeanGridSeg::SetMaxIters(nat32 iters)
  maxIters = iters;
 }
 
+void MeanGridSeg::Slic(bit enable)
+{
+ slic = enable;
+}
+
 void MeanGridSeg::Run(time::Progress * prog)
 {
+ if (slic)
+ {
+  RunSlic(prog);
+  return;
+ }
+
  prog->Push();
 
  // Prep storage...
@@ -178,73 +189,380 @@ void MeanGridSeg::CalcMeans(const ds::Array2D<nat32> & seg,ds::Array<Mean> & mea
 
 nat32 MeanGridSeg::UpdatePixels(const ds::Array2D<nat32> & oldSeg, ds::Array2D<nat32> & newSeg,
                                 const ds::Array<Mean> & mean)
+{
+ UpdateJob job;
+ job.self = this;
+ job.oldSeg = &oldSeg;
+ job.newSeg = &newSeg;
+ job.mean = &mean;
+ job.changes = 0;
+ mt::SharedPool().Run(job,oldSeg.Height());
+ return job.changes;
+}
+
+nat32 MeanGridSeg::UpdateRow(nat32 y,const ds::Array2D<nat32> & oldSeg, ds::Array2D<nat32> & newSeg,
+                             const ds::Array<Mean> & mean)
 {
  nat32 changes = 0;
- for (nat32 y=0;y<oldSeg.Height();y++)
+ for (nat32 x=0;x<oldSeg.Width();x++)
  {
-  for (nat32 x=0;x<oldSeg.Width();x++)
+  nat32 cur = oldSeg.Get(x,y);
+  nat32 nx = (x!=0)?oldSeg.Get(x-1,y):cur;
+  nat32 px = (x+1!=oldSeg.Width())?oldSeg.Get(x+1,y):cur;
+  nat32 ny = (y!=0)?oldSeg.Get(x,y-1):cur;
+  nat32 py = (y+1!=oldSeg.Height())?oldSeg.Get(x,y+1):cur;
+  
+  if ((cur!=nx)||(cur!=px)||(cur!=ny)||(cur!=py))
   {
-   nat32 cur = oldSeg.Get(x,y);
-   nat32 nx = (x!=0)?oldSeg.Get(x-1,y):cur;
-   nat32 px = (x+1!=oldSeg.Width())?oldSeg.Get(x+1,y):cur;
-   nat32 ny = (y!=0)?oldSeg.Get(x,y-1):cur;
-   nat32 py = (y+1!=oldSeg.Height())?oldSeg.Get(x,y+1):cur;
+   real32 best = DistSqr(mean[cur],x,y);
+   nat32 bestSeg = cur;
    
-   if ((cur!=nx)||(cur!=px)||(cur!=ny)||(cur!=py))
+   if (nx!=cur)
    {
-    real32 best = DistSqr(mean[cur],x,y);
-    nat32 bestSeg = cur;
-    
-    if (nx!=cur)
+    real32 cost = DistSqr(mean[nx],x,y);
+    if (cost<best)
     {
-     real32 cost = DistSqr(mean[nx],x,y);
-     if (cost<best)
-     {
-      best = cost;
-      bestSeg = nx;
-     }
+     best = cost;
+     bestSeg = nx;
     }
-    
-    if (px!=cur)
+   }
+   
+   if (px!=cur)
+   {
+    real32 cost = DistSqr(mean[px],x,y);
+    if (cost<best)
     {
-     real32 cost = DistSqr(mean[px],x,y);
-     if (cost<best)
-     {
-      best = cost;
-      bestSeg = px;
-     }
+     best = cost;
+     bestSeg = px;
     }
-    
-    if (ny!=cur)
+   }
+   
+   if (ny!=cur)
+   {
+    real32 cost = DistSqr(mean[ny],x,y);
+    if (cost<best)
+    {
+     best = cost;
+     bestSeg = ny;
+    }
+   }
+   
+   if (py!=cur)
+   {
+    real32 cost = DistSqr(mean[py],x,y);
+    if (cost<best)
+    {
+     best = cost;
+     bestSeg = py;
+    }
+   }
+   
+   if (bestSeg!=cur) changes += 1;
+   newSeg.Get(x,y) = bestSeg;
+  }
+  else
+  {
+   newSeg.Get(x,y) = oldSeg.Get(x,y);
+  }
+ }
+ return changes;
+}
+
+void MeanGridSeg::UpdateJob::Do(nat32 y,nat32)
+{
+ nat32 c = self->UpdateRow(y,*oldSeg,*newSeg,*mean);
+ if (c!=0) mt::AtomicAdd(changes,c);
+}
+
+//------------------------------------------------------------------------------
+void MeanGridSeg::RunSlic(time::Progress * prog)
+{
+ prog->Push();
+ nat32 steps = math::Min<nat32>(maxIters,10) + 2;
+ prog->Report(0,steps);
+
+ // Copy the image into arrays...
+  width = image.Size(0);
+  height = image.Size(1);
+  nat32 pixels = width*height;
+  pl.Size(pixels);
+  pu.Size(pixels);
+  pv.Size(pixels);
+  label.Size(pixels);
+  last.Size(pixels);
+  pixDist.Size(pixels);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    const bs::ColourLuv & col = image.Get(x,y);
+    nat32 i = y*width + x;
+    pl[i] = col.l;
+    pu[i] = col.u;
+    pv[i] = col.v;
+    label[i] = 0;
+   }
+  }
+
+
+ // Initialise the means at the centres of the grid cells, moved to the lowest
+ // gradient position in a 3x3 window so they don't start on an edge...
+  gridWidth  = ((width-1)/dim)+1;
+  gridHeight = ((height-1)/dim)+1;
+  nat32 means = gridWidth*gridHeight;
+  ml.Size(means);
+  mu.Size(means);
+  mv.Size(means);
+  mx.Size(means);
+  my.Size(means);
+  bandStart.Size(gridHeight+1);
+  bandMean.Size(means);
+
+  for (nat32 gy=0;gy<gridHeight;gy++)
+  {
+   for (nat32 gx=0;gx<gridWidth;gx++)
+   {
+    nat32 cx = gx*dim + (math::Min(dim,width-gx*dim))/2;
+    nat32 cy = gy*dim + (math::Min(dim,height-gy*dim))/2;
+
+    nat32 bx = cx;
+    nat32 by = cy;
+    real32 bestGrad = math::Infinity<real32>();
+    for (nat32 y=math::Max<nat32>(cy,1)-1;y<=math::Min(cy+1,height-1);y++)
     {
-     real32 cost = DistSqr(mean[ny],x,y);
-     if (cost<best)
+     for (nat32 x=math::Max<nat32>(cx,1)-1;x<=math::Min(cx+1,width-1);x++)
      {
-      best = cost;
-      bestSeg = ny;
+      nat32 i = y*width + x;
+      nat32 l = (x!=0)?(i-1):i;
+      nat32 r = (x+1!=width)?(i+1):i;
+      nat32 u = (y!=0)?(i-width):i;
+      nat32 d = (y+1!=height)?(i+width):i;
+      real32 grad = math::Sqr(pl[r]-pl[l]) + math::Sqr(pu[r]-pu[l]) + math::Sqr(pv[r]-pv[l]) +
+                    math::Sqr(pl[d]-pl[u]) + math::Sqr(pu[d]-pu[u]) + math::Sqr(pv[d]-pv[u]);
+      if (grad<bestGrad)
+      {
+       bestGrad = grad;
+       bx = x;
+       by = y;
+      }
      }
     }
-    
-    if (py!=cur)
+
+    nat32 m = gy*gridWidth + gx;
+    nat32 i = by*width + bx;
+    mx[m] = real32(bx);
+    my[m] = real32(by);
+    ml[m] = pl[i];
+    mu[m] = pu[i];
+    mv[m] = pv[i];
+   }
+  }
+
+
+ // Iterate assignment and update until few pixels change...
+  mt::Pool & pool = mt::SharedPool();
+  acc.Size(pool.Threads()*means*6);
+
+  for (nat32 iter=0;iter<maxIters;iter++)
+  {
+   prog->Report(1+math::Min(iter,steps-2),steps);
+
+   // Sort the means into bands by y, so each row need only check the means
+   // in the three bands arround it...
+    for (nat32 b=0;b<=gridHeight;b++) bandStart[b] = 0;
+    for (nat32 m=0;m<means;m++)
+    {
+     nat32 b = math::Min(nat32(math::Max<real32>(my[m],0.0))/dim,gridHeight-1);
+     bandStart[b+1] += 1;
+    }
+    for (nat32 b=0;b<gridHeight;b++) bandStart[b+1] += bandStart[b];
+    for (nat32 m=0;m<means;m++)
+    {
+     nat32 b = math::Min(nat32(math::Max<real32>(my[m],0.0))/dim,gridHeight-1);
+     bandMean[bandStart[b]] = m;
+     bandStart[b] += 1;
+    }
+    for (nat32 b=gridHeight;b>0;b--) bandStart[b] = bandStart[b-1];
+    bandStart[0] = 0;
+
+   // Assignment...
+    SlicJob job;
+    job.self = this;
+    job.sum = false;
+    slicChanges = 0;
+    pool.Run(job,height);
+
+   // Update...
+    for (nat32 i=0;i<acc.Size();i++) acc[i] = 0.0;
+    job.sum = true;
+    pool.Run(job,height);
+
+    for (nat32 m=0;m<means;m++)
     {
-     real32 cost = DistSqr(mean[py],x,y);
-     if (cost<best)
+     real64 a[6] = {0.0,0.0,0.0,0.0,0.0,0.0};
+     for (nat32 t=0;t<pool.Threads();t++)
+     {
+      real64 * ta = &acc[(t*means + m)*6];
+      for (nat32 j=0;j<6;j++) a[j] += ta[j];
+     }
+
+     if (a[0]>0.0)
      {
-      best = cost;
-      bestSeg = py;
+      real64 inv = 1.0/a[0];
+      mx[m] = a[1]*inv;
+      my[m] = a[2]*inv;
+      ml[m] = a[3]*inv;
+      mu[m] = a[4]*inv;
+      mv[m] = a[5]*inv;
      }
     }
-    
-    if (bestSeg!=cur) changes += 1;
-    newSeg.Get(x,y) = bestSeg;
-   }
-   else
+
+   if (slicChanges*1000<pixels) break;
+  }
+
+
+ // Enforce connectivity, which also creates the output...
+  prog->Report(steps-1,steps);
+  SlicConnect();
+
+ // Clean up...
+  pl.Size(0); pu.Size(0); pv.Size(0);
+  label.Size(0); last.Size(0); pixDist.Size(0);
+  acc.Size(0);
+
+ prog->Pop();
+}
+
+void MeanGridSeg::SlicAssign(nat32 y)
+{
+ nat32 row = y*width;
+ real32 * dist = &pixDist[row];
+ nat32 * lab = &label[row];
+ nat32 * prev = &last[row];
+ const real32 * l = &pl[row];
+ const real32 * u = &pu[row];
+ const real32 * v = &pv[row];
+
+ for (nat32 x=0;x<width;x++)
+ {
+  dist[x] = math::Infinity<real32>();
+  prev[x] = lab[x];
+ }
+
+ // Every mean whose window covers this row, each updating the span of the
+ // row inside its window...
+  nat32 band = y/dim;
+  nat32 bandLow = (band==0)?0:(band-1);
+  nat32 bandHigh = math::Min(band+2,gridHeight);
+  real32 fy = real32(y);
+  real32 win = real32(dim);
+  for (nat32 b=bandStart[bandLow];b<bandStart[bandHigh];b++)
+  {
+   nat32 m = bandMean[b];
+   real32 dy = my[m] - fy;
+   if (math::Abs(dy)>win) continue;
+
+   real32 cx = mx[m];
+   int32 x0 = math::Max<int32>(int32(math::RoundUp(cx-win)),0);
+   int32 x1 = math::Min<int32>(int32(math::RoundDown(cx+win)),int32(width)-1);
+
+   real32 base = spatialMult*dy*dy;
+   real32 cl = ml[m];
+   real32 cu = mu[m];
+   real32 cv = mv[m];
+   for (int32 x=x0;x<=x1;x++)
    {
-    newSeg.Get(x,y) = oldSeg.Get(x,y);
+    real32 d = colMult*(math::Sqr(l[x]-cl) + math::Sqr(u[x]-cu) + math::Sqr(v[x]-cv)) +
+               spatialMult*math::Sqr(real32(x)-cx) + base;
+    if (d<dist[x])
+    {
+     dist[x] = d;
+     lab[x] = m;
+    }
    }
   }
+
+ // Count changes...
+  nat32 changes = 0;
+  for (nat32 x=0;x<width;x++)
+  {
+   if (lab[x]!=prev[x]) ++changes;
+  }
+  if (changes!=0) mt::AtomicAdd(slicChanges,changes);
+}
+
+void MeanGridSeg::SlicSum(nat32 y,real64 * a)
+{
+ nat32 row = y*width;
+ for (nat32 x=0;x<width;x++)
+ {
+  real64 * targ = a + label[row+x]*6;
+  targ[0] += 1.0;
+  targ[1] += real64(x);
+  targ[2] += real64(y);
+  targ[3] += pl[row+x];
+  targ[4] += pu[row+x];
+  targ[5] += pv[row+x];
  }
- return changes;
+}
+
+void MeanGridSeg::SlicConnect()
+{
+ // Flood fill each 4-connected component of the labels, in raster order, giving
+ // each a new number - if a component is too small give it the number of the
+ // component above or to the left of its first pixel instead...
+  nat32 pixels = width*height;
+  const nat32 unset = nat32(-1);
+  for (nat32 i=0;i<pixels;i++) last[i] = unset;
+
+  ds::Array<nat32> queue(pixels);
+  segments = 0;
+  for (nat32 i=0;i<pixels;i++)
+  {
+   if (last[i]!=unset) continue;
+
+   nat32 x = i%width;
+   nat32 adj = unset;
+   if (x!=0) adj = last[i-1];
+   else if (i>=width) adj = last[i-width];
+
+   nat32 old = label[i];
+   nat32 seg = segments;
+   nat32 head = 0;
+   nat32 tail = 1;
+   queue[0] = i;
+   last[i] = seg;
+   while (head<tail)
+   {
+    nat32 p = queue[head];
+    ++head;
+    nat32 px = p%width;
+
+    if ((px!=0)&&(last[p-1]==unset)&&(label[p-1]==old)) {last[p-1] = seg; queue[tail] = p-1; ++tail;}
+    if ((px+1!=width)&&(last[p+1]==unset)&&(label[p+1]==old)) {last[p+1] = seg; queue[tail] = p+1; ++tail;}
+    if ((p>=width)&&(last[p-width]==unset)&&(label[p-width]==old)) {last[p-width] = seg; queue[tail] = p-width; ++tail;}
+    if ((p+width<pixels)&&(last[p+width]==unset)&&(label[p+width]==old)) {last[p+width] = seg; queue[tail] = p+width; ++tail;}
+   }
+
+   if ((tail<minSize)&&(adj!=unset))
+   {
+    for (nat32 j=0;j<tail;j++) last[queue[j]] = adj;
+   }
+   else segments += 1;
+  }
+
+ // Output...
+  out.Resize(width,height);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++) out.Get(x,y) = last[y*width + x];
+  }
+}
+
+void MeanGridSeg::SlicJob::Do(nat32 y,nat32 thread)
+{
+ if (sum) self->SlicSum(y,&self->acc[thread*self->ml.Size()*6]);
+     else self->SlicAssign(y);
 }
 
 //------------------------------------------------------------------------------
@@ -28,6 +28,7 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/time/progress.h"
 #include "eos/svt/field.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -41,6 +42,15 @@ namespace eos
 /// oversegmentation, but it also limits the size of segments to a relativly
 /// tight range, making it useful for certain kinds of algorithm.
 /// The small segments also limit the potential affect of the inevitable errors.
+///
+/// Optionally the SLIC variant can be used instead, 'SLIC Superpixels Compared
+/// to State-of-the-art Superpixel Methods' by Achanta et al. Each pixel is
+/// then assigned to the closest of all the means within a window of twice the
+/// grid size centred on it, rather than moving boundary pixels between
+/// neighbouring segments, so it converges in a handful of iterations. A final
+/// linear time pass makes every segment connected, merging components smaller
+/// than the minimum segment size into a neighbour. Both versions run in
+/// parallel, on mt::SharedPool().
 class EOS_CLASS MeanGridSeg
 {
  public:
@@ -69,6 +79,11 @@ class EOS_CLASS MeanGridSeg
   /// Sets the maximum number of iterations - defaults to 1000.
    void SetMaxIters(nat32 iters);
 
+  /// Enables the SLIC variant, see the class description. Defaults to false.
+  /// The SLIC variant converges much faster, 10 iterations is typical, and
+  /// stops when an iteration changes less than 0.1% of the pixels.
+   void Slic(bit enable);
+
 
   /// &nbsp;
    void Run(time::Progress * prog = null<time::Progress*>());
@@ -92,6 +107,7 @@ class EOS_CLASS MeanGridSeg
    real32 colMult;
    real32 spatialMult;
    nat32 maxIters;
+   bit slic;
    
   // Input...
    svt::Field<bs::ColourLuv> image;
@@ -111,6 +127,51 @@ class EOS_CLASS MeanGridSeg
    void CalcMeans(const ds::Array2D<nat32> & seg,ds::Array<Mean> & mean);
    nat32 UpdatePixels(const ds::Array2D<nat32> & oldSeg, ds::Array2D<nat32> & newSeg,
                       const ds::Array<Mean> & mean); // Returns the number of changes.
+   nat32 UpdateRow(nat32 y,const ds::Array2D<nat32> & oldSeg, ds::Array2D<nat32> & newSeg,
+                   const ds::Array<Mean> & mean); // Does a single row of the above.
+
+   class UpdateJob : public mt::Job
+   {
+    public:
+     MeanGridSeg * self;
+     const ds::Array2D<nat32> * oldSeg;
+     ds::Array2D<nat32> * newSeg;
+     const ds::Array<Mean> * mean;
+     volatile nat32 changes;
+     void Do(nat32 y,nat32 thread);
+   };
+
+
+  // The SLIC variant, with the image and means stored as structures of
+  // arrays...
+   void RunSlic(time::Progress * prog);
+   void SlicAssign(nat32 y); // Assigns a row of pixels to there closest mean.
+   void SlicSum(nat32 y,real64 * acc); // Sums a row into per-mean accumulators.
+   void SlicConnect(); // Makes segments connected, and fills in out.
+
+   nat32 width;
+   nat32 height;
+   ds::Array<real32> pl,pu,pv; // Pixel colours.
+   ds::Array<nat32> label; // Pixel labels.
+   ds::Array<real32> pixDist; // Distance to the mean of each pixels label.
+   ds::Array<nat32> last; // Labels from the previous iteration.
+
+   nat32 gridWidth;
+   nat32 gridHeight;
+   ds::Array<real32> ml,mu,mv,mx,my; // Means.
+   ds::Array<nat32> bandStart; // Means sorted by y into bands of the grid size, offset of each band in bandMean.
+   ds::Array<nat32> bandMean;
+
+   ds::Array<real64> acc; // Per thread accumulators for the means, 6 per mean.
+   volatile nat32 slicChanges;
+
+   class SlicJob : public mt::Job
+   {
+    public:
+     MeanGridSeg * self;
+     bit sum; // false to assign, true to sum.
+     void Do(nat32 y,nat32 thread);
+   };
    
    real32 DistSqr(const Mean & m,nat32 x,nat32 y) const
    {
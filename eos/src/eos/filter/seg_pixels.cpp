@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/filter/seg_pixels.h"
+
+#include "eos/ds/sorting.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+// For ordering segments by size, largest first, with ties in segment order...
+struct SizeSeg
+{
+ nat32 size;
+ nat32 seg;
+
+ bit operator < (const SizeSeg & rhs) const
+ {
+  if (size!=rhs.size) return size>rhs.size;
+  return seg<rhs.seg;
+ }
+};
+
+//------------------------------------------------------------------------------
+SegPixels::SegPixels(const svt::Field<nat32> & segs,nat32 segments)
+{
+ // Count the segments if not told...
+  if (segments==0)
+  {
+   segments = 1;
+   for (nat32 y=0;y<segs.Size(1);y++)
+   {
+    for (nat32 x=0;x<segs.Size(0);x++) segments = math::Max(segments,segs.Get(x,y)+1);
+   }
+  }
+
+ // Count the pixels in each segment, then convert to offsets...
+  offset.Size(segments+1);
+  for (nat32 i=0;i<offset.Size();i++) offset[i] = 0;
+
+  for (nat32 y=0;y<segs.Size(1);y++)
+  {
+   for (nat32 x=0;x<segs.Size(0);x++) offset[segs.Get(x,y)+1] += 1;
+  }
+
+  for (nat32 i=1;i<offset.Size();i++) offset[i] += offset[i-1];
+
+ // Fill in the pixels, in raster order so each segments pixels are too, using
+ // a cursor per segment...
+  pixel.Size(offset[segments]);
+  ds::Array<nat32> cursor(segments);
+  for (nat32 i=0;i<segments;i++) cursor[i] = offset[i];
+
+  for (nat32 y=0;y<segs.Size(1);y++)
+  {
+   for (nat32 x=0;x<segs.Size(0);x++)
+   {
+    Pair<nat32,nat32> & targ = pixel[cursor[segs.Get(x,y)]];
+    targ.first = x;
+    targ.second = y;
+    cursor[segs.Get(x,y)] += 1;
+   }
+  }
+}
+
+SegPixels::~SegPixels()
+{}
+
+void SegPixels::Order(ds::Array<nat32> & out) const
+{
+ // Sort (size,segment) pairs, largest first...
+  ds::Array<SizeSeg> sorted(Segments());
+  for (nat32 i=0;i<sorted.Size();i++)
+  {
+   sorted[i].size = Size(i);
+   sorted[i].seg = i;
+  }
+  sorted.SortNorm();
+
+ // Extract...
+  out.Size(sorted.Size());
+  for (nat32 i=0;i<out.Size();i++) out[i] = sorted[i].seg;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,83 @@
+#ifndef EOS_FILTER_SEG_PIXELS_H
+#define EOS_FILTER_SEG_PIXELS_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file seg_pixels.h
+/// Given a segmentation this indexes the pixels of each segment, so per-segment
+/// algorithms can visit just the pixels of a segment rather than rescanning
+/// the entire segmentation for each.
+
+#include "eos/types.h"
+#include "eos/svt/field.h"
+#include "eos/ds/arrays.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+/// Stores the pixels of every segment of a segmentation, in compressed sparse
+/// row form - a single array of pixel coordinates sorted by segment, plus an
+/// offset into it for each segment. Within a segment pixels are in raster
+/// order, so anything accumulated over them matches a raster scan of the
+/// segmentation exactly. Read only once constructed, so any number of threads
+/// can query it at once, making it ideal for fitting segments in parallel.
+class EOS_CLASS SegPixels
+{
+ public:
+  /// Indexes the given segmentation. If segments is 0 it is calculated as one
+  /// more than the largest segment number, with a minimum of 1.
+   SegPixels(const svt::Field<nat32> & segs,nat32 segments = 0);
+
+  /// &nbsp;
+   ~SegPixels();
+
+
+  /// Returns how many segments are indexed.
+   nat32 Segments() const {return offset.Size()-1;}
+
+  /// Returns how many pixels the given segment contains.
+   nat32 Size(nat32 seg) const {return offset[seg+1] - offset[seg];}
+
+  /// Returns the x coordinate of pixel i of the given segment.
+   nat32 X(nat32 seg,nat32 i) const {return pixel[offset[seg]+i].first;}
+
+  /// Returns the y coordinate of pixel i of the given segment.
+   nat32 Y(nat32 seg,nat32 i) const {return pixel[offset[seg]+i].second;}
+
+
+  /// Fills the given array with every segment number, ordered from the largest
+  /// segment to the smallest. Handing segments out to threads in this order
+  /// stops a single large segment started last from holding up the rest.
+   void Order(ds::Array<nat32> & out) const;
+
+
+  /// &nbsp;
+   inline cstrconst TypeString() const {return "eos::filter::SegPixels";}
+
+
+ private:
+  ds::Array<nat32> offset; // Segments()+1 entries, segment s is [offset[s],offset[s+1]) in pixel.
+  ds::Array< Pair<nat32,nat32> > pixel; // (x,y) of every pixel, grouped by segment.
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -165,148 +165,96 @@ void Segmenter::GetOutput(ds::Array2D<nat32> & out) const
 //------------------------------------------------------------------------------
 void Segmenter::MergeBasic()
 {
- // Now iterativly merge - we do this by iterating all Nodes and checking 
- // there neighbours, and merging with the closest neighbour if there is
- // one within the cutoff. When an iteration with no change happens we stop.
-  while (true)
+ // Merging repeatedly merges each node with its nearest neighbour of another
+ // segment, if within the cutoff, until nothing changes. As the feature
+ // vectors of the nodes are not changed whilst doing so the end result is
+ // simply the connected components of the graph of below-cutoff edges between
+ // neighbouring nodes, so we find those edges and union-find them instead...
+  ds::Array<byte> edgeFlags(nodeCount);
+  NearJob job;
+  job.self = this;
+  job.edgeFlags = edgeFlags.Ptr();
+  mt::SharedPool().Run(job,height);
+
+ // Union the segments across every marked edge...
+  Node * targ = forest;
+  byte * n = edgeFlags.Ptr();
+  for (nat32 y=0;y<height;y++)
   {
-   // First pass, select neighbours to cluster with for each node.
-    Node * targ = forest;
-    for (nat32 y=0;y<height;y++)
+   for (nat32 x=0;x<width;x++)
+   {
+    if (*n&1) Union(targ,(Node*)((byte*)targ + nodeSize));
+    if (*n&2) Union(targ,(Node*)((byte*)targ + nodeSize*width));
+    ++n;
+    (byte*&)targ += nodeSize;
+   }
+  }
+
+ // Mark nodes surrounded by there own segment as stopped, as the iterative
+ // approach would have done, for the benefit of MergeSmallOnce...
+  targ = forest;
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    if (!targ->stop)
     {
-     for (nat32 x=0;x<width;x++)
-     {
-      if (!targ->stop)
-      {
-       Node * head = targ->Head();
+     Node * head = targ->Head();
+     bit stop = true;
+     if ((x!=0)&&(((Node*)((byte*)targ - nodeSize))->Head()!=head)) stop = false;
+     if ((x!=(width-1))&&(((Node*)((byte*)targ + nodeSize))->Head()!=head)) stop = false;
+     if ((y!=0)&&(((Node*)((byte*)targ - nodeSize*width))->Head()!=head)) stop = false;
+     if ((y!=(height-1))&&(((Node*)((byte*)targ + nodeSize*width))->Head()!=head)) stop = false;
+     targ->stop = stop;
+    }
+    (byte*&)targ += nodeSize;
+   }
+  }
+}
 
-       Node * nearHead = 0;
-       Node * nearNode = 0;
-       real32 nearDist = 1e100; // distance squared in fact, for speed.
+void Segmenter::Union(Node * a,Node * b)
+{
+ Node * head1 = a->Head();
+ Node * head2 = b->Head();
+ if (head1==head2) return;
 
-       // Find the minimum distance to the 4 neighbours, ignoring once of the same cluster...
-        // Left...
-         if (x!=0)
-         {
-          Node * tempNode = (Node*)((byte*)targ - nodeSize);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }
-         }
+ if (head1->weight<head2->weight) math::Swap(head1,head2);
+ head1->weight = head1->weight + head2->weight;
+ head2->parent = head1;
+}
 
-        // Right...
-         if (x!=(width-1))
-         {
-          Node * tempNode = (Node*)((byte*)targ + nodeSize);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }
-         }
+void Segmenter::NearJob::Do(nat32 y,nat32)
+{
+ nat32 width = self->width;
+ nat32 nodeSize = self->nodeSize;
+ nat32 fvSize = self->feat.Size();
+ real32 cutoffSqr = self->cutoff*self->cutoff;
+
+ Node * targ = (Node*)((byte*)self->forest + y*width*nodeSize);
+ byte * n = edgeFlags + y*width;
+ for (nat32 x=0;x<width;x++)
+ {
+  *n = 0;
 
-        // Up...
-         if (y!=0)
-         {
-          Node * tempNode = (Node*)((byte*)targ - nodeSize*width);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }         
-         }
- 
-        // Down...
-         if (y!=(height-1))
-         {
-          Node * tempNode = (Node*)((byte*)targ + nodeSize*width);
-          Node * tempHead = tempNode->Head();
-          if (tempHead!=head)
-          {
-           real32 tempDist = 0.0;
-           for (nat32 i=0;i<feat.Size();i++)
-           {
-            tempDist += (targ->fv[i]-tempNode->fv[i])*(targ->fv[i]-tempNode->fv[i]);
-           }
-           if (tempDist<nearDist)
-           {
-            nearHead = tempHead;
-            nearNode = tempNode;
-            nearDist = tempDist;         
-           }
-          }
-         }
- 
-       // If it is null then we are surrounded by nodes of the same cluster - stop proccessing this one, permanantly...
-        if (nearNode==0) targ->stop = true;
-        else
-        {
-         // If the nearest cluster is within the cutoff then merge...
-          if (nearDist<(cutoff*cutoff))
-          {
-           targ->newParent = nearHead;
-          }
-        }
-       }
-      (byte*&)targ += nodeSize;
-     }
-    }
+  if (x!=(width-1))
+  {
+   Node * other = (Node*)((byte*)targ + nodeSize);
+   real32 dist = 0.0;
+   for (nat32 i=0;i<fvSize;i++) dist += math::Sqr(targ->fv[i]-other->fv[i]);
+   if (dist<cutoffSqr) *n |= 1;
+  }
 
-   // Second pass, merge clusters that have been marked for the merging.
-   // Also, detect when its time to finish...
-    targ = forest;
-    bit wibble = true;
-     for (nat32 i=0;i<nodeCount;i++)
-     {
-      if (targ->newParent)
-      {
-       Node * head1 = targ->Head();
-       Node * head2 = targ->newParent->Head();
-       targ->newParent = null<Node*>();
- 
-       if (head1!=head2)
-       {
-        head1->weight = head1->weight + head2->weight;
-        head2->parent = head1;
-        wibble = false;
-       }    
-      }
-      (byte*&)targ += nodeSize; 
-     }
-    if (wibble) break;
+  if (y!=(self->height-1))
+  {
+   Node * other = (Node*)((byte*)targ + nodeSize*width);
+   real32 dist = 0.0;
+   for (nat32 i=0;i<fvSize;i++) dist += math::Sqr(targ->fv[i]-other->fv[i]);
+   if (dist<cutoffSqr) *n |= 2;
   }
+
+  ++n;
+  (byte*&)targ += nodeSize;
+ }
 }
 
 void Segmenter::MergeWeighted()
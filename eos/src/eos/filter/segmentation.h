@@ -28,6 +28,7 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/svt/var.h"
 #include "eos/svt/field.h"
+#include "eos/mt/pool.h"
 #include "eos/time/progress.h"
 
 namespace eos
@@ -177,9 +178,23 @@ class EOS_CLASS Segmenter
 
 
   // This method merges all segments in the data structure that are within the 
-  // cutoff distance of each other for pixels at the edges...
+  // cutoff distance of each other for pixels at the edges. Union-find over
+  // the below-cutoff edges, with the edges found in parallel...
    void MergeBasic();
 
+  // Joins the segments of two nodes, the smaller under the larger...
+   void Union(Node * a,Node * b);
+
+  // Job for MergeBasic, marks the below-cutoff edges of each row, bit 0 for
+  // right, bit 1 for down...
+   class NearJob : public mt::Job
+   {
+    public:
+     Segmenter * self;
+     byte * edgeFlags;
+     void Do(nat32 y,nat32 thread);
+   };
+
   // Identical to MergeBasic, except it also does the weighting requirement,
   // an optional code path to replace MergeBasic when weighting is enabled.
    void MergeWeighted();
@@ -0,0 +1,433 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/filter/tiled.h"
+
+#include "eos/math/functions.h"
+#include "eos/mem/functions.h"
+#include "eos/mt/threads.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+// Sink that writes tiles into fields, a field per channel...
+class TileFieldSink : public TileSink
+{
+ public:
+  svt::Field<real32> ** out;
+  nat32 channels;
+
+  void Put(nat32 x,nat32 y,nat32 width,nat32 height,const real32 * data,nat32 stride)
+  {
+   for (nat32 c=0;c<channels;c++)
+   {
+    for (nat32 v=0;v<height;v++)
+    {
+     const real32 * s = data + v*stride + c;
+     for (nat32 u=0;u<width;u++) out[c]->Get(x+u,y+v) = s[u*channels];
+    }
+   }
+  }
+};
+
+//------------------------------------------------------------------------------
+const nat32 TileStage::tileSize;
+
+TileStage::TileStage(TileStage & in,nat32 ch,nat32 ha)
+:input(&in),width(in.Width()),height(in.Height()),channels(ch),halo(ha),
+userCache(0),capacity(0),size(0),entry(null<Entry*>()),clock(0)
+{}
+
+TileStage::TileStage(nat32 w,nat32 h,nat32 ch)
+:input(null<TileStage*>()),width(w),height(h),channels(ch),halo(0),
+userCache(0),capacity(0),size(0),entry(null<Entry*>()),clock(0)
+{}
+
+TileStage::~TileStage()
+{
+ ClearCache();
+}
+
+void TileStage::ClearCache()
+{
+ for (nat32 i=0;i<size;i++) delete[] entry[i].data;
+ delete[] entry;
+ entry = null<Entry*>();
+ capacity = 0;
+ size = 0;
+}
+
+void TileStage::Fetch(int32 x,int32 y,nat32 w,nat32 h,real32 * out,nat32 stride)
+{
+ if ((w==0)||(h==0)) return;
+ const int32 ts = tileSize;
+
+ // The range of tiles covered, after clamping to the image...
+  int32 tx0 = math::Clamp<int32>(x,0,width-1)/ts;
+  int32 tx1 = math::Clamp<int32>(x+int32(w)-1,0,width-1)/ts;
+  int32 ty0 = math::Clamp<int32>(y,0,height-1)/ts;
+  int32 ty1 = math::Clamp<int32>(y+int32(h)-1,0,height-1)/ts;
+
+ // Clamping is monotonic, so the requested pixels that come from each tile
+ // form a rectangle - copy each in turn...
+  for (int32 ty=ty0;ty<=ty1;ty++)
+  {
+   int32 ys = (ty==ty0)?y:(ty*ts);
+   int32 ye = (ty==ty1)?(y+int32(h)):((ty+1)*ts);
+   for (int32 tx=tx0;tx<=tx1;tx++)
+   {
+    int32 xs = (tx==tx0)?x:(tx*ts);
+    int32 xe = (tx==tx1)?(x+int32(w)):((tx+1)*ts);
+
+    // The part of the range within the image, outside being repeats of the
+    // edge - the region can be entirely to one side, so the edge runs are
+    // bounded by the span as well...
+     int32 ms = math::Max<int32>(xs,0);
+     int32 me = math::Min<int32>(xe,width);
+
+    Entry * e = Acquire(tx,ty);
+    const int32 ch = channels;
+    for (int32 v=ys;v<ye;v++)
+    {
+     int32 cv = math::Clamp<int32>(v,0,height-1) - ty*ts;
+     const real32 * src = e->data + (cv*ts - tx*ts)*ch;
+     real32 * dst = out + (v-y)*int32(stride) - x*ch;
+
+     for (int32 u=xs;u<math::Min(ms,xe);u++) mem::Copy(dst + u*ch,src,channels);
+     if (me>ms) mem::Copy(dst + ms*ch,src + ms*ch,(me-ms)*channels);
+     for (int32 u=math::Max(me,xs);u<xe;u++) mem::Copy(dst + u*ch,src + (int32(width)-1)*ch,channels);
+    }
+    Release(e);
+   }
+  }
+}
+
+void TileStage::Render(TileSink & sink,nat32 strip,time::Progress * prog)
+{
+ LogBlock("void eos::filter::TileStage::Render(...)","{width,height,channels,strip}" << LogDiv() << width << LogDiv() << height << LogDiv() << channels << LogDiv() << strip);
+ if ((width==0)||(height==0)) return;
+ mt::Pool & pool = mt::SharedPool();
+
+ RenderJob job;
+  job.self = this;
+  job.sink = &sink;
+  job.tilesX = (width+tileSize-1)/tileSize;
+  job.tilesY = (height+tileSize-1)/tileSize;
+  job.strip = ((strip==0)||(strip>job.tilesX))?job.tilesX:strip;
+  job.buf = new real32[pool.Threads()*tileSize*tileSize*channels];
+
+ // Size the caches before the stages, then run...
+  if (input) input->Prepare(job.strip,pool.Threads(),1);
+
+  prog->Push();
+  pool.Run(job,job.tilesX*job.tilesY,prog);
+  prog->Pop();
+
+ delete[] job.buf;
+}
+
+void TileStage::Render(svt::Field<real32> ** out,nat32 strip,time::Progress * prog)
+{
+ TileFieldSink sink;
+  sink.out = out;
+  sink.channels = channels;
+ Render(sink,strip,prog);
+}
+
+TileStage::Entry * TileStage::Acquire(nat32 tx,nat32 ty)
+{
+ lock.Lock();
+ if (entry==null<Entry*>()) Allocate((userCache!=0)?userCache:(3*((width+tileSize-1)/tileSize)+4));
+
+ while (true)
+ {
+  // If its allready there use it, waiting if its being produced...
+   Entry * found = null<Entry*>();
+   for (nat32 i=0;i<size;i++)
+   {
+    if ((entry[i].tx==tx)&&(entry[i].ty==ty)) {found = &entry[i]; break;}
+   }
+
+   if (found)
+   {
+    if (found->ready)
+    {
+     found->users += 1;
+     found->lastUse = ++clock;
+     lock.Unlock();
+     return found;
+    }
+
+    lock.Unlock();
+    mt::Sleep(1);
+    lock.Lock();
+    continue;
+   }
+
+  // Get a slot, either unused or the least recently used tile not in use...
+   Entry * slot = null<Entry*>();
+   if (size<capacity)
+   {
+    slot = &entry[size];
+    slot->data = new real32[tileSize*tileSize*channels];
+    ++size;
+   }
+   else
+   {
+    for (nat32 i=0;i<size;i++)
+    {
+     if ((!entry[i].ready)||(entry[i].users!=0)) continue;
+     if ((slot==null<Entry*>())||(entry[i].lastUse<slot->lastUse)) slot = &entry[i];
+    }
+   }
+
+  // If there is no slot every tile is in use, so produce one outside the
+  // cache...
+   if (slot==null<Entry*>())
+   {
+    lock.Unlock();
+    Entry * ret = new Entry();
+    ret->tx = tx;
+    ret->ty = ty;
+    ret->data = new real32[tileSize*tileSize*channels];
+    ret->users = 1;
+    ret->ready = true;
+    ret->temp = true;
+    Produce(tx,ty,ret->data);
+    return ret;
+   }
+
+  // Produce the tile into the slot...
+   slot->tx = tx;
+   slot->ty = ty;
+   slot->users = 1;
+   slot->ready = false;
+   slot->temp = false;
+   slot->lastUse = ++clock;
+   lock.Unlock();
+
+   Produce(tx,ty,slot->data);
+
+   lock.Lock();
+    slot->ready = true;
+   lock.Unlock();
+   return slot;
+ }
+}
+
+void TileStage::Release(Entry * e)
+{
+ if (e->temp)
+ {
+  delete[] e->data;
+  delete e;
+  return;
+ }
+
+ lock.Lock();
+  e->users -= 1;
+ lock.Unlock();
+}
+
+void TileStage::Produce(nat32 tx,nat32 ty,real32 * out)
+{
+ nat32 x = tx*tileSize;
+ nat32 y = ty*tileSize;
+ nat32 w = math::Min(tileSize,width-x);
+ nat32 h = math::Min(tileSize,height-y);
+
+ if (input)
+ {
+  nat32 iw = w + 2*halo;
+  nat32 ih = h + 2*halo;
+  nat32 is = iw*input->Channels();
+  real32 * in = new real32[is*ih];
+  input->Fetch(int32(x)-int32(halo),int32(y)-int32(halo),iw,ih,in,is);
+  Compute(x,y,w,h,in,is,out,tileSize*channels);
+  delete[] in;
+ }
+ else
+ {
+  Compute(x,y,w,h,null<real32*>(),0,out,tileSize*channels);
+ }
+}
+
+void TileStage::Prepare(nat32 strip,nat32 threads,nat32 level)
+{
+ // Each stage back from the output needs about a tile more on each side, and
+ // a row more above and below, of its input...
+  nat32 tilesX = (width+tileSize-1)/tileSize;
+  nat32 across = math::Min(tilesX,strip + 2*level);
+  nat32 cap = (userCache!=0)?userCache:(across*(2*level+2) + 2*threads);
+
+  if (cap!=capacity) Allocate(cap);
+  if (input) input->Prepare(strip,threads,level+1);
+}
+
+void TileStage::Allocate(nat32 cap)
+{
+ ClearCache();
+ entry = new Entry[cap];
+ capacity = cap;
+}
+
+void TileStage::RenderJob::Do(nat32 unit,nat32 thread)
+{
+ // Convert the unit to a tile, working in bands of columns...
+  nat32 perBand = strip*tilesY;
+  nat32 band = unit/perBand;
+  nat32 rem = unit%perBand;
+  nat32 bandWidth = math::Min(strip,tilesX-band*strip);
+  nat32 tx = band*strip + rem%bandWidth;
+  nat32 ty = rem/bandWidth;
+
+ // Produce it and hand it over...
+  real32 * out = buf + thread*tileSize*tileSize*self->channels;
+  self->Produce(tx,ty,out);
+
+  nat32 x = tx*tileSize;
+  nat32 y = ty*tileSize;
+  sink->Put(x,y,math::Min(tileSize,self->width-x),math::Min(tileSize,self->height-y),out,tileSize*self->channels);
+}
+
+//------------------------------------------------------------------------------
+TileField::TileField(const svt::Field<real32> & in)
+:TileStage(in.Size(0),in.Size(1),1),field(in)
+{}
+
+void TileField::Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 *,nat32,real32 * out,nat32 outStride)
+{
+ for (nat32 v=0;v<h;v++)
+ {
+  real32 * o = out + v*outStride;
+  for (nat32 u=0;u<w;u++) o[u] = field.Get(x+u,y+v);
+ }
+}
+
+//------------------------------------------------------------------------------
+TileRGB::TileRGB(const svt::Field<bs::ColourRGB> & in)
+:TileStage(in.Size(0),in.Size(1),3),field(in)
+{}
+
+void TileRGB::Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 *,nat32,real32 * out,nat32 outStride)
+{
+ for (nat32 v=0;v<h;v++)
+ {
+  real32 * o = out + v*outStride;
+  for (nat32 u=0;u<w;u++)
+  {
+   const bs::ColourRGB & targ = field.Get(x+u,y+v);
+   o[u*3+0] = targ.r;
+   o[u*3+1] = targ.g;
+   o[u*3+2] = targ.b;
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+TileLuv::TileLuv(TileStage & input)
+:TileStage(input,3,0)
+{
+ log::Assert(input.Channels()==3);
+}
+
+void TileLuv::Compute(nat32,nat32,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride)
+{
+ for (nat32 v=0;v<h;v++)
+ {
+  const real32 * i = in + v*inStride;
+  real32 * o = out + v*outStride;
+  for (nat32 u=0;u<w;u++)
+  {
+   bs::ColourLuv luv(bs::ColourRGB(i[u*3+0],i[u*3+1],i[u*3+2]));
+   o[u*3+0] = luv.l;
+   o[u*3+1] = luv.u;
+   o[u*3+2] = luv.v;
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+TileConvolve::TileConvolve(TileStage & input,const KernelVect & k)
+:TileStage(input,input.Channels(),k.HalfSize()),kernel(k)
+{}
+
+void TileConvolve::Compute(nat32,nat32,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride)
+{
+ nat32 half = kernel.HalfSize();
+ nat32 ch = Channels();
+ nat32 rw = w*ch; // Floats in an output row.
+ nat32 ih = h + 2*half;
+
+ // Horizontal pass, over all rows of the input, into a buffer of output
+ // width - with interleaved channels a tap is just an offset of ch...
+  real32 * im = new real32[rw*ih];
+  for (nat32 v=0;v<ih;v++)
+  {
+   real32 * o = im + v*rw;
+   for (nat32 k=0;k<rw;k++) o[k] = 0.0;
+   for (int32 d=-int32(half);d<=int32(half);d++)
+   {
+    real32 wt = kernel.ValH(d);
+    const real32 * s = in + v*inStride + (d+int32(half))*ch;
+    for (nat32 k=0;k<rw;k++) o[k] += wt*s[k];
+   }
+  }
+
+ // Vertical pass...
+  for (nat32 v=0;v<h;v++)
+  {
+   real32 * o = out + v*outStride;
+   for (nat32 k=0;k<rw;k++) o[k] = 0.0;
+   for (int32 d=-int32(half);d<=int32(half);d++)
+   {
+    real32 wt = kernel.ValV(d);
+    const real32 * s = im + (v+d+int32(half))*rw;
+    for (nat32 k=0;k<rw;k++) o[k] += wt*s[k];
+   }
+  }
+
+ delete[] im;
+}
+
+//------------------------------------------------------------------------------
+TileGradient::TileGradient(TileStage & input,nat32 c)
+:TileStage(input,2,1),channel(c)
+{}
+
+void TileGradient::Compute(nat32,nat32,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride)
+{
+ nat32 ch = Input()->Channels();
+ for (nat32 v=0;v<h;v++)
+ {
+  const real32 * above = in + v*inStride + channel;
+  const real32 * row = above + inStride;
+  const real32 * below = row + inStride;
+  real32 * o = out + v*outStride;
+  for (nat32 u=0;u<w;u++)
+  {
+   o[u*2+0] = 0.5*(row[(u+2)*ch] - row[u*ch]);
+   o[u*2+1] = 0.5*(below[(u+1)*ch] - above[(u+1)*ch]);
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
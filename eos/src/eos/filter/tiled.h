@@ -0,0 +1,285 @@
+#ifndef EOS_FILTER_TILED_H
+#define EOS_FILTER_TILED_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file tiled.h
+/// Provides a pull based, tiled, image pipeline, for chaining local filters on
+/// images too large to have several full size intermediates in memory at once.
+/// Each stage produces square tiles of its output on demand, pulling the
+/// region it needs from the stage before, expanded by its halo, and keeps a
+/// bounded cache of the tiles it has produced. Rendering the last stage runs
+/// its tiles in parallel, so peak memory is a few rows of tiles per stage
+/// rather than a full image per stage.
+
+#include "eos/types.h"
+#include "eos/svt/field.h"
+#include "eos/bs/colours.h"
+#include "eos/filter/kernel.h"
+#include "eos/mt/locks.h"
+#include "eos/mt/pool.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace filter
+ {
+//------------------------------------------------------------------------------
+/// The interface for the final destination of a tiled pipeline, handed tiles
+/// as they are finished. Put is called by multiple threads at once, with
+/// different tiles.
+class EOS_CLASS TileSink
+{
+ public:
+  /// &nbsp;
+   virtual ~TileSink() {}
+
+  /// Given a finished tile, which starts at (x,y) and is width by height
+  /// pixels. data is interleaved by channel, with stride floats between rows.
+   virtual void Put(nat32 x,nat32 y,nat32 width,nat32 height,const real32 * data,nat32 stride) = 0;
+};
+
+//------------------------------------------------------------------------------
+/// A stage of a tiled pipeline, to be inherited from. A stage has an output
+/// image of real32 pixels with a number of interleaved channels, and
+/// optionally an input stage, which must be the same size. Stages with an input
+/// declare a halo, the number of pixels around each output tile needed from the
+/// input to compute it. Borders are handled by repetition, i.e. the input is
+/// presented as though its edge pixels extended forever.
+///
+/// Each stage keeps a cache of recently produced tiles, which Fetch uses and
+/// which may be accessed by many threads at once. If a tile another thread is
+/// producing is needed it waits rather than duplicating the work. The cache
+/// size is set automatically for the order Render works in, unless set by the
+/// user. Stages are not owned by the stages after them.
+class EOS_CLASS TileStage : public Deletable
+{
+ public:
+  /// The width and height of the square tiles.
+   static const nat32 tileSize = 128;
+
+
+  /// For a stage that takes an input, the size being taken from it.
+   TileStage(TileStage & input,nat32 channels,nat32 halo);
+
+  /// For a source, with no input.
+   TileStage(nat32 width,nat32 height,nat32 channels);
+
+  /// &nbsp;
+   ~TileStage();
+
+
+  /// &nbsp;
+   nat32 Width() const {return width;}
+
+  /// &nbsp;
+   nat32 Height() const {return height;}
+
+  /// &nbsp;
+   nat32 Channels() const {return channels;}
+
+  /// &nbsp;
+   nat32 Halo() const {return halo;}
+
+  /// Returns the input, null for a source.
+   TileStage * Input() const {return input;}
+
+
+  /// Sets how many tiles the cache can hold, 0 for automatic, the default.
+  /// Less than needed causes tiles to be recomputed, not failure.
+   void SetCache(nat32 tiles) {userCache = tiles;}
+
+  /// Deletes all cached tiles. Must not be called during a Fetch or Render.
+   void ClearCache();
+
+
+  /// Fills out with the given region of the output, with stride floats
+  /// between rows and the channels interleaved. The region may extend beyond
+  /// the image, in which case edge pixels are repeated.
+   void Fetch(int32 x,int32 y,nat32 w,nat32 h,real32 * out,nat32 stride);
+
+  /// Renders the entire output, a tile at a time in parallel, handing the
+  /// tiles to the sink. Tiles are produced a band of columns at a time, strip
+  /// tiles wide, 0 meaning the full width, in raster order within each band.
+  /// Narrower bands need smaller caches at the expense of recomputing input
+  /// tiles along the band edges.
+   void Render(TileSink & sink,nat32 strip = 0,time::Progress * prog = null<time::Progress*>());
+
+  /// Renders the entire output into fields, one per channel, which must be
+  /// the size of the output.
+   void Render(svt::Field<real32> ** out,nat32 strip = 0,time::Progress * prog = null<time::Progress*>());
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::TileStage";}
+
+
+ protected:
+  /// Computes the given rectangle of the output, which is entirely within the
+  /// image and at most a tile in size. in is the input for the rectangle
+  /// expanded by the halo, w+2*halo by h+2*halo pixels, with inStride floats
+  /// between rows. For a source in is null.
+   virtual void Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride) = 0;
+
+
+ private:
+  TileStage * input;
+  nat32 width;
+  nat32 height;
+  nat32 channels;
+  nat32 halo;
+
+  // The cache...
+   struct Entry
+   {
+    nat32 tx;
+    nat32 ty;
+    real32 * data; // tileSize*tileSize*channels, rows of tileSize pixels.
+    nat32 users; // Number of Fetch calls reading it.
+    bit ready; // false whilst being produced.
+    bit temp; // true if not in the cache, as it was full of tiles in use.
+    nat32 lastUse;
+   };
+
+   nat32 userCache;
+   nat32 capacity;
+   nat32 size;
+   Entry * entry;
+   nat32 clock;
+   mt::OwnedLock lock;
+
+  // Helpers...
+   Entry * Acquire(nat32 tx,nat32 ty);
+   void Release(Entry * e);
+   void Produce(nat32 tx,nat32 ty,real32 * out);
+   void Prepare(nat32 strip,nat32 threads,nat32 level);
+   void Allocate(nat32 cap);
+
+  // The job for Render...
+   class RenderJob : public mt::Job
+   {
+    public:
+     TileStage * self;
+     TileSink * sink;
+     nat32 strip;
+     nat32 tilesX;
+     nat32 tilesY;
+     real32 * buf; // A tile per thread.
+     void Do(nat32 unit,nat32 thread);
+   };
+};
+
+//------------------------------------------------------------------------------
+/// A source stage, a single channel from a field. The field must remain valid
+/// and unchanged whilst the pipeline is in use.
+class EOS_CLASS TileField : public TileStage
+{
+ public:
+  /// &nbsp;
+   TileField(const svt::Field<real32> & in);
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::TileField";}
+
+
+ protected:
+  void Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride);
+
+ private:
+  const svt::Field<real32> & field;
+};
+
+//------------------------------------------------------------------------------
+/// A source stage, 3 channels of red, green and blue from a field.
+class EOS_CLASS TileRGB : public TileStage
+{
+ public:
+  /// &nbsp;
+   TileRGB(const svt::Field<bs::ColourRGB> & in);
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::TileRGB";}
+
+
+ protected:
+  void Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride);
+
+ private:
+  const svt::Field<bs::ColourRGB> & field;
+};
+
+//------------------------------------------------------------------------------
+/// Converts 3 channels of rgb into 3 channels of Luv.
+class EOS_CLASS TileLuv : public TileStage
+{
+ public:
+  /// &nbsp;
+   TileLuv(TileStage & input);
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::TileLuv";}
+
+
+ protected:
+  void Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride);
+};
+
+//------------------------------------------------------------------------------
+/// Convolves every channel with a separable kernel, equivalent to
+/// KernelVect::ApplyRepeat. The halo is the half size of the kernel.
+class EOS_CLASS TileConvolve : public TileStage
+{
+ public:
+  /// The kernel is copied.
+   TileConvolve(TileStage & input,const KernelVect & kernel);
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::TileConvolve";}
+
+
+ protected:
+  void Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride);
+
+ private:
+  KernelVect kernel;
+};
+
+//------------------------------------------------------------------------------
+/// Calculates the gradient of a single channel of its input by central
+/// differences, outputing 2 channels, the x then y derivative.
+class EOS_CLASS TileGradient : public TileStage
+{
+ public:
+  /// &nbsp;
+   TileGradient(TileStage & input,nat32 channel = 0);
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::filter::TileGradient";}
+
+
+ protected:
+  void Compute(nat32 x,nat32 y,nat32 w,nat32 h,const real32 * in,nat32 inStride,real32 * out,nat32 outStride);
+
+ private:
+  nat32 channel;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -469,6 +469,8 @@ typedef struct {
 EOS_VAR void EOS_STDCALL (*gtk_init)(int * argc,char *** argv);
 EOS_VAR void EOS_STDCALL (*gtk_main)();
 EOS_VAR unsigned int EOS_STDCALL (*gtk_idle_add)(int (*)(void *),void * data);
+EOS_VAR unsigned int EOS_STDCALL (*gtk_timeout_add)(unsigned int interval,int (*)(void *),void * data);
+EOS_VAR void EOS_STDCALL (*gtk_timeout_remove)(unsigned int id);
 EOS_VAR int EOS_STDCALL (*gtk_events_pending)();
 EOS_VAR int EOS_STDCALL (*gtk_main_iteration)();
 EOS_VAR void EOS_STDCALL (*gtk_main_quit)();
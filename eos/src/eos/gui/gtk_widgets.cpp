@@ -1585,11 +1585,13 @@ int EOS_STDCALL WindowGtk::DeleteEvent(GtkWidget * widget,GdkEvent * event,void
 
 //------------------------------------------------------------------------------
 AppGtk::AppGtk()
-:lastDir(0)
+:lastDir(0),timer(0),timerCB(null<Callback*>())
 {}
 
 AppGtk::~AppGtk()
 {
+ SetTimer(0,null<Callback*>());
+
  ds::List<Window*>::Cursor targ = mw.FrontPtr();
  while (!targ.Bad())
  {
@@ -1618,6 +1620,15 @@ void AppGtk::Die()
  gtk_main_quit();
 }
 
+void AppGtk::SetTimer(nat32 ms,Callback * cb)
+{
+ if (timer) gtk_timeout_remove(timer);
+ timer = 0;
+ delete timerCB;
+ timerCB = cb;
+ if (timerCB) timer = gtk_timeout_add(math::Max<nat32>(ms,1),&TimerEvent,timerCB);
+}
+
 void AppGtk::Attach(Window * win,bit show)
 {
  mw.AddBack(win);
@@ -1760,6 +1771,12 @@ int AppGtk::IdleEvent(void * data)
  return 0;
 }
 
+int AppGtk::TimerEvent(void * data)
+{
+ ((Callback*)data)->Call(null<Base*>(),null<Event*>());
+ return 1;
+}
+
 //------------------------------------------------------------------------------
 GtkFactory::GtkFactory(str::TokenTable & tokTab)
 :Factory(tokTab)
@@ -481,6 +481,7 @@ class EOS_CLASS AppGtk : public App
   void Go();
   void Go(Callback * cb);
   void Die();
+  void SetTimer(nat32 ms,Callback * cb);
 
   void Attach(Window * win,bit show);
   void Detach(Base * win);
@@ -496,8 +497,12 @@ class EOS_CLASS AppGtk : public App
  private:
   ds::List<Window*> mw;
   char * lastDir;
+  
+  unsigned int timer; // 0 if no timer.
+  Callback * timerCB;
 
   static int IdleEvent(void * data);
+  static int TimerEvent(void * data);
 };
 
 //------------------------------------------------------------------------------
@@ -712,6 +712,13 @@ class EOS_CLASS App : public Base
   /// Makes it exit the message loop, the first step of program termination ushally.
    virtual void Die() = 0;
 
+  /// Calls the given callback every ms milliseconds from within the message
+  /// pump, until replaced by another call. Takes ownership of the callback,
+  /// passing null stops the timer. There is only one timer, and it is stopped
+  /// when the App is deleted. Used to poll work happening in other threads, as
+  /// nothing else may touch the gui.
+   virtual void SetTimer(nat32 ms,Callback * cb) = 0;
+
 
   /// Adds a window to the application. If show is set to true it will make the
   /// window visible at the same time.
@@ -104,31 +104,9 @@ void IntegrateBP::Run(time::Progress * prog)
  LogDebug("eos::inf::IntegrateBP::Run");
  prog->Push();
 
- // Create and null the message passing data structure...
- // It also contains the input messages, so fill them in.
-  prog->Report(0,iters+2);
-  ds::ArrayDel< ds::Array<Node> > data(out.Height());
-  for (nat32 i=0;i<data.Size();i++) data[i].Size(out.Width());
-
-  for (nat32 y=0;y<out.Height();y++)
-  {
-   for (nat32 x=0;x<out.Width();x++)
-   {
-    // Expected value...
-     if (in[y][x].lock==false)
-     {
-      data[y][x].exp.InvCoVar() = math::Sqr(in[y][x].invSd);
-      data[y][x].exp.InvCoVarMean() = math::Sqr(in[y][x].invSd) * in[y][x].mean;
-     }
-
-    // Messages...
-     for (nat32 i=0;i<4;i++) data[y][x].msg[i] = math::Gauss1D();
-   }
-  }
-
-
  // Update the input so that all off-grid relationships are set to invSd==0,
  // best that such memory damaging messages are not sent...
+  prog->Report(0,iters+3);
   for (nat32 y=0;y<out.Height();y++)
   {
    in[y][0].rel[2].invSd = 0.0;
@@ -186,111 +164,108 @@ void IntegrateBP::Run(time::Progress * prog)
   }
 
 
- // Pass messages (With a checkboard pattern.)...
-  for (nat32 i=0;i<iters;i++)
+ // Create the message passing state, zeroed so the border never sends, and
+ // fill in the expected values and relationships...
+  State state;
+  state.stride = out.Width()+2;
+  nat32 nodes = state.stride*(out.Height()+2);
+
+  state.expIv.Size(nodes);
+  state.expIvMean.Size(nodes);
+  for (nat32 j=0;j<4;j++)
   {
-   prog->Report(2+i,iters+3);
-   for (nat32 y=0;y<out.Height();y++)
+   state.msgIv[j].Size(nodes);
+   state.msgIvMean[j].Size(nodes);
+   state.m[j].Size(nodes);
+   state.z[j].Size(nodes);
+   state.mult[j].Size(nodes);
+  }
+  state.lock.Size(nodes);
+  state.val.Size(nodes);
+
+  for (nat32 i=0;i<nodes;i++)
+  {
+   state.expIv[i] = 0.0;
+   state.expIvMean[i] = 0.0;
+   for (nat32 j=0;j<4;j++)
+   {
+    state.msgIv[j][i] = 0.0;
+    state.msgIvMean[j][i] = 0.0;
+    state.m[j][i] = 1.0;
+    state.z[j][i] = 0.0;
+    state.mult[j][i] = 0.0;
+   }
+   state.lock[i] = 0;
+   state.val[i] = 0.0;
+  }
+
+  for (nat32 y=0;y<out.Height();y++)
+  {
+   nat32 n = (y+1)*state.stride + 1;
+   for (nat32 x=0;x<out.Width();x++,n++)
    {
-    for (nat32 x=(i+y)%2;x<out.Width();x+=2)
+    const Pixel & pix = in[y][x];
+    if (pix.lock)
     {
-     if (in[y][x].lock)
-     {
-      // Message calculation is far easier for locked nodes, simply use the
-      // relationship to calculate the absolute value and then apply the invSd to
-      // get the message...
-       for (nat32 j=0;j<4;j++)
-       {
-        if (!math::IsZero(in[y][x].rel[j].invSd))
-        {
-         // Calculate message...
-          real32 invVar = math::Sqr(in[y][x].rel[j].invSd);
-          real32 val = in[y][x].mean*in[y][x].rel[j].ubM + in[y][x].rel[j].ubZ;
-
-          math::Gauss1D msg;
-          msg.InvCoVar() = invVar;
-          msg.InvCoVarMean() = invVar * val;
-
-         // Send message...
-          switch (j)
-          {
-           case 0: data[y][x+1].msg[2] = msg; break;
-           case 1: data[y+1][x].msg[3] = msg; break;
-           case 2: data[y][x-1].msg[0] = msg; break;
-           case 3: data[y-1][x].msg[1] = msg; break;
-          }
-        }
-       }
-     }
-     else
+     state.lock[n] = 1;
+     state.val[n] = pix.mean;
+    }
+    else
+    {
+     state.expIv[n] = math::Sqr(pix.invSd);
+     state.expIvMean[n] = math::Sqr(pix.invSd) * pix.mean;
+    }
+
+    // The unbiased relationship is only calculated when a message is sent...
+     for (nat32 j=0;j<4;j++)
      {
-      // Calculate the accumulator of messages, from which we can subtract to get
-      // the outputs...
-       math::Gauss1D acc = data[y][x].exp;
-       for (nat32 j=0;j<4;j++) acc *= data[y][x].msg[j];
-
-      // Pass messages...
-       for (nat32 j=0;j<4;j++)
-       {
-        if (!math::IsZero(in[y][x].rel[j].invSd))
-        {
-         // Remove the message from the direction we are sending from the
-         // expectation...
-          math::Gauss1D accSub = acc;
-          accSub /= data[y][x].msg[j];
-
-         // Combine the acc with the compatability distribution and marginalise
-         // to generate our output message...
-          math::Gauss2D msgExt(accSub);
-
-          real32 m = in[y][x].rel[j].ubM;
-          real32 z = in[y][x].rel[j].ubZ;
-          real32 mult = 0.5 * math::Sqr(in[y][x].rel[j].invSd);
-
-          math::Gauss2D co;
-          co.InvCoVar()[0][0] = mult * math::Sqr(m);
-          co.InvCoVar()[0][1] = -mult * m;
-          co.InvCoVar()[1][0] = -mult * m;
-          co.InvCoVar()[1][1] = mult;
-          co.InvCoVarMean()[1] = -mult * z * m;
-          co.InvCoVarMean()[0] =  mult * z;
-
-          msgExt *= co;
-          math::Gauss1D msg;
-          msgExt.Marg1(msg);
-
-         // Send message...
-          switch (j)
-          {
-           case 0: data[y][x+1].msg[2] = msg; break;
-           case 1: data[y+1][x].msg[3] = msg; break;
-           case 2: data[y][x-1].msg[0] = msg; break;
-           case 3: data[y-1][x].msg[1] = msg; break;
-          }
-        }
-       }
+      if (!math::IsZero(pix.rel[j].invSd))
+      {
+       state.m[j][n] = pix.rel[j].ubM;
+       state.z[j][n] = pix.rel[j].ubZ;
+       state.mult[j][n] = 0.5 * math::Sqr(pix.rel[j].invSd);
+      }
      }
-    }
    }
-   
+  }
+
+
+ // Pass messages (With a checkboard pattern.)...
+  IterJob job;
+  job.state = &state;
+  job.width = out.Width();
+  for (nat32 i=0;i<iters;i++)
+  {
+   prog->Report(2+i,iters+3);
+   job.iter = i;
+   if (out.Width()*out.Height()<serialSize)
+   {
+    for (nat32 y=0;y<out.Height();y++) job.Do(y,0);
+   }
+   else mt::SharedPool().Run(job,out.Height());
+
    // Zero mean if needed...
-    if ((zeroM!=0)&&(((i+1)%zeroM)==0)) WeightedZeroMean(data);
+    if ((zeroM!=0)&&(((i+1)%zeroM)==0)) WeightedZeroMean(state);
   }
-  
+
  // Once done zero mean again if needed...
-  if (zeroM!=0) WeightedZeroMean(data);
+  if (zeroM!=0) WeightedZeroMean(state);
 
 
  // Extract the results...
   prog->Report(2+iters,iters+3);
   for (nat32 y=0;y<out.Height();y++)
   {
-   for (nat32 x=0;x<out.Width();x++)
+   nat32 n = (y+1)*state.stride + 1;
+   for (nat32 x=0;x<out.Width();x++,n++)
    {
     if (!in[y][x].lock)
     {
-     out.Get(x,y) = data[y][x].exp;
-     for (nat32 i=0;i<4;i++) out.Get(x,y) *= data[y][x].msg[i];
+     math::Gauss1D & targ = out.Get(x,y);
+     targ.InvCoVar() = state.expIv[n] + state.msgIv[2][n+1] + state.msgIv[3][n+state.stride]
+                                      + state.msgIv[0][n-1] + state.msgIv[1][n-state.stride];
+     targ.InvCoVarMean() = state.expIvMean[n] + state.msgIvMean[2][n+1] + state.msgIvMean[3][n+state.stride]
+                                              + state.msgIvMean[0][n-1] + state.msgIvMean[1][n-state.stride];
     }
    }
   }
@@ -350,42 +325,110 @@ void IntegrateBP::GetDeviation(svt::Field<real32> & o) const
  }
 }
 
-void IntegrateBP::WeightedZeroMean(ds::ArrayDel< ds::Array<Node> > & data)
+void IntegrateBP::WeightedZeroMean(State & state)
 {
  // First calculate the mean, incrimentally - we (conveniantly) weight each by the inverse of variance...
   real32 mean = 0.0;
   real32 weight = 0.0;
-  
-  for (nat32 y=0;y<data.Size();y++)
+
+  for (nat32 y=0;y<out.Height();y++)
   {
-   for (nat32 x=0;x<data[0].Size();x++)
+   nat32 n = (y+1)*state.stride + 1;
+   for (nat32 x=0;x<out.Width();x++,n++)
    {
     if (!in[y][x].lock)
     {
-     math::Gauss1D est = data[y][x].exp;
-     for (nat32 i=0;i<4;i++) est *= data[y][x].msg[i];
-     
-     if (!math::IsZero(est.InvCoVar()))
+     real32 iv = state.expIv[n] + state.msgIv[2][n+1] + state.msgIv[3][n+state.stride]
+                                + state.msgIv[0][n-1] + state.msgIv[1][n-state.stride];
+     real32 ivMean = state.expIvMean[n] + state.msgIvMean[2][n+1] + state.msgIvMean[3][n+state.stride]
+                                        + state.msgIvMean[0][n-1] + state.msgIvMean[1][n-state.stride];
+
+     if (!math::IsZero(iv))
      {
-      weight += est.InvCoVar();
-      mean   += (est.InvCoVarMean() - mean*est.InvCoVar()) / weight;
+      weight += iv;
+      mean   += (ivMean - mean*iv) / weight;
      }
     }
    }
   }
 
 
- // Now offset everything by subtracting the calculated mean...
-  for (nat32 y=0;y<data.Size();y++)
+ // Now offset everything by subtracting the calculated mean - each message is
+ // stored once, by its sender, so this offsets every message exactly once...
+  nat32 nodes = state.expIv.Size();
+  for (nat32 i=0;i<nodes;i++)
   {
-   for (nat32 x=0;x<data[0].Size();x++)
+   state.expIvMean[i] -= mean * state.expIv[i];
+   for (nat32 j=0;j<4;j++) state.msgIvMean[j][i] -= mean * state.msgIv[j][i];
+  }
+}
+
+//------------------------------------------------------------------------------
+void IntegrateBP::IterJob::Do(nat32 y,nat32)
+{
+ // Get pointers to the planes, offset to the first node of the row to be
+ // updated, which are the nodes where x+y+iter is even...
+  nat32 stride = state->stride;
+  nat32 start = (y+1)*stride + 1 + ((iter+y)%2);
+
+  const real32 * expIv = state->expIv.Ptr() + start;
+  const real32 * expIvMean = state->expIvMean.Ptr() + start;
+  const byte * lock = state->lock.Ptr() + start;
+  const real32 * val = state->val.Ptr() + start;
+
+  real32 * msgIv[4];
+  real32 * msgIvMean[4];
+  const real32 * m[4];
+  const real32 * z[4];
+  const real32 * mult[4];
+  for (nat32 j=0;j<4;j++)
+  {
+   msgIv[j] = state->msgIv[j].Ptr() + start;
+   msgIvMean[j] = state->msgIvMean[j].Ptr() + start;
+   m[j] = state->m[j].Ptr() + start;
+   z[j] = state->z[j].Ptr() + start;
+   mult[j] = state->mult[j].Ptr() + start;
+  }
+
+ // The messages arriving at each node, from the neighbour in each direction,
+ // were sent by that neighbour in the opposite direction...
+  const real32 * inIv[4];
+  const real32 * inIvMean[4];
+  inIv[0] = msgIv[2] + 1;       inIvMean[0] = msgIvMean[2] + 1;
+  inIv[1] = msgIv[3] + stride;  inIvMean[1] = msgIvMean[3] + stride;
+  inIv[2] = msgIv[0] - 1;       inIvMean[2] = msgIvMean[0] - 1;
+  inIv[3] = msgIv[1] - stride;  inIvMean[3] = msgIvMean[1] - stride;
+
+ // Update the row - the message calculation is Gauss2D::Marg1 of the
+ // expanded accumulator, minus the message from the direction being sent in,
+ // multiplied by the compatability distribution, written out in full so the
+ // loop has no branches. Locked nodes instead send their value through the
+ // relationship, with its full inverse variance...
+  nat32 count = (width + 1 - ((iter+y)%2))/2;
+  for (nat32 i=0;i<count;i++)
+  {
+   nat32 n = 2*i;
+
+   real32 accIv = expIv[n] + inIv[0][n] + inIv[1][n] + inIv[2][n] + inIv[3][n];
+   real32 accIvMean = expIvMean[n] + inIvMean[0][n] + inIvMean[1][n] + inIvMean[2][n] + inIvMean[3][n];
+
+   for (nat32 j=0;j<4;j++)
    {
-    data[y][x].exp.InvCoVarMean() -= mean * data[y][x].exp.InvCoVar();
-   
-    for (nat32 i=0;i<4;i++)
-    {
-     data[y][x].msg[i].InvCoVarMean() -= mean * data[y][x].msg[i].InvCoVar();
-    }
+    real32 k = mult[j][n];
+    real32 km = k * m[j][n];
+
+    real32 iv00 = accIv - inIv[j][n] + km*m[j][n];
+    real32 ivMean0 = accIvMean - inIvMean[j][n] + k*z[j][n];
+    real32 div = math::IsZero(iv00) ? 0.0 : (1.0/iv00);
+
+    real32 outIv = k - km*km*div;
+    real32 outIvMean = km*(ivMean0*div - z[j][n]);
+
+    real32 lockIv = 2.0*k;
+    real32 lockIvMean = lockIv * (val[n]*m[j][n] + z[j][n]);
+
+    msgIv[j][n] = lock[n] ? lockIv : outIv;
+    msgIvMean[j][n] = lock[n] ? lockIvMean : outIvMean;
    }
   }
 }
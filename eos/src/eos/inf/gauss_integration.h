@@ -28,6 +28,7 @@
 #include "eos/math/gaussian_mix.h"
 #include "eos/ds/arrays2d.h"
 #include "eos/svt/field.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -52,6 +53,13 @@ namespace eos
 /// as well as standard deviations to indicate confidence.
 /// This is done with belief propagation using a checkerboard update pattern and a
 /// given number of message passing iterations.
+///
+/// The message passing state is held as a structure of arrays, a plane per
+/// value, so the update of each row runs over contiguous memory without
+/// branches and can be vectorised. Each iteration only updates the nodes of
+/// one colour, which only read messages sent by the other colour, so the rows
+/// are done in parallel on mt::SharedPool(), with results independent of the
+/// thread count.
 class EOS_CLASS IntegrateBP
 {
  public:
@@ -161,19 +169,45 @@ class EOS_CLASS IntegrateBP
    ds::ArrayDel< ds::Array<Pixel> > in; // [y][x]. Declared like this so it it allocatable for large inputs.
 
 
-  // Runtime...
-   struct Node
+  // Runtime, a plane per value, each (Width()+2)*(Height()+2) with a border of
+  // dead nodes all round that never send, so updates need no bounds checks...
+   struct State
    {
-    math::Gauss1D exp;
-    math::Gauss1D msg[4]; // Comming into the node, so exp*msg[0]*msg[1]*msg[2]*msg[3] is the output.
+    nat32 stride; // Width()+2, the offset from a node to the node below.
+
+    ds::Array<real32> expIv; // Expected value, as the Gauss1D components.
+    ds::Array<real32> expIvMean;
+
+    ds::Array<real32> msgIv[4]; // Message sent from each node in each direction, as the Gauss1D components.
+    ds::Array<real32> msgIvMean[4];
+
+    ds::Array<real32> m[4]; // Unbiased relationship in each direction.
+    ds::Array<real32> z[4];
+    ds::Array<real32> mult[4]; // Half the inverse variance of the relationship, 0 if no message is sent.
+
+    ds::Array<byte> lock; // 1 if locked, 0 otherwise.
+    ds::Array<real32> val; // Value of locked nodes.
    };
 
+  // Does an iteration for a row, updating the nodes of one colour...
+   class IterJob : public mt::Job
+   {
+    public:
+     State * state;
+     nat32 width;
+     nat32 iter;
+
+     void Do(nat32 y,nat32 thread);
+   };
+
+   static const nat32 serialSize = 4096; // Grids with fewer nodes than this are iterated without the thread pool.
+
 
   // Output...
    ds::Array2D<math::Gauss1D> out;
-   
-  // Helper method - zero means the runtime array, weighting by inverse variance...
-   void WeightedZeroMean(ds::ArrayDel< ds::Array<Node> > & data);
+
+  // Helper method - zero means the runtime state, weighting by inverse variance...
+   void WeightedZeroMean(State & state);
 };
 
 //------------------------------------------------------------------------------
@@ -22,6 +22,9 @@
 #include "eos/ds/sort_lists.h"
 #include "eos/mt/threads.h"
 #include "eos/mt/locks.h"
+#include "eos/mem/functions.h"
+#include "eos/math/functions.h"
+#include "eos/str/functions.h"
 
 #ifdef EOS_LINUX
  #include <execinfo.h>
@@ -36,6 +39,10 @@ namespace eos
 #ifdef EOS_LINUX
 void SignalEatter(int sig,siginfo_t * info,void * context)
 {
+ // Get everything logged so far written, and go synchronous, as we are about
+ // to die...
+  logger.Async(false);
+
  // Log the signal, special case a seg fault...
   switch (sig)
   {
@@ -98,6 +105,87 @@ struct Block
  real64 systemSum;
 };
 
+//------------------------------------------------------------------------------
+// The header at the start of every record, both whilst under construction and
+// in the rings. size and pad come first as only they are written for the
+// padding that skips the end of a ring...
+struct LogHeader
+{
+ nat32 size; // Bytes, including this header, a multiple of 8.
+ nat32 pad; // 1 if this is padding rather than a record.
+ nat64 milli; // time::MilliTime() of the entry.
+ nat32 seq; // Entry number.
+ nat32 thread; // mt::ThreadID() of the logging thread.
+ nat32 depth; // Block depth of the logging thread.
+ nat32 items; // Bytes of items following the header.
+};
+
+// The per-thread state, indexed by mt::ThreadIndex(). Only the owning thread
+// appends to the ring, and only whoever has the lock consumes from it...
+static const nat32 logRingSize = 64*1024; // Power of 2.
+static const nat32 logThreadMax = 256; // Threads with a higher index share a locked record.
+
+struct LogThread
+{
+ LogRecord rec;
+ byte * ring;
+ volatile nat32 head; // Bytes ever appended, wraps.
+ volatile nat32 tail; // Bytes ever consumed, wraps.
+ bit busy; // true whilst rec is in use, so nested entries go to the shared record.
+};
+
+static LogThread * logThread[logThreadMax]; // Never freed, as threads may outlive anything.
+static volatile nat32 logThreads = 0; // One more than the highest index in use.
+
+//------------------------------------------------------------------------------
+// The filtering rules...
+static const nat32 logRuleMax = 64;
+static const nat32 logRuleLength = 64;
+
+struct LogRule
+{
+ cstrchar category[logRuleLength];
+ nat32 length;
+ bit enable;
+};
+
+static LogRule logRule[logRuleMax];
+static volatile nat32 logRules = 0; // Only ever grows, bar FilterReset, so reading is lock free.
+static mt::OwnedLock logRuleLock; // For adding rules.
+
+// Returns true if an entry with the given description should be logged...
+static bit LogPass(cstrconst s)
+{
+ // Extract the category, empty if there is none...
+  nat32 len = 0;
+  if (s[0]=='[')
+  {
+   ++s;
+   while ((s[len]!=0)&&(s[len]!=']')) ++len;
+   if (s[len]!=']') len = 0;
+  }
+
+ // Find the longest matching rule, which must end at a . or the end...
+  nat32 rules = logRules;
+  mt::Barrier();
+  bit ret = true;
+  nat32 best = 0;
+  for (nat32 i=0;i<rules;i++)
+  {
+   const LogRule & targ = logRule[i];
+   if ((targ.length>len)||(targ.length<best)) continue;
+   if ((targ.length<len)&&(targ.length!=0)&&(s[targ.length]!='.')) continue;
+
+   nat32 j = 0;
+   while ((j<targ.length)&&(s[j]==targ.category[j])) ++j;
+   if (j!=targ.length) continue;
+
+   best = targ.length;
+   ret = targ.enable;
+  }
+ return ret;
+}
+
 //------------------------------------------------------------------------------
 // Helper class that defines all logging data...
 class EOS_CLASS LogStore
@@ -106,18 +194,118 @@ class EOS_CLASS LogStore
   nat32 startTime;
   nat32 lastTime;
   ds::SortList<Block> profile;
-  mt::OwnedLock logLock;
-  
+  mt::OwnedLock logLock; // For the output file, and consuming from the rings.
+
+  LogRecord shared; // For nested entries and threads without a slot.
+  mt::OwnedLock sharedLock;
+
+  bit async; // false to write entries in EndEntry.
+  volatile nat32 writerState; // 0 = not started, 1 = starting, 2 = running, 3 = stopped or failed.
+  volatile nat32 quit; // Set to 1 to stop the writer.
+  class LogWriter * writer;
+  volatile nat32 writerId; // mt::ThreadID() of the writer.
+
   LogStore()
+  :async(true),writerState(0),quit(0),writer(null<LogWriter*>()),writerId(0)
   {
    startTime = time::Time();
    lastTime = startTime;
   }  
 };
 
+//------------------------------------------------------------------------------
+// The background thread that drains the rings...
+class LogWriter : public mt::Thread
+{
+ public:
+  LogObj * self;
+  LogStore * ls;
+
+  void Execute()
+  {
+   ls->writerId = mt::ThreadID();
+   while (ls->quit==0)
+   {
+    mt::Sleep(10);
+    self->Flush();
+   }
+  }
+};
+
+//------------------------------------------------------------------------------
+// The block depth, per thread, indexed by mt::ThreadIndex() (Wrapping, as
+// the odd collision for a depth column is neither here nor there.)...
+static const nat32 logDepthSize = 256;
+static nat32 logDepth[logDepthSize];
+
+//------------------------------------------------------------------------------
+LogRecord::LogRecord()
+:data(null<byte*>()),size(0),cap(0),drop(false),owner(null<LogThread*>())
+{}
+
+LogRecord::~LogRecord()
+{
+ delete[] data;
+}
+
+nat32 LogRecord::Write(const void * in,nat32 bytes)
+{
+ if (drop) return bytes;
+ Reserve(1+sizeof(nat32)+bytes);
+ data[size] = tag_text;
+ mem::Copy(data+size+1,(const byte*)&bytes,sizeof(nat32));
+ mem::Copy(data+size+1+sizeof(nat32),(const byte*)in,bytes);
+ size += 1+sizeof(nat32)+bytes;
+ return bytes;
+}
+
+nat32 LogRecord::Pad(nat32 bytes)
+{
+ if (drop) return bytes;
+ Reserve(1+sizeof(nat32)+bytes);
+ data[size] = tag_text;
+ mem::Copy(data+size+1,(const byte*)&bytes,sizeof(nat32));
+ for (nat32 i=0;i<bytes;i++) data[size+1+sizeof(nat32)+i] = ' ';
+ size += 1+sizeof(nat32)+bytes;
+ return bytes;
+}
+
+void LogRecord::Put(byte tag,const void * v,nat32 bytes)
+{
+ if (drop) return;
+ Reserve(1+bytes);
+ data[size] = tag;
+ if (bytes!=0) mem::Copy(data+size+1,(const byte*)v,bytes);
+ size += 1+bytes;
+}
+
+void LogRecord::Reserve(nat32 bytes)
+{
+ if (size+bytes<=cap) return;
+ nat32 nc = math::Max<nat32>(cap*2,256);
+ while (nc<size+bytes) nc *= 2;
+ byte * nd = new byte[nc];
+ if (size!=0) mem::Copy(nd,data,size);
+ delete[] data;
+ data = nd;
+ cap = nc;
+}
+
+void LogRecord::PutText(cstrconst s)
+{
+ // The first item is the description - check its category...
+  if ((size==sizeof(LogHeader))&&(logRules!=0)&&(!LogPass(s)))
+  {
+   drop = true;
+   return;
+  }
+
+ Write(s,str::Length(s));
+}
+
 //------------------------------------------------------------------------------
 LogObj::LogObj()
-:n(0),depth(0),
+:n(1), // 0 is the begin line.
 out(null<file::Csv*>()),
 ls(new LogStore())
 {
@@ -137,6 +325,9 @@ ls(new LogStore())
 
 LogObj::~LogObj()
 {
+ // Stop the writer and write out anything still in the rings...
+  Async(false);
+
  // If logging has happened add in the closing line and close the file...
   if (out)
   {
@@ -197,60 +388,156 @@ LogObj::~LogObj()
   delete ls;
 }
 
-file::Csv & LogObj::BeginEntry()
+LogRecord & LogObj::BeginEntry()
 {
- nat32 now = time::Time();
- nat32 milli = nat32(time::MilliTime()%1000);
- ls->logLock.Lock();
+ // Get the calling threads record, creating its state if need be - nested
+ // entries and threads without a slot use the shared record...
+  LogRecord * rec;
+  nat32 ind = mt::ThreadIndex();
+  LogThread * lt = (ind<logThreadMax)?logThread[ind]:null<LogThread*>();
+  if ((lt==null<LogThread*>())&&(ind<logThreadMax))
+  {
+   lt = new LogThread();
+   lt->ring = new byte[logRingSize];
+   lt->head = 0;
+   lt->tail = 0;
+   lt->busy = false;
+   lt->rec.owner = lt;
+   mt::Barrier();
+   logThread[ind] = lt;
 
- // Check for no logging having actually occured upto this point, i.e. no file is open...
-  if (out==null<file::Csv*>())
+   while (true)
+   {
+    nat32 threads = logThreads;
+    if ((threads>ind)||mt::AtomicSet(logThreads,threads,ind+1)) break;
+   }
+  }
+
+  if ((lt!=null<LogThread*>())&&(!lt->busy))
   {
-   // No logging has yet occured - we must open the output file and log the start of the program.
-   // (It allready happened, quite possibly hours ago.)
-    time::Date startTime(false,ls->startTime);
-    CreateFile(&startTime);
+   lt->busy = true;
+   rec = &lt->rec;
+  }
+  else
+  {
+   ls->sharedLock.Lock();
+   rec = &ls->shared;
+  }
 
-    *out << n << file::EndField()
-         << startTime.Str("Y-m-d H:i:s ") << milli << file::EndField()
-         << "-" << file::EndField()
-         << "0" << file::EndField() // 0 rather than depth incase the first logging is done by a block logger.
-         << "[exe] Begin" << file::EndRow();
+ // Write the standard header information, the items following...
+  rec->size = 0;
+  rec->drop = false;
+  rec->Reserve(sizeof(LogHeader));
+  rec->size = sizeof(LogHeader);
 
-    ++n;
-    ls->lastTime = now;
+  LogHeader & head = *(LogHeader*)rec->data;
+  head.pad = 0;
+  head.milli = time::MilliTime();
+  head.thread = mt::ThreadID();
+  head.depth = logDepth[ind%logDepthSize];
+
+ return *rec;
+}
+
+void LogObj::EndEntry(LogRecord & rec)
+{
+ // Finish the header, padding to keep the next record in a ring aligned...
+  bit drop = rec.drop;
+  if (!drop)
+  {
+   rec.Reserve(7);
+   LogHeader & head = *(LogHeader*)rec.data;
+   head.items = rec.size - sizeof(LogHeader);
+   rec.size = (rec.size+7) & (~nat32(7));
+   head.size = rec.size;
   }
- 
- // Check if we have changed date since the last call, if so open a new file...
-  time::Date lastTime(false,ls->lastTime);
-  time::Date nowTime(false,now);
- 
-  if (lastTime.day!=nowTime.day)
+
+ // The shared record, and synchronous logging, are written straight out...
+  LogThread * lt = rec.owner;
+  if ((lt==null<LogThread*>())||(!ls->async)||(rec.size>logRingSize/4))
   {
-   delete out;
-   CreateFile(&nowTime);
+   if (!drop)
+   {
+    ls->logLock.Lock();
+     Drain(); // So all entries before this one are written first.
+     ((LogHeader*)rec.data)->seq = mt::AtomicAdd(n,1);
+     Format(rec.data);
+     out->Flush();
+    ls->logLock.Unlock();
+   }
+
+   if (lt) lt->busy = false;
+      else ls->sharedLock.Unlock();
+   return;
   }
 
- // Write the standard header log information...
-  *out << n << file::EndField()
-       << nowTime.Str("Y-m-d H:i:s ") << milli << file::EndField()
-       << mt::ThreadID() << file::EndField()
-       << depth << file::EndField();
+ // Append to the ring, draining if its full...
+  if (!drop)
+  {
+   if (ls->writerState==0) StartWriter();
 
-  ++n;
-  ls->lastTime = now;
+   // Make space, by draining all the rings ourselves if need be...
+    nat32 at = lt->head & (logRingSize-1);
+    nat32 need = rec.size;
+    if (at+rec.size>logRingSize) need += logRingSize - at;
+
+    if (logRingSize-(lt->head-lt->tail)<need)
+    {
+     ls->logLock.Lock();
+      Drain();
+     ls->logLock.Unlock();
+    }
+
+   // Skip the end of the ring if the record does not fit before it...
+    if (at+rec.size>logRingSize)
+    {
+     LogHeader * pad = (LogHeader*)(lt->ring + at); // Only size and pad fit for certain.
+     pad->size = logRingSize - at;
+     pad->pad = 1;
+     mt::Barrier();
+     lt->head += logRingSize - at;
+     at = 0;
+    }
+
+   // The entry number is taken last, so entries reach the rings close to in
+   // order, and the merge in Drain rarely sees one arrive late...
+    ((LogHeader*)rec.data)->seq = mt::AtomicAdd(n,1);
+    mem::Copy(lt->ring + at,rec.data,rec.size);
+    mt::Barrier();
+    lt->head += rec.size;
+  }
 
- // Return the Csv object so the user can add there stuff...
-  return *out; 
+ lt->busy = false;
 }
 
-void LogObj::EndEntry()
+void LogObj::Flush()
 {
- (*out) << file::EndRow();
- out->Flush();
+ ls->logLock.Lock();
+  Drain();
+  if (out) out->Flush();
  ls->logLock.Unlock();
 }
 
+void LogObj::Async(bit enable)
+{
+ if (enable)
+ {
+  ls->async = true;
+  if (ls->writerState==3) ls->writerState = 0;
+ }
+ else
+ {
+  ls->async = false;
+  StopWriter();
+  Flush();
+ }
+}
+
+nat32 & LogObj::Depth()
+{
+ return logDepth[mt::ThreadIndex()%logDepthSize];
+}
+
 void LogObj::StoreBlock(cstrconst name,real64 real,real64 user,real64 system)
 {
  Block dummy;
@@ -273,6 +560,224 @@ void LogObj::StoreBlock(cstrconst name,real64 real,real64 user,real64 system)
  }
 }
 
+void LogObj::StartWriter()
+{
+ if (!mt::AtomicSet(ls->writerState,0,1)) return;
+
+ ls->quit = 0;
+ ls->writer = new LogWriter();
+ ls->writer->self = this;
+ ls->writer->ls = ls;
+ if (ls->writer->Run()) ls->writerState = 2;
+ else
+ {
+  // Fall back to synchronous logging...
+   delete ls->writer;
+   ls->writer = null<LogWriter*>();
+   ls->async = false;
+   ls->writerState = 3;
+ }
+}
+
+void LogObj::StopWriter()
+{
+ // Its possible this is the writer thread, if it crashed, in which case it
+ // can not wait for itself...
+  if (ls->writerState!=2) return;
+  ls->writerState = 3;
+  ls->quit = 1;
+  if (mt::ThreadID()!=ls->writerId)
+  {
+   ls->writer->Wait();
+   delete ls->writer;
+  }
+  ls->writer = null<LogWriter*>();
+}
+
+void LogObj::Drain()
+{
+ // Note where each ring ends, so records appended whilst draining are left
+ // for next time...
+  nat32 threads = logThreads;
+  nat32 pos[logThreadMax];
+  nat32 end[logThreadMax];
+  for (nat32 i=0;i<threads;i++)
+  {
+   LogThread * lt = logThread[i];
+   if (lt)
+   {
+    end[i] = lt->head;
+    pos[i] = lt->tail;
+   }
+   else
+   {
+    end[i] = 0;
+    pos[i] = 0;
+   }
+  }
+  mt::Barrier();
+
+ // Merge the rings by entry number, each being in order allready...
+  bit any = false;
+  while (true)
+  {
+   const LogHeader * best = null<const LogHeader*>();
+   nat32 bestInd = 0;
+   for (nat32 i=0;i<threads;i++)
+   {
+    while (pos[i]!=end[i])
+    {
+     const LogHeader * head = (const LogHeader*)(logThread[i]->ring + (pos[i]&(logRingSize-1)));
+     if (head->pad==0)
+     {
+      if ((best==null<const LogHeader*>())||(int32(head->seq-best->seq)<0))
+      {
+       best = head;
+       bestInd = i;
+      }
+      break;
+     }
+     pos[i] += head->size;
+    }
+   }
+   if (best==null<const LogHeader*>()) break;
+
+   Format((const byte*)best);
+   pos[bestInd] += best->size;
+   any = true;
+  }
+
+ // Hand the space back...
+  mt::Barrier();
+  for (nat32 i=0;i<threads;i++)
+  {
+   if (logThread[i]) logThread[i]->tail = end[i];
+  }
+  if (any) out->Flush();
+}
+
+void LogObj::Format(const byte * rec)
+{
+ const LogHeader & head = *(const LogHeader*)rec;
+ nat32 now = nat32(head.milli/1000);
+ nat32 milli = nat32(head.milli%1000);
+
+ // Check for no logging having actually occured upto this point, i.e. no file is open...
+  if (out==null<file::Csv*>())
+  {
+   // No logging has yet occured - we must open the output file and log the start of the program.
+   // (It allready happened, quite possibly hours ago.)
+    time::Date startTime(false,ls->startTime);
+    CreateFile(&startTime);
+
+    *out << 0 << file::EndField()
+         << startTime.Str("Y-m-d H:i:s ") << milli << file::EndField()
+         << "-" << file::EndField()
+         << "0" << file::EndField() // 0 rather than depth incase the first logging is done by a block logger.
+         << "[exe] Begin" << file::EndRow();
+
+    ls->lastTime = now;
+  }
+
+ // Check if we have changed date since the last entry, if so open a new file...
+  time::Date lastTime(false,ls->lastTime);
+  time::Date nowTime(false,now);
+
+  if (lastTime.day!=nowTime.day)
+  {
+   delete out;
+   CreateFile(&nowTime);
+  }
+
+ // Write the standard header log information...
+  *out << head.seq << file::EndField()
+       << nowTime.Str("Y-m-d H:i:s ") << milli << file::EndField()
+       << head.thread << file::EndField()
+       << head.depth << file::EndField();
+
+ // Write the items...
+  const byte * targ = rec + sizeof(LogHeader);
+  const byte * targEnd = targ + head.items;
+  while (targ<targEnd)
+  {
+   byte tag = *targ;
+   ++targ;
+   switch (tag)
+   {
+    case LogRecord::tag_text:
+    {
+     nat32 len;
+     mem::Copy((byte*)&len,targ,sizeof(nat32));
+     out->Write(targ+sizeof(nat32),len);
+     targ += sizeof(nat32) + len;
+    }
+    break;
+    case LogRecord::tag_bit:
+    {
+     bit v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_int32:
+    {
+     int32 v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_nat32:
+    {
+     nat32 v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_int64:
+    {
+     int64 v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_nat64:
+    {
+     nat64 v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_real32:
+    {
+     real32 v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_real64:
+    {
+     real64 v;
+     mem::Copy((byte*)&v,targ,sizeof(v));
+     *out << v;
+     targ += sizeof(v);
+    }
+    break;
+    case LogRecord::tag_div:
+     out->FieldEnd();
+    break;
+   }
+  }
+
+  *out << file::EndRow();
+  ls->lastTime = now;
+}
+
 void LogObj::CreateFile(time::Date * d)
 {
  /*file::Dir dir(file::WorkDir);
@@ -325,9 +830,48 @@ BlockLogger::~BlockLogger()
  logger.Depth() -= 1;
 }
 
+//------------------------------------------------------------------------------
+EOS_FUNC void Filter(cstrconst category,bit enable)
+{
+ nat32 len = str::Length(category);
+ if (len>=logRuleLength) return;
+
+ logRuleLock.Lock();
+  // Replace the rule if it exists...
+   nat32 rules = logRules;
+   for (nat32 i=0;i<rules;i++)
+   {
+    if (str::Compare(logRule[i].category,category)==0)
+    {
+     logRule[i].enable = enable;
+     logRuleLock.Unlock();
+     return;
+    }
+   }
+
+  // Otherwise add it, publishing only once filled in...
+   if (rules<logRuleMax)
+   {
+    str::Copy(logRule[rules].category,category);
+    logRule[rules].length = len;
+    logRule[rules].enable = enable;
+    mt::Barrier();
+    logRules = rules+1;
+   }
+ logRuleLock.Unlock();
+}
+
+EOS_FUNC void FilterReset()
+{
+ logRuleLock.Lock();
+  logRules = 0;
+ logRuleLock.Unlock();
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC void AssertFailure(cstrconst error)
 {
+ logger.Async(false);
  LogLog("[exe] Assert failed {error msg}" << LogDiv() << error);
 
  #ifdef EOS_LINUX
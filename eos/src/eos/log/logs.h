@@ -27,6 +27,7 @@
 /// modules in the system.
 
 #include "eos/types.h"
+#include "eos/time/profiler.h"
 
 namespace eos
 {
@@ -38,6 +39,10 @@ namespace eos
  {
   class Date;
  }
+ namespace io
+ {
+  struct Text;
+ }
  
  struct LogDivObject {};
  
@@ -50,11 +55,92 @@ namespace eos
  namespace log
  {
 //------------------------------------------------------------------------------
-// The logging singlton, acts as a lockable cvs file that creates itself on
-// first use, is flushed on unlock and records a whole host of default
-// information (id, date/time, thread id, depth). Changes log file when the date
-// changes, so you get a log file for each day, created in the log directory it
-// automatically creates in the working directory.
+// Helper for LogRecord, delays naming io::Text till a template is
+// instantiated, as the io headers can not be included here...
+template <typename T>
+struct LogEncode
+{
+ typedef io::Text Type;
+};
+
+//------------------------------------------------------------------------------
+// A log entry under construction, what the LogLog macros stream into. Strings
+// and the basic numeric types are stored raw, in a binary record, to be
+// formatted later by the writer thread - anything else is formatted to text
+// immediatly, via the usual io StreamWrite functions, so the io headers must be
+// included where such types are logged. (As they allways have been, for the
+// Csv this used to be.) Strings are copied, so need not be constant. If the
+// first string has a [a.b.c] category that has been filtered out the record is
+// dropped, and everything after it ignored.
+class EOS_CLASS LogRecord
+{
+ public:
+  LogRecord();
+  ~LogRecord();
+
+
+  // The types stored raw...
+   LogRecord & operator << (cstrconst rhs) {if (!drop) PutText(rhs); return *this;}
+   LogRecord & operator << (cstr rhs) {if (!drop) PutText(rhs); return *this;}
+   LogRecord & operator << (bit rhs) {Put(tag_bit,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (int32 rhs) {Put(tag_int32,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (nat32 rhs) {Put(tag_nat32,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (int64 rhs) {Put(tag_int64,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (nat64 rhs) {Put(tag_nat64,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (real32 rhs) {Put(tag_real32,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (real64 rhs) {Put(tag_real64,&rhs,sizeof(rhs)); return *this;}
+   LogRecord & operator << (const LogDivObject &) {Put(tag_div,null<void*>(),0); return *this;}
+
+  // Everything else, converted to text now...
+   template <typename T>
+   LogRecord & operator << (const T & rhs)
+   {
+    if (!drop) StreamWrite(*this,rhs,typename LogEncode<T>::Type());
+    return *this;
+   }
+
+
+  // For the io StreamWrite functions...
+   nat32 Write(const void * in,nat32 bytes);
+   nat32 Pad(nat32 bytes);
+   void FieldEnd() {Put(tag_div,null<void*>(),0);}
+   void SetError(bit) {}
+   bit Error() const {return false;}
+
+
+  // The item tags of the binary record, each item being a tag byte followed
+  // by the raw value, or for text a nat32 length then the characters...
+   enum {tag_text,tag_bit,tag_int32,tag_nat32,tag_int64,tag_nat64,tag_real32,tag_real64,tag_div};
+
+  // The record - a header followed by the items...
+   byte * data;
+   nat32 size;
+   nat32 cap;
+   bit drop; // true if filtered out.
+   struct LogThread * owner; // Thread the record belongs to, null for the shared one.
+
+  // Makes sure there is space for another so many bytes...
+   void Reserve(nat32 bytes);
+
+
+ private:
+  void Put(byte tag,const void * v,nat32 bytes);
+  void PutText(cstrconst s);
+};
+
+//------------------------------------------------------------------------------
+// The logging singlton, records a whole host of default information (id,
+// date/time, thread id, depth) with each entry and writes them to a csv file it
+// creates on first use. Changes log file when the date changes, so you get a
+// log file for each day, created in the working directory.
+//
+// Entries are built by each thread into its own record and then appended to a
+// ring buffer owned by that thread, without locking; a background thread,
+// started on first use, periodically drains all the rings, merging by entry
+// number, and does the formatting and writing. A thread that fills its ring
+// drains them itself. Entries from signal handlers and assertion failures are
+// written immediatly, after everything before them, as the program is about to
+// die. Async(false) makes all logging synchronous, as it used to be.
 class EOS_CLASS LogObj
 {
  public:
@@ -62,11 +148,19 @@ class EOS_CLASS LogObj
   ~LogObj();
    
   
-  // Returns a log file to stream to, adds all the default stuff.
-   file::Csv & BeginEntry();
+  // Returns a record to stream to, with all the default stuff filled in.
+   LogRecord & BeginEntry();
    
-  // Call when logging is finsihed. Do not forget, as there is locking.
-   void EndEntry();
+  // Call with the record when streaming to it is finished, hands it over to
+  // be written. Do not forget, as there can be locking.
+   void EndEntry(LogRecord & rec);
+
+  // Writes everything logged so far, by any thread, before returning.
+   void Flush();
+
+  // Switches the background writer on, the default, or off, in which case
+  // every entry is written before EndEntry returns. Switching off flushes.
+   void Async(bit enable);
    
   // Adds some profiling information. Note that we use the pointer to 
   // the string as an index, not the index itself. We can get away with 
@@ -74,18 +168,21 @@ class EOS_CLASS LogObj
   // have a constant unique pointer.
    void StoreBlock(cstrconst name,real64 real,real64 user,real64 system); 
    
-  // For access.
-   nat32 & Depth() {return depth;}
+  // For access - the depth is per thread.
+   nat32 & Depth();
 
 
  private:
-  nat32 n; // Log entry number. Blah.
-  nat32 depth;
+  volatile nat32 n; // Log entry number, handed out atomically. Blah.
   class file::Csv * out; // Current output file. Ushally null.
   class LogStore * ls; // Has to be declared like this to avoid circular dependency problems.
 
   // Helpers...
    void CreateFile(time::Date * d);
+   void Drain(); // Writes out the contents of the rings, must have the lock.
+   void Format(const byte * rec); // Writes a record, must have the lock.
+   void StartWriter();
+   void StopWriter();
 };
 
 //------------------------------------------------------------------------------
@@ -153,6 +250,8 @@ class EOS_CLASS BlockLogger
 /// As a useful little trick a global depth parameter is maintained for each
 /// thread, its incrimented with each LogBlock entry and decrimented with each
 /// exit, and recorded with each log entry.
+/// Regardless of EOS_LOG_BLOCKS it also opens a span in the profiler, see
+/// time/profiler.h, which costs nothing much unless the profiler is on.
 ///
 /// Traditional usage is to log a function, by example:
 /// LogBlock("Function(nat32 x,nat32 y)",x << log::Div() << y);
@@ -161,10 +260,11 @@ class EOS_CLASS BlockLogger
 /// This is identical to LogBlock(n,p), except it does not log entry/exit of each block.
 /// This is more conveniant for profiling purposes where a log entry for each call 
 /// is too major a slow down/memory hog/profiling distorter.
+/// Likewise always opens a profiler span.
 
 //------------------------------------------------------------------------------
 
-#define LogLog(x) {eos::log::logger.BeginEntry() << x; eos::log::logger.EndEntry();}
+#define LogLog(x) {eos::log::LogRecord & eosLogRecord = eos::log::logger.BeginEntry(); eosLogRecord << x; eos::log::logger.EndEntry(eosLogRecord);}
 
 #define LogAlways(x) LogLog(x)
 #define LogError(x) LogLog(x)
@@ -182,13 +282,27 @@ class EOS_CLASS BlockLogger
 #endif
 
 #ifdef EOS_LOG_BLOCKS
- #define LogBlock(n,p) eos::log::logger.Depth() += 1; LogLog("[block] Begin {name,details}" << LogDiv() << n << LogDiv() << p); eos::log::BlockLogger eosLogBlockLoggerInstance(n,true)
- #define LogTime(n) eos::log::logger.Depth() += 1; eos::log::BlockLogger eosLogBlockLoggerInstance(n,false)
+ #define LogBlock(n,p) eos::time::ProfileSpan eosProfileSpanInstance(n); eos::log::logger.Depth() += 1; LogLog("[block] Begin {name,details}" << LogDiv() << n << LogDiv() << p); eos::log::BlockLogger eosLogBlockLoggerInstance(n,true)
+ #define LogTime(n) eos::time::ProfileSpan eosProfileSpanInstance(n); eos::log::logger.Depth() += 1; eos::log::BlockLogger eosLogBlockLoggerInstance(n,false)
 #else
- #define LogBlock(n,p)
- #define LogTime(n)
+ #define LogBlock(n,p) eos::time::ProfileSpan eosProfileSpanInstance(n)
+ #define LogTime(n) eos::time::ProfileSpan eosProfileSpanInstance(n)
 #endif
 
+//------------------------------------------------------------------------------
+/// Filters log entries by the [a.b.c] category at the start of there
+/// description - entries in the given category, or any category below it, are
+/// dropped if enable is false, or kept if true, with the rule for the longest
+/// matching category winning. The category "" matches everything, so
+/// Filter("",false) followed by enabling a few categories logs only those.
+/// Entries without a category are only matched by "". Filtered entries are
+/// dropped as soon as there description is streamed, so cost next to nothing.
+/// Up to 64 rules, setting a category again replaces its rule.
+EOS_FUNC void Filter(cstrconst category,bit enable);
+
+/// Removes all filtering rules, so everything is logged.
+EOS_FUNC void FilterReset();
+
 //------------------------------------------------------------------------------
 EOS_FUNC void AssertFailure(cstrconst error);
 
@@ -0,0 +1,280 @@
+#ifndef EOS_MATH_BATCH_H
+#define EOS_MATH_BATCH_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+
+/// \file batch.h
+/// Provides batched solvers for very large numbers of small, independent,
+/// linear systems, as happen in per-pixel fitting and triangulation.
+
+#include "eos/types.h"
+#include "eos/ds/arrays.h"
+#include "eos/math/mat_ops.h"
+#include "eos/mt/pool.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+/// A batch of NxN linear systems, Ax = b, each of which can be solved or
+/// inverted. Storage is a structure of arrays, i.e. each matrix entry is
+/// stored for all systems contiguously, so the symmetric positive definite
+/// solver can run its inner loops across systems, which the compiler can
+/// vectorise, rather than across the tiny dimensions of a single system.
+/// Work is split into blocks of systems and run on a thread pool.
+///
+/// Usage: Set the size, fill in A and b for each system, call a solver, read
+/// the answers out of b and check Ok for each.
+template <nat32 N,typename T = real64>
+class EOS_CLASS Batch
+{
+ public:
+  /// &nbsp;
+   Batch(nat32 sz = 0)
+   :size(0)
+   {
+    SetSize(sz);
+   }
+
+  /// &nbsp;
+   ~Batch() {}
+
+
+  /// Sets how many systems there are, all contents become random.
+   void SetSize(nat32 sz)
+   {
+    size = sz;
+    a.Size(N*N*size);
+    b.Size(N*size);
+    diag.Size(N*size);
+    ok.Size(size);
+   }
+
+  /// &nbsp;
+   nat32 Size() const {return size;}
+
+
+  /// Returns a reference to an entry of the A matrix of system i.
+   T & A(nat32 i,nat32 r,nat32 c) {return a.Ptr()[(r*N+c)*size + i];}
+
+  /// Returns a reference to an entry of the b vector of system i. After
+  /// solving this is the corresponding entry of x.
+   T & B(nat32 i,nat32 r) {return b.Ptr()[r*size + i];}
+
+  /// Returns true if the last solve succeeded for system i, false if the
+  /// system was singular or, for SolveSpd, not positive definite.
+   bit Ok(nat32 i) const {return ok[i];}
+
+
+  /// Sets the A matrix of system i.
+   void SetA(nat32 i,const Mat<N,N,T> & m)
+   {
+    for (nat32 r=0;r<N;r++)
+    {
+     for (nat32 c=0;c<N;c++) A(i,r,c) = m[r][c];
+    }
+   }
+
+  /// Gets the A matrix of system i.
+   void GetA(nat32 i,Mat<N,N,T> & m)
+   {
+    for (nat32 r=0;r<N;r++)
+    {
+     for (nat32 c=0;c<N;c++) m[r][c] = A(i,r,c);
+    }
+   }
+
+  /// Sets the b vector of system i.
+   void SetB(nat32 i,const Vect<N,T> & v)
+   {
+    for (nat32 r=0;r<N;r++) B(i,r) = v[r];
+   }
+
+  /// Gets the b vector of system i, which is x after a solve.
+   void GetB(nat32 i,Vect<N,T> & v)
+   {
+    for (nat32 r=0;r<N;r++) v[r] = B(i,r);
+   }
+
+
+  /// Solves every system, assuming they are symmetric positive definite, as
+  /// for normal equations. Uses the Cholesky decomposition, only the lower
+  /// triangle of A is used, and A is trashed. The fastest option.
+   void SolveSpd(mt::Pool & pool = mt::SharedPool())
+   {
+    BatchJob job(this,BatchJob::spd);
+    pool.Run(job,(size+block-1)/block);
+   }
+
+  /// Solves every system, for any invertable A. Uses the closed form inverses
+  /// for sizes 2 to 4, Gauss-Jordan elimination otherwise. A is trashed.
+   void Solve(mt::Pool & pool = mt::SharedPool())
+   {
+    BatchJob job(this,BatchJob::solve);
+    pool.Run(job,(size+block-1)/block);
+   }
+
+  /// Replaces every A with its inverse, b is not used.
+   void Invert(mt::Pool & pool = mt::SharedPool())
+   {
+    BatchJob job(this,BatchJob::invert);
+    pool.Run(job,(size+block-1)/block);
+   }
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Batch<N,T>";}
+
+
+ private:
+  static const nat32 block = 256; // Systems per unit of work.
+
+  nat32 size;
+  ds::Array<T> a; // N*N arrays of size entrys.
+  ds::Array<T> b; // N arrays of size entrys.
+  ds::Array<T> diag; // Reciprocals of the Cholesky diagonal, as b.
+  ds::Array<bit> ok;
+
+  class BatchJob : public mt::Job
+  {
+   public:
+    enum Mode {spd,solve,invert};
+
+    BatchJob(Batch<N,T> * s,Mode m):self(s),mode(m) {}
+
+    void Do(nat32 unit,nat32)
+    {
+     nat32 start = unit*block;
+     nat32 end = math::Min(start+block,self->size);
+     switch (mode)
+     {
+      case spd: self->DoSpd(start,end); break;
+      case solve: self->DoSolve(start,end,true); break;
+      case invert: self->DoSolve(start,end,false); break;
+     }
+    }
+
+   private:
+    Batch<N,T> * self;
+    Mode mode;
+  };
+
+  // Cholesky factorisation and solve of the systems [start,end), with the
+  // system index as the innermost loop throughout...
+   void DoSpd(nat32 start,nat32 end)
+   {
+    T * ap = a.Ptr();
+    T * bp = b.Ptr();
+    T * dp = diag.Ptr();
+    bit * okp = ok.Ptr();
+
+    for (nat32 i=start;i<end;i++) okp[i] = true;
+
+    // Factorise, A = G G^T, with G in the lower triangle...
+     for (nat32 j=0;j<N;j++)
+     {
+      T * ajj = ap + (j*N+j)*size;
+      T * dj = dp + j*size;
+      for (nat32 k=0;k<j;k++)
+      {
+       const T * ajk = ap + (j*N+k)*size;
+       for (nat32 i=start;i<end;i++) ajj[i] -= ajk[i]*ajk[i];
+      }
+
+      for (nat32 i=start;i<end;i++)
+      {
+       bit pos = ajj[i]>static_cast<T>(0);
+       okp[i] = okp[i] && pos;
+       ajj[i] = pos?math::Sqrt(ajj[i]):static_cast<T>(1);
+       dj[i] = static_cast<T>(1)/ajj[i];
+      }
+
+      for (nat32 r=j+1;r<N;r++)
+      {
+       T * arj = ap + (r*N+j)*size;
+       for (nat32 k=0;k<j;k++)
+       {
+        const T * ark = ap + (r*N+k)*size;
+        const T * ajk = ap + (j*N+k)*size;
+        for (nat32 i=start;i<end;i++) arj[i] -= ark[i]*ajk[i];
+       }
+       for (nat32 i=start;i<end;i++) arj[i] *= dj[i];
+      }
+     }
+
+    // Forward substitution, G y = b...
+     for (nat32 r=0;r<N;r++)
+     {
+      T * br = bp + r*size;
+      for (nat32 k=0;k<r;k++)
+      {
+       const T * ark = ap + (r*N+k)*size;
+       const T * bk = bp + k*size;
+       for (nat32 i=start;i<end;i++) br[i] -= ark[i]*bk[i];
+      }
+      const T * dr = dp + r*size;
+      for (nat32 i=start;i<end;i++) br[i] *= dr[i];
+     }
+
+    // Back substitution, G^T x = y...
+     for (int32 r=N-1;r>=0;r--)
+     {
+      T * br = bp + r*size;
+      for (nat32 k=r+1;k<N;k++)
+      {
+       const T * akr = ap + (k*N+r)*size;
+       const T * bk = bp + k*size;
+       for (nat32 i=start;i<end;i++) br[i] -= akr[i]*bk[i];
+      }
+      const T * dr = dp + r*size;
+      for (nat32 i=start;i<end;i++) br[i] *= dr[i];
+     }
+   }
+
+  // General solve or inversion of the systems [start,end), one system at a
+  // time using the fixed size inverse...
+   void DoSolve(nat32 start,nat32 end,bit useB)
+   {
+    Mat<N,N,T> m;
+    Mat<N,N,T> temp;
+    Vect<N,T> v;
+    Vect<N,T> x;
+    for (nat32 i=start;i<end;i++)
+    {
+     GetA(i,m);
+     ok[i] = Inverse(m,temp);
+     if (useB)
+     {
+      if (ok[i])
+      {
+       GetB(i,v);
+       MultVect(m,v,x);
+       SetB(i,x);
+      }
+     }
+     else SetA(i,m);
+    }
+   }
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -27,6 +27,59 @@ namespace eos
 Distance::~Distance()
 {}
 
+//------------------------------------------------------------------------------
+EOS_FUNC real32 SqrEuclidean(nat32 d,const real32 * pa,const real32 * pb)
+{
+ real32 acc[4] = {0.0,0.0,0.0,0.0};
+ nat32 i = 0;
+ for (;i+4<=d;i+=4)
+ {
+  real32 d0 = pa[i]   - pb[i];
+  real32 d1 = pa[i+1] - pb[i+1];
+  real32 d2 = pa[i+2] - pb[i+2];
+  real32 d3 = pa[i+3] - pb[i+3];
+  acc[0] += d0*d0;
+  acc[1] += d1*d1;
+  acc[2] += d2*d2;
+  acc[3] += d3*d3;
+ }
+ for (;i<d;i++) acc[0] += math::Sqr(pa[i]-pb[i]);
+ return (acc[0]+acc[1]) + (acc[2]+acc[3]);
+}
+
+EOS_FUNC int32 SqrEuclidean(nat32 d,const int8 * pa,const int8 * pb)
+{
+ int32 acc[4] = {0,0,0,0};
+ nat32 i = 0;
+ for (;i+4<=d;i+=4)
+ {
+  int32 d0 = int32(pa[i])   - int32(pb[i]);
+  int32 d1 = int32(pa[i+1]) - int32(pb[i+1]);
+  int32 d2 = int32(pa[i+2]) - int32(pb[i+2]);
+  int32 d3 = int32(pa[i+3]) - int32(pb[i+3]);
+  acc[0] += d0*d0;
+  acc[1] += d1*d1;
+  acc[2] += d2*d2;
+  acc[3] += d3*d3;
+ }
+ for (;i<d;i++) acc[0] += math::Sqr(int32(pa[i])-int32(pb[i]));
+ return (acc[0]+acc[1]) + (acc[2]+acc[3]);
+}
+
+EOS_FUNC real32 SqrEuclideanLimit(nat32 d,const real32 * pa,const real32 * pb,real32 limit)
+{
+ // Done in blocks of 16, checking the limit between blocks...
+  real32 ret = 0.0;
+  nat32 i = 0;
+  for (;i+16<=d;i+=16)
+  {
+   ret += SqrEuclidean(16,pa+i,pb+i);
+   if (ret>limit) return ret;
+  }
+  if (i<d) ret += SqrEuclidean(d-i,pa+i,pb+i);
+ return ret;
+}
+
 //------------------------------------------------------------------------------
 EuclideanDistance::~EuclideanDistance()
 {}
@@ -44,6 +44,23 @@ class EOS_CLASS Distance : public Deletable
    virtual cstrconst TypeString() const = 0;
 };
 
+//------------------------------------------------------------------------------
+/// Returns the squared euclidean distance between two vectors of length d.
+/// This is the inner loop of most brute force matching, so its written with
+/// 4 independent accumulators, which the compiler can map to vector
+/// registers, and no function call per dimension.
+EOS_FUNC real32 SqrEuclidean(nat32 d,const real32 * pa,const real32 * pb);
+
+/// As SqrEuclidean, but for vectors that have been quantised to signed bytes.
+/// Uses integer accumulation, so is exact. d must be less than 2^16.
+EOS_FUNC int32 SqrEuclidean(nat32 d,const int8 * pa,const int8 * pb);
+
+/// Early termination variant of SqrEuclidean, once the partial sum exceeds 
+/// limit it gives up and returns a value greater than limit. Useful for nearest
+/// neighbour searches where most candidates are much further than the best so
+/// far.
+EOS_FUNC real32 SqrEuclideanLimit(nat32 d,const real32 * pa,const real32 * pb,real32 limit);
+
 //------------------------------------------------------------------------------
 /// Implimentation of euclidean distance.
 /// Provides a set-able distance multiplier which default to 1.
@@ -798,6 +798,223 @@ inline bit SymEigenSort(M & a,M & q,V & d)
  return true;
 }
 
+//------------------------------------------------------------------------------
+// Helper for SymEigen33 - given a unit vector outputs two more so the three
+// form an orthonormal basis...
+template <typename T>
+inline void SymEigen33Complement(const Vect<3,T> & w,Vect<3,T> & u,Vect<3,T> & v)
+{
+ if (math::Abs(w[0])>math::Abs(w[1]))
+ {
+  T inv = static_cast<T>(1)/math::Sqrt(w[0]*w[0] + w[2]*w[2]);
+  u[0] = -w[2]*inv; u[1] = static_cast<T>(0); u[2] = w[0]*inv;
+ }
+ else
+ {
+  T inv = static_cast<T>(1)/math::Sqrt(w[1]*w[1] + w[2]*w[2]);
+  u[0] = static_cast<T>(0); u[1] = w[2]*inv; u[2] = -w[1]*inv;
+ }
+ CrossProduct(w,u,v);
+}
+
+// Helper for SymEigen33 - outputs the eigenvector of an eigenvalue with
+// multiplicity 1, as the largest cross product of two rows of (A - eval I)...
+template <typename T>
+inline void SymEigen33Vector0(const Mat<3,3,T> & a,T eval,Vect<3,T> & out)
+{
+ Vect<3,T> r0,r1,r2;
+ r0[0] = a[0][0]-eval; r0[1] = a[0][1];      r0[2] = a[0][2];
+ r1[0] = a[0][1];      r1[1] = a[1][1]-eval; r1[2] = a[1][2];
+ r2[0] = a[0][2];      r2[1] = a[1][2];      r2[2] = a[2][2]-eval;
+
+ Vect<3,T> c01,c02,c12;
+ CrossProduct(r0,r1,c01);
+ CrossProduct(r0,r2,c02);
+ CrossProduct(r1,r2,c12);
+ T d01 = c01.LengthSqr();
+ T d02 = c02.LengthSqr();
+ T d12 = c12.LengthSqr();
+
+ if ((d01>=d02)&&(d01>=d12)) out = c01;
+ else
+ {
+  if (d02>=d12) {out = c02; d01 = d02;}
+           else {out = c12; d01 = d12;}
+ }
+
+ if (d01>static_cast<T>(0)) out /= math::Sqrt(d01);
+ else
+ {
+  out[0] = static_cast<T>(1); out[1] = static_cast<T>(0); out[2] = static_cast<T>(0);
+ }
+}
+
+// Helper for SymEigen33 - given one eigenvector outputs the eigenvector of
+// the given eigenvalue, by solving the 2x2 problem in the orthogonal
+// complement of the known eigenvector. Works with repeated eigenvalues...
+template <typename T>
+inline void SymEigen33Vector1(const Mat<3,3,T> & a,const Vect<3,T> & evec0,T eval1,Vect<3,T> & out)
+{
+ Vect<3,T> u,v,au,av;
+ SymEigen33Complement(evec0,u,v);
+ MultVect(a,u,au);
+ MultVect(a,v,av);
+
+ T m00 = u*au - eval1;
+ T m01 = u*av;
+ T m11 = v*av - eval1;
+ T absM00 = math::Abs(m00);
+ T absM01 = math::Abs(m01);
+ T absM11 = math::Abs(m11);
+
+ if (absM00>=absM11)
+ {
+  if (math::Max(absM00,absM01)>static_cast<T>(0))
+  {
+   if (absM00>=absM01)
+   {
+    m01 /= m00;
+    m00 = static_cast<T>(1)/math::Sqrt(static_cast<T>(1) + m01*m01);
+    m01 *= m00;
+   }
+   else
+   {
+    m00 /= m01;
+    m01 = static_cast<T>(1)/math::Sqrt(static_cast<T>(1) + m00*m00);
+    m00 *= m01;
+   }
+   for (nat32 i=0;i<3;i++) out[i] = m01*u[i] - m00*v[i];
+  }
+  else out = u;
+ }
+ else
+ {
+  if (math::Max(absM11,absM01)>static_cast<T>(0))
+  {
+   if (absM11>=absM01)
+   {
+    m01 /= m11;
+    m11 = static_cast<T>(1)/math::Sqrt(static_cast<T>(1) + m01*m01);
+    m01 *= m11;
+   }
+   else
+   {
+    m11 /= m01;
+    m01 = static_cast<T>(1)/math::Sqrt(static_cast<T>(1) + m11*m11);
+    m11 *= m01;
+   }
+   for (nat32 i=0;i<3;i++) out[i] = m11*u[i] - m01*v[i];
+  }
+  else out = u;
+ }
+}
+
+/// A closed form version of SymEigenSort for 3x3 symmetric matrices, for when
+/// millions of them need doing. The eigenvalues are the roots of the
+/// characteristic cubic, found with the trigonometric solution, the
+/// eigenvectors are then found with cross products and a 2x2 solve, such that
+/// repeated eigenvalues are handled and the output is always orthonormal.
+/// No iteration, no logging, and no tempory storage.
+/// Based on 'A Robust Eigensolver for 3x3 Symmetric Matrices' by Eberly.
+/// \param a The input symmetric matrix, only the upper triangle is used. Not trashed.
+/// \param q Output rotation matrix, with the eigenvectors as the columns.
+/// \param d Output eigenvalues, in decreasing order.
+template <typename T>
+inline void SymEigen33(const Mat<3,3,T> & a,Mat<3,3,T> & q,Vect<3,T> & d)
+{
+ // Scale to avoid overflow, and handle the zero matrix...
+  T scale = math::Max(math::Max(math::Abs(a[0][0]),math::Abs(a[0][1])),
+                      math::Max(math::Abs(a[0][2]),math::Abs(a[1][1])));
+  scale = math::Max(scale,math::Max(math::Abs(a[1][2]),math::Abs(a[2][2])));
+  if (scale==static_cast<T>(0))
+  {
+   Identity(q);
+   d[0] = static_cast<T>(0); d[1] = static_cast<T>(0); d[2] = static_cast<T>(0);
+   return;
+  }
+
+  Mat<3,3,T> s;
+  T invScale = static_cast<T>(1)/scale;
+  s[0][0] = a[0][0]*invScale; s[0][1] = a[0][1]*invScale; s[0][2] = a[0][2]*invScale;
+  s[1][1] = a[1][1]*invScale; s[1][2] = a[1][2]*invScale; s[2][2] = a[2][2]*invScale;
+  s[1][0] = s[0][1]; s[2][0] = s[0][2]; s[2][1] = s[1][2];
+
+ // Eigenvalues, from the shifted and normalised matrix B = (S - mean I)/p,
+ // which has characteristic equation beta^3 - 3 beta - det(B) = 0...
+  T mean = (s[0][0] + s[1][1] + s[2][2])/static_cast<T>(3);
+  T b00 = s[0][0] - mean;
+  T b11 = s[1][1] - mean;
+  T b22 = s[2][2] - mean;
+  T offDiag = s[0][1]*s[0][1] + s[0][2]*s[0][2] + s[1][2]*s[1][2];
+  T p = math::Sqrt((b00*b00 + b11*b11 + b22*b22 + static_cast<T>(2)*offDiag)/static_cast<T>(6));
+
+  if (p==static_cast<T>(0))
+  {
+   Identity(q);
+   d[0] = mean*scale; d[1] = d[0]; d[2] = d[0];
+   return;
+  }
+
+  T c00 = b11*b22 - s[1][2]*s[1][2];
+  T c01 = s[0][1]*b22 - s[1][2]*s[0][2];
+  T c02 = s[0][1]*s[1][2] - b11*s[0][2];
+  T halfDet = (b00*c00 - s[0][1]*c01 + s[0][2]*c02)/(static_cast<T>(2)*p*p*p);
+  halfDet = math::Clamp<T>(halfDet,static_cast<T>(-1),static_cast<T>(1));
+
+  T angle = math::InvCos(halfDet)/static_cast<T>(3);
+  T beta2 = static_cast<T>(2)*math::Cos(angle);
+  T beta0 = static_cast<T>(2)*math::Cos(angle + static_cast<T>(2.0*math::pi/3.0));
+  T beta1 = -(beta0 + beta2);
+
+  T eval0 = mean + p*beta0; // Smallest.
+  T eval1 = mean + p*beta1;
+  T eval2 = mean + p*beta2; // Largest.
+  // (The arc cosine loses half the precision near repeated eigenvalues, so
+  // these only serve to find the eigenvectors.)
+
+ // Eigenvectors - start with the eigenvalue furthest from the other two, as
+ // it has multiplicity 1...
+  Vect<3,T> evec0,evec1,evec2;
+  if (halfDet>=static_cast<T>(0))
+  {
+   SymEigen33Vector0(s,eval2,evec2);
+   SymEigen33Vector1(s,evec2,eval1,evec1);
+   CrossProduct(evec1,evec2,evec0);
+  }
+  else
+  {
+   SymEigen33Vector0(s,eval0,evec0);
+   SymEigen33Vector1(s,evec0,eval1,evec1);
+   CrossProduct(evec0,evec1,evec2);
+  }
+
+  for (nat32 r=0;r<3;r++)
+  {
+   q[r][0] = evec2[r];
+   q[r][1] = evec1[r];
+   q[r][2] = evec0[r];
+  }
+
+ // Final eigenvalues are the Rayleigh quotients of the eigenvectors, which
+ // are accurate to full precision; sort them, largest first...
+  for (nat32 c=0;c<3;c++)
+  {
+   Vect<3,T> e,se;
+   for (nat32 r=0;r<3;r++) e[r] = q[r][c];
+   MultVect(s,e,se);
+   d[c] = (e*se)*scale;
+  }
+
+  for (nat32 i=1;i<3;i++)
+  {
+   for (nat32 j=i;(j>0)&&(d[j]>d[j-1]);j--)
+   {
+    math::Swap(d[j],d[j-1]);
+    q.SwapCols(j,j-1);
+   }
+  }
+}
+
 //------------------------------------------------------------------------------
 /// This fits a polynomial function to a set of distinct points.
 /// This version allows you to specify the highest exponent as the length
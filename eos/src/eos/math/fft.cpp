@@ -0,0 +1,698 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/math/fft.h"
+
+#include "eos/math/constants.h"
+#include "eos/math/functions.h"
+#include "eos/ds/lists.h"
+#include "eos/mt/locks.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+EOS_FUNC bit FftGood(nat32 n)
+{
+ if (n==0) return false;
+ while (n%2==0) n /= 2;
+ while (n%3==0) n /= 3;
+ while (n%5==0) n /= 5;
+ return n==1;
+}
+
+EOS_FUNC nat32 FftSize(nat32 n)
+{
+ if (n<=1) return 1;
+ while (!FftGood(n)) ++n;
+ return n;
+}
+
+//------------------------------------------------------------------------------
+// The passes of the Stockham algorithm. Each takes x, consisting of s
+// interleaved sequences of length p*m, and writes y, with each sequence
+// replaced by p interleaved sequences of length m, i.e. a decimation in
+// frequency step. tw contains the p-1 twiddle factors for each i in [0,m).
+// The inner loop runs over the s sequences, which are contiguous...
+
+inline void FftPass2(const Complex<real32> * x,Complex<real32> * y,const Complex<real32> * tw,nat32 m,nat32 s)
+{
+ for (nat32 i=0;i<m;i++)
+ {
+  const Complex<real32> w1 = tw[i];
+  const Complex<real32> * x0 = x + s*i;
+  const Complex<real32> * x1 = x + s*(i+m);
+  Complex<real32> * y0 = y + s*(2*i);
+  Complex<real32> * y1 = y + s*(2*i+1);
+  for (nat32 q=0;q<s;q++)
+  {
+   real32 dx = x0[q].x - x1[q].x;
+   real32 dy = x0[q].y - x1[q].y;
+   y0[q].x = x0[q].x + x1[q].x;
+   y0[q].y = x0[q].y + x1[q].y;
+   y1[q].x = dx*w1.x - dy*w1.y;
+   y1[q].y = dx*w1.y + dy*w1.x;
+  }
+ }
+}
+
+inline void FftPass3(const Complex<real32> * x,Complex<real32> * y,const Complex<real32> * tw,nat32 m,nat32 s)
+{
+ static const real32 sin3 = 0.86602540378443864676; // sin(2pi/3)
+ for (nat32 i=0;i<m;i++)
+ {
+  const Complex<real32> w1 = tw[i*2];
+  const Complex<real32> w2 = tw[i*2+1];
+  const Complex<real32> * x0 = x + s*i;
+  const Complex<real32> * x1 = x + s*(i+m);
+  const Complex<real32> * x2 = x + s*(i+2*m);
+  Complex<real32> * y0 = y + s*(3*i);
+  Complex<real32> * y1 = y + s*(3*i+1);
+  Complex<real32> * y2 = y + s*(3*i+2);
+  for (nat32 q=0;q<s;q++)
+  {
+   real32 t1x = x1[q].x + x2[q].x;
+   real32 t1y = x1[q].y + x2[q].y;
+   real32 mx = x0[q].x - 0.5*t1x;
+   real32 my = x0[q].y - 0.5*t1y;
+   real32 sx =  sin3*(x1[q].y - x2[q].y); // -i*sin3*(x1-x2)
+   real32 sy = -sin3*(x1[q].x - x2[q].x);
+
+   y0[q].x = x0[q].x + t1x;
+   y0[q].y = x0[q].y + t1y;
+
+   real32 ax = mx + sx;
+   real32 ay = my + sy;
+   y1[q].x = ax*w1.x - ay*w1.y;
+   y1[q].y = ax*w1.y + ay*w1.x;
+
+   real32 bx = mx - sx;
+   real32 by = my - sy;
+   y2[q].x = bx*w2.x - by*w2.y;
+   y2[q].y = bx*w2.y + by*w2.x;
+  }
+ }
+}
+
+inline void FftPass4(const Complex<real32> * x,Complex<real32> * y,const Complex<real32> * tw,nat32 m,nat32 s)
+{
+ for (nat32 i=0;i<m;i++)
+ {
+  const Complex<real32> w1 = tw[i*3];
+  const Complex<real32> w2 = tw[i*3+1];
+  const Complex<real32> w3 = tw[i*3+2];
+  const Complex<real32> * x0 = x + s*i;
+  const Complex<real32> * x1 = x + s*(i+m);
+  const Complex<real32> * x2 = x + s*(i+2*m);
+  const Complex<real32> * x3 = x + s*(i+3*m);
+  Complex<real32> * y0 = y + s*(4*i);
+  Complex<real32> * y1 = y + s*(4*i+1);
+  Complex<real32> * y2 = y + s*(4*i+2);
+  Complex<real32> * y3 = y + s*(4*i+3);
+  for (nat32 q=0;q<s;q++)
+  {
+   real32 t0x = x0[q].x + x2[q].x;
+   real32 t0y = x0[q].y + x2[q].y;
+   real32 t1x = x0[q].x - x2[q].x;
+   real32 t1y = x0[q].y - x2[q].y;
+   real32 t2x = x1[q].x + x3[q].x;
+   real32 t2y = x1[q].y + x3[q].y;
+   real32 t3x =  (x1[q].y - x3[q].y); // -i*(x1-x3)
+   real32 t3y = -(x1[q].x - x3[q].x);
+
+   y0[q].x = t0x + t2x;
+   y0[q].y = t0y + t2y;
+
+   real32 ax = t1x + t3x;
+   real32 ay = t1y + t3y;
+   y1[q].x = ax*w1.x - ay*w1.y;
+   y1[q].y = ax*w1.y + ay*w1.x;
+
+   real32 bx = t0x - t2x;
+   real32 by = t0y - t2y;
+   y2[q].x = bx*w2.x - by*w2.y;
+   y2[q].y = bx*w2.y + by*w2.x;
+
+   real32 cx = t1x - t3x;
+   real32 cy = t1y - t3y;
+   y3[q].x = cx*w3.x - cy*w3.y;
+   y3[q].y = cx*w3.y + cy*w3.x;
+  }
+ }
+}
+
+inline void FftPass5(const Complex<real32> * x,Complex<real32> * y,const Complex<real32> * tw,nat32 m,nat32 s)
+{
+ static const real32 c1 =  0.30901699437494742410; // cos(2pi/5)
+ static const real32 c2 = -0.80901699437494742410; // cos(4pi/5)
+ static const real32 s1 =  0.95105651629515357212; // sin(2pi/5)
+ static const real32 s2 =  0.58778525229247312917; // sin(4pi/5)
+ for (nat32 i=0;i<m;i++)
+ {
+  const Complex<real32> w1 = tw[i*4];
+  const Complex<real32> w2 = tw[i*4+1];
+  const Complex<real32> w3 = tw[i*4+2];
+  const Complex<real32> w4 = tw[i*4+3];
+  const Complex<real32> * x0 = x + s*i;
+  const Complex<real32> * x1 = x + s*(i+m);
+  const Complex<real32> * x2 = x + s*(i+2*m);
+  const Complex<real32> * x3 = x + s*(i+3*m);
+  const Complex<real32> * x4 = x + s*(i+4*m);
+  Complex<real32> * y0 = y + s*(5*i);
+  Complex<real32> * y1 = y + s*(5*i+1);
+  Complex<real32> * y2 = y + s*(5*i+2);
+  Complex<real32> * y3 = y + s*(5*i+3);
+  Complex<real32> * y4 = y + s*(5*i+4);
+  for (nat32 q=0;q<s;q++)
+  {
+   real32 t1x = x1[q].x + x4[q].x;
+   real32 t1y = x1[q].y + x4[q].y;
+   real32 t2x = x2[q].x + x3[q].x;
+   real32 t2y = x2[q].y + x3[q].y;
+   real32 t3x = x1[q].x - x4[q].x;
+   real32 t3y = x1[q].y - x4[q].y;
+   real32 t4x = x2[q].x - x3[q].x;
+   real32 t4y = x2[q].y - x3[q].y;
+
+   y0[q].x = x0[q].x + t1x + t2x;
+   y0[q].y = x0[q].y + t1y + t2y;
+
+   real32 b1x = x0[q].x + c1*t1x + c2*t2x;
+   real32 b1y = x0[q].y + c1*t1y + c2*t2y;
+   real32 b2x = x0[q].x + c2*t1x + c1*t2x;
+   real32 b2y = x0[q].y + c2*t1y + c1*t2y;
+
+   // -i*(s1*t3 + s2*t4) and -i*(s2*t3 - s1*t4)...
+    real32 d1x =  (s1*t3y + s2*t4y);
+    real32 d1y = -(s1*t3x + s2*t4x);
+    real32 d2x =  (s2*t3y - s1*t4y);
+    real32 d2y = -(s2*t3x - s1*t4x);
+
+   real32 ax = b1x + d1x;
+   real32 ay = b1y + d1y;
+   y1[q].x = ax*w1.x - ay*w1.y;
+   y1[q].y = ax*w1.y + ay*w1.x;
+
+   ax = b2x + d2x;
+   ay = b2y + d2y;
+   y2[q].x = ax*w2.x - ay*w2.y;
+   y2[q].y = ax*w2.y + ay*w2.x;
+
+   ax = b2x - d2x;
+   ay = b2y - d2y;
+   y3[q].x = ax*w3.x - ay*w3.y;
+   y3[q].y = ax*w3.y + ay*w3.x;
+
+   ax = b1x - d1x;
+   ay = b1y - d1y;
+   y4[q].x = ax*w4.x - ay*w4.y;
+   y4[q].y = ax*w4.y + ay*w4.x;
+  }
+ }
+}
+
+// Any other radix, by brute force, omega being the p roots of unity...
+inline void FftPassGeneric(const Complex<real32> * x,Complex<real32> * y,const Complex<real32> * tw,
+                           const Complex<real32> * omega,nat32 p,nat32 m,nat32 s)
+{
+ for (nat32 i=0;i<m;i++)
+ {
+  for (nat32 k=0;k<p;k++)
+  {
+   Complex<real32> w(1.0,0.0);
+   if (k!=0) w = tw[i*(p-1) + k-1];
+   Complex<real32> * yk = y + s*(p*i+k);
+   for (nat32 q=0;q<s;q++)
+   {
+    real32 sx = 0.0;
+    real32 sy = 0.0;
+    nat32 e = 0;
+    for (nat32 r=0;r<p;r++)
+    {
+     const Complex<real32> & a = x[q + s*(i+r*m)];
+     sx += a.x*omega[e].x - a.y*omega[e].y;
+     sy += a.x*omega[e].y + a.y*omega[e].x;
+     e += k; if (e>=p) e -= p;
+    }
+    yk[q].x = sx*w.x - sy*w.y;
+    yk[q].y = sx*w.y + sy*w.x;
+   }
+  }
+ }
+}
+
+//------------------------------------------------------------------------------
+// The shared cache of plans. Plans are constructed outside the lock, as an
+// FftReal gets its Fft whilst being constructed, so two threads may race to
+// create the same plan, in which case the loser deletes its copy...
+class FftCache
+{
+ public:
+  mt::OwnedLock lock;
+  ds::List<Fft*,mem::KillDel<Fft> > complex; // Declared first so it outlives real.
+  ds::List<FftReal*,mem::KillDel<FftReal> > real;
+};
+
+static FftCache & TheFftCache()
+{
+ static FftCache cache;
+ return cache;
+}
+
+template <typename T>
+inline T * FftCacheFind(const ds::List<T*,mem::KillDel<T> > & list,nat32 n)
+{
+ typename ds::List<T*,mem::KillDel<T> >::Cursor targ = list.FrontPtr();
+ while (!targ.Bad())
+ {
+  if ((*targ)->Size()==n) return *targ;
+  ++targ;
+ }
+ return null<T*>();
+}
+
+template <typename T>
+inline const T & FftCacheGet(ds::List<T*,mem::KillDel<T> > & list,nat32 n)
+{
+ FftCache & cache = TheFftCache();
+
+ cache.lock.Lock();
+  T * ret = FftCacheFind(list,n);
+ cache.lock.Unlock();
+ if (ret) return *ret;
+
+ T * plan = new T(n);
+ cache.lock.Lock();
+  ret = FftCacheFind(list,n);
+  if (ret==null<T*>())
+  {
+   list.AddBack(plan);
+   ret = plan;
+  }
+  else delete plan;
+ cache.lock.Unlock();
+
+ return *ret;
+}
+
+//------------------------------------------------------------------------------
+Fft::Fft(nat32 nn)
+:n(nn),stages(0)
+{
+ // Factorise, radix 4 first as its the cheapest per element...
+  nat32 fact[32];
+  nat32 rem = n;
+  while (rem%4==0) {fact[stages++] = 4; rem /= 4;}
+  while (rem%2==0) {fact[stages++] = 2; rem /= 2;}
+  while (rem%3==0) {fact[stages++] = 3; rem /= 3;}
+  while (rem%5==0) {fact[stages++] = 5; rem /= 5;}
+  for (nat32 p=7;p*p<=rem;p+=2)
+  {
+   while (rem%p==0) {fact[stages++] = p; rem /= p;}
+  }
+  if (rem>1) fact[stages++] = rem;
+
+ // Create the twiddle factors for each stage...
+  radix = new nat32[stages];
+  twiddle = new Complex<real32>*[stages];
+  omega = new Complex<real32>*[stages];
+
+  nat32 cur = n;
+  for (nat32 st=0;st<stages;st++)
+  {
+   nat32 p = fact[st];
+   nat32 m = cur/p;
+   radix[st] = p;
+
+   twiddle[st] = new Complex<real32>[m*(p-1)];
+   for (nat32 i=0;i<m;i++)
+   {
+    for (nat32 k=1;k<p;k++)
+    {
+     real64 ang = -2.0*pi*real64(i*k)/real64(cur);
+     twiddle[st][i*(p-1) + k-1] = Complex<real32>(math::Cos(ang),math::Sin(ang));
+    }
+   }
+
+   if ((p==2)||(p==3)||(p==4)||(p==5)) omega[st] = null<Complex<real32>*>();
+   else
+   {
+    omega[st] = new Complex<real32>[p];
+    for (nat32 r=0;r<p;r++)
+    {
+     real64 ang = -2.0*pi*real64(r)/real64(p);
+     omega[st][r] = Complex<real32>(math::Cos(ang),math::Sin(ang));
+    }
+   }
+
+   cur = m;
+  }
+}
+
+Fft::~Fft()
+{
+ for (nat32 st=0;st<stages;st++)
+ {
+  delete[] twiddle[st];
+  delete[] omega[st];
+ }
+ delete[] omega;
+ delete[] twiddle;
+ delete[] radix;
+}
+
+void Fft::Forward(Complex<real32> * data,Complex<real32> * temp) const
+{
+ Complex<real32> * own = null<Complex<real32>*>();
+ if (temp==null<Complex<real32>*>()) {own = new Complex<real32>[n]; temp = own;}
+  Transform(data,temp);
+ delete[] own;
+}
+
+void Fft::Inverse(Complex<real32> * data,Complex<real32> * temp) const
+{
+ Complex<real32> * own = null<Complex<real32>*>();
+ if (temp==null<Complex<real32>*>()) {own = new Complex<real32>[n]; temp = own;}
+
+ // The inverse is the conjugate of the forward transform of the conjugate...
+  for (nat32 i=0;i<n;i++) data[i].y = -data[i].y;
+  Transform(data,temp);
+  real32 mult = 1.0/real32(n);
+  for (nat32 i=0;i<n;i++)
+  {
+   data[i].x *= mult;
+   data[i].y *= -mult;
+  }
+
+ delete[] own;
+}
+
+const Fft & Fft::Get(nat32 n)
+{
+ return FftCacheGet(TheFftCache().complex,n);
+}
+
+void Fft::Transform(Complex<real32> * data,Complex<real32> * temp) const
+{
+ Complex<real32> * x = data;
+ Complex<real32> * y = temp;
+ nat32 m = n;
+ nat32 s = 1;
+ for (nat32 st=0;st<stages;st++)
+ {
+  nat32 p = radix[st];
+  m /= p;
+  switch (p)
+  {
+   case 2: FftPass2(x,y,twiddle[st],m,s); break;
+   case 3: FftPass3(x,y,twiddle[st],m,s); break;
+   case 4: FftPass4(x,y,twiddle[st],m,s); break;
+   case 5: FftPass5(x,y,twiddle[st],m,s); break;
+   default: FftPassGeneric(x,y,twiddle[st],omega[st],p,m,s); break;
+  }
+  s *= p;
+
+  Complex<real32> * t = x;
+  x = y;
+  y = t;
+ }
+
+ if (x!=data)
+ {
+  for (nat32 i=0;i<n;i++) data[i] = x[i];
+ }
+}
+
+//------------------------------------------------------------------------------
+FftReal::FftReal(nat32 nn)
+:n(nn),plan(Fft::Get(((nn%2)==0)?(nn/2):nn)),twiddle(null<Complex<real32>*>())
+{
+ if (n%2==0)
+ {
+  twiddle = new Complex<real32>[n/2+1];
+  for (nat32 k=0;k<=n/2;k++)
+  {
+   real64 ang = -2.0*pi*real64(k)/real64(n);
+   twiddle[k] = Complex<real32>(math::Cos(ang),math::Sin(ang));
+  }
+ }
+}
+
+FftReal::~FftReal()
+{
+ delete[] twiddle;
+}
+
+void FftReal::Forward(const real32 * in,Complex<real32> * out,Complex<real32> * temp) const
+{
+ Complex<real32> * own = null<Complex<real32>*>();
+ if (temp==null<Complex<real32>*>()) {own = new Complex<real32>[TempSize()]; temp = own;}
+
+ if (n%2==0)
+ {
+  // Pack the even entries into the real parts and the odd into the imaginary,
+  // transform...
+   nat32 half = n/2;
+   Complex<real32> * z = temp;
+   for (nat32 j=0;j<half;j++)
+   {
+    z[j].x = in[2*j];
+    z[j].y = in[2*j+1];
+   }
+   plan.Forward(z,temp+half);
+
+  // Untangle, the transforms of the even and odd entries being the conjugate
+  // symmetric and antisymmetric parts...
+   for (nat32 k=0;k<=half;k++)
+   {
+    const Complex<real32> & a = z[(k==half)?0:k];
+    const Complex<real32> & b = z[(k==0)?0:(half-k)];
+
+    real32 ex = 0.5*(a.x + b.x);
+    real32 ey = 0.5*(a.y - b.y);
+    real32 ox = 0.5*(a.y + b.y);
+    real32 oy = -0.5*(a.x - b.x);
+
+    const Complex<real32> & w = twiddle[k];
+    out[k].x = ex + ox*w.x - oy*w.y;
+    out[k].y = ey + ox*w.y + oy*w.x;
+   }
+ }
+ else
+ {
+  Complex<real32> * z = temp;
+  for (nat32 i=0;i<n;i++)
+  {
+   z[i].x = in[i];
+   z[i].y = 0.0;
+  }
+  plan.Forward(z,temp+n);
+  for (nat32 k=0;k<=n/2;k++) out[k] = z[k];
+ }
+
+ delete[] own;
+}
+
+void FftReal::Inverse(const Complex<real32> * in,real32 * out,Complex<real32> * temp) const
+{
+ Complex<real32> * own = null<Complex<real32>*>();
+ if (temp==null<Complex<real32>*>()) {own = new Complex<real32>[TempSize()]; temp = own;}
+
+ if (n%2==0)
+ {
+  // Recover the transforms of the even and odd entries and retangle...
+   nat32 half = n/2;
+   Complex<real32> * z = temp;
+   for (nat32 k=0;k<half;k++)
+   {
+    Complex<real32> a = in[k];
+    Complex<real32> b = in[half-k];
+    if (k==0) {a.y = 0.0; b.y = 0.0;}
+
+    real32 ex = 0.5*(a.x + b.x);
+    real32 ey = 0.5*(a.y - b.y);
+    real32 dx = 0.5*(a.x - b.x);
+    real32 dy = 0.5*(a.y + b.y);
+
+    const Complex<real32> & w = twiddle[k]; // Multiplied by its conjugate.
+    real32 ox = dx*w.x + dy*w.y;
+    real32 oy = dy*w.x - dx*w.y;
+
+    z[k].x = ex - oy;
+    z[k].y = ey + ox;
+   }
+
+  // Transform and unpack...
+   plan.Inverse(z,temp+half);
+   for (nat32 j=0;j<half;j++)
+   {
+    out[2*j] = z[j].x;
+    out[2*j+1] = z[j].y;
+   }
+ }
+ else
+ {
+  // Rebuild the full spectrum from its conjugate symmetry...
+   Complex<real32> * z = temp;
+   z[0].x = in[0].x;
+   z[0].y = 0.0;
+   for (nat32 k=1;k<=n/2;k++)
+   {
+    z[k] = in[k];
+    z[n-k].x = in[k].x;
+    z[n-k].y = -in[k].y;
+   }
+
+  plan.Inverse(z,temp+n);
+  for (nat32 i=0;i<n;i++) out[i] = z[i].x;
+ }
+
+ delete[] own;
+}
+
+const FftReal & FftReal::Get(nat32 n)
+{
+ return FftCacheGet(TheFftCache().real,n);
+}
+
+//------------------------------------------------------------------------------
+// Rows of the 2D transform are handed to the pool in bands of this many, and
+// columns in blocks of this many...
+static const nat32 rowBand = 8;
+static const nat32 colBlock = 8;
+
+Fft2D::Fft2D(nat32 width,nat32 height)
+:rows(FftReal::Get(width)),cols(Fft::Get(height))
+{}
+
+void Fft2D::Forward(const real32 * in,nat32 stride,Complex<real32> * out) const
+{
+ mt::Pool & pool = mt::SharedPool();
+ nat32 height = Height();
+ nat32 specWidth = SpecWidth();
+
+ // Rows...
+ {
+  Complex<real32> * temp = new Complex<real32>[pool.Threads()*rows.TempSize()];
+  RowJob job;
+   job.plan = &rows;
+   job.im = const_cast<real32*>(in);
+   job.rows = height;
+   job.stride = stride;
+   job.spec = out;
+   job.temp = temp;
+   job.inverse = false;
+  pool.Run(job,(height+rowBand-1)/rowBand);
+  delete[] temp;
+ }
+
+ // Columns...
+ {
+  Complex<real32> * temp = new Complex<real32>[pool.Threads()*(colBlock+1)*height];
+  ColJob job;
+   job.plan = &cols;
+   job.spec = out;
+   job.specWidth = specWidth;
+   job.temp = temp;
+   job.inverse = false;
+  pool.Run(job,(specWidth+colBlock-1)/colBlock);
+  delete[] temp;
+ }
+}
+
+void Fft2D::Inverse(Complex<real32> * in,real32 * out,nat32 stride) const
+{
+ mt::Pool & pool = mt::SharedPool();
+ nat32 height = Height();
+ nat32 specWidth = SpecWidth();
+
+ // Columns...
+ {
+  Complex<real32> * temp = new Complex<real32>[pool.Threads()*(colBlock+1)*height];
+  ColJob job;
+   job.plan = &cols;
+   job.spec = in;
+   job.specWidth = specWidth;
+   job.temp = temp;
+   job.inverse = true;
+  pool.Run(job,(specWidth+colBlock-1)/colBlock);
+  delete[] temp;
+ }
+
+ // Rows...
+ {
+  Complex<real32> * temp = new Complex<real32>[pool.Threads()*rows.TempSize()];
+  RowJob job;
+   job.plan = &rows;
+   job.im = out;
+   job.rows = height;
+   job.stride = stride;
+   job.spec = in;
+   job.temp = temp;
+   job.inverse = true;
+  pool.Run(job,(height+rowBand-1)/rowBand);
+  delete[] temp;
+ }
+}
+
+void Fft2D::RowJob::Do(nat32 unit,nat32 thread)
+{
+ nat32 specWidth = plan->SpecSize();
+ Complex<real32> * t = temp + thread*plan->TempSize();
+ nat32 end = math::Min(rows,(unit+1)*rowBand);
+ for (nat32 y=unit*rowBand;y<end;y++)
+ {
+  if (inverse) plan->Inverse(spec + y*specWidth,im + y*stride,t);
+          else plan->Forward(im + y*stride,spec + y*specWidth,t);
+ }
+}
+
+void Fft2D::ColJob::Do(nat32 unit,nat32 thread)
+{
+ nat32 height = plan->Size();
+ Complex<real32> * block = temp + thread*(colBlock+1)*height;
+ Complex<real32> * t = block + colBlock*height;
+
+ nat32 start = unit*colBlock;
+ nat32 cols = math::Min(colBlock,specWidth-start);
+
+ // Gather the block of columns, a row at a time...
+  for (nat32 y=0;y<height;y++)
+  {
+   const Complex<real32> * row = spec + y*specWidth + start;
+   for (nat32 c=0;c<cols;c++) block[c*height + y] = row[c];
+  }
+
+ // Transform each...
+  for (nat32 c=0;c<cols;c++)
+  {
+   if (inverse) plan->Inverse(block + c*height,t);
+           else plan->Forward(block + c*height,t);
+  }
+
+ // Scatter them back...
+  for (nat32 y=0;y<height;y++)
+  {
+   Complex<real32> * row = spec + y*specWidth + start;
+   for (nat32 c=0;c<cols;c++) row[c] = block[c*height + y];
+  }
+}
+
+//------------------------------------------------------------------------------
+ };
+};
@@ -0,0 +1,223 @@
+#ifndef EOS_MATH_FFT_H
+#define EOS_MATH_FFT_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file fft.h
+/// Provides fast fourier transforms, of complex and real data in 1D and of
+/// real data in 2D. Lengths are factored into radices of 4, 2, 3 and 5, which
+/// have dedicated butterflies, any other prime factors are handled by a
+/// generic, O(p^2), butterfly, so any length works but lengths with only the
+/// factors 2, 3 and 5 are fast - use FftSize to pad to one. Forward transforms
+/// use e^{-2 pi i jk/n} and are unnormalised, inverse transforms divide by n,
+/// so an inverse undoes a forward exactly (Up to rounding.).
+
+#include "eos/types.h"
+#include "eos/math/complex.h"
+#include "eos/mt/pool.h"
+
+namespace eos
+{
+ namespace math
+ {
+//------------------------------------------------------------------------------
+/// Returns true if the only prime factors of n are 2, 3 and 5, i.e. the
+/// transforms are fast for a length of n.
+EOS_FUNC bit FftGood(nat32 n);
+
+/// Returns the smallest length that is at least n and FftGood, for padding
+/// data up to before transforming.
+EOS_FUNC nat32 FftSize(nat32 n);
+
+//------------------------------------------------------------------------------
+/// A plan for the complex fourier transform of a particular length, with the
+/// factorisation and twiddle factors precalculated. Uses the Stockham autosort
+/// algorithm, which ping-pongs between the data and a temporary buffer rather
+/// than bit reversing, with the inner loops of each pass running over
+/// contiguous memory without branches, so the compiler can vectorise them.
+/// Once constructed a plan is only read, so it can be used by many threads at
+/// once as long as each provides its own temporary buffer. Get provides
+/// cached plans, which is what you should normally use.
+class EOS_CLASS Fft : public Deletable
+{
+ public:
+  /// n must be at least 1.
+   Fft(nat32 n);
+
+  /// &nbsp;
+   ~Fft();
+
+
+  /// Returns the length transformed.
+   nat32 Size() const {return n;}
+
+  /// In place forward transform of Size() values. temp must be Size() in
+  /// size, or null in which case it is allocated.
+   void Forward(Complex<real32> * data,Complex<real32> * temp = null<Complex<real32>*>()) const;
+
+  /// In place inverse transform, as for Forward.
+   void Inverse(Complex<real32> * data,Complex<real32> * temp = null<Complex<real32>*>()) const;
+
+
+  /// Returns a plan for the given length from a shared cache, constructing it
+  /// the first time a length is asked for. Thread safe. Plans last until the
+  /// program exits.
+   static const Fft & Get(nat32 n);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Fft";}
+
+
+ private:
+  nat32 n;
+  nat32 stages;
+  nat32 * radix; // Radix of each stage.
+  Complex<real32> ** twiddle; // For each stage, (n/p)*(p-1) twiddle factors.
+  Complex<real32> ** omega; // For each stage with a generic radix p, the p roots of unity, else null.
+
+  void Transform(Complex<real32> * data,Complex<real32> * temp) const;
+};
+
+//------------------------------------------------------------------------------
+/// A plan for the fourier transform of real data of a particular length,
+/// which takes n real values to the n/2+1 complex values that define the
+/// spectrum, the rest being given by conjugate symmetry. For even lengths the
+/// real data is packed into a complex transform of half the length, which is
+/// then untangled, so it costs about half a complex transform. Odd lengths
+/// fall back to a full complex transform. As for Fft, use Get.
+class EOS_CLASS FftReal : public Deletable
+{
+ public:
+  /// n must be at least 1.
+   FftReal(nat32 n);
+
+  /// &nbsp;
+   ~FftReal();
+
+
+  /// Returns the number of real values transformed.
+   nat32 Size() const {return n;}
+
+  /// Returns the number of complex values in the spectrum, n/2+1.
+   nat32 SpecSize() const {return n/2+1;}
+
+  /// Returns the size of the temporary buffer the transforms need.
+   nat32 TempSize() const {return (n%2==0)?n:(2*n);}
+
+
+  /// Transforms Size() reals in to SpecSize() complex values in out. temp
+  /// must be TempSize() in size, or null in which case it is allocated.
+   void Forward(const real32 * in,Complex<real32> * out,Complex<real32> * temp = null<Complex<real32>*>()) const;
+
+  /// Transforms SpecSize() complex values in to Size() reals in out. The
+  /// imaginary parts of the first and, for even lengths, the last entry are
+  /// ignored, as they are zero for the spectrum of real data.
+   void Inverse(const Complex<real32> * in,real32 * out,Complex<real32> * temp = null<Complex<real32>*>()) const;
+
+
+  /// Returns a plan for the given length from a shared cache, as Fft::Get.
+   static const FftReal & Get(nat32 n);
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::FftReal";}
+
+
+ private:
+  nat32 n;
+  const Fft & plan; // Of length n/2 for even n, n for odd.
+  Complex<real32> * twiddle; // e^{-2 pi i k/n} for k in [0,n/2], even n only.
+};
+
+//------------------------------------------------------------------------------
+/// The 2D fourier transform of real data, an image of width by height. The
+/// spectrum is SpecWidth() by height complex values, row major, the rest being
+/// given by conjugate symmetry. Rows are transformed with FftReal, then
+/// columns with Fft, both passes split across mt::SharedPool(), the column
+/// pass gathering a block of columns at a time into contiguous buffers.
+class EOS_CLASS Fft2D
+{
+ public:
+  /// Both sizes must be at least 1, and should be FftGood.
+   Fft2D(nat32 width,nat32 height);
+
+  /// &nbsp;
+   ~Fft2D() {}
+
+
+  /// &nbsp;
+   nat32 Width() const {return rows.Size();}
+
+  /// &nbsp;
+   nat32 Height() const {return cols.Size();}
+
+  /// Returns the width of the spectrum, Width()/2+1.
+   nat32 SpecWidth() const {return rows.SpecSize();}
+
+
+  /// Transforms in, which has stride real32's between rows, into out, which
+  /// must be SpecWidth()*Height() in size.
+   void Forward(const real32 * in,nat32 stride,Complex<real32> * out) const;
+
+  /// Transforms the spectrum in back into out, which has stride real32's
+  /// between rows. in is used as workspace, so is destroyed.
+   void Inverse(Complex<real32> * in,real32 * out,nat32 stride) const;
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::math::Fft2D";}
+
+
+ private:
+  const FftReal & rows;
+  const Fft & cols;
+
+  // Transforms a band of rows, forwards or backwards...
+   class RowJob : public mt::Job
+   {
+    public:
+     const FftReal * plan;
+     nat32 rows;
+     real32 * im;
+     nat32 stride;
+     Complex<real32> * spec;
+     Complex<real32> * temp; // TempSize() per thread.
+     bit inverse;
+
+     void Do(nat32 unit,nat32 thread);
+   };
+
+  // Transforms a block of columns of the spectrum in place...
+   class ColJob : public mt::Job
+   {
+    public:
+     const Fft * plan;
+     Complex<real32> * spec;
+     nat32 specWidth;
+     Complex<real32> * temp; // colBlock+1 columns per thread.
+     bit inverse;
+
+     void Do(nat32 unit,nat32 thread);
+   };
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
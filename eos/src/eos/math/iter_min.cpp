@@ -17,17 +17,48 @@
 
 #include "eos/math/iter_min.h"
 
+#include "eos/mt/pool.h"
+
 namespace eos
 {
  namespace math
  {
+//------------------------------------------------------------------------------
+// The jobs SparseLM runs on the pool, each unit being an error function or a
+// parameter vector from one of the lists, as appropriate to the job...
+enum {slmResidual,     // pair - err from para.
+      slmResidualNew,  // pair - errNew from paraNew.
+      slmJacobian,     // pair - Jacobians and w.
+      slmBlockA,       // a - u and e.
+      slmBlockB,       // b - v and e.
+      slmDampB,        // b - inverse of augmented v, and it multiplied by e into t.
+      slmReduceA,      // a - es.
+      slmBuildS,       // a - block row of s.
+      slmPrecondA,     // a - inverse of diagonal block of s.
+      slmMultB,        // b - first half of multiplying multIn by s.
+      slmMultA,        // a - second half of multiplying multIn by s, into multOut.
+      slmBackB         // b - the second list deltas, into paraNew.
+     };
+
+class SparseLMJob : public mt::Job
+{
+ public:
+  SparseLMJob(SparseLM & s,nat32 j):self(s),job(j) {}
+  void Do(nat32 unit,nat32 thread) {self.Do(job,unit,thread);}
+
+ private:
+  SparseLM & self;
+  nat32 job;
+};
+
 //------------------------------------------------------------------------------
 SparseLM::SparseLM()
-:sizeA(0),sizeB(0),sizeErr(0),preStruct(true),list(null<PairNode*>()),
-tempParaA(null<Vector<real64>*>()),tempParaB(null<Vector<real64>*>()),tempErr(null<Vector<real64>*>()),
-tempAerr(null<Matrix<real64>*>()),tempBerr(null<Matrix<real64>*>()),
-tempU(null<Matrix<real64>*>()),tempV(null<Matrix<real64>*>()),tempV2(null<Matrix<real64>*>()),
-pimt(null<PseudoInverseTemp<real64>*>()),s(null<Matrix<real64>*>()),es(null<Vector<real64>*>())
+:sizeA(0),sizeB(0),sizeErr(0),useCG(false),cgMaxIter(500),cgTol(1e-10),
+preStruct(true),list(null<PairNode*>()),lambda(0.0),
+pimt(null<PseudoInverseTemp<real64>*>()),s(null<Matrix<real64>*>()),es(null<Vector<real64>*>()),
+cgX(null<Vector<real64>*>()),cgR(null<Vector<real64>*>()),cgZ(null<Vector<real64>*>()),
+cgP(null<Vector<real64>*>()),cgQ(null<Vector<real64>*>()),
+multIn(null<const Vector<real64>*>()),multOut(null<Vector<real64>*>())
 {}
 
 SparseLM::~SparseLM()
@@ -39,20 +70,15 @@ SparseLM::~SparseLM()
   delete victim;
  }
 
- delete tempParaA;
- delete tempParaB;
- delete tempErr;
- 
- delete tempAerr;
- delete tempBerr; 
- 
- delete tempU;
- delete tempV;
- delete tempV2;
- 
  delete pimt;
  delete s;
  delete es;
+
+ delete cgX;
+ delete cgR;
+ delete cgZ;
+ delete cgP;
+ delete cgQ;
 }
 
 void SparseLM::SetSizes(nat32 sA,nat32 sB,nat32 sE)
@@ -77,7 +103,8 @@ nat32 SparseLM::AddParaB(const Vector<real64> & in)
 }
 
 void SparseLM::AddError(nat32 a,nat32 b,const Vector<real64> & m,
-                        void (*F)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Vector<real64> & err))
+                        void (*F)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Vector<real64> & err),
+                        void (*J)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Matrix<real64> & ja,Matrix<real64> & jb))
 {
  // If we are not allready in postStruct mode, enter it...
   if (preStruct)
@@ -112,6 +139,8 @@ void SparseLM::AddError(nat32 a,nat32 b,const Vector<real64> & m,
      paraB[i]->paraNew = new Vector<real64>(sizeB);
      paraB[i]->uv = new Matrix<real64>(sizeB,sizeB); 
      paraB[i]->e = new Vector<real64>(sizeB);
+     paraB[i]->inv = new Matrix<real64>(sizeB,sizeB);
+     paraB[i]->t = new Vector<real64>(sizeB);
      ++i;
     }    
   }
@@ -125,12 +154,12 @@ void SparseLM::AddError(nat32 a,nat32 b,const Vector<real64> & m,
    npn->b = b;
    npn->m = new Vector<real64>(m);
    npn->F = F;
+   npn->J = J;
    npn->err = new Vector<real64>(sizeErr);
    npn->errNew = new Vector<real64>(sizeErr);
    npn->aJacob = new Matrix<real64>(sizeErr,sizeA);
    npn->bJacob = new Matrix<real64>(sizeErr,sizeB);   
    npn->w = new Matrix<real64>(sizeA,sizeB);
-   npn->y = new Matrix<real64>(sizeA,sizeB);
 }
 
 void SparseLM::AddConsA(nat32 a,void (*C)(Vector<real64> & a))
@@ -150,84 +179,100 @@ void SparseLM::AddCovar(nat32 a,nat32 b,const Matrix<real64> & covar)
  Inverse(*ci,*cit); 
  delete cit;
   
- PairNode * targ = list;
+ PairNode * targ = listA[a];
  while (targ)
  {
-  if ((targ->a==a)&&(targ->b==b))
+  if (targ->b==b)
   {
+   delete targ->covarInv;
    targ->covarInv = ci;
-   break;
+   return;
   }
-  targ = targ->next;
+  targ = targ->nextA;
  }
+ delete ci;
+}
+
+void SparseLM::UseCG(bit enable,nat32 maxIter,real64 tol)
+{
+ useCG = enable;
+ cgMaxIter = maxIter;
+ cgTol = tol;
 }
 
 real64 SparseLM::Run(time::Progress * prog)
 {
+ LogBlock("eos::math::SparseLM::Run","{a,b,cg}" << LogDiv() << paraA.Size() << LogDiv() << paraB.Size() << LogDiv() << useCG);
  prog->Push();
  // Here we do the looping over trying lambda values and checking for
  // improvment, everything else is pushed to other methods.
-  // Create a bunch of large data structures...
-   tempParaA = new Vector<real64>(sizeA);
-   tempParaB = new Vector<real64>(sizeB);
-   tempErr = new Vector<real64>(sizeErr);
+  // Create the per-thread tempories...
+   scratch.Size(mt::SharedPool().Threads());
+   for (nat32 i=0;i<scratch.Size();i++)
+   {
+    scratch[i].paraA.SetSize(sizeA);
+    scratch[i].paraB.SetSize(sizeB);
+    scratch[i].err.SetSize(sizeErr);
+    scratch[i].aErr.SetSize(sizeA,sizeErr);
+    scratch[i].bErr.SetSize(sizeB,sizeErr);
+    scratch[i].u.SetSize(sizeA,sizeA);
+    scratch[i].u2.SetSize(sizeA,sizeA);
+    scratch[i].v.SetSize(sizeB,sizeB);
+    scratch[i].ab.SetSize(sizeA,sizeB);
+   }
 
-   tempAerr = new Matrix<real64>(sizeA,sizeErr);
-   tempBerr = new Matrix<real64>(sizeB,sizeErr);
-   
-   tempU = new Matrix<real64>(sizeA,sizeA);
-   tempV = new Matrix<real64>(sizeB,sizeB);
-   tempV2 = new Matrix<real64>(sizeB,sizeB);
-   
+  // Create the solver data structures - only the dense solver needs memory
+  // quadratic in the first list...
    nat32 sSize = sizeA * paraA.Size();
-   pimt = new PseudoInverseTemp<real64>(sSize,sSize);
-   s = new Matrix<real64>(sSize,sSize);
    es = new Vector<real64>(sSize);
+   if (useCG)
+   {
+    cgX = new Vector<real64>(sSize);
+    cgR = new Vector<real64>(sSize);
+    cgZ = new Vector<real64>(sSize);
+    cgP = new Vector<real64>(sSize);
+    cgQ = new Vector<real64>(sSize);
+    for (nat32 i=0;i<paraA.Size();i++) paraA[i]->inv = new Matrix<real64>(sizeA,sizeA);
+   }
+   else
+   {
+    pimt = new PseudoInverseTemp<real64>(sSize,sSize);
+    s = new Matrix<real64>(sSize,sSize);
+   }
 
 
-  // We require the listA linked lists to be sorted by b, a bit of a pain,
-  // an inline bucket sort...
+  // We require the listA linked lists to be sorted by b, rebuild them from
+  // the listB lists in reverse order of b to get this...
   {
-   ds::Array<PairNode*> entry(paraB.Size());
-   for (nat32 i=0;i<paraA.Size();i++)
+   for (nat32 i=0;i<paraA.Size();i++) listA[i] = null<PairNode*>();
+   for (int32 j=paraB.Size()-1;j>=0;j--)
    {
-    for (nat32 j=0;j<entry.Size();j++) entry[j] = null<PairNode*>();
-    
-    PairNode * targ = listA[i];
+    PairNode * targ = listB[j];
     while (targ)
     {
-     entry[targ->b] = targ; 
-     targ = targ->nextA;
-    }
-    
-    listA[i] = null<PairNode*>();
-    for (int32 j=paraB.Size()-1;j>=0;j--)
-    {
-     if (entry[j])
-     {
-      entry[j]->nextA = listA[i];
-      listA[i] = entry[j];
-     }
+     targ->nextA = listA[targ->a];
+     listA[targ->a] = targ;
+     targ = targ->nextB;
     }
    }
   }
 
+  // Index the pair nodes...
+  {
+   nat32 count = 0;
+   for (PairNode * targ = list;targ;targ = targ->next) ++count;
+   pair.Size(count);
+   count = 0;
+   for (PairNode * targ = list;targ;targ = targ->next) {pair[count] = targ; ++count;}
+  }
+
 
   // Before we start calculate the error vectors and the residual for all of 'em...
-   real64 residual = 0.0; // We work squared, obviously.
-   {
-    PairNode * targ = list;
-    while (targ)
-    {
-     (targ->F)(*paraA[targ->a]->para,*paraB[targ->b]->para,*targ->m,*targ->err);
-     residual += targ->err->LengthSqr();
-     targ = targ->next;
-    }
-   }
+   real64 residual = Residual(false); // We work squared, obviously.
 
 
   // The primary loop, each time through we should reduce our residual...
-   real64 lambda = 1e-3;   
+   lambda = 1e-3;   
    for (nat32 k=0;k<maxIter;k++)
    {
     prog->Report(k,k+1);
@@ -245,16 +290,7 @@ real64 SparseLM::Run(time::Progress * prog)
 
       // If its residual is an improvement swap it in, decrease lambda and break,
       // otherwise increase lambda and go arround again...
-       real64 newResidual = 0.0;
-       {
-        PairNode * targ = list;
-        while (targ)
-        {
-         (targ->F)(*paraA[targ->a]->paraNew,*paraB[targ->b]->paraNew,*targ->m,*targ->errNew);
-         newResidual += targ->errNew->LengthSqr();
-         targ = targ->next;
-        }
-       }
+       real64 newResidual = Residual(true);
        if (newResidual<residual)
        {
         // It has improved, we are done doing secondry iterations, for now...
@@ -296,284 +332,455 @@ void SparseLM::GetParaB(nat32 ind,Vector<real64> & out)
  out = *(paraB[ind]->para);
 }
 
-void SparseLM::MakeJacobians()
+void SparseLM::RunJob(nat32 job,nat32 units)
 {
- PairNode * targ = list;
- while (targ)
- {
-  // Jacobian A...
-   *tempParaA = paraA[targ->a]->para[0];
-   for (nat32 c=0;c<targ->aJacob->Cols();c++)
-   {
-    real64 delta = Max(Abs(10e-4 * (*tempParaA)[c]),10e-6);
-    (*tempParaA)[c] += delta;
-      
-    (targ->F)(*tempParaA,*paraB[targ->b]->para,*targ->m,*tempErr);
-    delta = 1.0/delta;   
-       
-    for (nat32 r=0;r<targ->aJacob->Rows();r++)
-    {
-     (*targ->aJacob)[r][c] = ((*tempErr)[r] - (*targ->err)[r])*delta;
-    }
-    
-    (*tempParaA)[c] = paraA[targ->a]->para[0][c];
-   }
+ SparseLMJob j(*this,job);
+ mt::SharedPool().Run(j,units);
+}
 
-  // B Jacobian...
-   *tempParaB = *paraB[targ->b]->para;
-   for (nat32 c=0;c<targ->bJacob->Cols();c++)
-   {
-    real64 delta = Max(Abs(10e-4 * (*tempParaB)[c]),10e-6);
-    (*tempParaB)[c] += delta;
-    
-    (targ->F)(*paraA[targ->a]->para,*tempParaB,*targ->m,*tempErr);       
-    delta = 1.0/delta;        
-    for (nat32 r=0;r<targ->bJacob->Rows();r++)
-    {
-     (*targ->bJacob)[r][c] = ((*tempErr)[r] - (*targ->err)[r])*delta;
-    }
-    
-    (*tempParaB)[c] = (*paraB[targ->b]->para)[c];
-   }
-   
-  targ = targ->next;
- }
+real64 SparseLM::Residual(bit useNew)
+{
+ RunJob(useNew?slmResidualNew:slmResidual,pair.Size());
+
+ // Summed in a fixed order, so the result does not depend on the threads...
+  real64 ret = 0.0;
+  for (nat32 i=0;i<pair.Size();i++)
+  {
+   ret += (useNew?pair[i]->errNew:pair[i]->err)->LengthSqr();
+  }
+ return ret;
+}
+
+void SparseLM::MakeJacobians()
+{
+ RunJob(slmJacobian,pair.Size());
 }
 
 void SparseLM::NonLambdaWork()
 {
  // Calculate all the intermediate values that do not contain lambda, i.e. only have
  // to be done each primary loop instead of each secondry loop...
-  PairNode * targ;
-  // Pass through the a list...
-   for (nat32 i=0;i<paraA.Size();i++)
+  RunJob(slmBlockA,paraA.Size());
+  RunJob(slmBlockB,paraB.Size());
+}
+
+void SparseLM::MakePara(real64 l)
+{
+ lambda = l;
+
+ // Invert the augmented V's, then construct es...
+  RunJob(slmDampB,paraB.Size());
+  RunJob(slmReduceA,paraA.Size());
+
+ // Solve for the first list deltas, replacing es with them...
+  if (useCG) SolveCG();
+        else SolveDense();
+
+ // Calculate and apply the second list deltas...
+  RunJob(slmBackB,paraB.Size());
+
+ // Apply the first list deltas...
+  for (nat32 i=0;i<paraA.Size();i++)
+  {
+   nat32 base = i*sizeA;
+   Vector<real64> & targ = *paraA[i]->paraNew;
+   for (nat32 j=0;j<sizeA;j++) targ[j] = (*paraA[i]->para)[j] - (*es)[base+j];
+   if (paraA[i]->C) (*paraA[i]->C)(targ);
+  }
+}
+
+bit SparseLM::SolveDense()
+{
+ RunJob(slmBuildS,paraA.Size());
+
+ // Cholesky, S = G G^T, then solve with G and G^T in turn...
+  if (Cholesky(*s))
+  {
+   SolveLinearLowerTri(*s,*es);
+
+   int32 n = es->Size();
+   for (int32 i=n-1;i>=0;i--)
    {
-    Zero(*paraA[i]->uv);
-    for (nat32 j=0;j<paraA[i]->e->Size();j++) (*paraA[i]->e)[j] = 0.0;
-    
-    targ = listA[i];
-    while (targ)
+    real64 t = (*es)[i];
+    for (int32 j=i+1;j<n;j++) t -= (*s)[j][i] * (*es)[j];
+    (*es)[i] = t/(*s)[i][i];
+   }
+   return true;
+  }
+
+ // Failed, so its not positive definite - fall back to the pseudo inverse...
+  LogDebug("[math.sparse_lm] Cholesky failed, using pseudo inverse {lambda}" << LogDiv() << lambda);
+  RunJob(slmBuildS,paraA.Size());
+  PseudoInverse(*s,*pimt);
+
+  Vector<real64> temp(*es);
+  MultVect(*s,temp,*es);
+  return false;
+}
+
+void SparseLM::SolveCG()
+{
+ nat32 sSize = es->Size();
+
+ // Setup, starting from zero so the residual is es...
+  RunJob(slmPrecondA,paraA.Size());
+
+  for (nat32 i=0;i<sSize;i++)
+  {
+   (*cgX)[i] = 0.0;
+   (*cgR)[i] = (*es)[i];
+  }
+
+ // Iterate...
+  real64 limit = math::Sqr(cgTol) * cgR->LengthSqr();
+  real64 rz = 0.0;
+  nat32 iter = 0;
+  for (;iter<cgMaxIter;iter++)
+  {
+   // Apply the block-Jacobi preconditioner, z = M^-1 r...
+    for (nat32 a=0;a<paraA.Size();a++)
     {
-     if (targ->covarInv)
+     nat32 base = a*sizeA;
+     const Matrix<real64> & inv = *paraA[a]->inv;
+     for (nat32 r=0;r<sizeA;r++)
      {
-      // Calculate common factor...
-       TransMult(*targ->aJacob,*targ->covarInv,*tempAerr);
-      
-      // Calculate U...
-       Mult(*tempAerr,*targ->aJacob,*tempU);
-       (*paraA[i]->uv) += *tempU;
-     
-      // Calculate e_a...   
-       MultVect(*tempAerr,*targ->err,*tempParaA);
-       (*paraA[i]->e) += *tempParaA;
+      real64 t = 0.0;
+      for (nat32 c=0;c<sizeA;c++) t += inv[r][c] * (*cgR)[base+c];
+      (*cgZ)[base+r] = t;
      }
-     else
-     {
-      // Calculate U...
-       TransMult(*targ->aJacob,*targ->aJacob,*tempU);
-       (*paraA[i]->uv) += *tempU;
-       
-      // Calculate e_a...   
-       TransMultVect(*targ->aJacob,*targ->err,*tempParaA);
-       (*paraA[i]->e) += *tempParaA;
-     } 
-     targ = targ->nextA;
     }
-   }
-  
-  // Pass through the b list...
-   for (nat32 i=0;i<paraB.Size();i++)
-   {
-    Zero(*paraB[i]->uv);
-    for (nat32 j=0;j<paraB[i]->e->Size();j++) (*paraB[i]->e)[j] = 0.0;
-    
-    targ = listB[i];
-    while (targ)
+
+   // Update the search direction...
+    real64 rzNew = 0.0;
+    for (nat32 i=0;i<sSize;i++) rzNew += (*cgR)[i] * (*cgZ)[i];
+
+    if (iter==0)
+    {
+     for (nat32 i=0;i<sSize;i++) (*cgP)[i] = (*cgZ)[i];
+    }
+    else
     {
-     if (targ->covarInv)
+     real64 beta = rzNew/rz;
+     for (nat32 i=0;i<sSize;i++) (*cgP)[i] = (*cgZ)[i] + beta*(*cgP)[i];
+    }
+    rz = rzNew;
+
+   // q = S p, without ever constructing S...
+    multIn = cgP;
+    multOut = cgQ;
+    RunJob(slmMultB,paraB.Size());
+    RunJob(slmMultA,paraA.Size());
+
+   // Step...
+    real64 pq = 0.0;
+    for (nat32 i=0;i<sSize;i++) pq += (*cgP)[i] * (*cgQ)[i];
+    if (!(pq>0.0)) break;
+    real64 alpha = rz/pq;
+
+    for (nat32 i=0;i<sSize;i++)
+    {
+     (*cgX)[i] += alpha * (*cgP)[i];
+     (*cgR)[i] -= alpha * (*cgQ)[i];
+    }
+
+    if (cgR->LengthSqr()<=limit) {++iter; break;}
+  }
+
+ LogDebug("[math.sparse_lm] Conjugate gradient {iterations,lambda}" << LogDiv() << iter << LogDiv() << lambda);
+
+ for (nat32 i=0;i<sSize;i++) (*es)[i] = (*cgX)[i];
+}
+
+void SparseLM::Do(nat32 job,nat32 unit,nat32 thread)
+{
+ Scratch & sc = scratch[thread];
+ switch (job)
+ {
+  case slmResidual:
+  {
+   PairNode * targ = pair[unit];
+   (targ->F)(*paraA[targ->a]->para,*paraB[targ->b]->para,*targ->m,*targ->err);
+  }
+  break;
+
+  case slmResidualNew:
+  {
+   PairNode * targ = pair[unit];
+   (targ->F)(*paraA[targ->a]->paraNew,*paraB[targ->b]->paraNew,*targ->m,*targ->errNew);
+  }
+  break;
+
+  case slmJacobian:
+  {
+   PairNode * targ = pair[unit];
+   const Vector<real64> & pa = *paraA[targ->a]->para;
+   const Vector<real64> & pb = *paraB[targ->b]->para;
+
+   if (targ->J) (targ->J)(pa,pb,*targ->m,*targ->aJacob,*targ->bJacob);
+   else
+   {
+    // Jacobian A...
+     sc.paraA = pa;
+     for (nat32 c=0;c<sizeA;c++)
      {
-      // Calculate common factor...
-       TransMult(*targ->bJacob,*targ->covarInv,*tempBerr);
-      
-      // Calculate V...
-       Mult(*tempBerr,*targ->bJacob,*tempV);
-       (*paraB[i]->uv) += *tempV;
-     
-      // Calculate e_a...   
-       MultVect(*tempBerr,*targ->err,*tempParaB);
-       (*paraB[i]->e) += *tempParaB;
+      real64 delta = Max(Abs(10e-4 * sc.paraA[c]),10e-6);
+      sc.paraA[c] += delta;
+
+      (targ->F)(sc.paraA,pb,*targ->m,sc.err);
+      delta = 1.0/delta;
+      for (nat32 r=0;r<sizeErr;r++)
+      {
+       (*targ->aJacob)[r][c] = (sc.err[r] - (*targ->err)[r])*delta;
+      }
+
+      sc.paraA[c] = pa[c];
      }
-     else
+
+    // B Jacobian...
+     sc.paraB = pb;
+     for (nat32 c=0;c<sizeB;c++)
      {
-      // Calculate V...
-       TransMult(*targ->bJacob,*targ->bJacob,*tempV);
-       (*paraB[i]->uv) += *tempV;
-       
-      // Calculate e_a...   
-       TransMultVect(*targ->bJacob,*targ->err,*tempParaB);
-       (*paraB[i]->e) += *tempParaB;            
+      real64 delta = Max(Abs(10e-4 * sc.paraB[c]),10e-6);
+      sc.paraB[c] += delta;
+
+      (targ->F)(pa,sc.paraB,*targ->m,sc.err);
+      delta = 1.0/delta;
+      for (nat32 r=0;r<sizeErr;r++)
+      {
+       (*targ->bJacob)[r][c] = (sc.err[r] - (*targ->err)[r])*delta;
+      }
+
+      sc.paraB[c] = pb[c];
      }
-     targ = targ->nextB;
+   }
+
+   // W...
+    if (targ->covarInv)
+    {
+     TransMult(*targ->aJacob,*targ->covarInv,sc.aErr);
+     Mult(sc.aErr,*targ->bJacob,*targ->w);
     }
+    else
+    {
+     TransMult(*targ->aJacob,*targ->bJacob,*targ->w);
+    }
+  }
+  break;
+
+  case slmBlockA:
+  {
+   ParaNode & pn = *paraA[unit];
+   Zero(*pn.uv);
+   for (nat32 j=0;j<sizeA;j++) (*pn.e)[j] = 0.0;
+
+   PairNode * targ = listA[unit];
+   while (targ)
+   {
+    if (targ->covarInv)
+    {
+     TransMult(*targ->aJacob,*targ->covarInv,sc.aErr);
+     Mult(sc.aErr,*targ->aJacob,sc.u);
+     MultVect(sc.aErr,*targ->err,sc.paraA);
+    }
+    else
+    {
+     TransMult(*targ->aJacob,*targ->aJacob,sc.u);
+     TransMultVect(*targ->aJacob,*targ->err,sc.paraA);
+    }
+    *pn.uv += sc.u;
+    *pn.e += sc.paraA;
+    targ = targ->nextA;
    }
-  
-  // Pass through the error set...
-   targ = list;
+  }
+  break;
+
+  case slmBlockB:
+  {
+   ParaNode & pn = *paraB[unit];
+   Zero(*pn.uv);
+   for (nat32 j=0;j<sizeB;j++) (*pn.e)[j] = 0.0;
+
+   PairNode * targ = listB[unit];
    while (targ)
    {
     if (targ->covarInv)
     {
-     TransMult(*targ->aJacob,*targ->covarInv,*tempU);
-     Mult(*tempU,*targ->bJacob,*targ->w);
+     TransMult(*targ->bJacob,*targ->covarInv,sc.bErr);
+     Mult(sc.bErr,*targ->bJacob,sc.v);
+     MultVect(sc.bErr,*targ->err,sc.paraB);
     }
     else
     {
-     TransMult(*targ->aJacob,*targ->bJacob,*targ->w);
-    }    
-    targ = targ->next;
+     TransMult(*targ->bJacob,*targ->bJacob,sc.v);
+     TransMultVect(*targ->bJacob,*targ->err,sc.paraB);
+    }
+    *pn.uv += sc.v;
+    *pn.e += sc.paraB;
+    targ = targ->nextB;
    }
-}
+  }
+  break;
 
-void SparseLM::MakePara(real64 lambda)
-{
- // Calculate the only intermediate value dependent on lambda, Y...
- {
-  PairNode * targ = list;
-  while (targ)
+  case slmDampB:
   {
-   *tempV = *paraB[targ->b]->uv;
-   for (nat32 i=0;i<sizeB;i++) (*tempV)[i][i] *= 1.0 + lambda;
-   Inverse(*tempV,*tempV2);
-   Mult(*targ->w,*tempV,*targ->y);   
-   targ = targ->next;
+   ParaNode & pn = *paraB[unit];
+   *pn.inv = *pn.uv;
+   for (nat32 i=0;i<sizeB;i++) (*pn.inv)[i][i] *= 1.0 + lambda;
+   Inverse(*pn.inv,sc.v);
+   MultVect(*pn.inv,*pn.e,*pn.t);
   }
- }
+  break;
 
+  case slmReduceA:
+  {
+   nat32 base = unit*sizeA;
+   for (nat32 j=0;j<sizeA;j++) (*es)[base+j] = (*paraA[unit]->e)[j];
+
+   PairNode * targ = listA[unit];
+   while (targ)
+   {
+    MultVect(*targ->w,*paraB[targ->b]->t,sc.paraA);
+    for (nat32 j=0;j<sizeA;j++) (*es)[base+j] -= sc.paraA[j];
+    targ = targ->nextA;
+   }
+  }
+  break;
 
- // Construct S...
-  Zero(*s);  
-  // The main bit, with different code for the diagonals..
-   for (nat32 br=0;br<paraA.Size();br++)
+  case slmBuildS:
+  {
+   nat32 br = unit;
+   nat32 baseR = br*sizeA;
+   for (nat32 r=0;r<sizeA;r++)
    {
+    for (nat32 c=0;c<s->Cols();c++) (*s)[baseR+r][c] = 0.0;
+   }
+
+   // Augmented U on the diagonal...
+    for (nat32 r=0;r<sizeA;r++)
+    {
+     for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseR+c] = (*paraA[br]->uv)[r][c];
+     (*s)[baseR+r][baseR+r] *= 1.0 + lambda;
+    }
+
+   // Subtract W V^*-1 W^T for every second list entry that the row shares
+   // with each column. The sorted lists make finding them a merge...
     for (nat32 bc=0;bc<paraA.Size();bc++)
     {
-     nat32 baseR = br*sizeA;
      nat32 baseC = bc*sizeA;
-
-     if (bc==br)
-     {
-      // Diagonal...
-       // Sum in augmented U...
-        for (nat32 r=0;r<sizeA;r++)
-        {
-         for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] = (*paraA[bc]->uv)[r][c];
-        }
-        for (nat32 i=0;i<sizeA;i++) (*s)[baseR+i][baseC+i] *= 1.0 + lambda;
-        
-       // Subtract the combinations for each point...
-        PairNode * targ = listA[br];
-        while (targ)
-        {
-         MultTrans(*targ->y,*targ->w,*tempU);
-         for (nat32 r=0;r<sizeA;r++)
-         {
-          for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] -= (*tempU)[r][c];
-         }
-         targ = targ->nextA;
-        }
-     }
-     else
+     PairNode * targY = listA[br];
+     PairNode * targW = listA[bc];
+     while (targY&&targW)
      {
-      // Off-diagonal - subtract point combinations...
-       PairNode * targY = listA[br];
-       PairNode * targW = listA[bc];
-       while (targY&&targW)
+      if (targY->b==targW->b)
+      {
+       Mult(*targY->w,*paraB[targY->b]->inv,sc.ab);
+       MultTrans(sc.ab,*targW->w,sc.u);
+       for (nat32 r=0;r<sizeA;r++)
        {
-        if (targY->b==targW->b)
-        {
-         // We have a match - multiply and subtract...
-          MultTrans(*targY->y,*targW->w,*tempU);
-          for (nat32 r=0;r<sizeA;r++)
-          {
-           for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] -= (*tempU)[r][c];
-          }
-         targY = targY->nextA;
-         targW = targW->nextA;         
-        }
-        else
-        {
-         if (targY->b<targW->b) targY = targY->nextA;
-                           else targW = targW->nextA;
-        }
-       }       
+        for (nat32 c=0;c<sizeA;c++) (*s)[baseR+r][baseC+c] -= sc.u[r][c];
+       }
+       targY = targY->nextA;
+       targW = targW->nextA;
+      }
+      else
+      {
+       if (targY->b<targW->b) targY = targY->nextA;
+                         else targW = targW->nextA;
+      }
      }
     }
-   }
-
+  }
+  break;
 
- // Construct es...
-  for (nat32 i=0;i<paraA.Size();i++)
+  case slmPrecondA:
   {
-   nat32 base = i*sizeA;
-   for (nat32 j=0;j<sizeA;j++) (*es)[base+j] = (*paraA[i]->e)[j];
-   
-   PairNode * targ = listA[i];
+   ParaNode & pn = *paraA[unit];
+   *pn.inv = *pn.uv;
+   for (nat32 i=0;i<sizeA;i++) (*pn.inv)[i][i] *= 1.0 + lambda;
+
+   PairNode * targ = listA[unit];
    while (targ)
    {
-    MultVect(*targ->y,*paraB[targ->b]->e,*tempParaA);    
-    for (nat32 j=0;j<sizeA;j++) (*es)[base+j] -= (*tempParaA)[j];
+    Mult(*targ->w,*paraB[targ->b]->inv,sc.ab);
+    MultTrans(sc.ab,*targ->w,sc.u);
+    *pn.inv -= sc.u;
     targ = targ->nextA;
    }
-  }
 
+   if (!Inverse(*pn.inv,sc.u)) Identity(*pn.inv);
+  }
+  break;
 
- // From S & es calculate the deltas for the first list...
- // (A pseudo inverse and inline multiply.)
-  PseudoInverse(*s,*pimt);
-  for (nat32 i=0;i<paraA.Size();i++)
+  case slmMultB:
   {
-   nat32 base = i*sizeA;
-   Vector<real64> & targ = *paraA[i]->paraNew;
-   for (nat32 j=0;j<sizeA;j++)
-   {
-    targ[j] = 0.0;
-    for (nat32 k=0;k<s->Cols();k++) targ[j] += (*s)[base+j][k] * (*es)[k];
-   }
+   // t = V^*-1 W^T x...
+    ParaNode & pn = *paraB[unit];
+    for (nat32 j=0;j<sizeB;j++) sc.paraB[j] = 0.0;
+
+    PairNode * targ = listB[unit];
+    while (targ)
+    {
+     nat32 base = targ->a*sizeA;
+     for (nat32 r=0;r<sizeA;r++)
+     {
+      real64 x = (*multIn)[base+r];
+      for (nat32 c=0;c<sizeB;c++) sc.paraB[c] += (*targ->w)[r][c] * x;
+     }
+     targ = targ->nextB;
+    }
+
+    MultVect(*pn.inv,sc.paraB,*pn.t);
   }
- 
- 
- // Calculate and apply the second list deltas in one swoop...
-  for (nat32 i=0;i<paraB.Size();i++)
+  break;
+
+  case slmMultA:
   {
-   // Fill a vector with the relevent starting vector...
-    *tempParaB = *paraB[i]->e;
-    
-   // Subtract the W's by the a list deltas...
-    PairNode * targ = listB[i];
+   // out = U^* x - W t...
+    ParaNode & pn = *paraA[unit];
+    nat32 base = unit*sizeA;
+    for (nat32 r=0;r<sizeA;r++)
+    {
+     real64 v = 0.0;
+     for (nat32 c=0;c<sizeA;c++) v += (*pn.uv)[r][c] * (*multIn)[base+c];
+     v += lambda * (*pn.uv)[r][r] * (*multIn)[base+r];
+     (*multOut)[base+r] = v;
+    }
+
+    PairNode * targ = listA[unit];
     while (targ)
     {
-     TransMultVect(*targ->w,*paraA[targ->a]->paraNew,*paraB[i]->paraNew);
-     *tempParaB -= *paraB[i]->paraNew;    
-     targ = targ->nextB;
+     MultVect(*targ->w,*paraB[targ->b]->t,sc.paraA);
+     for (nat32 r=0;r<sizeA;r++) (*multOut)[base+r] -= sc.paraA[r];
+     targ = targ->nextA;
     }
-   
-   // Multiply by V^*-1, to get the b list deltas...
-    *tempV = *paraB[i]->uv;
-    for (nat32 j=0;j<sizeB;j++) (*tempV)[j][j] *= 1.0 + lambda;    
-    Inverse(*tempV,*tempV2);
-    
-    MultVect(*tempV,*tempParaB,*paraB[i]->paraNew);
-    *paraB[i]->paraNew += *paraB[i]->para;
-    if (paraB[i]->C) (*paraB[i]->C)(*paraB[i]->paraNew);
   }
- 
- 
- // Apply the first list deltas...
-  for (nat32 i=0;i<paraA.Size();i++)
+  break;
+
+  case slmBackB:
   {
-   *paraA[i]->paraNew += *paraA[i]->para;   
-   if (paraA[i]->C) (*paraA[i]->C)(*paraA[i]->paraNew);
+   // Start with e, subtract the W's by the first list deltas...
+    ParaNode & pn = *paraB[unit];
+    sc.paraB = *pn.e;
+
+    PairNode * targ = listB[unit];
+    while (targ)
+    {
+     nat32 base = targ->a*sizeA;
+     for (nat32 r=0;r<sizeA;r++)
+     {
+      real64 d = (*es)[base+r];
+      for (nat32 c=0;c<sizeB;c++) sc.paraB[c] -= (*targ->w)[r][c] * d;
+     }
+     targ = targ->nextB;
+    }
+
+   // Multiply by V^*-1 to get the deltas, apply...
+    MultVect(*pn.inv,sc.paraB,*pn.paraNew);
+    for (nat32 j=0;j<sizeB;j++) (*pn.paraNew)[j] = (*pn.para)[j] - (*pn.paraNew)[j];
+    if (pn.C) (*pn.C)(*pn.paraNew);
   }
+  break;
+ }
 }
 
 //------------------------------------------------------------------------------
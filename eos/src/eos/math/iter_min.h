@@ -387,14 +387,20 @@ inline void JacobianLM(nat32 evs,const Vector<RT> & pv,const OT & oi,
 /// - Each element of the error vector is only dependent on its two associated entrys, assuming it exists at all.
 ///
 /// This means that the error function passed in is given two parameter vectors as well
-/// as its own measurement vector. This class does not accept jacobian matrice functions
-/// due to the complexity of specification, it does however accept covariance matrices.
+/// as its own measurement vector. Jacobians are calculated numerically unless a
+/// function to calculate them is provided with the error function. Covariance
+/// matrices are also accepted.
 /// From an optimisation point of view the first list is presumed greatly smaller than
-/// the second, best to stick to this pattern.
+/// the second, best to stick to this pattern - the second list is eliminated
+/// with the Schur complement, leaving the reduced system for the first list,
+/// which is solved either with a dense Cholesky decomposition or with block-Jacobi
+/// preconditioned conjugate gradient. The dense solver uses memory quadratic in
+/// the size of the first list, the conjugate gradient solver memory linear in
+/// the number of error functions, so use it for large problems.
+/// Error functions, Jacobians and all of the per-parameter work are evaluated in
+/// parallel using mt::SharedPool(), so the function pointers must be thread safe.
 ///
-/// This is a use and delete class, you can not use it twice. The memory consumption is
-/// heavy also, so deleting it straight after use is recomended unless you want to start
-/// paging, or even exceding memory address space on a 32 bit computer.
+/// This is a use and delete class, you can not use it twice.
 class EOS_CLASS SparseLM
 {
  public:
@@ -428,8 +434,12 @@ class EOS_CLASS SparseLM
   /// called it fundamentally changes the internal data structure. Obviously,
   /// you must call this at least once before calling Run, and you must *never*
   /// call this multiple times for the same (a,b) key.
+  /// J is optional - if provided it must calculate the Jacobians of the error
+  /// vector with respect to a and b, sizeErr x sizeA and sizeErr x sizeB
+  /// respectivly, otherwise they are calculated numerically.
    void AddError(nat32 a,nat32 b,const Vector<real64> & m,
-                 void (*F)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Vector<real64> & err));
+                 void (*F)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Vector<real64> & err),
+                 void (*J)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Matrix<real64> & ja,Matrix<real64> & jb) = 0);
 
   /// This sets a constraint function for a parameter vector, called after the
   /// vector changes so it can correct any inconsistancy in a representation with
@@ -455,6 +465,14 @@ class EOS_CLASS SparseLM
    void AddCovar(nat32 a,nat32 b,const Matrix<real64> & covar);
 
 
+  /// Selects the solver used for the reduced system. By default a dense
+  /// Cholesky decomposition is used, which is fastest for small numbers of
+  /// first list entries. Enabling this switches to block-Jacobi preconditioned
+  /// conjugate gradient, with the given iteration cap and tolerance, relative
+  /// to the initial residual.
+   void UseCG(bit enable,nat32 maxIter = 500,real64 tol = 1e-10);
+
+
   /// This does the calculation. Whilst it does take a progress object it dosn't use it
   /// properly as it never knows when the main loop is goig to end till it does, so it
   /// just keeps track of how many loops it has actually done.
@@ -474,6 +492,8 @@ class EOS_CLASS SparseLM
 
 
  private:
+  friend class SparseLMJob;
+
   // Internal constant variables...
    static const real64 maxLambda = 1e100;
    static const nat32 maxIter = 1000;
@@ -483,6 +503,11 @@ class EOS_CLASS SparseLM
    nat32 sizeB;
    nat32 sizeErr;
 
+  // Solver selection...
+   bit useCG;
+   nat32 cgMaxIter;
+   real64 cgTol;
+
   // The pre-AddError data structure, just a pair of linked lists of parameters...
    bit preStruct; // true when the below stuff is actually in use.
    ds::List< Vector<real64>*,mem::KillDel< Vector<real64> > > paraListA;
@@ -496,10 +521,11 @@ class EOS_CLASS SparseLM
     {
       ParaNode()
       :C(0),para(null<Vector<real64>*>()),paraNew(null<Vector<real64>*>()),
-      uv(null<Matrix<real64>*>()),e(null<Vector<real64>*>())
+      uv(null<Matrix<real64>*>()),e(null<Vector<real64>*>()),
+      inv(null<Matrix<real64>*>()),t(null<Vector<real64>*>())
       {}
 
-     ~ParaNode() {delete para; delete paraNew; delete uv; delete e;}
+     ~ParaNode() {delete para; delete paraNew; delete uv; delete e; delete inv; delete t;}
      
      void (*C)(Vector<real64> & a);
      
@@ -507,25 +533,27 @@ class EOS_CLASS SparseLM
      Vector<real64> * paraNew;
      Matrix<real64> * uv; // Either the u or v matrix.
      Vector<real64> * e;
+     Matrix<real64> * inv; // For b the inverse of the augmented v, for a the inverse of the diagonal block of s, for preconditioning.
+     Vector<real64> * t; // Tempory, used when multiplying by s.
     };
 
     ds::Array< ParaNode*,mem::MakeNull< ParaNode* >,mem::KillDel< ParaNode > > paraA;
     ds::Array< ParaNode*,mem::MakeNull< ParaNode* >,mem::KillDel< ParaNode > > paraB;
 
-   // A structure and Array2D which stores some data for every pair taken from 
-   // paraA and paraB. Several linked lists are also created over this structure
+   // A node for every pair taken from paraA and paraB that has an error
+   // function. Several linked lists are also created over this structure
    // for efficient access of relevent data sets...
     struct PairNode
     {
       PairNode()
-      :m(null< Vector<real64>* >()),covarInv(null< Matrix<real64>* >()),
+      :J(0),m(null< Vector<real64>* >()),covarInv(null< Matrix<real64>* >()),
       err(null< Vector<real64>* >()),errNew(null< Vector<real64>* >()),
       aJacob(null< Matrix<real64>* >()),bJacob(null< Matrix<real64>* >()),
-      w(null< Matrix<real64>* >()),y(null< Matrix<real64>* >())
+      w(null< Matrix<real64>* >())
       {}
       
      ~PairNode()
-     {delete m; delete covarInv; delete err; delete errNew; delete aJacob; delete bJacob; delete w; delete y;}
+     {delete m; delete covarInv; delete err; delete errNew; delete aJacob; delete bJacob; delete w;}
      
   
      // Linked list stuff...
@@ -539,6 +567,7 @@ class EOS_CLASS SparseLM
      // Parameters passed in with regards to this coordinate...
       Vector<real64> * m;
       void (*F)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Vector<real64> & err);
+      void (*J)(const Vector<real64> & a,const Vector<real64> & b,const Vector<real64> & m,Matrix<real64> & ja,Matrix<real64> & jb);
       Matrix<real64> * covarInv; // Store the inverse, as we don't need the not-inverse.
 
      // Intermediate storage used during algorithm run time...
@@ -548,35 +577,57 @@ class EOS_CLASS SparseLM
       Matrix<real64> * bJacob;
       
       Matrix<real64> * w;
-      Matrix<real64> * y; 
     };
     
     // Linked lists of pair nodes...     
      PairNode * list; // A linked list of all PairNode's.
      ds::Array<PairNode*,mem::MakeNull< PairNode* > > listA;
      ds::Array<PairNode*,mem::MakeNull< PairNode* > > listB;
+     ds::Array<PairNode*> pair; // All PairNode's, indexed so they can be divided between threads.
      
      
   // The runtime data structures, to save passing parameters between methods...
-   Vector<real64> * tempParaA;
-   Vector<real64> * tempParaB;   
-   Vector<real64> * tempErr;  
-   
-   Matrix<real64> * tempAerr; // sizeA by sizeErr matrix.
-   Matrix<real64> * tempBerr; // sizeB by sizeErr matrix.
-   
-   Matrix<real64> * tempU; // sizeA by sizeA matrix.
-   Matrix<real64> * tempV; // sizeB by sizeB matrix.
-   Matrix<real64> * tempV2; // sizeB by sizeB matrix.
-   
-   PseudoInverseTemp<real64> * pimt;
-   Matrix<real64> * s;
-   Vector<real64> * es;
-  
+   // Per-thread tempories...
+    struct Scratch
+    {
+     Vector<real64> paraA; // sizeA
+     Vector<real64> paraB; // sizeB
+     Vector<real64> err; // sizeErr
+
+     Matrix<real64> aErr; // sizeA by sizeErr matrix.
+     Matrix<real64> bErr; // sizeB by sizeErr matrix.
+     Matrix<real64> u; // sizeA by sizeA matrix.
+     Matrix<real64> u2; // sizeA by sizeA matrix.
+     Matrix<real64> v; // sizeB by sizeB matrix.
+     Matrix<real64> ab; // sizeA by sizeB matrix.
+    };
+    ds::ArrayDel<Scratch> scratch;
+
+   real64 lambda;
+
+   // Dense solver...
+    PseudoInverseTemp<real64> * pimt;
+    Matrix<real64> * s;
+    Vector<real64> * es;
+
+   // Conjugate gradient solver, all of size sizeA * paraA.Size()...
+    Vector<real64> * cgX;
+    Vector<real64> * cgR;
+    Vector<real64> * cgZ;
+    Vector<real64> * cgP;
+    Vector<real64> * cgQ;
+    const Vector<real64> * multIn; // Input and output of the multiplication by s.
+    Vector<real64> * multOut;
+
   // Internal methods, these do all the real work...
+   void Do(nat32 job,nat32 unit,nat32 thread);
+   void RunJob(nat32 job,nat32 units);
+   real64 Residual(bit useNew);
    void MakeJacobians();
    void NonLambdaWork();
    void MakePara(real64 lambda);
+   bit SolveDense();
+   void SolveCG();
 };
 
 //------------------------------------------------------------------------------
@@ -711,6 +711,46 @@ inline T Determinant(const Matrix<T> & mat)
  return SubDeterminant(const_cast<T*>(&mat[0][0]),mat.Rows(),mat.Cols());
 }
 
+/// Closed form determinant for 2x2 matrices, selected in preference to the
+/// general version.
+template <typename T>
+inline T Determinant(const Mat<2,2,T> & mat)
+{
+ return mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0];
+}
+
+/// Closed form determinant for 3x3 matrices, selected in preference to the
+/// general version.
+template <typename T>
+inline T Determinant(const Mat<3,3,T> & mat)
+{
+ return mat[0][0]*(mat[1][1]*mat[2][2] - mat[1][2]*mat[2][1]) -
+        mat[0][1]*(mat[1][0]*mat[2][2] - mat[1][2]*mat[2][0]) +
+        mat[0][2]*(mat[1][0]*mat[2][1] - mat[1][1]*mat[2][0]);
+}
+
+/// Closed form determinant for 4x4 matrices, selected in preference to the
+/// general version. Uses the 2x2 minors of the top and bottom row pairs.
+template <typename T>
+inline T Determinant(const Mat<4,4,T> & mat)
+{
+ T s0 = mat[0][0]*mat[1][1] - mat[1][0]*mat[0][1];
+ T s1 = mat[0][0]*mat[1][2] - mat[1][0]*mat[0][2];
+ T s2 = mat[0][0]*mat[1][3] - mat[1][0]*mat[0][3];
+ T s3 = mat[0][1]*mat[1][2] - mat[1][1]*mat[0][2];
+ T s4 = mat[0][1]*mat[1][3] - mat[1][1]*mat[0][3];
+ T s5 = mat[0][2]*mat[1][3] - mat[1][2]*mat[0][3];
+
+ T c5 = mat[2][2]*mat[3][3] - mat[3][2]*mat[2][3];
+ T c4 = mat[2][1]*mat[3][3] - mat[3][1]*mat[2][3];
+ T c3 = mat[2][1]*mat[3][2] - mat[3][1]*mat[2][2];
+ T c2 = mat[2][0]*mat[3][3] - mat[3][0]*mat[2][3];
+ T c1 = mat[2][0]*mat[3][2] - mat[3][0]*mat[2][2];
+ T c0 = mat[2][0]*mat[3][1] - mat[3][0]*mat[2][1];
+
+ return s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+}
+
 //------------------------------------------------------------------------------
 /// Solves the classical Ax = b for x where A is a lower triangular matrix.
 /// Overwrites b with x. A must be a square matrix, x and b are vectors.
@@ -1075,7 +1115,7 @@ inline bit Inverse(MT & mat,MT & temp)
    for (nat32 i=0;i<mat.Rows();i++)
    {
     if (i==r) continue;
-    real32 factor = mat[i][r];
+    typename MT::type factor = mat[i][r];
     mat[i][r] = 0.0;
 
     for (nat32 j=r+1;j<mat.Cols();j++) mat[i][j] -= factor * mat[r][j];
@@ -1087,6 +1127,102 @@ inline bit Inverse(MT & mat,MT & temp)
  return true;
 }
 
+/// Closed form inverse for 2x2 matrices, selected in preference to the general
+/// version. Fails only if the determinant is zero. temp is not used.
+template <typename T>
+inline bit Inverse(Mat<2,2,T> & mat,Mat<2,2,T> &)
+{
+ T det = mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0];
+ if (math::IsZero(det)) return false;
+ T inv = static_cast<T>(1)/det;
+
+ T m00 = mat[0][0];
+ mat[0][0] = mat[1][1]*inv;
+ mat[1][1] = m00*inv;
+ mat[0][1] *= -inv;
+ mat[1][0] *= -inv;
+ return true;
+}
+
+/// Closed form inverse for 3x3 matrices, via the adjugate, selected in
+/// preference to the general version. Fails only if the determinant is zero.
+/// temp is used to hold the adjugate.
+template <typename T>
+inline bit Inverse(Mat<3,3,T> & mat,Mat<3,3,T> & temp)
+{
+ temp[0][0] = mat[1][1]*mat[2][2] - mat[1][2]*mat[2][1];
+ temp[1][0] = mat[1][2]*mat[2][0] - mat[1][0]*mat[2][2];
+ temp[2][0] = mat[1][0]*mat[2][1] - mat[1][1]*mat[2][0];
+
+ T det = mat[0][0]*temp[0][0] + mat[0][1]*temp[1][0] + mat[0][2]*temp[2][0];
+ if (math::IsZero(det)) return false;
+ T inv = static_cast<T>(1)/det;
+
+ temp[0][1] = mat[0][2]*mat[2][1] - mat[0][1]*mat[2][2];
+ temp[1][1] = mat[0][0]*mat[2][2] - mat[0][2]*mat[2][0];
+ temp[2][1] = mat[0][1]*mat[2][0] - mat[0][0]*mat[2][1];
+ temp[0][2] = mat[0][1]*mat[1][2] - mat[0][2]*mat[1][1];
+ temp[1][2] = mat[0][2]*mat[1][0] - mat[0][0]*mat[1][2];
+ temp[2][2] = mat[0][0]*mat[1][1] - mat[0][1]*mat[1][0];
+
+ for (nat32 r=0;r<3;r++)
+ {
+  mat[r][0] = temp[r][0]*inv;
+  mat[r][1] = temp[r][1]*inv;
+  mat[r][2] = temp[r][2]*inv;
+ }
+ return true;
+}
+
+/// Closed form inverse for 4x4 matrices, via the adjugate expressed with the
+/// 2x2 minors of the top and bottom row pairs, selected in preference to the
+/// general version. Fails only if the determinant is zero. temp is used to
+/// hold the adjugate.
+template <typename T>
+inline bit Inverse(Mat<4,4,T> & mat,Mat<4,4,T> & temp)
+{
+ T s0 = mat[0][0]*mat[1][1] - mat[1][0]*mat[0][1];
+ T s1 = mat[0][0]*mat[1][2] - mat[1][0]*mat[0][2];
+ T s2 = mat[0][0]*mat[1][3] - mat[1][0]*mat[0][3];
+ T s3 = mat[0][1]*mat[1][2] - mat[1][1]*mat[0][2];
+ T s4 = mat[0][1]*mat[1][3] - mat[1][1]*mat[0][3];
+ T s5 = mat[0][2]*mat[1][3] - mat[1][2]*mat[0][3];
+
+ T c5 = mat[2][2]*mat[3][3] - mat[3][2]*mat[2][3];
+ T c4 = mat[2][1]*mat[3][3] - mat[3][1]*mat[2][3];
+ T c3 = mat[2][1]*mat[3][2] - mat[3][1]*mat[2][2];
+ T c2 = mat[2][0]*mat[3][3] - mat[3][0]*mat[2][3];
+ T c1 = mat[2][0]*mat[3][2] - mat[3][0]*mat[2][2];
+ T c0 = mat[2][0]*mat[3][1] - mat[3][0]*mat[2][1];
+
+ T det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+ if (math::IsZero(det)) return false;
+ T inv = static_cast<T>(1)/det;
+
+ temp[0][0] = ( mat[1][1]*c5 - mat[1][2]*c4 + mat[1][3]*c3)*inv;
+ temp[0][1] = (-mat[0][1]*c5 + mat[0][2]*c4 - mat[0][3]*c3)*inv;
+ temp[0][2] = ( mat[3][1]*s5 - mat[3][2]*s4 + mat[3][3]*s3)*inv;
+ temp[0][3] = (-mat[2][1]*s5 + mat[2][2]*s4 - mat[2][3]*s3)*inv;
+
+ temp[1][0] = (-mat[1][0]*c5 + mat[1][2]*c2 - mat[1][3]*c1)*inv;
+ temp[1][1] = ( mat[0][0]*c5 - mat[0][2]*c2 + mat[0][3]*c1)*inv;
+ temp[1][2] = (-mat[3][0]*s5 + mat[3][2]*s2 - mat[3][3]*s1)*inv;
+ temp[1][3] = ( mat[2][0]*s5 - mat[2][2]*s2 + mat[2][3]*s1)*inv;
+
+ temp[2][0] = ( mat[1][0]*c4 - mat[1][1]*c2 + mat[1][3]*c0)*inv;
+ temp[2][1] = (-mat[0][0]*c4 + mat[0][1]*c2 - mat[0][3]*c0)*inv;
+ temp[2][2] = ( mat[3][0]*s4 - mat[3][1]*s2 + mat[3][3]*s0)*inv;
+ temp[2][3] = (-mat[2][0]*s4 + mat[2][1]*s2 - mat[2][3]*s0)*inv;
+
+ temp[3][0] = (-mat[1][0]*c3 + mat[1][1]*c1 - mat[1][2]*c0)*inv;
+ temp[3][1] = ( mat[0][0]*c3 - mat[0][1]*c1 + mat[0][2]*c0)*inv;
+ temp[3][2] = (-mat[3][0]*s3 + mat[3][1]*s1 - mat[3][2]*s0)*inv;
+ temp[3][3] = ( mat[2][0]*s3 - mat[2][1]*s1 + mat[2][2]*s0)*inv;
+
+ mat = temp;
+ return true;
+}
+
 //------------------------------------------------------------------------------
 /// This is given a 3x3 rotation matrix, from which is calculates an angle-axis
 /// representation of the rotation. This is a representation as a vector,
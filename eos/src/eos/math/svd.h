@@ -23,6 +23,7 @@
 
 #include "eos/types.h"
 #include "eos/math/mat_ops.h"
+#include "eos/math/eigen.h"
 
 namespace eos
 {
@@ -612,6 +613,86 @@ inline bit SVD(MT1 & u,MT2 & d,MT3 & v,MT4 & temp)
  return all_good;
 }
 
+//------------------------------------------------------------------------------
+/// A closed form SVD for 3x3 matrices, with the same interface as SVD but for
+/// the tempory. v comes from SymEigen33 applied to A^T A, the columns of A v
+/// then give the singular values and u, with u re-orthogonalised so it is
+/// always a rotation or reflection even for rank deficient input. Much faster
+/// than SVD, for when millions of 3x3 decompositions are required, but
+/// singular vectors of small, close, singular values are only accurate to
+/// roughly the square root of machine precision relative to the largest -
+/// use SVD for badly conditioned problems.
+/// \param u On call A, on return u, with orthonormal columns.
+/// \param d Output singular values, decreasing and positive.
+/// \param v Output v, with orthonormal columns.
+template <typename T>
+inline void SVD33(Mat<3,3,T> & u,Vect<3,T> & d,Mat<3,3,T> & v)
+{
+ // Eigen decomposition of A^T A gives v...
+  Mat<3,3,T> ata;
+  TransMult(u,u,ata);
+  Vect<3,T> ev;
+  SymEigen33(ata,v,ev);
+
+ // Columns of A v are u scaled by the singular values...
+  Mat<3,3,T> av;
+  Mult(u,v,av);
+
+  Vect<3,T> col[3];
+  for (nat32 c=0;c<3;c++)
+  {
+   for (nat32 r=0;r<3;r++) col[c][r] = av[r][c];
+  }
+
+ // First column...
+  d[0] = col[0].Length();
+  if (d[0]>static_cast<T>(0)) col[0] /= d[0];
+  else
+  {
+   // Zero matrix...
+    Identity(u);
+    d[1] = static_cast<T>(0);
+    d[2] = static_cast<T>(0);
+    return;
+  }
+
+ // Second column, orthogonalised against the first...
+  T dot = col[0]*col[1];
+  for (nat32 r=0;r<3;r++) col[1][r] -= dot*col[0][r];
+  d[1] = col[1].Length();
+  if (d[1]>d[0]*static_cast<T>(1e-12)) col[1] /= d[1];
+  else
+  {
+   Perpendicular(col[0],col[1]);
+   col[1].Normalise();
+  }
+
+ // Third column is fixed by the other two, the sign of its singular value is
+ // pushed into v...
+  Vect<3,T> third;
+  CrossProduct(col[0],col[1],third);
+  d[2] = third*col[2];
+  if (d[2]<static_cast<T>(0))
+  {
+   d[2] = -d[2];
+   for (nat32 r=0;r<3;r++) v[r][2] = -v[r][2];
+  }
+  col[2] = third;
+
+  for (nat32 c=0;c<3;c++)
+  {
+   for (nat32 r=0;r<3;r++) u[r][c] = col[c][r];
+  }
+
+ // Rounding can break the ordering of the last two...
+  if (d[2]>d[1])
+  {
+   math::Swap(d[1],d[2]);
+   u.SwapCols(1,2);
+   v.SwapCols(1,2);
+  }
+}
+
 //------------------------------------------------------------------------------
 /// Pseudo Inverse, this will invert all matrices, even non-square and singular
 /// once, uses SVD to accheive this goal.
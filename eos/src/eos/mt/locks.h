@@ -27,6 +27,29 @@ namespace eos
 {
  namespace mt
  {
+//------------------------------------------------------------------------------
+/// Atomically adds amount to the given variable, returning the value it had
+/// before the addition. For counters shared between threads where a full
+/// lock would be overkill, such as handing out units of work.
+inline nat32 AtomicAdd(volatile nat32 & var,nat32 amount)
+{
+ return __sync_fetch_and_add(&var,amount);
+}
+
+/// Atomically sets var to nv if it currently equals ov, returns true if it 
+/// did so, false if var had some other value and was left alone.
+inline bit AtomicSet(volatile nat32 & var,nat32 ov,nat32 nv)
+{
+ return __sync_bool_compare_and_swap(&var,ov,nv);
+}
+
+/// A full memory barrier, so writes before it are visible to other threads
+/// before writes after it.
+inline void Barrier()
+{
+ __sync_synchronize();
+}
+
 //------------------------------------------------------------------------------
 /// The standard locked/unlocked mutex, where only one thread can have it locked
 /// at any given time.
@@ -0,0 +1,159 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/mt/pool.h"
+
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace mt
+ {
+//------------------------------------------------------------------------------
+Pool::Pool(nat32 t)
+:threads(t),job(null<Job*>()),units(0),next(0),done(0),busy(0),stop(0),quit(0),
+worker(null<Worker*>())
+{
+ if (threads==0) threads = CoreCount();
+ if (threads>1)
+ {
+  worker = new Worker[threads-1];
+  for (nat32 i=0;i<threads-1;i++)
+  {
+   worker[i].pool = this;
+   worker[i].index = i+1;
+   if (worker[i].Run()==false)
+   {
+    // Failed to create the thread - just run with the ones we have...
+     LogAlways("[mt.pool] Failed to create worker thread {index}" << LogDiv() << (i+1));
+     threads = i+1;
+     break;
+   }
+  }
+ }
+}
+
+Pool::~Pool()
+{
+ if (worker)
+ {
+  quit = 1;
+  Barrier();
+  start.Add(threads-1);
+  for (nat32 i=0;i<threads-1;i++) worker[i].Wait();
+  delete[] worker;
+ }
+}
+
+void Pool::Run(Job & j,nat32 u,time::Progress * prog)
+{
+ if (u==0) return;
+
+ // If single threaded or already busy just do it all in this thread...
+  if ((threads==1)||(AtomicSet(busy,0,1)==false))
+  {
+   for (nat32 i=0;i<u;i++)
+   {
+    prog->Report(i,u);
+    j.Do(i,0);
+   }
+   return;
+  }
+
+ // Setup the job and set the workers going...
+  job = &j;
+  units = u;
+  next = 0;
+  done = 0;
+  stop = 0;
+  Barrier();
+  start.Add(threads-1);
+
+ // Do our share of the work, then wait for the workers to finish, reporting
+ // progress as we go...
+  nat32 waiting = threads-1;
+  try
+  {
+   while (true)
+   {
+    nat32 unit = AtomicAdd(next,1);
+    if (unit>=units) break;
+    job->Do(unit,0);
+    AtomicAdd(done,1);
+    prog->Report(done,units);
+   }
+
+   while (waiting!=0)
+   {
+    if (finish.Get(50)) --waiting;
+                   else prog->Report(done,units);
+   }
+  }
+  catch (...)
+  {
+   stop = 1;
+   Barrier();
+   while (waiting!=0)
+   {
+    finish.Get();
+    --waiting;
+   }
+   job = null<Job*>();
+   busy = 0;
+   throw;
+  }
+
+ job = null<Job*>();
+ Barrier();
+ busy = 0;
+}
+
+nat32 Pool::Work(nat32 thread)
+{
+ nat32 ret = 0;
+ while (stop==0)
+ {
+  nat32 unit = AtomicAdd(next,1);
+  if (unit>=units) break;
+  job->Do(unit,thread);
+  AtomicAdd(done,1);
+  ++ret;
+ }
+ return ret;
+}
+
+void Pool::Worker::Execute()
+{
+ while (true)
+ {
+  pool->start.Get();
+  if (pool->quit) return;
+  pool->Work(index);
+  pool->finish.Add();
+ }
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC Pool & SharedPool()
+{
+ static Pool pool;
+ return pool;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
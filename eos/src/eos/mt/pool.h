@@ -0,0 +1,131 @@
+#ifndef EOS_MT_POOL_H
+#define EOS_MT_POOL_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file pool.h
+/// Provides a pool of worker threads, to which jobs consisting of many
+/// independent units of work can be handed, so algorithms can make use of
+/// all the cores in a machine without each managing there own threads.
+
+#include "eos/types.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace mt
+ {
+//------------------------------------------------------------------------------
+/// The interface for a job to be run by a Pool. A job consists of a number of
+/// units, numbered from 0, each of which must be independent of the others,
+/// as they will be run in an arbitary order by multiple threads at once.
+/// Each unit is also told which thread is running it, as a number from 0 to
+/// the pool thread count minus one, so per-thread scratch memory can be
+/// indexed without locking.
+class EOS_CLASS Job
+{
+ public:
+  /// &nbsp;
+   virtual ~Job() {}
+
+  /// Called once for each unit of work. Must not throw.
+   virtual void Do(nat32 unit,nat32 thread) = 0;
+};
+
+//------------------------------------------------------------------------------
+/// A set of worker threads, created on construction and kept waiting until
+/// handed a Job. The thread that calls Run also does work, so a pool of n
+/// threads creates n-1 extra threads. Units are handed out one at a time from
+/// a shared counter, so uneven unit sizes balance themselves - make units
+/// small enough for this to work but large enough that the hand-out overhead
+/// is irrelevant. (A row band of an image, not a pixel.)
+///
+/// Run is not re-entrant - if a Job calls Run on the pool already running it
+/// (Or another thread calls Run whilst its busy.) the inner job is simply run
+/// serially by the calling thread, so nesting algorithms that use the pool is
+/// always safe.
+class EOS_CLASS Pool
+{
+ public:
+  /// \param threads Number of threads to use, including the calling thread. 0 means use CoreCount().
+   Pool(nat32 threads = 0);
+
+  /// Terminates the worker threads, must not be called whilst Run is in progress.
+   ~Pool();
+
+
+  /// Returns how many threads the pool will use, including the calling thread.
+  /// Per-thread storage should be this big.
+   nat32 Threads() const {return threads;}
+
+
+  /// Runs the given job, calling Do for every unit from 0 to units-1 exactly
+  /// once, returning only when all have completed. If a progress bar is
+  /// provided it is reported to by the calling thread only, as units complete.
+  /// If the progress bar throws (To cancel.) no further units are started, the
+  /// units in progress are allowed to finish and then the exception is
+  /// re-thrown from this method.
+   void Run(Job & job,nat32 units,time::Progress * prog = null<time::Progress*>());
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::mt::Pool";}
+
+
+ private:
+  nat32 threads;
+
+  // Current job...
+   Job * job;
+   nat32 units;
+   volatile nat32 next; // Next unit to hand out.
+   volatile nat32 done; // Number of units completed.
+   volatile nat32 busy; // 1 when Run is in progress.
+   volatile nat32 stop; // Set to 1 to stop handing out units.
+   volatile nat32 quit; // Set to 1 to make the workers exit.
+
+  // Synchronisation...
+   EventLock start; // One event per worker per job.
+   EventLock finish; // One event per worker per job.
+
+  // The worker threads...
+   class Worker : public Thread
+   {
+    public:
+     Pool * pool;
+     nat32 index;
+     void Execute();
+   };
+   Worker * worker; // threads-1 of them.
+
+  // Helper, does units until they run out. Returns how many it did...
+   nat32 Work(nat32 thread);
+};
+
+//------------------------------------------------------------------------------
+/// Returns a pool shared by the entire library, created on first use with
+/// CoreCount() threads. Algorithms that want to run in parallel without
+/// troubling the user with a Pool object use this.
+EOS_FUNC Pool & SharedPool();
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
@@ -18,6 +18,7 @@
 #include "eos/mt/threads.h"
 
 #include "eos/mem/alloc.h"
+#include "eos/mt/locks.h"
 
 //------------------------------------------------------------------------------
 
@@ -27,10 +28,9 @@
  #include <unistd.h>
  #include <sys/types.h>
  #include <stdio.h>
- #include <sys/mman.h>
- #include <sched.h>
- #include <sys/wait.h>
- #include <signal.h>
+ #include <pthread.h>
+ #include <cxxabi.h>
+ #include <sys/syscall.h>
  #include <sys/time.h> 
  #include <sys/resource.h>
 #endif
@@ -68,7 +68,7 @@ EOS_FUNC void Sleep(nat32 ms)
 
 EOS_FUNC nat32 ThreadID()
 {
- return getpid();
+ return syscall(SYS_gettid);
 }
 
 EOS_FUNC nat32 CoreCount()
@@ -104,14 +104,45 @@ EOS_FUNC nat32 CoreCount()
 #endif
 
 //------------------------------------------------------------------------------
-// Helper function, used by the below class...
+// Open addressing table from ThreadID() to ThreadIndex(), slots being claimed
+// by compare and swap - 0 is empty and 0xFFFFFFFF a slot being filled in...
+static const nat32 threadSlots = 1024;
+static volatile nat32 threadSlotId[threadSlots];
+static volatile nat32 threadSlotIndex[threadSlots];
+static volatile nat32 threadCount = 0;
+
+EOS_FUNC nat32 ThreadIndex()
+{
+ nat32 id = ThreadID();
+ nat32 h = (id*2654435761U) & (threadSlots-1);
+ for (nat32 i=0;i<threadSlots;)
+ {
+  nat32 s = threadSlotId[h];
+  if (s==id) return threadSlotIndex[h];
+  if (s==0)
+  {
+   if (AtomicSet(threadSlotId[h],0,0xFFFFFFFF))
+   {
+    nat32 ret = AtomicAdd(threadCount,1);
+    threadSlotIndex[h] = ret;
+    Barrier();
+    threadSlotId[h] = id;
+    return ret;
+   }
+   continue; // Lost the race, look again.
+  }
+  if (s==0xFFFFFFFF) continue; // Being filled in, wait.
+  h = (h+1) & (threadSlots-1);
+  ++i;
+ }
+ return AtomicAdd(threadCount,1); // Table full - a new index every call.
+}
 
-#ifdef EOS_WIN32
-DWORD WINAPI 
-#else
-int
-#endif
-thread_func(void * data)
+//------------------------------------------------------------------------------
+#ifdef WIN32
+
+// Helper function, used by the below class...
+DWORD WINAPI thread_func(void * data)
 {
  try
  {
@@ -124,6 +155,8 @@ thread_func(void * data)
  return 0;
 }
 
+#endif
+
 //------------------------------------------------------------------------------
 #ifdef WIN32
 
@@ -178,60 +211,88 @@ void Thread::Priority(bit high)
 #else
 
 Thread::Thread()
-:stack(null<void*>()),procId(-1)
+:hand(null<void*>()),joined(false),state(0),tid(0)
 {}
 
 Thread::~Thread()
 {
  Kill();
+ delete (pthread_t*)hand;
 }
 
 bit Thread::Run()
 {
- // Create the stack, using mmap...
-  stack = mmap(0,start_size,PROT_EXEC | PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_GROWSDOWN | MAP_ANONYMOUS,0,0);
-  if (stack==null<void*>()) return false;
- 
- // Clone to create the new kernel space thread...
-  procId = clone(thread_func,stack,SIGCHLD | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_PTRACE | CLONE_VM,this);
+ // A real pthread, rather than a bare clone, so the C library knows the
+ // process is threaded, locking its malloc and giving each thread its own
+ // errno and thread local storage...
+  hand = new pthread_t;
+  state = 1;
+  if (pthread_create((pthread_t*)hand,0,Main,this)!=0)
+  {
+   delete (pthread_t*)hand;
+   hand = null<void*>();
+   state = 0;
+   return false;
+  }
 
- return procId!=-1;
+ return true;
 }
 
 void Thread::Kill()
 {
- if (procId!=-1) kill(procId,SIGKILL);
- if (stack) munmap(stack,start_size);
+ // Cancellation only happens at the next cancellation point, so wait for it,
+ // as the thread must not outlive this object...
+  if ((hand==null<void*>())||joined) return;
+  if (state==1) pthread_cancel(*(pthread_t*)hand);
+  pthread_join(*(pthread_t*)hand,0);
+  joined = true;
 }
 
 bit Thread::Running() const
 {
- if (procId==-1) return false;
- return waitpid(procId,0,WNOHANG)==0;
+ return state==1;
 }
 
 bit Thread::Error() const
 {
- if (procId==-1) return true;
- int status;
- int res = waitpid(procId,&status,WNOHANG);
- if (res!=procId)
- {
-  if (res==0) return false;
-         else return true;
- }
- return !WIFEXITED(status) || (WEXITSTATUS(status)!=0);
+ return (state==0)||(state==3);
 }
 
 void Thread::Wait() const
 {
- if (procId!=-1) waitpid(procId,0,0);
+ if ((hand==null<void*>())||joined) return;
+ pthread_join(*(pthread_t*)hand,0);
+ joined = true;
 }
 
 void Thread::Priority(bit high)
 {
- if (high) setpriority(PRIO_PROCESS,procId,0);
-      else setpriority(PRIO_PROCESS,procId,-1);
+ while (tid==0) Sleep(0);
+ if (high) setpriority(PRIO_PROCESS,tid,0);
+      else setpriority(PRIO_PROCESS,tid,-1);
+}
+
+void * Thread::Main(void * data)
+{
+ Thread * self = static_cast<Thread*>(data);
+ self->tid = ThreadID();
+ try
+ {
+  self->Execute();
+ }
+ catch(abi::__forced_unwind &)
+ {
+  // Cancelled by Kill - must be let through...
+   self->state = 3;
+   throw;
+ }
+ catch(...)
+ {
+  self->state = 3;
+  return 0;
+ }
+ self->state = 2;
+ return 0;
 }
 
 #endif
@@ -42,6 +42,14 @@ EOS_FUNC void Sleep(nat32 ms);
 /// Mostly used by the logging system.
 EOS_FUNC nat32 ThreadID();
 
+/// Returns a small index for the current thread, starting at 0 for the first
+/// thread to call it and counting up, so per-thread data can be kept in an
+/// array. Done with a table rather than __thread and the like so it works
+/// the same with every compiler the library is built with. A thread keeps
+/// its index for life - if a threads id is reused after it dies the new thread
+/// gets the same index.
+EOS_FUNC nat32 ThreadIndex();
+
 /// Returns how many proccessing units the computer has, i.e. the minimum
 /// number of un-blocked threads required to keep the computer maxed out.
 /// The sum of the number of cores for each proccessor.
@@ -108,9 +116,12 @@ class EOS_CLASS Thread : public Deletable
   #ifdef WIN32
    void * hand;
   #else
-   static const int start_size = 1024; // Starting stack size.
-   void * stack;
-   int procId;
+   void * hand; // A pthread_t, allocated by Run.
+   mutable bit joined; // hand has been joined, so is finished with.
+   volatile nat32 state; // 0 = not run, 1 = running, 2 = finished, 3 = finished with an error.
+   volatile int tid; // Kernel id of the thread, 0 till it starts.
+
+   static void * Main(void * data);
   #endif
 };
 
@@ -20,6 +20,8 @@
 #include "eos/ds/arrays2d.h"
 #include "eos/ds/priority_queues.h"
 #include "eos/file/wavefront.h"
+#include "eos/math/fft.h"
+#include "eos/alg/multigrid.h"
 
 namespace eos
 {
@@ -317,6 +319,430 @@ EOS_FUNC void IntegrateNeedle(const svt::Field<bs::Normal> & needle,const svt::F
    }*/
 }
 
+//------------------------------------------------------------------------------
+// The depth change from (x,y) to (x+dx,y+dy), where one of dx and dy is 1 and
+// the other 0, as the average gradient of the two normals...
+inline real32 NeedleDelta(const svt::Field<bs::Normal> & needle,nat32 x,nat32 y,nat32 dx,nat32 dy)
+{
+ nat32 axis = (dx!=0)?0:1;
+ const bs::Normal & a = needle.Get(x,y);
+ const bs::Normal & b = needle.Get(x+dx,y+dy);
+ real32 ga = math::IsZero(a[2])?0.0:(a[axis]/a[2]);
+ real32 gb = math::IsZero(b[2])?0.0:(b[axis]/b[2]);
+ return 0.5*(ga+gb);
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void IntegrateNeedleFft(const svt::Field<bs::Normal> & needle,svt::Field<real32> & depth,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = needle.Size(0);
+ nat32 height = needle.Size(1);
+ nat32 pw = width*2;
+ nat32 ph = height*2;
+
+ // Calculate b of the normal equations, Az = b, where A is the negated
+ // Laplacian with Neumann boundaries, in the top left quarter...
+  prog->Report(0,4);
+  ds::Array<real32> b(pw*ph);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++) b[y*pw + x] = 0.0;
+  }
+
+  for (nat32 y=0;y<height;y++)
+  {
+   real32 * row = b.Ptr() + y*pw;
+   for (nat32 x=0;x<width;x++)
+   {
+    if (x+1<width)
+    {
+     real32 d = NeedleDelta(needle,x,y,1,0);
+     row[x] -= d;
+     row[x+1] += d;
+    }
+
+    if (y+1<height)
+    {
+     real32 d = NeedleDelta(needle,x,y,0,1);
+     row[x] -= d;
+     row[x+pw] += d;
+    }
+   }
+  }
+
+ // Mirror it into the other quarters, as the periodic Laplacian of the
+ // mirrored grid is the Neumann Laplacian of the original...
+  for (nat32 y=0;y<height;y++)
+  {
+   real32 * row = b.Ptr() + y*pw;
+   real32 * rowM = b.Ptr() + (ph-1-y)*pw;
+   for (nat32 x=0;x<width;x++)
+   {
+    row[pw-1-x] = row[x];
+    rowM[x] = row[x];
+    rowM[pw-1-x] = row[x];
+   }
+  }
+
+ // To the frequency domain, where A is diagonal, divide by its eigenvalues,
+ // zeroing the mean, and back again...
+  prog->Report(1,4);
+  math::Fft2D fft(pw,ph);
+  nat32 sw = fft.SpecWidth();
+  ds::Array<math::Complex<real32> > spec(sw*ph);
+  fft.Forward(b.Ptr(),pw,spec.Ptr());
+
+  prog->Report(2,4);
+  ds::Array<real32> cosX(sw);
+  ds::Array<real32> cosY(ph);
+  for (nat32 k=0;k<sw;k++) cosX[k] = 2.0 - 2.0*math::Cos(math::pi*real64(k)/real64(width));
+  for (nat32 l=0;l<ph;l++) cosY[l] = 2.0 - 2.0*math::Cos(math::pi*real64(l)/real64(height));
+
+  for (nat32 l=0;l<ph;l++)
+  {
+   math::Complex<real32> * row = spec.Ptr() + l*sw;
+   for (nat32 k=0;k<sw;k++)
+   {
+    real32 lambda = cosX[k] + cosY[l];
+    if (math::IsZero(lambda)) row[k] = 0.0;
+    else
+    {
+     real32 mult = 1.0/lambda;
+     row[k].x *= mult;
+     row[k].y *= mult;
+    }
+   }
+  }
+
+  prog->Report(3,4);
+  fft.Inverse(spec.Ptr(),b.Ptr(),pw);
+
+ // Extract the top left quarter...
+  for (nat32 y=0;y<height;y++)
+  {
+   const real32 * row = b.Ptr() + y*pw;
+   for (nat32 x=0;x<width;x++) depth.Get(x,y) = row[x];
+  }
+
+ prog->Pop();
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void IntegrateNeedleMultigrid(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,
+                                       svt::Field<real32> & depth,time::Progress * prog)
+{
+ prog->Push();
+ nat32 width = needle.Size(0);
+ nat32 height = needle.Size(1);
+ static const int32 offX[4] = {1,0,-1,0};
+ static const int32 offY[4] = {0,1,0,-1};
+
+ // Find the connected regions of the mask, by flood filling with a stack of
+ // pixel indices, and their bounding boxes. Each region is solved on its own,
+ // as the coarse levels of a solve would otherwise couple nearby regions,
+ // which then drift against one another and slow convergence to a crawl...
+  prog->Report(0,1);
+  ds::Array2D<nat32> region(width,height);
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    region.Get(x,y) = mask.Get(x,y)?nat32(-1):nat32(-2);
+    depth.Get(x,y) = 0.0;
+   }
+  }
+
+  ds::Array<nat32> stack(width*height);
+  ds::Array<nat32> size(16);
+  ds::Array<nat32> minX(16);
+  ds::Array<nat32> minY(16);
+  ds::Array<nat32> maxX(16);
+  ds::Array<nat32> maxY(16);
+  nat32 regions = 0;
+  for (nat32 y=0;y<height;y++)
+  {
+   for (nat32 x=0;x<width;x++)
+   {
+    if (region.Get(x,y)!=nat32(-1)) continue;
+
+    if (regions==size.Size())
+    {
+     size.Size(regions*2);
+     minX.Size(regions*2);
+     minY.Size(regions*2);
+     maxX.Size(regions*2);
+     maxY.Size(regions*2);
+    }
+    size[regions] = 0;
+    minX[regions] = x; minY[regions] = y;
+    maxX[regions] = x; maxY[regions] = y;
+
+    nat32 stackSize = 1;
+    stack[0] = y*width + x;
+    region.Get(x,y) = regions;
+    while (stackSize!=0)
+    {
+     nat32 ind = stack[--stackSize];
+     nat32 px = ind%width;
+     nat32 py = ind/width;
+     size[regions] += 1;
+     minX[regions] = math::Min(minX[regions],px);
+     minY[regions] = math::Min(minY[regions],py);
+     maxX[regions] = math::Max(maxX[regions],px);
+     maxY[regions] = math::Max(maxY[regions],py);
+
+     for (nat32 i=0;i<4;i++)
+     {
+      int32 u = int32(px) + offX[i];
+      int32 v = int32(py) + offY[i];
+      if ((u<0)||(v<0)||(u>=int32(width))||(v>=int32(height))) continue;
+      if (region.Get(u,v)!=nat32(-1)) continue;
+      region.Get(u,v) = regions;
+      stack[stackSize++] = v*width + u;
+     }
+    }
+
+    ++regions;
+   }
+  }
+
+
+ // Solve each region with more than one pixel in turn...
+  for (nat32 r=0;r<regions;r++)
+  {
+   prog->Report(r,regions);
+   if (size[r]<2) continue;
+   nat32 baseX = minX[r];
+   nat32 baseY = minY[r];
+   nat32 w = maxX[r] + 1 - baseX;
+   nat32 h = maxY[r] + 1 - baseY;
+
+   // Setup the solver on the bounding box, with a 4-way stencil on level 0
+   // and 8-way on the coarser levels, as needed by their Galerkin operators.
+   // The unused entries of level 0 are given offsets of (0,0), so it is
+   // swept red-black rather than with four colours...
+    alg::Multigrid2D mg;
+    mg.SetSize(w,h,9);
+    mg.SetOffset(0,0, 0, 0);
+    mg.SetOffset(0,1, 1, 0);
+    mg.SetOffset(0,2, 0, 1);
+    mg.SetOffset(0,3,-1, 0);
+    mg.SetOffset(0,4, 0,-1);
+    mg.SetOffset(0,5, 1, 1);
+    mg.SetOffset(0,6,-1, 1);
+    mg.SetOffset(0,7,-1,-1);
+    mg.SetOffset(0,8, 1,-1);
+    mg.SpreadFirstStencil();
+    for (nat32 se=5;se<9;se++) mg.SetOffset(0,se,0,0);
+
+   // Fill in A for level 0 as the negated Laplacian of the region, nodes
+   // outside it being left to sit at zero, and b from the gradients between
+   // neighbours in the region...
+    for (nat32 y=0;y<h;y++)
+    {
+     for (nat32 x=0;x<w;x++)
+     {
+      if (region.Get(baseX+x,baseY+y)!=r)
+      {
+       mg.SetA(0,x,y,0,1.0);
+       continue;
+      }
+
+      nat32 count = 0;
+      for (nat32 i=0;i<4;i++)
+      {
+       int32 u = int32(baseX+x) + offX[i];
+       int32 v = int32(baseY+y) + offY[i];
+       if ((u>=0)&&(v>=0)&&(u<int32(width))&&(v<int32(height))&&(region.Get(u,v)==r))
+       {
+        mg.SetA(0,x,y,i+1,-1.0);
+        ++count;
+       }
+      }
+      mg.SetA(0,x,y,0,real32(count));
+     }
+    }
+
+    ds::Array2D<real32> b(w,h);
+    for (nat32 y=0;y<h;y++)
+    {
+     for (nat32 x=0;x<w;x++) b.Get(x,y) = 0.0;
+    }
+
+    for (nat32 y=0;y<h;y++)
+    {
+     for (nat32 x=0;x<w;x++)
+     {
+      if (region.Get(baseX+x,baseY+y)!=r) continue;
+      if ((x+1<w)&&(region.Get(baseX+x+1,baseY+y)==r))
+      {
+       real32 d = NeedleDelta(needle,baseX+x,baseY+y,1,0);
+       b.Get(x,y) -= d;
+       b.Get(x+1,y) += d;
+      }
+
+      if ((y+1<h)&&(region.Get(baseX+x,baseY+y+1)==r))
+      {
+       real32 d = NeedleDelta(needle,baseX+x,baseY+y,0,1);
+       b.Get(x,y) -= d;
+       b.Get(x,y+1) += d;
+      }
+     }
+    }
+
+   // Derive the coarser levels, as the mask makes rediscretising them
+   // awkward...
+    mg.MakeGalerkin();
+    if (mg.Levels()>1) mg.SetIters(0.0,16);
+    mg.SetCycle(alg::Multigrid2D::CycleV,1,0.0);
+
+   // Solve with conjugate gradients, preconditioned by a V cycle. Cycling
+   // alone stalls on regions with narrow necks, as the coarse levels couple
+   // the pixels either side of a gap; the few slow modes this leaves are
+   // what conjugate gradients removes quickly. The system is singular, with b
+   // summing to zero, so the residual is kept zero mean, and the coarsest
+   // level only gets a few sweeps, else it drifts...
+    ds::Array2D<real32> est(w,h); // b becomes the residual of this.
+    ds::Array2D<real32> dir(w,h);
+    ds::Array2D<real32> adir(w,h);
+    ds::Array2D<real32> pre(w,h);
+    for (nat32 v=0;v<h;v++)
+    {
+     for (nat32 u=0;u<w;u++)
+     {
+      est.Get(u,v) = 0.0;
+      dir.Get(u,v) = 0.0;
+     }
+    }
+
+    real64 rz = 0.0;
+    real64 start = -1.0;
+    for (nat32 iter=0;iter<32;iter++)
+    {
+     // Zero mean the residual, and check if its small enough...
+      real64 sum = 0.0;
+      real64 rr = 0.0;
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++) sum += b.Get(u,v);
+      }
+
+      real32 mean = sum/real64(size[r]);
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++)
+       {
+        if (region.Get(baseX+u,baseY+v)!=r) continue;
+        b.Get(u,v) -= mean;
+        rr += math::Sqr(b.Get(u,v));
+       }
+      }
+
+      if (start<0.0) start = rr;
+      if (rr<=(1e-8*start)) break;
+
+     // Precondition...
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++)
+       {
+        mg.SetB(0,u,v,b.Get(u,v));
+        mg.SetX(0,u,v,0.0);
+       }
+      }
+      mg.RunCycles();
+
+      real64 rzNew = 0.0;
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++)
+       {
+        pre.Get(u,v) = (region.Get(baseX+u,baseY+v)==r)?mg.Get(u,v):0.0;
+        rzNew += b.Get(u,v) * pre.Get(u,v);
+       }
+      }
+
+     // Update the search direction...
+      real32 beta = (iter==0)?0.0:(rzNew/rz);
+      rz = rzNew;
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++) dir.Get(u,v) = pre.Get(u,v) + beta*dir.Get(u,v);
+      }
+
+     // Multiply by A, and step...
+      real64 pq = 0.0;
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++)
+       {
+        adir.Get(u,v) = 0.0;
+        if (region.Get(baseX+u,baseY+v)!=r) continue;
+        for (nat32 i=0;i<4;i++)
+        {
+         int32 nu = int32(u) + offX[i];
+         int32 nv = int32(v) + offY[i];
+         if ((nu<0)||(nv<0)||(nu>=int32(w))||(nv>=int32(h))) continue;
+         if (region.Get(baseX+nu,baseY+nv)!=r) continue;
+         adir.Get(u,v) += dir.Get(u,v) - dir.Get(nu,nv);
+        }
+        pq += dir.Get(u,v) * adir.Get(u,v);
+       }
+      }
+      if (math::IsZero(pq)) break;
+
+      real32 alpha = rz/pq;
+      for (nat32 v=0;v<h;v++)
+      {
+       for (nat32 u=0;u<w;u++)
+       {
+        est.Get(u,v) += alpha*dir.Get(u,v);
+        b.Get(u,v) -= alpha*adir.Get(u,v);
+       }
+      }
+    }
+
+   // Extract, zero meaning...
+    real64 sum = 0.0;
+    for (nat32 v=0;v<h;v++)
+    {
+     for (nat32 u=0;u<w;u++)
+     {
+      if (region.Get(baseX+u,baseY+v)==r) sum += est.Get(u,v);
+     }
+    }
+
+    real32 mean = sum/real64(size[r]);
+    for (nat32 v=0;v<h;v++)
+    {
+     for (nat32 u=0;u<w;u++)
+     {
+      if (region.Get(baseX+u,baseY+v)==r) depth.Get(baseX+u,baseY+v) = est.Get(u,v) - mean;
+     }
+    }
+  }
+
+ prog->Pop();
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void IntegrateNeedlePoisson(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,
+                                     svt::Field<real32> & depth,time::Progress * prog)
+{
+ bit full = math::FftGood(needle.Size(0)) && math::FftGood(needle.Size(1));
+ for (nat32 y=0;(y<needle.Size(1))&&full;y++)
+ {
+  for (nat32 x=0;x<needle.Size(0);x++)
+  {
+   if (!mask.Get(x,y)) {full = false; break;}
+  }
+ }
+
+ if (full) IntegrateNeedleFft(needle,depth,prog);
+      else IntegrateNeedleMultigrid(needle,mask,depth,prog);
+}
+
 //------------------------------------------------------------------------------
 EOS_FUNC bit SaveNeedleModel(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,nat32 freq,cstrconst fn,bit overwrite)
 {
@@ -23,6 +23,7 @@
 
 #include "eos/svt/field.h"
 #include "eos/bs/geo3d.h"
+#include "eos/time/progress.h"
 
 namespace eos
 {
@@ -35,6 +36,35 @@ namespace eos
 /// trees each time.
 EOS_FUNC void IntegrateNeedle(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,svt::Field<real32> & depth);
 
+//------------------------------------------------------------------------------
+/// Integrates a needle map as the least squares solution of a Poisson equation,
+/// i.e. the depth map whose differences between 4-way neighbours best match
+/// the gradients of the needle map, using the same gradient between a pair as
+/// IntegrateNeedle. This version is for complete needle maps, without a mask,
+/// and solves directly in the frequency domain - the grid is mirrored to twice
+/// its size, so the periodic solution a Frankot-Chellappa style division gives
+/// has the Neumann boundary the least squares solution needs, making it a DCT
+/// solver. Fast when the width and height are FftGood, slow if they have large
+/// prime factors. The output is zero mean.
+EOS_FUNC void IntegrateNeedleFft(const svt::Field<bs::Normal> & needle,svt::Field<real32> & depth,
+                                 time::Progress * prog = null<time::Progress*>());
+
+/// Solves the same least squares problem as IntegrateNeedleFft, but only for
+/// the pixels in the mask, with the gradients between masked pixels, using
+/// conjugate gradients preconditioned by a multigrid V cycle with Galerkin
+/// coarse levels. Each connected region of the mask is solved seperatly, on
+/// its bounding box, and zero meaned, as each is only defined up to an offset;
+/// depths outside the mask are set to 0.
+EOS_FUNC void IntegrateNeedleMultigrid(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,
+                                       svt::Field<real32> & depth,
+                                       time::Progress * prog = null<time::Progress*>());
+
+/// Calls IntegrateNeedleFft if the mask is all true and the size is FftGood,
+/// IntegrateNeedleMultigrid otherwise.
+EOS_FUNC void IntegrateNeedlePoisson(const svt::Field<bs::Normal> & needle,const svt::Field<bit> & mask,
+                                     svt::Field<real32> & depth,
+                                     time::Progress * prog = null<time::Progress*>());
+
 //------------------------------------------------------------------------------
 /// A helper function, given a needle map this saves a Wavefront .obj 3D model
 /// to a given filename, overwritting on request. You also provide a sampling
@@ -93,6 +93,114 @@ void DiffusionWeight::Create(const bs::LuvRangeImage & img, const bs::LuvRangeDi
 }
 
 //------------------------------------------------------------------------------
+// Fills in the stencil offset table for the given number of steps, returning
+// how many entries there are...
+static nat32 DiffusionOffsets(nat32 steps,ds::Array2D<nat32> & offset)
+{
+ offset.Resize(steps*2+1,steps*2+1);
+ nat32 valueCount = 0;
+ for (int32 v=0;v<int32(offset.Height());v++)
+ {
+  for (int32 u=0;u<int32(offset.Width());u++)
+  {
+   if (math::Abs(u-int32(steps)) + math::Abs(v-int32(steps)) <= int32(steps))
+   {
+    offset.Get(u,v) = valueCount;
+    valueCount += 1;
+   }
+  }
+ }
+ return valueCount;
+}
+
+// How many rows RangeDiffusionImage bands are, enough to keep the pool busy
+// whilst only holding a small part of the image...
+static nat32 DiffusionBandRows(mt::Pool & pool)
+{
+ return math::Max<nat32>(32,4*pool.Threads());
+}
+
+// Does the diffusion for a single pixel, writing the weight for each stencil
+// entry i to out[i*stride]. bufA and bufB must be steps*2+1 square...
+static void DiffusePixel(nat32 x,nat32 y,nat32 steps,const bs::LuvRangeImage & img,const DiffusionWeight & dw,
+                         const ds::Array2D<nat32> & offset,nat32 valueCount,
+                         ds::Array2D<real32> & bufA,ds::Array2D<real32> & bufB,real32 * out,nat32 stride)
+{
+ // Helpful little arrays...
+  int32 du[4] = {1,0,-1, 0};
+  int32 dv[4] = {0,1, 0,-1};
+
+  if (!img.Valid(x,y))
+  {
+   for (nat32 v=0;v<valueCount;v++) out[v*stride] = 0.0;
+   return;
+  }
+   
+ // Do the diffusion - we have to bounce between two buffers; when zeroing
+ // the old buffer only clear the range to be used next time...
+  ds::Array2D<real32> * from = &bufA;
+  ds::Array2D<real32> * to = &bufB;
+    
+  from->Get(steps,steps) = 1.0;
+    
+  for (nat32 s=0;s<steps;s++)
+  {
+   // Zero out relevant range of to buffer...
+    for (int32 v=-int32(s)-1;v<=int32(s)+1;v++)
+    {
+     for (int32 u=-int32(s)-1;u<=int32(s)+1;u++) to->Get(u+steps,v+steps) = 0.0;
+    }
+      
+   // Do diffusion step...
+    for (int32 v=-int32(s);v<=int32(s);v++)
+    {
+     for (int32 u=-int32(s);u<=int32(s);u++)
+     {
+      int32 ax = int32(x) + u;
+      int32 ay = int32(y) + v;
+        
+      if (((math::Abs(v)+math::Abs(u))<=int32(s))&&
+          (ax>=0)&&(ay>=0)&&(ax<int32(img.Width()))&&(ay<int32(img.Height())))
+      {
+       real32 val = from->Get(u+steps,v+steps);
+       for (nat32 d=0;d<4;d++)
+       {
+        to->Get(u+steps+du[d],v+steps+dv[d]) += val * dw.Get(ax,ay,d);
+       }
+      }
+     }
+    }
+     
+   // Swap buffers...
+    math::Swap(from,to);
+  }
+
+
+ // Copy result into storage - result is in from...
+  for (nat32 v=0;v<from->Height();v++)
+  {
+   for (nat32 u=0;u<from->Width();u++)
+   {
+    int32 ru = int32(u) - int32(steps);
+    int32 rv = int32(v) - int32(steps);
+    if (math::Abs(ru) + math::Abs(rv) <= int32(steps))
+    {
+     out[offset.Get(u,v)*stride] = from->Get(u,v);
+    }
+   }
+  }
+    
+ // Normalise - it should be already, but numerical error will creep in...
+  real32 sum = 0.0;
+  for (nat32 v=0;v<valueCount;v++) sum += out[v*stride];
+    
+  if (sum>0.5) // sum could be zero in the case of a pixel surrounded by masked pixels.
+  {
+   for (nat32 v=0;v<valueCount;v++) out[v*stride] /= sum;
+  }
+}
+
+//------------------------------------------------------------------------------
 RangeDiffusionSlice::RangeDiffusionSlice()
 :steps(0)
 {}
@@ -109,28 +217,12 @@ void RangeDiffusionSlice::Create(nat32 yy, nat32 stps, const bs::LuvRangeImage &
   prog->Report(0,img.Width()+1);
   y = yy;
   steps = stps;
-  offset.Resize(steps*2+1,steps*2+1);
-  nat32 valueCount = 0;
-  for (int32 v=0;v<int32(offset.Height());v++)
-  {
-   for (int32 u=0;u<int32(offset.Width());u++)
-   {
-    if (math::Abs(u-int32(steps)) + math::Abs(v-int32(steps)) <= int32(steps))
-    {
-     offset.Get(u,v) = valueCount;
-     valueCount += 1;
-    }
-   }
-  }
+  nat32 valueCount = DiffusionOffsets(steps,offset);
  
  // We need some tempory arrays for doing the diffusion in...
   ds::Array2D<real32> bufA(offset.Width(),offset.Height());
   ds::Array2D<real32> bufB(offset.Width(),offset.Height());
 
- // Helpful little arrays...
-  int32 du[4] = {1,0,-1, 0};
-  int32 dv[4] = {0,1, 0,-1};
-
 
  // Now iterate the pixels and calculate and store the diffusion weights for
  // each...
@@ -142,75 +234,7 @@ void RangeDiffusionSlice::Create(nat32 yy, nat32 stps, const bs::LuvRangeImage &
   for (nat32 x=0;x<img.Width();x++)
   {
    prog->Report(x+1,img.Width()+1);
-   
-   if (!img.Valid(x,y))
-   {
-    for (nat32 v=0;v<valueCount;v++)  data.Get(x,v) = 0.0;
-    continue;
-   }
-   
-   // Do the diffusion - we have to bounce between two buffers; when zeroing
-   // the old buffer only clear the range to be used next time...
-    ds::Array2D<real32> * from = &bufA;
-    ds::Array2D<real32> * to = &bufB;
-    
-    from->Get(steps,steps) = 1.0;
-    
-    for (nat32 s=0;s<steps;s++)
-    {
-     // Zero out relevant range of to buffer...
-      for (int32 v=-int32(s)-1;v<=int32(s)+1;v++)
-      {
-       for (int32 u=-int32(s)-1;u<=int32(s)+1;u++) to->Get(u+steps,v+steps) = 0.0;
-      }
-      
-     // Do diffusion step...
-      for (int32 v=-int32(s);v<=int32(s);v++)
-      {
-       for (int32 u=-int32(s);u<=int32(s);u++)
-       {
-        int32 ax = int32(x) + u;
-        int32 ay = int32(y) + v;
-        
-        if (((math::Abs(v)+math::Abs(u))<=int32(s))&&
-            (ax>=0)&&(ay>=0)&&(ax<int32(img.Width()))&&(ay<int32(img.Height())))
-        {
-         real32 val = from->Get(u+steps,v+steps);
-         for (nat32 d=0;d<4;d++)
-         {
-          to->Get(u+steps+du[d],v+steps+dv[d]) += val * dw.Get(ax,ay,d);
-         }
-        }
-       }
-      }
-     
-     // Swap buffers...
-      math::Swap(from,to);
-    }
-
-
-   // Copy result into storage - result is in from...
-    for (nat32 v=0;v<from->Height();v++)
-    {
-     for (nat32 u=0;u<from->Width();u++)
-     {
-      int32 ru = int32(u) - int32(steps);
-      int32 rv = int32(v) - int32(steps);
-      if (math::Abs(ru) + math::Abs(rv) <= int32(steps))
-      {
-       data.Get(x,offset.Get(u,v)) = from->Get(u,v);
-      }
-     }
-    }
-    
-   // Normalise - it should be already, but numerical error will creep in...
-    real32 sum = 0.0;
-    for (nat32 v=0;v<data.Height();v++) sum += data.Get(x,v);
-    
-    if (sum>0.5) // sum could be zero in the case of a pixel surrounded by masked pixels.
-    {
-     for (nat32 v=0;v<data.Height();v++) data.Get(x,v) /= sum;
-    }
+   DiffusePixel(x,y,steps,img,dw,offset,valueCount,bufA,bufB,&data.Get(x,0),data.Width());
   }
 
  
@@ -236,9 +260,74 @@ real32 RangeDiffusionSlice::Get(nat32 x,int32 u,int32 v) const
  return data.Get(x,os);
 }
 
+//------------------------------------------------------------------------------
+RangeDiffusionImage::RangeDiffusionImage()
+:steps(0),width(0),height(0),size(0),img(null<bs::LuvRangeImage*>()),dw(null<DiffusionWeight*>()),
+first(0),rows(0)
+{}
+
+RangeDiffusionImage::~RangeDiffusionImage()
+{}
+
+void RangeDiffusionImage::Setup(nat32 stps, const bs::LuvRangeImage & im, const DiffusionWeight & w)
+{
+ steps = stps;
+ width = im.Width();
+ height = im.Height();
+ size = DiffusionOffsets(steps,offset);
+ img = &im;
+ dw = &w;
+ first = 0;
+ rows = 0;
+}
+
+void RangeDiffusionImage::Band(nat32 f, nat32 r, const bit * need, time::Progress * prog)
+{
+ prog->Push();
+
+ // Setup the storage, keeping it if big enough...
+  first = f;
+  rows = r;
+  if (data.Size()<rows*size*width) data.Size(rows*size*width);
+
+ // Do the rows, with a pair of diffusion buffers per thread...
+  mt::Pool & pool = mt::SharedPool();
+  ds::ArrayDel< ds::Array2D<real32> > buf(2*pool.Threads());
+  for (nat32 i=0;i<buf.Size();i++) buf[i].Resize(offset.Width(),offset.Height());
+
+  RowJob job;
+  job.self = this;
+  job.need = need;
+  job.buf = &buf[0];
+  pool.Run(job,rows,prog);
+
+ prog->Pop();
+}
+
+real32 RangeDiffusionImage::Get(nat32 x,nat32 y,int32 u,int32 v) const
+{
+ nat32 man = math::Abs(u) + math::Abs(v);
+ if (man>steps) return 0.0;
+ return Row(y,Index(u,v))[x];
+}
+
+void RangeDiffusionImage::RowJob::Do(nat32 r,nat32 thread)
+{
+ if (need&&(!need[r])) return;
+
+ nat32 y = self->first + r;
+ real32 * row = &self->data[r*self->size*self->width];
+ for (nat32 x=0;x<self->width;x++)
+ {
+  DiffusePixel(x,y,self->steps,*self->img,*self->dw,self->offset,self->size,buf[thread*2],buf[thread*2+1],row+x,self->width);
+ }
+}
+
 //------------------------------------------------------------------------------
 DiffuseCorrelation::DiffuseCorrelation()
-:dist(null<bs::LuvRangeDist*>()),img1(null<bs::LuvRangeImage*>()),dif1(null<RangeDiffusionSlice*>()),img2(null<bs::LuvRangeImage*>()),dif2(null<RangeDiffusionSlice*>())
+:dist(null<bs::LuvRangeDist*>()),
+img1(null<bs::LuvRangeImage*>()),dif1(null<RangeDiffusionSlice*>()),kern1(null<RangeDiffusionImage*>()),
+img2(null<bs::LuvRangeImage*>()),dif2(null<RangeDiffusionSlice*>()),kern2(null<RangeDiffusionImage*>())
 {}
 
 DiffuseCorrelation::~DiffuseCorrelation()
@@ -253,8 +342,25 @@ void DiffuseCorrelation::Setup(const bs::LuvRangeDist & d, real32 dc, const bs::
  
  img1 = &i1;
  dif1 = &f1;
+ kern1 = null<RangeDiffusionImage*>();
  img2 = &i2;
  dif2 = &f2;
+ kern2 = null<RangeDiffusionImage*>();
+}
+
+void DiffuseCorrelation::Setup(const bs::LuvRangeDist & d, real32 dc, const bs::LuvRangeImage & i1, const RangeDiffusionImage & f1, const bs::LuvRangeImage & i2, const RangeDiffusionImage & f2)
+{
+ log::Assert(f1.Steps()==f2.Steps());
+
+ dist = &d;
+ distCap = dc;
+
+ img1 = &i1;
+ dif1 = null<RangeDiffusionSlice*>();
+ kern1 = &f1;
+ img2 = &i2;
+ dif2 = null<RangeDiffusionSlice*>();
+ kern2 = &f2;
 }
 
 nat32 DiffuseCorrelation::Width1() const
@@ -297,6 +403,48 @@ real32 DiffuseCorrelation::Cost(nat32 xx1,nat32 xx2) const
  return ret/2.0;
 }
 
+void DiffuseCorrelation::Cost(nat32 y,nat32 x1,nat32 x2,nat32 count,real32 * out,real32 * temp) const
+{
+ for (nat32 k=0;k<count;k++) out[k] = 0.0;
+
+ // Iterate the stencil, for each entry adding in the weighted distances for
+ // the run...
+  int32 steps = kern1->Steps();
+  for (int32 v=-steps;v<=steps;v++)
+  {
+   int32 yy = int32(y) + v;
+   int32 range = steps - math::Abs(v);
+   for (int32 u=-range;u<=range;u++)
+   {
+    nat32 index = kern1->Index(u,v);
+    real32 w1 = kern1->Row(y,index)[x1];
+    const real32 * w2 = kern2->Row(y,index) + x2;
+
+    // Calculate the distances, capped, using the cap for out of bounds and
+    // masked pixels...
+     int32 start = int32(x2) + u; // Position in image 2 of the first pixel of the run.
+     int32 low = math::Clamp<int32>(-start,0,count);
+     int32 high = math::Clamp<int32>(int32(img2->Width())-start,low,count);
+     if ((!img1->ValidExt(int32(x1)+u,yy))||(yy>=int32(img2->Height()))) high = low;
+
+     for (int32 k=0;k<low;k++) temp[k] = distCap;
+     for (int32 k=high;k<int32(count);k++) temp[k] = distCap;
+
+     if (high>low)
+     {
+      dist->Run(img1->Get(x1+u,yy),img2->Row(yy)+start+low,high-low,temp+low);
+      const bit * valid = img2->ValidRow(yy) + start;
+      for (int32 k=low;k<high;k++) temp[k] = valid[k] ? math::Min(temp[k],distCap) : distCap;
+     }
+
+    // Sum them in, weighted...
+     for (nat32 k=0;k<count;k++) out[k] += (w1 + w2[k]) * temp[k];
+   }
+  }
+
+ for (nat32 k=0;k<count;k++) out[k] *= 0.5;
+}
+
 real32 DiffuseCorrelation::DistanceCap() const
 {
  return distCap;
@@ -342,12 +490,6 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
   
   DiffusionWeight leftDiff;
   DiffusionWeight rightDiff;
-  RangeDiffusionSlice leftSliceLow;
-  RangeDiffusionSlice leftSliceHigh;
-  RangeDiffusionSlice rightSliceLow;
-  RangeDiffusionSlice rightSliceHigh;
-  DiffuseCorrelation dcLow;
-  DiffuseCorrelation dcHigh;
   
   ds::Array<real32> distCap(levels);
   distCap[0] = baseDistCap;
@@ -357,7 +499,7 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
  // Create result for highest level - its low enough resolution that we can brute force...
   prog->Report(step++,steps);
   prog->Push();
-  prog->Report(0,left->Level(0).Height()+1);
+  prog->Report(0,2);
   
   nat32 l = levels-1;  
   leftDiff.Create(left->Level(l),*dist,distMult);
@@ -365,11 +507,6 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
   
   for (nat32 y=0;y<left->Level(l).Height();y++)
   {
-   prog->Report(y+1,left->Level(l).Height()+1);
-   leftSliceLow.Create(y,steps,left->Level(l),leftDiff);
-   rightSliceLow.Create(y,steps,right->Level(l),rightDiff);
-   dcLow.Setup(*dist,distCap[l],left->Level(l),leftSliceLow,right->Level(l),rightSliceLow);
-   
    for (nat32 xLeft=0;xLeft<left->Level(l).Width();xLeft++)
    {
     for (nat32 xRight=0;xRight<right->Level(l).Width();xRight++)
@@ -378,12 +515,15 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
      m.y = y;
      m.xLeft = xLeft;
      m.xRight = xRight;
-     m.score = dcLow.Cost(xLeft,xRight);
+     m.score = 0.0;
      
      matches[l].Add(m);
     }
    }
   }
+
+  prog->Report(1,2);
+  Score(matches[l],left->Level(l),leftDiff,right->Level(l),rightDiff,steps,distCap[l],prog);
   prog->Pop();
 
 
@@ -394,7 +534,7 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
    prog->Report(step++,steps);
    // Move to the level we need to proccess...
     l -= 1;
-    nat32 step2 = 0,steps2 = matches[l+1].Size()+1;
+    nat32 step2 = 0,steps2 = matches[l+1].Size()+2;
     prog->Push();
     prog->Report(step2++,steps2);
     
@@ -405,8 +545,8 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
     leftDiff.Create(leftImg,*dist,distMult);
     rightDiff.Create(rightImg,*dist,distMult);
     
-   // Iterate every match in the above layer...
-    int32 prevY = -1; // Dummy value, so we always reset for the first entry.
+   // Iterate every match in the above layer, collecting the pairings it
+   // wants at this level - they are scored afterwards, all in one go...
     if (matches[l+1].Size()==0) break; // So we don't crash if the parameters are too fussy.
     ds::SortList<Match>::Cursor targ = matches[l+1].FrontPtr();
     while (!targ.Bad())
@@ -419,32 +559,8 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
      // Only consider this match if it is good enough...
       if (m.score<(distCap[l+1]*distCapThreshold))
       {
-       // If the match has a different y coordinate we need to recalculate the
-       // slices and update the correlation calculation objects...
-        if (m.y!=prevY)
-        {
-         prevY = m.y;
-         
-         if (left->HalfHeight())
-         {
-          leftSliceLow.Create(m.y*2,steps,leftImg,leftDiff);
-          rightSliceLow.Create(m.y*2,steps,rightImg,rightDiff);
-          dcLow.Setup(*dist,distCap[l],leftImg,leftSliceLow,rightImg,rightSliceLow);
-
-          leftSliceHigh.Create(m.y*2+1,steps,leftImg,leftDiff);
-          rightSliceHigh.Create(m.y*2+1,steps,rightImg,rightDiff);
-          dcHigh.Setup(*dist,distCap[l],leftImg,leftSliceHigh,rightImg,rightSliceHigh);
-         }
-         else
-         {
-          leftSliceLow.Create(m.y,steps,leftImg,leftDiff);
-          rightSliceLow.Create(m.y,steps,rightImg,rightDiff);
-          dcLow.Setup(*dist,distCap[l],leftImg,leftSliceLow,rightImg,rightSliceLow);
-         }
-        }
-
-       // Iterate the region around the match in the current level, calculating
-       // correlation values where they currently don't exist...
+       // Iterate the region around the match in the current level, adding
+       // pairings where they currently don't exist...
         int32 lowLeftX = math::Clamp<int32>(m.xLeft*2-int32(range),0,leftImg.Width()-1);
         int32 highLeftX = math::Clamp<int32>(m.xLeft*2+1+int32(range),0,leftImg.Width()-1);
         int32 lowRightX = math::Clamp<int32>(m.xRight*2-int32(range),0,rightImg.Width()-1);
@@ -454,37 +570,17 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
         {
          for (int32 xRight=lowRightX;xRight<=highRightX;xRight++)
          {
+          Match mNew;
+          mNew.y = left->HalfHeight() ? (m.y*2) : m.y;
+          mNew.xLeft = xLeft;
+          mNew.xRight = xRight;
+          mNew.score = 0.0;
+          if (matches[l].Get(mNew)==null<Match*>()) matches[l].Add(mNew);
+
           if (left->HalfHeight())
           {
-           Match mNew;
-           mNew.y = m.y*2;
-           mNew.xLeft = xLeft;
-           mNew.xRight = xRight;
-           if (matches[l].Get(mNew)==null<Match*>())
-           {
-            mNew.score = dcLow.Cost(xLeft,xRight);
-            matches[l].Add(mNew);
-           }
-           
            mNew.y += 1;
-           if ((mNew.y<int32(leftImg.Height()))&&(matches[l].Get(mNew)==null<Match*>()))
-           {
-            mNew.score = dcHigh.Cost(xLeft,xRight);
-            matches[l].Add(mNew);
-           }
-          }
-          else
-          {
-           Match mNew;
-           mNew.y = m.y;
-           mNew.xLeft = xLeft;
-           mNew.xRight = xRight;
-           
-           if (matches[l].Get(mNew)==null<Match*>())
-           {
-            mNew.score = dcLow.Cost(xLeft,xRight);
-            matches[l].Add(mNew);
-           }
+           if ((mNew.y<int32(leftImg.Height()))&&(matches[l].Get(mNew)==null<Match*>())) matches[l].Add(mNew);
           }
          }
         }
@@ -493,10 +589,22 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
      // To the next...   
       ++targ;
     }
+
+   // Score the new pairings...
+    prog->Report(step2++,steps2);
+    Score(matches[l],leftImg,leftDiff,rightImg,rightDiff,steps,distCap[l],prog);
     prog->Pop();
     
    // Break if we have just done the full resolution level...
     if (l==0) break;
+    if (prog->Cancelling()) break;
+  }
+
+ // Stop if cancelled, as there may be levels left undone...
+  if (prog->Cancelling())
+  {
+   prog->Pop();
+   return;
   }
  
  
@@ -722,6 +830,110 @@ void DiffusionCorrelationImage::Run(time::Progress * prog)
  prog->Pop();
 }
 
+void DiffusionCorrelationImage::Score(ds::SortList<Match> & matches,
+                                      const bs::LuvRangeImage & leftImg,const DiffusionWeight & leftDiff,
+                                      const bs::LuvRangeImage & rightImg,const DiffusionWeight & rightDiff,
+                                      nat32 diffSteps,real32 distCap,time::Progress * prog)
+{
+ prog->Push();
+
+ // Setup the diffusion weights, which are made a band at a time, and the
+ // correlation object...
+  RangeDiffusionImage leftKern;
+  leftKern.Setup(diffSteps,leftImg,leftDiff);
+
+  RangeDiffusionImage rightKern;
+  rightKern.Setup(diffSteps,rightImg,rightDiff);
+
+  DiffuseCorrelation dc;
+  dc.Setup(*dist,distCap,leftImg,leftKern,rightImg,rightKern);
+
+
+ // Index the matches, which are sorted by row then left then right, so each
+ // row is a contiguous range...
+  ds::Array<Match*> match(matches.Size());
+  if (matches.Size()!=0)
+  {
+   nat32 i = 0;
+   ds::SortList<Match>::Cursor targ = matches.FrontPtr();
+   while (!targ.Bad())
+   {
+    match[i] = &(*targ);
+    ++i;
+    ++targ;
+   }
+  }
+
+  ds::Array<nat32> rowStart(leftImg.Height()+1);
+  {
+   nat32 i = 0;
+   for (nat32 y=0;y<rowStart.Size();y++)
+   {
+    while ((i<match.Size())&&(match[i]->y<int32(y))) ++i;
+    rowStart[y] = i;
+   }
+  }
+
+
+ // Score the rows a band at a time, making the weights for just the rows of
+ // the band with matches...
+  mt::Pool & pool = mt::SharedPool();
+  ds::Array<real32> temp(2*rightImg.Width()*pool.Threads());
+
+  ScoreJob job;
+  job.dc = &dc;
+  job.match = match.Ptr();
+  job.rowStart = rowStart.Ptr();
+  job.temp = temp.Ptr();
+  job.width = rightImg.Width();
+
+  nat32 height = leftImg.Height();
+  nat32 bandRows = DiffusionBandRows(pool);
+  ds::Array<bit> need(bandRows);
+  for (nat32 first=0;first<height;first+=bandRows)
+  {
+   if (prog->Cancelling()) break;
+   prog->Report(first,height);
+   nat32 rows = math::Min(bandRows,height-first);
+   bit any = false;
+   for (nat32 r=0;r<rows;r++)
+   {
+    need[r] = rowStart[first+r+1]!=rowStart[first+r];
+    any = any || need[r];
+   }
+   if (!any) continue;
+
+   leftKern.Band(first,rows,need.Ptr());
+   rightKern.Band(first,rows,need.Ptr());
+
+   job.first = first;
+   pool.Run(job,rows);
+  }
+
+ prog->Pop();
+}
+
+void DiffusionCorrelationImage::ScoreJob::Do(nat32 r,nat32 thread)
+{
+ nat32 y = first + r;
+ real32 * out = temp + thread*2*width;
+ real32 * tmp = out + width;
+
+ nat32 i = rowStart[y];
+ while (i<rowStart[y+1])
+ {
+  // Find the run...
+   nat32 j = i+1;
+   while ((j<rowStart[y+1])&&(match[j]->xLeft==match[i]->xLeft)&&(match[j]->xRight==match[j-1]->xRight+1)) ++j;
+
+  // Score it...
+   dc->Cost(y,match[i]->xLeft,match[i]->xRight,j-i,out,tmp);
+   for (nat32 k=i;k<j;k++) match[k]->score = out[k-i];
+
+  i = j;
+ }
+}
+
 int32 DiffusionCorrelationImage::Range() const
 {
  return range;
@@ -840,6 +1052,11 @@ void DiffCorrStereo::Run(time::Progress * prog)
   dci.Set(minimaLimit,baseDistCap,distCapMult,distCapThreshold,dispRange,diffSteps);
 
   dci.Run(prog);
+  if (prog->Cancelling())
+  {
+   prog->Pop();
+   return;
+  }
 
 
  // Finally, do the work this class is meant to do - for each pixel calculate a
@@ -1039,7 +1256,7 @@ void DiffCorrRefine::Run(time::Progress * prog)
   bs::BasicLRD dist;
   
  // Generate range images from the inputs...
-  prog->Report(0,disp.Size(1)+2);
+  prog->Report(0,3);
   bs::LuvRangeImage l;
   l.Create(left,leftMask,useHalfX,useHalfY,useCorners);
   
@@ -1047,7 +1264,7 @@ void DiffCorrRefine::Run(time::Progress * prog)
   lw.Create(l,dist,distMult,prog);
 
 
-  prog->Report(1,disp.Size(1)+2);
+  prog->Report(1,3);
   bs::LuvRangeImage r;
   r.Create(right,rightMask,useHalfX,useHalfY,useCorners);
   
@@ -1055,74 +1272,105 @@ void DiffCorrRefine::Run(time::Progress * prog)
   rw.Create(r,dist,distMult,prog);
   
   
- // Iterate the disparity map and refine...
+ // Setup the diffusion maps, which are made a band at a time...
+  RangeDiffusionImage ls;
+  ls.Setup(diffSteps,l,lw);
+
+  RangeDiffusionImage rs;
+  rs.Setup(diffSteps,r,rw);
+
+
+ // Iterate the disparity map and refine, a band of rows at a time with the
+ // rows of a band done in parallel, making the diffusion maps of just the rows
+ // that have disparities to refine...
+  prog->Report(2,3);
+  prog->Push();
   out.Resize(disp.Size(0),disp.Size(1));
 
-  RangeDiffusionSlice ls;
-  RangeDiffusionSlice rs;
   DiffuseCorrelation dc;
-  
-  for (int32 y=0;y<int32(out.Height());y++)
+  dc.Setup(dist,cap,l,ls,r,rs);
+
+  RefineJob job;
+  job.self = this;
+  job.dc = &dc;
+  job.l = &l;
+  job.r = &r;
+
+  mt::Pool & pool = mt::SharedPool();
+  nat32 height = out.Height();
+  nat32 bandRows = DiffusionBandRows(pool);
+  ds::Array<bit> need(bandRows);
+  for (nat32 first=0;first<height;first+=bandRows)
   {
-   prog->Report(2+y,disp.Size(1)+2);
-   prog->Push();
-   
-   // Create the diffusion maps for this scanline...
-    prog->Report(0,3);
-    ls.Create(y,diffSteps,l,lw,prog);
-    
-    prog->Report(1,3);
-    rs.Create(y,diffSteps,r,rw,prog);
+   if (prog->Cancelling()) break;
+   prog->Report(first,height);
+   nat32 rows = math::Min(bandRows,height-first);
+   for (nat32 r=0;r<rows;r++)
+   {
+    need[r] = !dispMask.Valid();
+    for (nat32 x=0;(x<out.Width())&&(!need[r]);x++) need[r] = dispMask.Get(x,first+r);
+   }
+
+   ls.Band(first,rows,need.Ptr());
+   rs.Band(first,rows,need.Ptr());
+
+   job.first = first;
+   pool.Run(job,rows);
+  }
+  prog->Pop();
     
+ 
+ prog->Pop();
+}
 
-   // Do the scanline...
-    prog->Report(2,3);
-    dc.Setup(dist,cap,l,ls,r,rs);
-    for (int32 x=0;x<int32(out.Width());x++)
-    {
-     // Make it bad, so we can continue if we give up and obey the mask...
-      out.Get(x,y) = math::Infinity<real32>();
-      if (dispMask.Valid()&&(dispMask.Get(x,y)==false)) continue;
+void DiffCorrRefine::RefineJob::Do(nat32 yy,nat32)
+{
+ int32 y = first + yy;
+ for (int32 x=0;x<int32(self->out.Width());x++)
+ {
+  // Make it bad, so we can continue if we give up and obey the mask...
+   self->out.Get(x,y) = math::Infinity<real32>();
+   if (self->dispMask.Valid()&&(self->dispMask.Get(x,y)==false)) continue;
       
-     // Get the discrete x value for the other image, rounding if needed...
-      int32 x2 = x + int32(math::Round(disp.Get(x,y)));
+  // Get the discrete x value for the other image, rounding if needed...
+   int32 x2 = x + int32(math::Round(self->disp.Get(x,y)));
       
-     // Check the masking is safe - we throw away values that have bad masking...
-      if ((l.ValidExt(x   ,y)==false)||
-          (l.ValidExt(x+1 ,y)==false)||
-          (l.ValidExt(x-1 ,y)==false)||
-          (r.ValidExt(x2  ,y)==false)||
-          (r.ValidExt(x2+1,y)==false)||
-          (r.ValidExt(x2-1,y)==false)) continue;
+  // Check the masking is safe - we throw away values that have bad masking...
+   if ((l->ValidExt(x   ,y)==false)||
+       (l->ValidExt(x+1 ,y)==false)||
+       (l->ValidExt(x-1 ,y)==false)||
+       (r->ValidExt(x2  ,y)==false)||
+       (r->ValidExt(x2+1,y)==false)||
+       (r->ValidExt(x2-1,y)==false)) continue;
      
-     // Get the 5 needed correlation values - the current pixel and offset 
-     // by 1 for each image...
-      real32 centre = dc.Cost(x,x2);
-      real32 negL = dc.Cost(x-1,x2);
-      real32 posL = dc.Cost(x+1,x2);
-      real32 negR = dc.Cost(x,x2-1);
-      real32 posR = dc.Cost(x,x2+1);
+  // Get the 5 needed correlation values - the current pixel and offset 
+  // by 1 for each image. The three offsets in the right image are a run...
+   real32 run[3];
+   real32 temp[3];
+   dc->Cost(y,x,x2-1,3,run,temp);
+   real32 negR = run[0];
+   real32 centre = run[1];
+   real32 posR = run[2];
+
+   real32 negL;
+   dc->Cost(y,x-1,x2,1,&negL,temp);
+   real32 posL;
+   dc->Cost(y,x+1,x2,1,&posL,temp);
      
-     // Verify that the pixel is sufficiently better than the rest...
-      if (((negL-centre)<prune)||
-          ((posL-centre)<prune)||
-          ((negR-centre)<prune)||
-          ((posR-centre)<prune)) continue;
+  // Verify that the pixel is sufficiently better than the rest...
+   if (((negL-centre)<self->prune)||
+       ((posL-centre)<self->prune)||
+       ((negR-centre)<self->prune)||
+       ((posR-centre)<self->prune)) continue;
      
-     // Refine the disparity position and store it...
-      real32 p = 0.5*(negL+negR);
-      real32 q = centre;
-      real32 r = 0.5*(posL+posR);
+  // Refine the disparity position and store it...
+   real32 p = 0.5*(negL+negR);
+   real32 q = centre;
+   real32 r = 0.5*(posL+posR);
       
-      real32 dOS = (p-r)/(2.0*(p+r) - 4.0*q);
-      out.Get(x,y) = real32(x2-x) + dOS;
-    }
-
-   prog->Pop();
-  }
-    
- 
- prog->Pop();
+   real32 dOS = (p-r)/(2.0*(p+r) - 4.0*q);
+   self->out.Get(x,y) = real32(x2-x) + dOS;
+ }
 }
 
 void DiffCorrRefine::GetDisp(svt::Field<real32> & d) const
@@ -25,7 +25,9 @@
 #include "eos/types.h"
 #include "eos/time/progress.h"
 #include "eos/bs/luv_range.h"
+#include "eos/ds/sort_lists.h"
 #include "eos/stereo/dsi.h"
+#include "eos/mt/pool.h"
 
 
 namespace eos
@@ -130,6 +132,98 @@ class EOS_CLASS RangeDiffusionSlice
    ds::Array2D<nat32> offset; // Index from (u+steps,v+steps) to the above linearisation. Only valid when abs(u) + abs(v) <= steps.
 };
 
+//------------------------------------------------------------------------------
+/// The multi-row version of RangeDiffusionSlice - calculates the diffusion
+/// weights of every pixel in a band of rows in one go, with the rows done in
+/// parallel on mt::SharedPool(). Only the diamond of the stencil, the (u,v)
+/// with abs(u) + abs(v) <= steps, is stored, each entry as a plane with a row
+/// for every row of the band, so the weights of a run of pixels for a given
+/// stencil entry are contiguous. This is what DiffuseCorrelation needs to
+/// evaluate a pixel against a run of pixels in the other image. At 2s(s+1)+1
+/// floats a pixel the weights of a whole image are too big to keep, so users
+/// work down the image a band at a time.
+class EOS_CLASS RangeDiffusionImage
+{
+ public:
+  /// &nbsp;
+   RangeDiffusionImage();
+
+  /// &nbsp;
+   ~RangeDiffusionImage();
+
+
+  /// Sets the image and weights to diffuse with, which must survive till the
+  /// last call to Band. Calculates nothing.
+   void Setup(nat32 steps, const bs::LuvRangeImage & img, const DiffusionWeight & dw);
+
+  /// Calculates the data for rows first to first+rows-1, as for
+  /// RangeDiffusionSlice::Create, replacing the previous band. If need is
+  /// given only rows with need[y-first] true are calculated, the data of the
+  /// others being undefined.
+   void Band(nat32 first, nat32 rows, const bit * need = null<const bit*>(), time::Progress * prog = null<time::Progress*>());
+
+
+  /// &nbsp;
+   nat32 Width() const {return width;}
+
+  /// &nbsp;
+   nat32 Height() const {return height;}
+
+  /// &nbsp;
+   nat32 Steps() const {return steps;}
+
+  /// Returns the first row of the current band.
+   nat32 First() const {return first;}
+
+  /// Returns how many rows the current band has.
+   nat32 Rows() const {return rows;}
+
+  /// Returns how many entries the stencil has.
+   nat32 Size() const {return size;}
+
+  /// Returns the index of the stencil entry for a (u,v) window coordinate,
+  /// which must satisfy abs(u) + abs(v) <= steps.
+   nat32 Index(int32 u,int32 v) const {return offset.Get(u+int32(steps),v+int32(steps));}
+
+  /// Returns the weight for a pixel and (u,v) window coordinate, 0.0 for
+  /// out of range window coordinates. y must be in the current band.
+   real32 Get(nat32 x,nat32 y,int32 u,int32 v) const;
+
+  /// Returns the weights of a given stencil entry for a row of the image,
+  /// Width() contiguous values. y must be in the current band.
+   const real32 * Row(nat32 y,nat32 index) const {return &data[((y-first)*size + index)*width];}
+
+
+  /// &nbsp;
+   inline cstrconst TypeString() const {return "eos::stereo::RangeDiffusionImage";}
+
+
+ private:
+  nat32 steps;
+  nat32 width;
+  nat32 height;
+  nat32 size;
+  const bs::LuvRangeImage * img;
+  const DiffusionWeight * dw;
+
+  nat32 first;
+  nat32 rows;
+
+  ds::Array2D<nat32> offset; // As for RangeDiffusionSlice.
+  ds::Array<real32> data; // Indexed [y-first][index][x], only grown.
+
+  // Does the diffusion for a row of the band...
+   class RowJob : public mt::Job
+   {
+    public:
+     RangeDiffusionImage * self;
+     const bit * need;
+     ds::Array2D<real32> * buf; // Two per thread.
+
+     void Do(nat32 y,nat32 thread);
+   };
+};
+
 //------------------------------------------------------------------------------
 /// This is given a pair of bs::LuvRangeImage's and RangeDiffusionSlice's,
 /// it then calculates the correlation between pixels in the two slices.
@@ -140,6 +234,11 @@ class EOS_CLASS RangeDiffusionSlice
 /// A distance cap is provided - distances are capped at this value, to
 /// handle outliers. This is also the value used if either pixel is outside the
 /// image or masked.
+/// Can alternativly be setup with a pair of RangeDiffusionImage's, in which
+/// case any row of there current bands can be used and a pixel can be
+/// evaluated against a run of pixels in the other image in one pass, with the
+/// inner loops over contiguous memory so they vectorise. Evaluation is const,
+/// so many threads can share one object.
 class EOS_CLASS DiffuseCorrelation
 {
  public:
@@ -153,6 +252,10 @@ class EOS_CLASS DiffuseCorrelation
   /// Fills in the valid details - note that all passed in objects must survive
   /// the lifetime of this object.
    void Setup(const bs::LuvRangeDist & dist, real32 distCap, const bs::LuvRangeImage & img1, const RangeDiffusionSlice & dif1, const bs::LuvRangeImage & img2, const RangeDiffusionSlice & dif2);
+
+  /// Fills in the details from banded diffusion weights, for use with the
+  /// run version of Cost. Again, all passed in objects must survive.
+   void Setup(const bs::LuvRangeDist & dist, real32 distCap, const bs::LuvRangeImage & img1, const RangeDiffusionImage & dif1, const bs::LuvRangeImage & img2, const RangeDiffusionImage & dif2);
    
   /// Returns the width of image 1.
    nat32 Width1() const;
@@ -161,8 +264,15 @@ class EOS_CLASS DiffuseCorrelation
    nat32 Width2() const;
    
   /// Given two x coordinates this returns their matching cost - note that this
-  /// does the correlation and is a slow method call.
+  /// does the correlation and is a slow method call. Only for when setup with
+  /// RangeDiffusionSlice's.
    real32 Cost(nat32 x1,nat32 x2) const;
+
+  /// Calculates the matching cost for pixel x1 against each of the count
+  /// pixels starting at x2, all in row y, writing them into out. temp must be
+  /// count in size. Only for when setup with RangeDiffusionImage's, the run
+  /// must be inside image 2.
+   void Cost(nat32 y,nat32 x1,nat32 x2,nat32 count,real32 * out,real32 * temp) const;
    
   /// Returns the distance cap used.
    real32 DistanceCap() const;
@@ -178,8 +288,10 @@ class EOS_CLASS DiffuseCorrelation
   
   const bs::LuvRangeImage * img1;
   const RangeDiffusionSlice * dif1;
+  const RangeDiffusionImage * kern1;
   const bs::LuvRangeImage * img2;
   const RangeDiffusionSlice * dif2;
+  const RangeDiffusionImage * kern2;
 };
 
 //------------------------------------------------------------------------------
@@ -216,7 +328,8 @@ class EOS_CLASS DiffusionCorrelationImage
    void Set(nat32 minimaLimit = 8, real32 baseDistCap = 1.0, real32 distCapMult = 2.0, real32 distCapThreshold = 0.5, nat32 range = 2, nat32 steps = 5);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm. Stops early if prog is cancelled, in which case the
+  /// output is invalid.
    void Run(time::Progress * prog = null<time::Progress*>());
    
   
@@ -307,6 +420,30 @@ class EOS_CLASS DiffusionCorrelationImage
      return d < rhs.d;
     }
    };
+
+  // Scores the matches of a row, doing each run of matches with the same
+  // left pixel and consecutive right pixels in one pass...
+   class ScoreJob : public mt::Job
+   {
+    public:
+     const DiffuseCorrelation * dc;
+     Match ** match; // Sorted.
+     nat32 * rowStart; // Index of first match of each row in match, with an extra entry at the end.
+     real32 * temp; // 2*width per thread.
+     nat32 width;
+     nat32 first; // Row of unit 0, the first of the band being done.
+
+     void Do(nat32 y,nat32 thread);
+   };
+
+  // Fills in the score of all matches in the given list, which are for the
+  // given images, working down the image a band of rows at a time - the
+  // diffusion weights of the rows of a band with matches are made, then the
+  // rows scored in parallel...
+   void Score(ds::SortList<Match> & matches,
+              const bs::LuvRangeImage & leftImg,const DiffusionWeight & leftDiff,
+              const bs::LuvRangeImage & rightImg,const DiffusionWeight & rightDiff,
+              nat32 diffSteps,real32 distCap,time::Progress * prog);
 };
 
 //------------------------------------------------------------------------------
@@ -361,7 +498,8 @@ class EOS_CLASS DiffCorrStereo : public DSI
    void SetRefine(bit doLR,real32 distCapDifference);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm. Stops early if prog is cancelled, in which case the
+  /// output is invalid.
    void Run(time::Progress * prog = null<time::Progress*>());
 
   
@@ -469,7 +607,8 @@ class EOS_CLASS DiffCorrRefine
    void SetDist(real32 cap,real32 prune);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm. Stops early if prog is cancelled, in which case the
+  /// output is invalid.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -506,6 +645,19 @@ class EOS_CLASS DiffCorrRefine
 
   // Output...
    ds::Array2D<real32> out; // I use infinity to indicate masked values.
+
+  // Refines a row...
+   class RefineJob : public mt::Job
+   {
+    public:
+     DiffCorrRefine * self;
+     const DiffuseCorrelation * dc;
+     const bs::LuvRangeImage * l;
+     const bs::LuvRangeImage * r;
+     nat32 first; // Row of unit 0, the first of the band being done.
+
+     void Do(nat32 y,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
@@ -1013,60 +1013,62 @@ void SparsePlane::Run(time::Progress * prog)
 {
  prog->Push();
  
- // Count how many segments there are...
+ // Index the pixels of each segment...
   prog->Report(0,2);
-  nat32 segCount = 1;
-  for (nat32 y=0;y<seg.Size(1);y++)
-  {
-   for (nat32 x=0;x<seg.Size(0);x++) segCount = math::Max(segCount,seg.Get(x,y)+1);
-  }
- 
- // Create a plane fitter for each...
-  ds::ArrayDel<alg::LinePlaneFit> fit(segCount);
+  filter::SegPixels pixels(seg);
+  nat32 segCount = pixels.Segments();
 
- // Run through and fill in the relevant data for each fitter...
-  prog->Push();
-   for (nat32 y=0;y<seg.Size(1);y++)
-   {
-    prog->Report(y,seg.Size(1));
-    for (nat32 x=0;x<seg.Size(0);x++)
-    {
-     nat32 s = seg.Get(x,y);
-     if ((!duds)||(s!=0))
-     {
-      for (nat32 i=0;i<spos->Size(x,y);i++)
-      {
-       fit[s].Add(spos->Start(x,y,i),spos->End(x,y,i),math::Exp(-spos->Cost(x,y,i)));
-      }
-     }
-    }
-   }
-  prog->Pop();
+  ds::Array<nat32> order;
+  pixels.Order(order);
 
- // Run 'em all, extracting as we go...
+ // Fit every segment, in parallel...
   prog->Report(1,2);
-  prog->Push();
   plane.Size(segCount);
-  if (duds)
-  {
-   plane[0].n[0] = 0.0;
-   plane[0].n[1] = 0.0;
-   plane[0].n[2] = 0.0;
-   plane[0].d = 1.0;
-  }
-   
-  for (nat32 i=duds?1:0;i<fit.Size();i++)
-  {
-   prog->Report(i,fit.Size());
-   fit[i].Run();
-   plane[i] = fit[i].Plane();
-   plane[i].Normalise();
-  }
+
+  FitJob job;
+  job.self = this;
+  job.pixels = &pixels;
+  job.order = &order;
+  prog->Push();
+   mt::SharedPool().Run(job,segCount,prog);
   prog->Pop();
  
  prog->Pop();
 }
 
+void SparsePlane::FitJob::Do(nat32 unit,nat32)
+{
+ nat32 s = (*order)[unit];
+ bs::Plane & out = self->plane[s];
+
+ if (self->duds&&(s==0))
+ {
+  out.n[0] = 0.0;
+  out.n[1] = 0.0;
+  out.n[2] = 0.0;
+  out.d = 1.0;
+  return;
+ }
+
+ // Fill in the fitter, in raster order...
+  const SparsePos & spos = *self->spos;
+  alg::LinePlaneFit fit;
+  for (nat32 j=0;j<pixels->Size(s);j++)
+  {
+   nat32 x = pixels->X(s,j);
+   nat32 y = pixels->Y(s,j);
+   for (nat32 i=0;i<spos.Size(x,y);i++)
+   {
+    fit.Add(spos.Start(x,y,i),spos.End(x,y,i),math::Exp(-spos.Cost(x,y,i)));
+   }
+  }
+
+ // Run it and extract...
+  fit.Run();
+  out = fit.Plane();
+  out.Normalise();
+}
+
 nat32 SparsePlane::Segments() const
 {
  return plane.Size();
@@ -1226,80 +1228,94 @@ void LocalSparsePlane::Run(time::Progress * prog)
    math::PseudoInverse(pair.lp,invLP);
 
 
- // Iterate every single pixel, for each do a plane fitting...
+ // Iterate every single pixel, for each do a plane fitting, a row at a time
+ // in parallel...
   data.Resize(seg.Size(0),seg.Size(1));
-  for (int32 y=0;y<int32(seg.Size(1));y++)
-  {
-   prog->Report(y,seg.Size(1));
-   for (int32 x=0;x<int32(seg.Size(0));x++)
+
+  RowJob job;
+  job.self = this;
+  job.centre = &centre;
+  job.invLP = &invLP;
+  mt::SharedPool().Run(job,seg.Size(1),prog);
+ 
+ prog->Pop();
+}
+
+void LocalSparsePlane::RowJob::Do(nat32 row,nat32)
+{
+ const svt::Field<nat32> & seg = self->seg;
+ const SparsePos * spos = self->spos;
+ int32 radius = self->radius;
+ const cam::CameraPair & pair = self->pair;
+ ds::Array2D<bs::PosDir> & data = self->data;
+
+ int32 y = int32(row);
+ for (int32 x=0;x<int32(seg.Size(0));x++)
+ {
+  nat32 s = seg.Get(x,y);
+    
+  // Set or calculate the plane...
+   bs::Plane plane;
+   if (self->duds&&(s==0))
+   {
+    plane.n[0] = 0.0;
+    plane.n[1] = 0.0;
+    plane.n[2] = 0.0;
+    plane.d = 1.0;
+   }
+   else
    {
-    nat32 s = seg.Get(x,y);
+    alg::LinePlaneFit lpf;
     
-    // Set or calculate the plane...
-     bs::Plane plane;
-     if (duds&&(s==0))
+    // Iterate the window and add all relevant pixels...
+     real32 distMult = 1.0/real32(radius+1);
+     for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
      {
-      plane.n[0] = 0.0;
-      plane.n[1] = 0.0;
-      plane.n[2] = 0.0;
-      plane.d = 1.0;
-     }
-     else
-     {
-      alg::LinePlaneFit lpf;
-    
-      // Iterate the window and add all relevant pixels...
-       real32 distMult = 1.0/real32(radius+1);
-       for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
+      for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
+      {
+       if (seg.Get(u,v)==s)
        {
-        for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
+        for (nat32 i=0;i<spos->Size(u,v);i++)
         {
-         if (seg.Get(u,v)==s)
-         {
-          for (nat32 i=0;i<spos->Size(u,v);i++)
-          {
-           real32 dist = math::Sqrt(math::Sqr(u-x)+math::Sqr(v-y));
-           real32 mult = math::Max(0.0,1.0-distMult*dist);
-           lpf.Add(spos->Start(u,v,i),spos->End(u,v,i),mult*math::Exp(-spos->Cost(u,v,i)));
-          }
-         }
+         real32 dist = math::Sqrt(math::Sqr(u-x)+math::Sqr(v-y));
+         real32 mult = math::Max(0.0,1.0-distMult*dist);
+         lpf.Add(spos->Start(u,v,i),spos->End(u,v,i),mult*math::Exp(-spos->Cost(u,v,i)));
         }
        }
-    
-      // Find the plane...
-       lpf.Run();
-       plane = lpf.Plane();
-       plane.Normalise();
+      }
      }
+    
+    // Find the plane...
+     lpf.Run();
+     plane = lpf.Plane();
+     plane.Normalise();
+   }
 
-    // Calculate and store the position and orientation...
-     // Calculate ray - we have the centre, we now need another point, which may
-     // be provided by the psuedo inverse, after un-rectification of course...
-      math::Vect<3,real64> rp;
-       rp[0] = x;
-       rp[1] = y;
-       rp[2] = 1.0;
+  // Calculate and store the position and orientation...
+   // Calculate ray - we have the centre, we now need another point, which may
+   // be provided by the psuedo inverse, after un-rectification of course...
+    math::Vect<3,real64> rp;
+     rp[0] = x;
+     rp[1] = y;
+     rp[2] = 1.0;
      
-      math::Vect<3,real64> urp;
-      math::MultVect(pair.unRectLeft,rp,urp);
+    math::Vect<3,real64> urp;
+    math::MultVect(pair.unRectLeft,rp,urp);
      
-      math::Vect<4,real64> to;
-      math::MultVect(invLP,urp,to);
-      if (!math::IsZero(to[3])) to /= to[3];
+    math::Vect<4,real64> to;
+    math::MultVect(*invLP,urp,to);
+    if (!math::IsZero(to[3])) to /= to[3];
     
-     // Intercept with plane...
-      math::Vect<4,real64> loc;
-      plane.LineIntercept(centre,to,loc);
-      data.Get(x,y).pos = loc;
-      if (!math::IsZero(data.Get(x,y).pos[3])) data.Get(x,y).pos /= data.Get(x,y).pos[3];
+   // Intercept with plane...
+    math::Vect<4,real64> loc;
+    plane.LineIntercept(*centre,to,loc);
+    data.Get(x,y).pos = loc;
+    if (!math::IsZero(data.Get(x,y).pos[3])) data.Get(x,y).pos /= data.Get(x,y).pos[3];
       
-     // Orientation from plane is somewhat easier...
-      data.Get(x,y).dir = plane.n;
-      if (plane.n[2]<0.0) data.Get(x,y).dir *= -1.0;
-   }
-  }
- 
- prog->Pop();
+   // Orientation from plane is somewhat easier...
+    data.Get(x,y).dir = plane.n;
+    if (plane.n[2]<0.0) data.Get(x,y).dir *= -1.0;
+ }
 }
 
 void LocalSparsePlane::PosMap(svt::Field<bs::Vertex> & out) const
@@ -1407,78 +1423,93 @@ void OrientSparsePlane::Run(time::Progress * prog)
    math::PseudoInverse(pair.lp,invLP);
 
 
- // Iterate every single pixel, for each do a plane fitting...
+ // Iterate every single pixel, for each do a plane fitting, a row at a time
+ // in parallel...
   data.Resize(seg.Size(0),seg.Size(1));
-  for (int32 y=0;y<int32(seg.Size(1));y++)
-  {
-   prog->Report(y,seg.Size(1));
-   for (int32 x=0;x<int32(seg.Size(0));x++)
+
+  RowJob job;
+  job.self = this;
+  job.centre = &centre;
+  job.invLP = &invLP;
+  mt::SharedPool().Run(job,seg.Size(1),prog);
+ 
+ prog->Pop();
+}
+
+void OrientSparsePlane::RowJob::Do(nat32 row,nat32)
+{
+ const svt::Field<nat32> & seg = self->seg;
+ const SparsePos * spos = self->spos;
+ int32 radius = self->radius;
+ const svt::Field<bs::Normal> & needle = self->needle;
+ const cam::CameraPair & pair = self->pair;
+ ds::Array2D<bs::PosDir> & data = self->data;
+
+ int32 y = int32(row);
+ for (int32 x=0;x<int32(seg.Size(0));x++)
+ {
+  nat32 s = seg.Get(x,y);
+    
+  // Set or calculate the plane...
+   bs::Plane plane;
+   if (self->duds&&(s==0))
    {
-    nat32 s = seg.Get(x,y);
+    plane.n[0] = 0.0;
+    plane.n[1] = 0.0;
+    plane.n[2] = 0.0;
+    plane.d = 1.0;
+   }
+   else
+   {
+    alg::DepthPlane lpf;
+    lpf.Set(needle.Get(x,y));
     
-    // Set or calculate the plane...
-     bs::Plane plane;
-     if (duds&&(s==0))
+    // Iterate the window and add all relevant pixels...
+     for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
      {
-      plane.n[0] = 0.0;
-      plane.n[1] = 0.0;
-      plane.n[2] = 0.0;
-      plane.d = 1.0;
-     }
-     else
-     {
-      alg::DepthPlane lpf;
-      lpf.Set(needle.Get(x,y));
-    
-      // Iterate the window and add all relevant pixels...
-       for (int32 v=math::Max<int32>(y-radius,0);v<=math::Min<int32>(y+radius,int32(seg.Size(1))-1);v++)
+      for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
+      {
+       if (seg.Get(u,v)==s)
        {
-        for (int32 u=math::Max<int32>(x-radius,0);u<=math::Min<int32>(x+radius,int32(seg.Size(0))-1);u++)
+        for (nat32 i=0;i<spos->Size(u,v);i++)
         {
-         if (seg.Get(u,v)==s)
-         {
-          for (nat32 i=0;i<spos->Size(u,v);i++)
-          {
-           lpf.Add(spos->Centre(x,y,i));
-          }
-         }
+         lpf.Add(spos->Centre(x,y,i));
         }
        }
-    
-      // Find the plane...
-       lpf.Run();
-       plane = lpf.Plane();
-       plane.Normalise();
+      }
      }
+    
+    // Find the plane...
+     lpf.Run();
+     plane = lpf.Plane();
+     plane.Normalise();
+   }
 
-    // Calculate and store the position and orientation...
-     // Calculate ray - we have the centre, we now need another point, which may
-     // be provided by the psuedo inverse, after un-rectification of course...
-      math::Vect<3,real64> rp;
-       rp[0] = x;
-       rp[1] = y;
-       rp[2] = 1.0;
+  // Calculate and store the position and orientation...
+   // Calculate ray - we have the centre, we now need another point, which may
+   // be provided by the psuedo inverse, after un-rectification of course...
+    math::Vect<3,real64> rp;
+     rp[0] = x;
+     rp[1] = y;
+     rp[2] = 1.0;
      
-      math::Vect<3,real64> urp;
-      math::MultVect(pair.unRectLeft,rp,urp);
+    math::Vect<3,real64> urp;
+    math::MultVect(pair.unRectLeft,rp,urp);
      
-      math::Vect<4,real64> to;
-      math::MultVect(invLP,urp,to);
-      if (!math::IsZero(to[3])) to /= to[3];
+    math::Vect<4,real64> to;
+    math::MultVect(*invLP,urp,to);
+    if (!math::IsZero(to[3])) to /= to[3];
     
-     // Intercept with plane...
-      math::Vect<4,real64> loc;
-      plane.LineIntercept(centre,to,loc);
-      data.Get(x,y).pos = loc;
-      if (!math::IsZero(data.Get(x,y).pos[3])) data.Get(x,y).pos /= data.Get(x,y).pos[3];
+   // Intercept with plane...
+    math::Vect<4,real64> loc;
+    plane.LineIntercept(*centre,to,loc);
+    data.Get(x,y).pos = loc;
+    if (!math::IsZero(data.Get(x,y).pos[3])) data.Get(x,y).pos /= data.Get(x,y).pos[3];
       
-     // Orientation from plane is somewhat easier...
-      data.Get(x,y).dir = plane.n;
-      if (plane.n[2]<0.0) data.Get(x,y).dir *= -1.0;
-   }
-  }
- 
- prog->Pop();
+   // Orientation from plane is somewhat easier...
+    data.Get(x,y).dir = plane.n;
+    if (plane.n[2]<0.0) data.Get(x,y).dir *= -1.0;
+ }
 }
 
 void OrientSparsePlane::PosMap(svt::Field<bs::Vertex> & out) const
@@ -36,6 +36,8 @@
 #include "eos/file/csv.h"
 #include "eos/cam/files.h"
 #include "eos/bs/geo3d.h"
+#include "eos/mt/pool.h"
+#include "eos/filter/seg_pixels.h"
 #include "eos/stereo/dsi.h"
 
 namespace eos
@@ -451,7 +453,9 @@ class EOS_CLASS SparsePlane
    void Duds(bit enable);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm. Segments are fitted in parallel, each from an index
+  /// of its pixels, so thousands of small segments cost little more than a
+  /// single pass over the data.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -482,6 +486,18 @@ class EOS_CLASS SparsePlane
 
   // Output...
    ds::Array<bs::Plane> plane;
+
+  // Fits the plane of one segment per unit, with the segments handed out
+  // largest first so the big ones don't end up finishing last...
+   class FitJob : public mt::Job
+   {
+    public:
+     SparsePlane * self;
+     const filter::SegPixels * pixels;
+     const ds::Array<nat32> * order;
+
+     void Do(nat32 unit,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
@@ -545,6 +561,17 @@ class EOS_CLASS LocalSparsePlane
 
   // Output...
    ds::Array2D<bs::PosDir> data;
+
+  // Fits the planes of a row of pixels per unit...
+   class RowJob : public mt::Job
+   {
+    public:
+     LocalSparsePlane * self;
+     const math::Vect<4,real64> * centre;
+     const math::Mat<4,3,real64> * invLP;
+
+     void Do(nat32 row,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
@@ -617,6 +644,17 @@ class EOS_CLASS OrientSparsePlane
 
   // Output...
    ds::Array2D<bs::PosDir> data;
+
+  // Fits the planes of a row of pixels per unit...
+   class RowJob : public mt::Job
+   {
+    public:
+     OrientSparsePlane * self;
+     const math::Vect<4,real64> * centre;
+     const math::Mat<4,3,real64> * invLP;
+
+     void Do(nat32 row,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
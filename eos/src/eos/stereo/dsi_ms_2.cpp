@@ -58,9 +58,6 @@ void SparseDSI2::Run(time::Progress * prog)
 {
  LogBlock("eos::stereo::SparseDSI2::Run","-");
  prog->Push();
- #ifdef EOS_DEBUG
- nat32 dispCount = 0;
- #endif
 
 
  // Create data structures needed during the process, plus other initialisation
@@ -85,416 +82,479 @@ void SparseDSI2::Run(time::Progress * prog)
    int32 levels = math::Min(math::TopBit(widthLeft),math::TopBit(widthRight));
 
 
-  // Create a data structure to store the masking for a single scanline...
-   ds::ArrayDel< ds::Array<bit> > leftMask(levels);
-   ds::ArrayDel< ds::Array<bit> > rightMask(levels);
-   for (int32 l=0;l<levels;l++)
+
+ // Process the image a row at a time - without a vertical cost the rows are
+ // independent so are done in parallel, each thread with its own workspace,
+ // otherwise each row needs the one above so they are done in order...
+  if (math::IsZero(vertMult))
+  {
+   mt::Pool & pool = mt::SharedPool();
+   ds::ArrayDel<Workspace> ws(pool.Threads());
+   for (nat32 t=0;t<ws.Size();t++) Prepare(levels,ws[t]);
+
+   RowJob job;
+   job.self = this;
+   job.levels = levels;
+   job.ws = &ws;
+   job.prog = prog;
+
+   pool.Run(job,heightLeft,prog);
+  }
+  else
+  {
+   Workspace ws;
+   Prepare(levels,ws);
+
+   for (int32 y=0;(y<heightLeft)&&(!prog->Cancelling());y++)
    {
-    leftMask[l].Size(widthLeft>>l);
-    rightMask[l].Size(widthRight>>l);
+    prog->Report(y,heightLeft);
+    DoRow(y,levels,ws);
    }
+  }
+
+
+ #ifdef EOS_DEBUG
+ nat32 dispCount = 0;
+ for (int32 y=0;y<heightLeft;y++) dispCount += data[y].data.Size();
+ #endif
+ LogDebug("[SparseStereo 2] {left pixels,disparities,d/p}" << LogDiv()
+            << (widthLeft*heightLeft) << LogDiv() << dispCount << LogDiv()
+            << real32(dispCount)/real32(widthLeft*heightLeft));
+ prog->Pop();
+}
+
+nat32 SparseDSI2::Size(nat32 x,nat32 y) const
+{
+ return data[y].index[x+1] - data[y].index[x];
+}
+
+real32 SparseDSI2::Disp(nat32 x,nat32 y,nat32 i) const
+{
+ return data[y].data[data[y].index[x]+i].disp;
+}
 
+real32 SparseDSI2::Cost(nat32 x,nat32 y,nat32 i) const
+{
+ return data[y].data[data[y].index[x]+i].cost;
+}
 
-  // Create a data structure to store a feature hierachy for a single scanline...
-   ds::ArrayDel< mem::StackPtr<byte> > leftCol(levels);
-   ds::ArrayDel< mem::StackPtr<byte> > rightCol(levels);
-   for (int32 l=0;l<levels;l++)
+void SparseDSI2::SortByDisp(time::Progress * prog)
+{
+ prog->Push();
+  // Simply sort each pixel by a suitable cost function...
+  // (Lots of lil' sorts.)
+   for (int32 y=0;y<heightLeft;y++)
    {
-    leftCol[l] = new byte[dsc->Bytes() * (widthLeft>>l)];
-    rightCol[l] = new byte[dsc->Bytes() * (widthRight>>l)];
+    prog->Report(y,heightLeft);
+    for (int32 x=0;x<widthLeft;x++)
+    {
+     data[y].data.SortRange<DispCost::SortDisp>(data[y].index[x],data[y].index[x+1]-1);
+    }
    }
+ prog->Pop();
+}
 
+void SparseDSI2::SortByCost(time::Progress * prog)
+{
+ prog->Push();
+  // Simply sort each pixel by a suitable cost function...
+  // (Lots of lil' sorts.)
+   for (int32 y=0;y<heightLeft;y++)
+   {
+    prog->Report(y,heightLeft);
+    for (int32 x=0;x<widthLeft;x++)
+    {
+     data[y].data.SortRange<DispCost::SortCost>(data[y].index[x],data[y].index[x+1]-1);
+    }
+   }
+ prog->Pop();
+}
+
+//------------------------------------------------------------------------------
+void SparseDSI2::Prepare(int32 levels,Workspace & ws) const
+{
+ // Create a data structure to store the masking for a single scanline...
+  ws.leftMask.Size(levels);
+  ws.rightMask.Size(levels);
+  for (int32 l=0;l<levels;l++)
+  {
+   ws.leftMask[l].Size(widthLeft>>l);
+   ws.rightMask[l].Size(widthRight>>l);
+  }
 
-  // The previous row cost structure...
-   ds::ArrayDel< ds::InplaceKdTree<byte*,2> > prevRow(levels);
-   for (int32 l=0;l<levels;l++) prevRow[l].Shrinks(false);
 
+ // Create a data structure to store a feature hierachy for a single scanline...
+  ws.leftCol.Size(levels);
+  ws.rightCol.Size(levels);
+  for (int32 l=0;l<levels;l++)
+  {
+   ws.leftCol[l] = new byte[dsc->Bytes() * (widthLeft>>l)];
+   ws.rightCol[l] = new byte[dsc->Bytes() * (widthRight>>l)];
+  }
 
-  // Storage for the current ordered match set. Stored in an evergrowing array
-  // to avoid memory bashing. Defaults to being the size of the left image,
-  // most cases will ultimatly make it bigger once it hits the lower levels in
-  // the hierachy...
-   ds::ArrayNS<Match> matchSet(widthLeft);
 
-  // Various buffers etc so we don't have to allocate stuff regularly...
-   ds::ArrayDel<ds::SparseBitArray> expandTemp(widthLeft+widthRight);
+ // The previous row cost structure...
+  ws.prevRow.Size(levels);
+  for (int32 l=0;l<levels;l++) ws.prevRow[l].Shrinks(false);
 
-   ds::Array<real32> pruneLeft(widthLeft);
-   ds::Array<real32> pruneRight(widthRight);
 
-   ds::Array<BestCost> leftCost(widthRight);
-   ds::Array<BestCost> rightCost(widthLeft);
+ // Storage for the current ordered match set. Stored in an evergrowing array
+ // to avoid memory bashing. Defaults to being the size of the left image,
+ // most cases will ultimatly make it bigger once it hits the lower levels in
+ // the hierachy...
+  ws.matchSet.Size(widthLeft);
 
-   ds::Array<BestMatch> leftBest(widthLeft);
-   ds::Array<BestMatch> rightBest(widthRight);
-   
-   ds::MultiNth nth;
+ // Various buffers etc so we don't have to allocate stuff regularly...
+  ws.expandTemp.Size(widthLeft+widthRight);
 
-  // Storage of colour information for vertical consistancy, lots of byte
-  // buffers, one for each level, all sized to the maximum possible storage
-  //requirement...
-   ds::ArrayDel< mem::StackPtr<byte> > colBuf(levels);
-   for (int32 l=0;l<levels;l++)
-   {
-    colBuf[l] = new byte[dsc->Bytes() * 2 * math::Min(widthLeft>>l,widthRight>>l)];
-   }
+  ws.pruneLeft.Size(widthLeft);
+  ws.pruneRight.Size(widthRight);
 
+  ws.leftCost.Size(widthRight);
+  ws.rightCost.Size(widthLeft);
 
+  ws.leftBest.Size(widthLeft);
+  ws.rightBest.Size(widthRight);
 
- // Process the image a row at a time...
-  for (int32 y=0;y<heightLeft;y++)
+ // Storage of colour information for vertical consistancy, lots of byte
+ // buffers, one for each level, all sized to the maximum possible storage
+ //requirement...
+  ws.colBuf.Size(levels);
+  for (int32 l=0;l<levels;l++)
   {
-   prog->Report(y,heightLeft);
+   ws.colBuf[l] = new byte[dsc->Bytes() * 2 * math::Min(widthLeft>>l,widthRight>>l)];
+  }
+}
 
-   // Calculate the mask hierachy...
-    // Left...
+void SparseDSI2::DoRow(int32 y,int32 levels,Workspace & ws)
+{
+ ds::ArrayDel< ds::Array<bit> > & leftMask = ws.leftMask;
+ ds::ArrayDel< ds::Array<bit> > & rightMask = ws.rightMask;
+ ds::ArrayDel< mem::StackPtr<byte> > & leftCol = ws.leftCol;
+ ds::ArrayDel< mem::StackPtr<byte> > & rightCol = ws.rightCol;
+ ds::ArrayDel< ds::InplaceKdTree<byte*,2> > & prevRow = ws.prevRow;
+ ds::ArrayDel< mem::StackPtr<byte> > & colBuf = ws.colBuf;
+ ds::ArrayNS<Match> & matchSet = ws.matchSet;
+ ds::Array<BestCost> & leftCost = ws.leftCost;
+ ds::Array<BestCost> & rightCost = ws.rightCost;
+ ds::Array<BestMatch> & leftBest = ws.leftBest;
+ ds::Array<BestMatch> & rightBest = ws.rightBest;
+
+ // Calculate the mask hierachy...
+  // Left...
+  {
+   // Start...
+    if (maskLeft.Valid())
     {
-     // Start...
-      if (maskLeft.Valid())
-      {
-       for (int32 x=0;x<widthLeft;x++) leftMask[0][x] = maskLeft.Get(x,y);
-      }
-      else
-      {
-       for (int32 x=0;x<widthLeft;x++) leftMask[0][x] = true;
-      }
+     for (int32 x=0;x<widthLeft;x++) leftMask[0][x] = maskLeft.Get(x,y);
+    }
+    else
+    {
+     for (int32 x=0;x<widthLeft;x++) leftMask[0][x] = true;
+    }
 
-     // Rest of hierachy - 'or' together the lower levels...
-      for (int32 l=1;l<levels;l++)
-      {
-       int32 prevWidth = widthLeft>>(l-1);
-       int32 currWidth = widthLeft>>l;
+   // Rest of hierachy - 'or' together the lower levels...
+    for (int32 l=1;l<levels;l++)
+    {
+     int32 prevWidth = widthLeft>>(l-1);
+     int32 currWidth = widthLeft>>l;
 
-       for (int32 x=0;x<currWidth;x++)
-       {
-        if ((x*2+1)!=prevWidth) leftMask[l][x] = leftMask[l-1][x*2] | leftMask[l-1][x*2+1];
-                           else leftMask[l][x] = leftMask[l-1][x*2];
-       }
-      }
+     for (int32 x=0;x<currWidth;x++)
+     {
+      if ((x*2+1)!=prevWidth) leftMask[l][x] = leftMask[l-1][x*2] | leftMask[l-1][x*2+1];
+                         else leftMask[l][x] = leftMask[l-1][x*2];
+     }
     }
+  }
 
-    // Right...
+  // Right...
+  {
+   // Start...
+    if (maskRight.Valid())
     {
-     // Start...
-      if (maskRight.Valid())
-      {
-       for (int32 x=0;x<widthRight;x++) rightMask[0][x] = maskRight.Get(x,y);
-      }
-      else
-      {
-       for (int32 x=0;x<widthRight;x++) rightMask[0][x] = true;
-      }
+     for (int32 x=0;x<widthRight;x++) rightMask[0][x] = maskRight.Get(x,y);
+    }
+    else
+    {
+     for (int32 x=0;x<widthRight;x++) rightMask[0][x] = true;
+    }
 
-     // Rest of hierachy - 'or' together the lower levels...
-      for (int32 l=1;l<levels;l++)
-      {
-       int32 prevWidth = widthRight>>(l-1);
-       int32 currWidth = widthRight>>l;
+   // Rest of hierachy - 'or' together the lower levels...
+    for (int32 l=1;l<levels;l++)
+    {
+     int32 prevWidth = widthRight>>(l-1);
+     int32 currWidth = widthRight>>l;
 
-       for (int32 x=0;x<currWidth;x++)
-       {
-        if ((x*2+1)!=prevWidth) rightMask[l][x] = rightMask[l-1][x*2] | rightMask[l-1][x*2+1];
-                           else rightMask[l][x] = rightMask[l-1][x*2];
-       }
-      }
+     for (int32 x=0;x<currWidth;x++)
+     {
+      if ((x*2+1)!=prevWidth) rightMask[l][x] = rightMask[l-1][x*2] | rightMask[l-1][x*2+1];
+                         else rightMask[l][x] = rightMask[l-1][x*2];
+     }
     }
+  }
 
 
-   // Calculate the entire feature hierachy for efficiency...
-   // (We have to handle masking whilst we are at it, painful.)
-    // Left...
+ // Calculate the entire feature hierachy for efficiency...
+ // (We have to handle masking whilst we are at it, painful.)
+  // Left...
+   {
+    // Starting level...
+     byte * targ = leftCol[0].Ptr();
+     for (int32 x=0;x<widthLeft;x++)
      {
-      // Starting level...
-       byte * targ = leftCol[0].Ptr();
-       for (int32 x=0;x<widthLeft;x++)
-       {
-        dsc->Left(x,y,targ);
-        targ += dsc->Bytes();
-       }
+      dsc->Left(x,y,targ);
+      targ += dsc->Bytes();
+     }
 
-      // Rest of hierachy...
-       for (int32 l=1;l<levels;l++)
-       {
-        int32 prevWidth = widthLeft>>(l-1);
-        int32 currWidth = widthLeft>>l;
+    // Rest of hierachy...
+     for (int32 l=1;l<levels;l++)
+     {
+      int32 prevWidth = widthLeft>>(l-1);
+      int32 currWidth = widthLeft>>l;
 
-        byte * prevTarg = leftCol[l-1].Ptr();
-        byte * currTarg = leftCol[l].Ptr();
-        for (int32 x=0;x<currWidth;x++)
+      byte * prevTarg = leftCol[l-1].Ptr();
+      byte * currTarg = leftCol[l].Ptr();
+      for (int32 x=0;x<currWidth;x++)
+      {
+       if ((x*2+1)!=prevWidth)
+       {
+        if (leftMask[l-1][x*2+1]==false) mem::Copy(currTarg,prevTarg,dsc->Bytes());
+        else
         {
-         if ((x*2+1)!=prevWidth)
-         {
-          if (leftMask[l-1][x*2+1]==false) mem::Copy(currTarg,prevTarg,dsc->Bytes());
-          else
-          {
-           if (leftMask[l-1][x*2]==false) mem::Copy(currTarg,prevTarg+dsc->Bytes(),dsc->Bytes());
-                                     else dsc->Join(prevTarg,prevTarg+dsc->Bytes(),currTarg);
-          }
-         }
-         else mem::Copy(currTarg,prevTarg,dsc->Bytes());
-
-         prevTarg += dsc->Bytes() * 2;
-         currTarg += dsc->Bytes();
+         if (leftMask[l-1][x*2]==false) mem::Copy(currTarg,prevTarg+dsc->Bytes(),dsc->Bytes());
+                                   else dsc->Join(prevTarg,prevTarg+dsc->Bytes(),currTarg);
         }
        }
+       else mem::Copy(currTarg,prevTarg,dsc->Bytes());
+
+       prevTarg += dsc->Bytes() * 2;
+       currTarg += dsc->Bytes();
+      }
      }
+   }
 
-    // Right...
+  // Right...
+   {
+    // Starting level...
+     byte * targ = rightCol[0].Ptr();
+     for (int32 x=0;x<widthRight;x++)
      {
-      // Starting level...
-       byte * targ = rightCol[0].Ptr();
-       for (int32 x=0;x<widthRight;x++)
-       {
-        dsc->Right(x,y,targ);
-        targ += dsc->Bytes();
-       }
+      dsc->Right(x,y,targ);
+      targ += dsc->Bytes();
+     }
 
-      // Rest of hierachy...
-       for (int32 l=1;l<levels;l++)
-       {
-        int32 prevWidth = widthRight>>(l-1);
-        int32 currWidth = widthRight>>l;
+    // Rest of hierachy...
+     for (int32 l=1;l<levels;l++)
+     {
+      int32 prevWidth = widthRight>>(l-1);
+      int32 currWidth = widthRight>>l;
 
-        byte * prevTarg = rightCol[l-1].Ptr();
-        byte * currTarg = rightCol[l].Ptr();
-        for (int32 x=0;x<currWidth;x++)
+      byte * prevTarg = rightCol[l-1].Ptr();
+      byte * currTarg = rightCol[l].Ptr();
+      for (int32 x=0;x<currWidth;x++)
+      {
+       if ((x*2+1)!=prevWidth)
+       {
+        if (rightMask[l-1][x*2+1]==false) mem::Copy(currTarg,prevTarg,dsc->Bytes());
+        else
         {
-         if ((x*2+1)!=prevWidth)
-         {
-          if (rightMask[l-1][x*2+1]==false) mem::Copy(currTarg,prevTarg,dsc->Bytes());
-          else
-          {
-           if (rightMask[l-1][x*2]==false) mem::Copy(currTarg,prevTarg+dsc->Bytes(),dsc->Bytes());
-                                      else dsc->Join(prevTarg,prevTarg+dsc->Bytes(),currTarg);
-          }
-         }
-         else mem::Copy(currTarg,prevTarg,dsc->Bytes());
-
-         prevTarg += dsc->Bytes() * 2;
-         currTarg += dsc->Bytes();
+         if (rightMask[l-1][x*2]==false) mem::Copy(currTarg,prevTarg+dsc->Bytes(),dsc->Bytes());
+                                    else dsc->Join(prevTarg,prevTarg+dsc->Bytes(),currTarg);
         }
        }
+       else mem::Copy(currTarg,prevTarg,dsc->Bytes());
+
+       prevTarg += dsc->Bytes() * 2;
+       currTarg += dsc->Bytes();
+      }
      }
+   }
 
 
-   // Prepare the starting ordered match set, we match every pixel to every
-   // other in the top level, with consideration of masking of course...
-   // (The hierachy is of course set so the highest level has only 1 range in
-   // one of the images.)
-   {
-    int32 leftWid = widthLeft>>(levels-1);
-    int32 rightWid = widthRight>>(levels-1);
+ // Prepare the starting ordered match set, we match every pixel to every
+ // other in the top level, with consideration of masking of course...
+ // (The hierachy is of course set so the highest level has only 1 range in
+ // one of the images.)
+ {
+  int32 leftWid = widthLeft>>(levels-1);
+  int32 rightWid = widthRight>>(levels-1);
 
-    matchSet.Size(leftWid*rightWid);
+  matchSet.Size(leftWid*rightWid);
 
-    nat32 pos = 0;
-    for (int32 sum=0;sum<=leftWid+rightWid-2;sum++)
+  nat32 pos = 0;
+  for (int32 sum=0;sum<=leftWid+rightWid-2;sum++)
+  {
+   for (int32 left=math::Max(int32(0),sum-rightWid+1);left<math::Min(leftWid,sum+1);left++)
+   {
+    int32 right = sum-left;
+    if (leftMask[levels-1][left]&&rightMask[levels-1][right])
     {
-     for (int32 left=math::Max(int32(0),sum-rightWid+1);left<math::Min(leftWid,sum+1);left++)
-     {
-      int32 right = sum-left;
-      if (leftMask[levels-1][left]&&rightMask[levels-1][right])
-      {
-       matchSet[pos].left = left;
-       matchSet[pos].right = right;
-       pos++;
-      }
-     }
+     matchSet[pos].left = left;
+     matchSet[pos].right = right;
+     pos++;
     }
-
-    matchSet.Size(pos);
    }
+  }
+
+  matchSet.Size(pos);
+ }
 
 
-   // Iterate throught the levels, calculating each and passing to the next...
-    for (int32 l=levels-1;l>=0;l--)
+ // Iterate throught the levels, calculating each and passing to the next...
+  for (int32 l=levels-1;l>=0;l--)
+  {
+   // Calculate the cost of the matchSet - 3 passes, the first split into
+   // blocks across the pool when big enough to be worth it...
     {
-     // Calculate the cost of the matchSet - 3 passes...
-      CostPass(matchSet,leftCol[l].Ptr(),rightCol[l].Ptr(),
-               ((y!=0)&&(prevRow[l].Size()!=0))?(&prevRow[l]):null<ds::InplaceKdTree<byte*,2>*>());
-      IncPass(l,matchSet,leftCost,rightCost);
-      DecPass(l,matchSet,leftCost,rightCost);
+     CostJob job;
+     job.self = this;
+     job.match = &matchSet[0];
+     job.count = matchSet.Size();
+     job.leftCol = leftCol[l].Ptr();
+     job.rightCol = rightCol[l].Ptr();
+     job.prevRow = ((y!=0)&&(prevRow[l].Size()!=0))?(&prevRow[l]):null<ds::InplaceKdTree<byte*,2>*>();
+
+     nat32 blocks = (job.count+CostJob::block-1)/CostJob::block;
+     if (blocks>1) mt::SharedPool().Run(job,blocks);
+              else CostPass(job.match,job.count,job.leftCol,job.rightCol,job.prevRow);
+    }
+    IncPass(l,matchSet,leftCost,rightCost);
+    DecPass(l,matchSet,leftCost,rightCost);
 
-     // Prune out matches with costs that are too high...
-      Prune(l,matchSet,pruneLeft,pruneRight,nth);
+   // Prune out matches with costs that are too high...
+    Prune(l,matchSet,ws.pruneLeft,ws.pruneRight,ws.nth);
 
 
-     // If enabled create the previous row data structure at this resolution
-     // ready for the next level...
-      if (!math::IsZero(vertMult))
+   // If enabled create the previous row data structure at this resolution
+   // ready for the next level...
+    if (!math::IsZero(vertMult))
+    {
+     // Reset the needed parts of the leftBest and rightBest buffers...
+      for (int32 i=0;i<(widthLeft>>l);i++)
       {
-       // Reset the needed parts of the leftBest and rightBest buffers...
-        for (int32 i=0;i<(widthLeft>>l);i++)
-        {
-         leftBest[i].other = -1;
-         leftBest[i].cost = math::Infinity<real32>();
-        }
+       leftBest[i].other = -1;
+       leftBest[i].cost = math::Infinity<real32>();
+      }
 
-        for (int32 i=0;i<(widthRight>>l);i++)
-        {
-         rightBest[i].other = -1;
-         rightBest[i].cost = math::Infinity<real32>();
-        }
+      for (int32 i=0;i<(widthRight>>l);i++)
+      {
+       rightBest[i].other = -1;
+       rightBest[i].cost = math::Infinity<real32>();
+      }
 
 
-       // Find the index of the minimum cost member for each pixel in the left
-       // and right sides...
-        for (nat32 i=0;i<matchSet.Size();i++)
-        {
-         real32 matchCost = matchSet[i].TotalCost();
-
-         if (matchCost<leftBest[matchSet[i].left].cost)
-         {
-          leftBest[matchSet[i].left].other = matchSet[i].right;
-          leftBest[matchSet[i].left].cost  = matchCost;
-         }
-
-         if (matchCost<rightBest[matchSet[i].right].cost)
-         {
-          rightBest[matchSet[i].right].other = matchSet[i].left;
-          rightBest[matchSet[i].right].cost  = matchCost;
-         }
-        }
-
+     // Find the index of the minimum cost member for each pixel in the left
+     // and right sides...
+      for (nat32 i=0;i<matchSet.Size();i++)
+      {
+       real32 matchCost = matchSet[i].TotalCost();
 
-       // Work out how many best costs there are going to be from the above
-       // calculated data structure...
-        nat32 costCount = 0;
-        for (int32 i=0;i<(widthLeft>>l);i++)
-        {
-         if (leftBest[i].other!=-1)
-         {
-          if (rightBest[leftBest[i].other].other==i) costCount += 1;
-         }
-        }
+       if (matchCost<leftBest[matchSet[i].left].cost)
+       {
+        leftBest[matchSet[i].left].other = matchSet[i].right;
+        leftBest[matchSet[i].left].cost  = matchCost;
+       }
 
+       if (matchCost<rightBest[matchSet[i].right].cost)
+       {
+        rightBest[matchSet[i].right].other = matchSet[i].left;
+        rightBest[matchSet[i].right].cost  = matchCost;
+       }
+      }
 
-       // Iterate and store all the best costs, with each one we store both its
-       // left and right colour, such that we can adjust the vertical
-       // consistancy cost by vertical colour difference...
-        prevRow[l].Size(costCount);
-        costCount = 0;
-        for (nat32 i=0;i<matchSet.Size();i++)
-        {
-         if ((leftBest[matchSet[i].left].other==matchSet[i].right)&&
-             (rightBest[matchSet[i].right].other==matchSet[i].left))
-         {
-          math::Vect<2> pos;
-          pos[0] = matchSet[i].left;
-          pos[1] = matchSet[i].right;
-          prevRow[l].SetPos(costCount,pos);
-
-          nat32 cs = dsc->Bytes();
-          byte * targ = colBuf[l].Ptr() + cs * 2 * costCount;
-          prevRow[l][costCount] = targ;
-          mem::Copy(targ   ,leftCol[l].Ptr()  + cs*matchSet[i].left ,cs);
-          mem::Copy(targ+cs,rightCol[l].Ptr() + cs*matchSet[i].right,cs);
-
-          costCount += 1;
-         }
-        }
-        log::Assert(costCount==prevRow[l].Size());
 
-       // Build it, so we can use it next time around...
-        prevRow[l].Build();
+     // Work out how many best costs there are going to be from the above
+     // calculated data structure...
+      nat32 costCount = 0;
+      for (int32 i=0;i<(widthLeft>>l);i++)
+      {
+       if (leftBest[i].other!=-1)
+       {
+        if (rightBest[leftBest[i].other].other==i) costCount += 1;
+       }
       }
 
 
-     // Unless this is the last level expand out the matches for the next level
-     // below in the hierachy...
-      if (l!=0) Expand(l-1,matchSet,leftMask[l-1],rightMask[l-1],expandTemp);
-    }
+     // Iterate and store all the best costs, with each one we store both its
+     // left and right colour, such that we can adjust the vertical
+     // consistancy cost by vertical colour difference...
+      prevRow[l].Size(costCount);
+      costCount = 0;
+      for (nat32 i=0;i<matchSet.Size();i++)
+      {
+       if ((leftBest[matchSet[i].left].other==matchSet[i].right)&&
+           (rightBest[matchSet[i].right].other==matchSet[i].left))
+       {
+        math::Vect<2> pos;
+        pos[0] = matchSet[i].left;
+        pos[1] = matchSet[i].right;
+        prevRow[l].SetPos(costCount,pos);
+
+        nat32 cs = dsc->Bytes();
+        byte * targ = colBuf[l].Ptr() + cs * 2 * costCount;
+        prevRow[l][costCount] = targ;
+        mem::Copy(targ   ,leftCol[l].Ptr()  + cs*matchSet[i].left ,cs);
+        mem::Copy(targ+cs,rightCol[l].Ptr() + cs*matchSet[i].right,cs);
+
+        costCount += 1;
+       }
+      }
+      log::Assert(costCount==prevRow[l].Size());
 
+     // Build it, so we can use it next time around...
+      prevRow[l].Build();
+    }
 
-   // Extract the final result for this scanline...
-    Extract(matchSet,data[y]);
 
-    #ifdef EOS_DEBUG
-    dispCount += data[y].data.Size();
-    #endif
+   // Unless this is the last level expand out the matches for the next level
+   // below in the hierachy...
+    if (l!=0) Expand(l-1,matchSet,leftMask[l-1],rightMask[l-1],ws.expandTemp);
   }
 
 
- LogDebug("[SparseStereo 2] {left pixels,disparities,d/p}" << LogDiv()
-            << (widthLeft*heightLeft) << LogDiv() << dispCount << LogDiv()
-            << real32(dispCount)/real32(widthLeft*heightLeft));
- prog->Pop();
-}
-
-nat32 SparseDSI2::Size(nat32 x,nat32 y) const
-{
- return data[y].index[x+1] - data[y].index[x];
+ // Extract the final result for this scanline...
+  Extract(matchSet,data[y]);
 }
 
-real32 SparseDSI2::Disp(nat32 x,nat32 y,nat32 i) const
+void SparseDSI2::RowJob::Do(nat32 y,nat32 thread)
 {
- return data[y].data[data[y].index[x]+i].disp;
+ if (prog->Cancelling()) return;
+ self->DoRow(y,levels,(*ws)[thread]);
 }
 
-real32 SparseDSI2::Cost(nat32 x,nat32 y,nat32 i) const
+void SparseDSI2::CostJob::Do(nat32 unit,nat32)
 {
- return data[y].data[data[y].index[x]+i].cost;
+ nat32 start = unit*block;
+ nat32 end = math::Min(start+block,count);
+ self->CostPass(match+start,end-start,leftCol,rightCol,prevRow);
 }
 
-void SparseDSI2::SortByDisp(time::Progress * prog)
-{
- prog->Push();
-  // Simply sort each pixel by a suitable cost function...
-  // (Lots of lil' sorts.)
-   for (int32 y=0;y<heightLeft;y++)
-   {
-    prog->Report(y,heightLeft);
-    for (int32 x=0;x<widthLeft;x++)
-    {
-     data[y].data.SortRange<DispCost::SortDisp>(data[y].index[x],data[y].index[x+1]-1);
-    }
-   }
- prog->Pop();
-}
-
-void SparseDSI2::SortByCost(time::Progress * prog)
-{
- prog->Push();
-  // Simply sort each pixel by a suitable cost function...
-  // (Lots of lil' sorts.)
-   for (int32 y=0;y<heightLeft;y++)
-   {
-    prog->Report(y,heightLeft);
-    for (int32 x=0;x<widthLeft;x++)
-    {
-     data[y].data.SortRange<DispCost::SortCost>(data[y].index[x],data[y].index[x+1]-1);
-    }
-   }
- prog->Pop();
-}
-
-//------------------------------------------------------------------------------
-void SparseDSI2::CostPass(ds::ArrayNS<Match> & matchSet,
+void SparseDSI2::CostPass(Match * match,nat32 count,
                           byte * leftCol,byte * rightCol,
-                          ds::InplaceKdTree<byte*,2> * prevRow)
+                          ds::InplaceKdTree<byte*,2> * prevRow) const
 {
  LogTime("eos::stereo::SparseDSI2::CostPass");
 
  // Iterate each match and calculate its cost, this is simply the matching cost
  // plus the vertical consistancy cost as applicable. We optimise calculation
  // speed for the vertical cost quite a lot as otherwise it takes too long...
-  for (nat32 i=0;i<matchSet.Size();i++)
+  for (nat32 i=0;i<count;i++)
   {
-   matchSet[i].cost = dsc->Cost(leftCol  + dsc->Bytes()*matchSet[i].left,
-                                rightCol + dsc->Bytes()*matchSet[i].right);
+   match[i].cost = dsc->Cost(leftCol  + dsc->Bytes()*match[i].left,
+                             rightCol + dsc->Bytes()*match[i].right);
 
    if ((prevRow)&&(!math::IsZero(vertMult)))
    {
     math::Vect<2> pos;
-    pos[0] = matchSet[i].left;
-    pos[1] = matchSet[i].right;
+    pos[0] = match[i].left;
+    pos[1] = match[i].right;
 
     real32 dist;
     byte * col = (*prevRow)[prevRow->NearestMan(pos,&dist)];
-    real32 colCost = dsc->Cost(leftCol   + dsc->Bytes()*matchSet[i].left ,col) +
-                     dsc->Cost(rightCol  + dsc->Bytes()*matchSet[i].right,col+dsc->Bytes());
+    real32 colCost = dsc->Cost(leftCol   + dsc->Bytes()*match[i].left ,col) +
+                     dsc->Cost(rightCol  + dsc->Bytes()*match[i].right,col+dsc->Bytes());
 
-    matchSet[i].cost += vertMult * math::Exp(-colCost*vertCost) * dist;
+    match[i].cost += vertMult * math::Exp(-colCost*vertCost) * dist;
    }
   }
 }
@@ -24,6 +24,7 @@
 
 #include "eos/types.h"
 
+#include "eos/mem/safety.h"
 #include "eos/file/csv.h"
 #include "eos/time/progress.h"
 
@@ -36,6 +37,7 @@
 
 #include "eos/svt/field.h"
 #include "eos/stereo/dsi.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -59,6 +61,12 @@ namespace eos
 /// It retains all the advantages of the earlier version, such as being
 /// hierachical and working with pixel regions rather than points.
 /// The interface is almost identical.
+///
+/// Uses mt::SharedPool(). With no vertical cost the scanlines are independent
+/// and are done in parallel, otherwise each scanline depends on the one above
+/// so they are done in order, with the cost pass, where most of the time goes,
+/// split across the pool instead. The DSC must be safe to call from multiple
+/// threads at once, which all the const implimentations are.
 class EOS_CLASS SparseDSI2 : public DSI
 {
  public:
@@ -96,7 +104,8 @@ class EOS_CLASS SparseDSI2 : public DSI
    void Set(const svt::Field<bit> & maskLeft,const svt::Field<bit> & maskRight);
 
 
-  /// &nbsp;
+  /// Runs the algorithm. Stops early if prog is cancelled, in which case the
+  /// output is invalid.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -248,10 +257,71 @@ class EOS_CLASS SparseDSI2 : public DSI
    ds::ArrayDel<Scanline> data;
 
 
+  // All the buffers needed to process a scanline, so each thread can have its
+  // own. Sized by Prepare...
+   struct Workspace
+   {
+    // Mask and feature hierachies...
+     ds::ArrayDel< ds::Array<bit> > leftMask;
+     ds::ArrayDel< ds::Array<bit> > rightMask;
+     ds::ArrayDel< mem::StackPtr<byte> > leftCol;
+     ds::ArrayDel< mem::StackPtr<byte> > rightCol;
+
+    // The previous row cost structure for each level, with its colour storage...
+     ds::ArrayDel< ds::InplaceKdTree<byte*,2> > prevRow;
+     ds::ArrayDel< mem::StackPtr<byte> > colBuf;
+
+    // The current ordered match set, and the buffers used by the passes...
+     ds::ArrayNS<Match> matchSet;
+     ds::ArrayDel<ds::SparseBitArray> expandTemp;
+     ds::Array<real32> pruneLeft;
+     ds::Array<real32> pruneRight;
+     ds::Array<BestCost> leftCost;
+     ds::Array<BestCost> rightCost;
+     ds::Array<BestMatch> leftBest;
+     ds::Array<BestMatch> rightBest;
+     ds::MultiNth nth;
+   };
+
+  // Processes a scanline, used when they are independent...
+   class RowJob : public mt::Job
+   {
+    public:
+     SparseDSI2 * self;
+     int32 levels;
+     ds::ArrayDel<Workspace> * ws; // One per thread.
+     time::Progress * prog; // Rows are skipped once it is cancelling.
+
+     void Do(nat32 y,nat32 thread);
+   };
+
+  // Does the cost pass for a block of matches...
+   class CostJob : public mt::Job
+   {
+    public:
+     static const nat32 block = 512;
+
+     const SparseDSI2 * self;
+     Match * match;
+     nat32 count;
+     byte * leftCol;
+     byte * rightCol;
+     ds::InplaceKdTree<byte*,2> * prevRow;
+
+     void Do(nat32 unit,nat32 thread);
+   };
+
+
   // Helper methods, these cover the real work done by run...
+   // Sizes the buffers of a workspace...
+    void Prepare(int32 levels,Workspace & ws) const;
+
+   // Does all the work for a single scanline, writing it into data...
+    void DoRow(int32 y,int32 levels,Workspace & ws);
+
    // First pass - calculates costs for each match in a match array...
-    void CostPass(ds::ArrayNS<Match> & matchSet,byte * leftCol,byte * rightCol,
-                  ds::InplaceKdTree<byte*,2> * prevRow);
+    void CostPass(Match * match,nat32 count,byte * leftCol,byte * rightCol,
+                  ds::InplaceKdTree<byte*,2> * prevRow) const;
    
    // Second pass - dynamic programming forwards through the structure to 
    // calculate the inc costs...
@@ -17,8 +17,6 @@
 
 #include "eos/stereo/dsr.h"
 
-#include "eos/ds/arrays2d.h"
-
 namespace eos
 {
  namespace stereo
@@ -470,8 +468,10 @@ DSR * SpreadDSR::Clone() const
 
 void SpreadDSR::Set(const DSR & dsr,nat32 radius,const svt::Field<bit> & leftMask)
 {
- mem::Packer packer(pack_size);
- 
+ mt::Pool & pool = mt::SharedPool();
+ ds::ArrayPtr<mem::Packer> packer(pool.Threads());
+ for (nat32 i=0;i<packer.Size();i++) packer[i] = new mem::Packer(pack_size);
+
  // Mirror the input dsr into our own data structure...
   // Build empty index...
    ds::Array2D<RanLink> index1(dsr.Width(),dsr.Height());
@@ -486,7 +486,8 @@ void SpreadDSR::Set(const DSR & dsr,nat32 radius,const svt::Field<bit> & leftMas
     }
    }
 
-  // Fill it...
+  // Fill it - done by this thread alone, as a DSR need not support being
+  // accessed by several at once...
    for (nat32 y=0;y<dsr.Height();y++)
    {
     for (nat32 x=0;x<dsr.Width();x++)
@@ -494,7 +495,7 @@ void SpreadDSR::Set(const DSR & dsr,nat32 radius,const svt::Field<bit> & leftMas
      RanLink & targ = index1.Get(x,y);
      for (nat32 i=0;i<dsr.Ranges(x,y);i++)
      {
-      Ran * ran = packer.Malloc<Ran>();
+      Ran * ran = packer[0]->Malloc<Ran>();
       ran->rl.ptr = ran;
       ran->rl.next = &targ;
       ran->rl.last = targ.last;
@@ -508,96 +509,36 @@ void SpreadDSR::Set(const DSR & dsr,nat32 radius,const svt::Field<bit> & leftMas
    }
 
 
- // Union the input into an intermediate, applying the horizontal part of the 
- // top-hat as we do so...
-  // Build empty index...
-   ds::Array2D<RanLink> index2(dsr.Width(),dsr.Height());
-   for (nat32 y=0;y<index2.Height();y++)
-   {
-    for (nat32 x=0;x<index2.Width();x++)
-    {
-     RanLink & targ = index2.Get(x,y);
-     targ.ptr = null<Ran*>();
-     targ.next = &targ;
-     targ.last = &targ;
-    }
-   }
-   
-  // Do the unioning...
-   for (int32 y=0;y<int32(index1.Height());y++)
-   {
-    for (int32 x=0;x<int32(index1.Width());x++)
-    {
-     for (int32 x2=math::Max(int32(0),x-int32(radius));
-                x2<=math::Min(int32(index2.Width()-1),x+int32(radius));
-                x2++)
-     {
-      Union(index2.Get(x2,y),index1.Get(x,y),packer);
-     }
-    }
-   }
-
-
- // Union the intermediate back to the dsr copy, applying the vertical part of
- // the top-hat as we do so (Can just leave original data, as it will be part
- // of the output regardless.)...
-  for (int32 y=0;y<int32(index2.Height());y++)
+ // Build an empty intermediate...
+  ds::Array2D<RanLink> index2(dsr.Width(),dsr.Height());
+  for (nat32 y=0;y<index2.Height();y++)
   {
-   for (int32 x=0;x<int32(index2.Width());x++)
+   for (nat32 x=0;x<index2.Width();x++)
    {
-    for (int32 y2=math::Max(int32(0),y-int32(radius));
-               y2<=math::Min(int32(index1.Height()-1),y+int32(radius));
-               y2++)
-    {
-     Union(index1.Get(x,y2),index2.Get(x,y),packer);
-    }
+    RanLink & targ = index2.Get(x,y);
+    targ.ptr = null<Ran*>();
+    targ.next = &targ;
+    targ.last = &targ;
    }
-  } 
+  }
 
 
- // Take the final data structure and convert it into the scanline structure
- // used for actual storage...
- // (It is here that the mask is considered.)
+ // Union the input into the intermediate, applying the horizontal part of the
+ // top-hat, then union the intermediate back to the dsr copy, applying the
+ // vertical part (Can just leave original data, as it will be part of the
+ // output regardless.), then convert to the scanline structure used for actual
+ // storage - each pass only writes to the row its working on...
   data.Size(dsr.Height());
-  for (nat32 y=0;y<data.Size();y++)
-  {   
-   // First pass over scanline to build the index...
-    data[y].index.Size(dsr.Width()+1);
-    data[y].index[0] = 0;
-    for (nat32 x=0;x<dsr.Width();x++)
-    {
-     nat32 size = 0;
-     if ((!leftMask.Valid())||(leftMask.Get(x,y)))
-     {
-      RanLink * targ = index1.Get(x,y).next;
-      while (targ->ptr)
-      {
-       ++size;
-       targ = targ->next;
-      }
-     }
-     data[y].index[x+1] = data[y].index[x] + size;
-    }
-    
-   // Second pass to build the data...
-    data[y].data.Size(data[y].index[data[y].index.Size()-1]);
-    nat32 ind = 0;
-    for (nat32 x=0;x<dsr.Width();x++)
-    {
-     if ((!leftMask.Valid())||(leftMask.Get(x,y)))
-     {
-      RanLink * targ = index1.Get(x,y).next;
-      while (targ->ptr)
-      {
-       data[y].data[ind].start = targ->ptr->range.start;
-       data[y].data[ind].end = targ->ptr->range.end;
-       ++ind;
-       targ = targ->next;
-      }
-     }
-    }
-    log::Assert(ind==data[y].data.Size());
-  }
+
+  SpreadJob job;
+  job.self = this;
+  job.radius = radius;
+  job.index1 = &index1;
+  job.index2 = &index2;
+  job.leftMask = &leftMask;
+  job.packer = &packer;
+
+  for (job.pass=0;job.pass<3;job.pass++) pool.Run(job,dsr.Height());
 }
 
 nat32 SpreadDSR::Width() const
@@ -681,6 +622,83 @@ void SpreadDSR::Union(RanLink & out,const RanLink & in,mem::Packer & packer)
  }
 }
 
+void SpreadDSR::SpreadJob::Do(nat32 y,nat32 thread)
+{
+ mem::Packer & pack = *(*packer)[thread];
+ switch (pass)
+ {
+  case 0: // Horizontal...
+  {
+   for (int32 x=0;x<int32(index1->Width());x++)
+   {
+    for (int32 x2=math::Max(int32(0),x-int32(radius));
+               x2<=math::Min(int32(index2->Width()-1),x+int32(radius));
+               x2++)
+    {
+     Union(index2->Get(x2,y),index1->Get(x,y),pack);
+    }
+   }
+  }
+  break;
+  case 1: // Vertical...
+  {
+   for (nat32 x=0;x<index1->Width();x++)
+   {
+    for (int32 y2=math::Max(int32(0),int32(y)-int32(radius));
+               y2<=math::Min(int32(index2->Height()-1),int32(y)+int32(radius));
+               y2++)
+    {
+     Union(index1->Get(x,y),index2->Get(x,y2),pack);
+    }
+   }
+  }
+  break;
+  case 2: // Store, which is where the mask is considered...
+  {
+   Scanline & out = self->data[y];
+   nat32 width = index1->Width();
+
+   // First pass over scanline to build the index...
+    out.index.Size(width+1);
+    out.index[0] = 0;
+    for (nat32 x=0;x<width;x++)
+    {
+     nat32 size = 0;
+     if ((!leftMask->Valid())||(leftMask->Get(x,y)))
+     {
+      RanLink * targ = index1->Get(x,y).next;
+      while (targ->ptr)
+      {
+       ++size;
+       targ = targ->next;
+      }
+     }
+     out.index[x+1] = out.index[x] + size;
+    }
+
+   // Second pass to build the data...
+    out.data.Size(out.index[out.index.Size()-1]);
+    nat32 ind = 0;
+    for (nat32 x=0;x<width;x++)
+    {
+     if ((!leftMask->Valid())||(leftMask->Get(x,y)))
+     {
+      RanLink * targ = index1->Get(x,y).next;
+      while (targ->ptr)
+      {
+       out.data[ind].start = targ->ptr->range.start;
+       out.data[ind].end = targ->ptr->range.end;
+       ++ind;
+       targ = targ->next;
+      }
+     }
+    }
+    log::Assert(ind==out.data.Size());
+  }
+  break;
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
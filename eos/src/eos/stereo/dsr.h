@@ -27,6 +27,8 @@
 
 #include "eos/stereo/dsi.h"
 #include "eos/mem/packer.h"
+#include "eos/ds/arrays2d.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -282,7 +284,8 @@ class EOS_CLASS HierachyDSR : public DSR
 /// it, sort of a top-hat blur for DSR's. Required in a hierachy, to avoid the
 /// grid pattern overidiing the costs and destroying any chance of results.
 /// Unlike BasicDSR this uses a very efficient data structure, and makes a 
-/// serious effort at being fast.
+/// serious effort at being fast. The input is read by a single thread, but the
+/// spreading itself is done a row at a time on mt::SharedPool().
 class EOS_CLASS SpreadDSR : public DSR
 {
  public:
@@ -374,6 +377,22 @@ class EOS_CLASS SpreadDSR : public DSR
   // Helper method - given the root RanLink of two sorted range sets this merges
   // one into another. Requires a memory allocator.
    static void Union(RanLink & out,const RanLink & in,mem::Packer & packer);
+
+  // Job for Set, each unit a row. Pass 0 spreads index1 horizontally into
+  // index2, pass 1 spreads index2 vertically back into index1, pass 2 stores
+  // index1 in the scanline structure...
+   class SpreadJob : public mt::Job
+   {
+    public:
+     SpreadDSR * self;
+     nat32 pass;
+     nat32 radius;
+     ds::Array2D<RanLink> * index1;
+     ds::Array2D<RanLink> * index2;
+     const svt::Field<bit> * leftMask;
+     ds::ArrayPtr<mem::Packer> * packer; // Per thread.
+     void Do(nat32 y,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
@@ -91,10 +91,12 @@ void EBP::Run(time::Progress * prog)
 
  // Phase 1 - construct the hierachy of data structures in which messages will be
  // passed...
-  // Create the indexes and memory allocator...
+  // Create the indexes and a memory allocator per thread...
    prog->Report(0,levels*2 + 3);
+   mt::Pool & pool = mt::SharedPool();
    ds::ArrayDel< ds::Array2D<Pixel*> > index(levels);
-   mem::Packer mem(blockSize);
+   ds::ArrayPtr<mem::Packer> packer(pool.Threads());
+   for (nat32 i=0;i<packer.Size();i++) packer[i] = new mem::Packer(blockSize);
 
    index[0].Resize(dsc->WidthLeft(),dsc->HeightLeft());
    for (int32 l=1;l<levels;l++)
@@ -107,121 +109,67 @@ void EBP::Run(time::Progress * prog)
    }
 
 
-  // Build the base layer, with costs...
-   mem::StackPtr<byte,mem::KillDelArray<byte> > pixA = new byte[dscOcc->Bytes()];
-   mem::StackPtr<byte,mem::KillDelArray<byte> > pixB = new byte[dscOcc->Bytes()];
-
-   prog->Report(1,levels*2 + 3);
-   prog->Push();
+  // Extract the search ranges of the base layer from the dsr, which need not
+  // support being accessed by several threads at once...
+   nat32 pixels = index[0].Width()*index[0].Height();
+   ds::Array<nat32> secIndex(pixels+1);
+   secIndex[0] = 0;
    for (nat32 y=0;y<index[0].Height();y++)
    {
-    prog->Report(y,index[0].Height());
     for (nat32 x=0;x<index[0].Width();x++)
     {
-     // Check for it being masked...
-      if (dsr->Ranges(x,y)==0)
-      {
-       index[0].Get(x,y) = null<Pixel*>();
-       continue;
-      }
-
-     // Go through the dsr and count the number of disparities...
-      nat32 msgSize = 0;
-      for (nat32 i=0;i<dsr->Ranges(x,y);i++)
-      {
-       msgSize += 1 + dsr->End(x,y,i) - dsr->Start(x,y,i);
-      }
-
-     // Construct the relevant Pixel structure...
-      nat32 pixSize = sizeof(Pixel) + dsr->Ranges(x,y) * sizeof(Section) + 5 * msgSize * sizeof(real32);
-      Pixel * pix = (Pixel*)(void*)mem.Malloc<byte>(pixSize);
-      index[0].Get(x,y) = pix;
-
-      pix->passFlags = 0xFFFFFFFF;
-      pix->msgSize = msgSize;
-      pix->sections = dsr->Ranges(x,y);
-
-     // Fill in the occCost array...
-      dscOcc->Left(x,y,pixA.Ptr());
-      for (nat32 i=0;i<4;i++)
-      {
-       pix->occCost[i] = occCostBase;
-
-       nat32 xp = x;
-       nat32 yp = y;
-       bit done = false;
-       switch (i)
-       {
-        case 0: ++xp; if (xp==index[0].Width()) done = true; break;
-        case 1: ++yp; if (yp==index[0].Height()) done = true; break;
-        case 2: if (xp==0) done = true; else --xp; break;
-        case 3: if (yp==0) done = true; else --yp; break;
-       }
-       if (done) continue;
+     nat32 i = y*index[0].Width() + x;
+     secIndex[i+1] = secIndex[i] + dsr->Ranges(x,y);
+    }
+   }
 
-       dscOcc->Left(xp,yp,pixB.Ptr());
-       real32 diff = dscOcc->Cost(pixA.Ptr(),pixB.Ptr());
-       pix->occCost[i] += diff * occCostMult;
-      }
+   ds::Array<Section> sec(secIndex[pixels]);
+   for (nat32 y=0;y<index[0].Height();y++)
+   {
+    for (nat32 x=0;x<index[0].Width();x++)
+    {
+     Section * targ = sec.Ptr() + secIndex[y*index[0].Width() + x];
+     for (nat32 i=0;i<dsr->Ranges(x,y);i++)
+     {
+      targ[i].startDisp = dsr->Start(x,y,i);
+      targ[i].runLength = 1 + dsr->End(x,y,i) - dsr->Start(x,y,i);
+     }
+    }
+   }
 
 
-     // Fill in the sections...
-      for (nat32 i=0;i<dsr->Ranges(x,y);i++)
-      {
-       pix->GetSec(i)->startDisp = dsr->Start(x,y,i);
-       pix->GetSec(i)->runLength = 1 + dsr->End(x,y,i) - dsr->Start(x,y,i);
-      }
+  // Build the base layer, with costs...
+   mem::StackPtr<byte,mem::KillDelArray<byte> > scratch = new byte[2*dscOcc->Bytes()*pool.Threads()];
 
-     // Fill in the matching costs taken from the DSC...
-     // (Because we allow matches outside the image range we have to do bound checking.)
-      nat32 offset = 0;
-      for (nat32 i=0;i<pix->sections;i++)
-      {
-       for (int32 d=dsr->Start(x,y,i);d<=dsr->End(x,y,i);d++)
-       {
-        int32 ux2 = int32(x) + d;
-        int32 x2 = math::Clamp(ux2,int32(0),int32(dsc->WidthRight())-1);
-        pix->Start()[offset] = dsc->Cost(x,x2,y) + occCostBase*math::Abs(ux2-x2);
-        ++offset;
-       }
-      }
+   prog->Report(1,levels*2 + 3);
+   {
+    BaseJob job;
+    job.self = this;
+    job.index = &index[0];
+    job.secIndex = secIndex.Ptr();
+    job.sec = sec.Ptr();
+    job.packer = &packer;
+    job.scratch = scratch.Ptr();
 
-     // Null the messages...
-      for (nat32 i=pix->msgSize;i<pix->msgSize*5;i++) pix->Start()[i] = 0.0;
-    }
+    prog->Push();
+    pool.Run(job,index[0].Height(),prog);
+    prog->Pop();
    }
-   prog->Pop();
 
 
   // Create further layers...
    for (int32 l=1;l<levels;l++)
    {
     prog->Report(l+1,levels*2 + 3);
-    prog->Push();
-    for (nat32 y=0;y<index[l].Height();y++)
-    {
-     prog->Report(y,index[l].Height());
-     for (nat32 x=0;x<index[l].Width();x++)
-     {
-      nat32 fromX = x*2;
-      nat32 fromY = y*2;
-
-      bit okX = (fromX+1)!=index[l-1].Width();
-      bit okY = (fromY+1)!=index[l-1].Height();
-
-      Pixel * pix[4];
 
-      pix[0] = index[l-1].Get(fromX,fromY);
-      if (okX) pix[1] = index[l-1].Get(fromX+1,fromY);
-          else pix[1] = null<Pixel*>();
-      if (okY) pix[2] = index[l-1].Get(fromX,fromY+1);
-          else pix[2] = null<Pixel*>();
-      if (okX&&okY) pix[3] = index[l-1].Get(fromX+1,fromY+1);
-               else pix[3] = null<Pixel*>();
+    UnionJob job;
+    job.self = this;
+    job.from = &index[l-1];
+    job.to = &index[l];
+    job.packer = &packer;
 
-      index[l].Get(x,y) = Union(pix,&mem);
-     }
-    }
+    prog->Push();
+    pool.Run(job,index[l].Height(),prog);
     prog->Pop();
    }
 
@@ -315,12 +263,12 @@ void EBP::Run(time::Progress * prog)
 
     // Transfer from above to current level of hierachy...
      prog->Report(0,iters+1);
-     for (nat32 y=0;y<index[l].Height();y++)
      {
-      for (nat32 x=0;x<index[l].Width();x++)
-      {
-       if (index[l].Get(x,y)) GetMessages(index[l].Get(x,y),index[l+1].Get(x/2,y/2));
-      }
+      MessageJob job;
+      job.self = this;
+      job.from = &index[l+1];
+      job.to = &index[l];
+      pool.Run(job,index[l].Height());
      }
 
 
@@ -339,85 +287,13 @@ void EBP::Run(time::Progress * prog)
  // Auxilary pass - extract the results...
   prog->Report(levels*2 + 2,levels*2 + 3);
   prog->Push();
-
-  ds::PriorityQueue<Match> dispHeap(outCount);
-  ds::Array<Match> dispArray(outCount);
-
-  disp.Size(index[0].Height());
-  for (nat32 y=0;y<disp.Size();y++)
   {
-   prog->Report(y,disp.Size());
-
-   // First pass to count how many disparities we will actually be outputting,
-   // for this scanline. Index is filled in during this process...
-    disp[y].index.Size(index[0].Width()+1);
-    disp[y].index[0] = 0;
-    for (nat32 x=0;x<index[0].Width();x++)
-    {
-     if (index[0].Get(x,y)) disp[y].index[x+1] = disp[y].index[x] + math::Min(index[0].Get(x,y)->msgSize,outCount);
-                       else disp[y].index[x+1] = disp[y].index[x];
-    }
-
-
-   // Second pass to fill in the data structure with the actual disparities
-   // and costs...
-    disp[y].data.Size(disp[y].index[disp[y].index.Size()-1]);
-    for (nat32 x=0;x<index[0].Width();x++)
-    {
-     Pixel * targ = index[0].Get(x,y);
-     if ((targ!=null<Pixel*>())&&(targ->sections!=0))
-     {
-      // Find the best matches...
-       dispHeap.MakeEmpty();
-       DispIter di;
-       targ->MakeIter(di);
-
-       for (nat32 i=0;i<targ->msgSize;i++)
-       {
-        real32 cost = di.Value(0) + di.Value(1) + di.Value(2) + di.Value(3) + di.Value(4);
-        if (dispHeap.Size()<outCount)
-        {
-         // No competition - just store it...
-          Match m;
-          m.disp = di.Disparity();
-          m.cost = cost;
-          dispHeap.Add(m);
-        }
-        else
-        {
-         // Check if its good enough to be included, and include it if so, removing the member it superceded...
-          if (cost<dispHeap.Peek().cost)
-          {
-           dispHeap.Rem();
-           Match m;
-           m.disp = di.Disparity();
-           m.cost = cost;
-           dispHeap.Add(m);
-          }
-        }
-        di.ToNext();
-       }
+   disp.Size(index[0].Height());
 
-
-      // Sort them by disparity...
-       nat32 num = 0;
-       while (dispHeap.Size()!=0)
-       {
-        dispArray[num] = dispHeap.Peek();
-        ++num;
-        dispHeap.Rem();
-       }
-
-       dispArray.SortRange<DispSort>(0,num-1);
-
-
-      // Write them into the correct scanline positions...
-       for (nat32 i=0;i<num;i++)
-       {
-        disp[y].data[disp[y].index[x]+i] = dispArray[i];
-       }
-     }
-    }
+   ExtractJob job;
+   job.self = this;
+   job.index = &index[0];
+   pool.Run(job,disp.Size(),prog);
   }
   prog->Pop();
 
@@ -463,129 +339,142 @@ cstrconst EBP::TypeString() const
 void EBP::Iter(ds::Array2D<Pixel*> & index,nat32 iter)
 {
  LogTime("eos::stereo::EBP::Iter");
- for (nat32 y=0;y<index.Height();y++)
+ if (index.Width()*index.Height()<serialSize)
  {
-  for (nat32 x=((y+iter)%2);x<index.Width();x+=2)
-  {
-   // Iterate every other pixel with a checkboard pattern, for each pixel
-   // calculate and pass the messages, except when the flags say otherwise...
-    Pixel * targ = index.Get(x,y);
-    if (targ==null<Pixel*>()) continue;
+  for (nat32 y=0;y<index.Height();y++) IterRow(index,iter,y);
+ }
+ else
+ {
+  IterJob job;
+  job.self = this;
+  job.index = &index;
+  job.iter = iter;
+  mt::SharedPool().Run(job,index.Height());
+ }
+}
+
+void EBP::IterRow(ds::Array2D<Pixel*> & index,nat32 iter,nat32 y)
+{
+ for (nat32 x=((y+iter)%2);x<index.Width();x+=2)
+ {
+  // Iterate every other pixel with a checkboard pattern, for each pixel
+  // calculate and pass the messages, except when the flags say otherwise...
+   Pixel * targ = index.Get(x,y);
+   if (targ==null<Pixel*>()) continue;
 
-    for (nat32 md=0;md<4;md++)
+   for (nat32 md=0;md<4;md++)
+   {
+    if (targ->Pass(md))
     {
-     if (targ->Pass(md))
-     {
-      // Get iterators for destination message and self, with destination index...
-       DispIter self;
-       targ->MakeIter(self);
+     // Get iterators for destination message and self, with destination index...
+      DispIter self;
+      targ->MakeIter(self);
 
-       DispIter out;
-       switch (md)
-       {
-        case 0: index.Get(x+1,y)->MakeIter(out); break;
-        case 1: index.Get(x,y+1)->MakeIter(out); break;
-        case 2: index.Get(x-1,y)->MakeIter(out); break;
-        default: index.Get(x,y-1)->MakeIter(out); break;
-       }
-       if (out.msgSize==0) continue; // This shouldn't be required. Bug, presumably, means it is however.
+      DispIter out;
+      switch (md)
+      {
+       case 0: index.Get(x+1,y)->MakeIter(out); break;
+       case 1: index.Get(x,y+1)->MakeIter(out); break;
+       case 2: index.Get(x-1,y)->MakeIter(out); break;
+       default: index.Get(x,y-1)->MakeIter(out); break;
+      }
+      if (out.msgSize==0) continue; // This shouldn't be required. Bug, presumably, means it is however.
 
-       nat32 outInd = 1 + ((md+2)%4);
+      nat32 outInd = 1 + ((md+2)%4);
 
 
-      // Forward pass - calculate the minimum cost, fill in the output message
-      // with minimums including previous entrys...
-       real32 lastCost = math::Infinity<real32>();
-       int32 lastDisp = 0; // Above infinity makes this value irrelevant, zero to make compiler shut up.
+     // Forward pass - calculate the minimum cost, fill in the output message
+     // with minimums including previous entrys...
+      real32 lastCost = math::Infinity<real32>();
+      int32 lastDisp = 0; // Above infinity makes this value irrelevant, zero to make compiler shut up.
 
-       real32 minCost = lastCost;
-       nat32 selfRem = self.msgSize;
+      real32 minCost = lastCost;
+      nat32 selfRem = self.msgSize;
 
-       for (nat32 i=0;;i++)
-       {
-        // Move self forward until it matches or excedes the disparity of out,
-        // maintainning some variables...
-         if (selfRem!=0)
+      for (nat32 i=0;;i++)
+      {
+       // Move self forward until it matches or excedes the disparity of out,
+       // maintainning some variables...
+        if (selfRem!=0)
+        {
+         while (self.Disparity()<=out.Disparity())
          {
-          while (self.Disparity()<=out.Disparity())
-          {
-           real32 cost = self.Value(0);
-           for (nat32 j=0;j<md;j++) cost += self.Value(j+1);
-           for (nat32 j=md+1;j<4;j++) cost += self.Value(j+1);
-           minCost = math::Min(minCost,cost);
+          real32 cost = self.Value(0);
+          for (nat32 j=0;j<md;j++) cost += self.Value(j+1);
+          for (nat32 j=md+1;j<4;j++) cost += self.Value(j+1);
+          minCost = math::Min(minCost,cost);
 
-           lastCost = math::Min(cost,lastCost + targ->occCost[md]*real32(self.Disparity()-lastDisp));
-           lastDisp = self.Disparity();
+          lastCost = math::Min(cost,lastCost + targ->occCost[md]*real32(self.Disparity()-lastDisp));
+          lastDisp = self.Disparity();
 
-           --selfRem;
-           if (selfRem==0) break;
-           self.ToNext();
-          }
+          --selfRem;
+          if (selfRem==0) break;
+          self.ToNext();
          }
+        }
 
-        // Update the out message and support variables, move to next...
-         out.Value(outInd) = lastCost + targ->occCost[md]*real32(out.Disparity()-lastDisp);
-         if (i+1==out.msgSize) break;
-         out.ToNext();
-       }
+       // Update the out message and support variables, move to next...
+        out.Value(outInd) = lastCost + targ->occCost[md]*real32(out.Disparity()-lastDisp);
+        if (i+1==out.msgSize) break;
+        out.ToNext();
+      }
 
 
-      // Continue onto the end of self, ready for the backward pass...
-       if (selfRem!=0)
+     // Continue onto the end of self, ready for the backward pass...
+      if (selfRem!=0)
+      {
+       while (true)
        {
-        while (true)
-        {
-         real32 cost = self.Value(0);
-         for (nat32 j=0;j<md;j++) cost += self.Value(j+1);
-         for (nat32 j=md+1;j<4;j++) cost += self.Value(j+1);
-         minCost = math::Min(minCost,cost);
-
-         --selfRem;
-         if (selfRem==0) break;
-         self.ToNext();
-        }
+        real32 cost = self.Value(0);
+        for (nat32 j=0;j<md;j++) cost += self.Value(j+1);
+        for (nat32 j=md+1;j<4;j++) cost += self.Value(j+1);
+        minCost = math::Min(minCost,cost);
+
+        --selfRem;
+        if (selfRem==0) break;
+        self.ToNext();
        }
+      }
 
 
-      // Backward pass - propagate the costs and apply the cost cap...
-       lastCost = math::Infinity<real32>();
-       lastDisp = 0;
+     // Backward pass - propagate the costs and apply the cost cap...
+      lastCost = math::Infinity<real32>();
+      lastDisp = 0;
 
-       selfRem = self.msgSize;
-       real32 occLim = targ->occCost[md] * occLimMult;
+      selfRem = self.msgSize;
+      real32 occLim = targ->occCost[md] * occLimMult;
 
-       for (nat32 i=0;;i++)
-       {
-        // Move self forward until it matches or excedes the disparity of out,
-        // maintainning some variables...
-         if (selfRem!=0)
+      for (nat32 i=0;;i++)
+      {
+       // Move self forward until it matches or excedes the disparity of out,
+       // maintainning some variables...
+        if (selfRem!=0)
+        {
+         while (self.Disparity()>=out.Disparity())
          {
-          while (self.Disparity()>=out.Disparity())
-          {
-           real32 cost = self.Value(0);
-           for (nat32 j=0;j<md;j++) cost += self.Value(j+1);
-           for (nat32 j=md+1;j<4;j++) cost += self.Value(j+1);
+          real32 cost = self.Value(0);
+          for (nat32 j=0;j<md;j++) cost += self.Value(j+1);
+          for (nat32 j=md+1;j<4;j++) cost += self.Value(j+1);
 
-           lastCost = math::Min(cost,lastCost + targ->occCost[md]*real32(lastDisp-self.Disparity()));
-           lastDisp = self.Disparity();
+          lastCost = math::Min(cost,lastCost + targ->occCost[md]*real32(lastDisp-self.Disparity()));
+          lastDisp = self.Disparity();
 
-           --selfRem;
-           if (selfRem==0) break;
-           self.ToPrev();
-          }
+          --selfRem;
+          if (selfRem==0) break;
+          self.ToPrev();
          }
+        }
 
-        // Update the out message and support variables, move to next...
-         real32 byLast = lastCost + targ->occCost[md]*real32(lastDisp-out.Disparity());
-         out.Value(outInd) = math::Min(out.Value(outInd),byLast);
-         out.Value(outInd) = math::Min(occLim,out.Value(outInd)-minCost);
+       // Update the out message and support variables, move to next...
+        real32 byLast = lastCost + targ->occCost[md]*real32(lastDisp-out.Disparity());
+        out.Value(outInd) = math::Min(out.Value(outInd),byLast);
+        out.Value(outInd) = math::Min(occLim,out.Value(outInd)-minCost);
 
-         if (i+1==out.msgSize) break;
-         out.ToPrev();
-       }
-     }
+        if (i+1==out.msgSize) break;
+        out.ToPrev();
+      }
     }
-  }
+   }
  }
 }
 
@@ -767,6 +656,203 @@ void EBP::GetMessages(Pixel * to,Pixel * from)
   }
 }
 
+//------------------------------------------------------------------------------
+void EBP::BaseJob::Do(nat32 y,nat32 thread)
+{
+ const DSC * dsc = self->dsc;
+ const DSC * dscOcc = self->dscOcc;
+ mem::Packer & mem = *(*packer)[thread];
+ byte * pixA = scratch + 2*dscOcc->Bytes()*thread;
+ byte * pixB = pixA + dscOcc->Bytes();
+
+ for (nat32 x=0;x<index->Width();x++)
+ {
+  // Check for it being masked...
+   nat32 pi = y*index->Width() + x;
+   nat32 sections = secIndex[pi+1] - secIndex[pi];
+   if (sections==0)
+   {
+    index->Get(x,y) = null<Pixel*>();
+    continue;
+   }
+   const Section * ps = sec + secIndex[pi];
+
+  // Go through the ranges and count the number of disparities...
+   nat32 msgSize = 0;
+   for (nat32 i=0;i<sections;i++) msgSize += ps[i].runLength;
+
+  // Construct the relevant Pixel structure...
+   nat32 pixSize = sizeof(Pixel) + sections * sizeof(Section) + 5 * msgSize * sizeof(real32);
+   Pixel * pix = (Pixel*)(void*)mem.Malloc<byte>(pixSize);
+   index->Get(x,y) = pix;
+
+   pix->passFlags = 0xFFFFFFFF;
+   pix->msgSize = msgSize;
+   pix->sections = sections;
+
+  // Fill in the occCost array...
+   dscOcc->Left(x,y,pixA);
+   for (nat32 i=0;i<4;i++)
+   {
+    pix->occCost[i] = self->occCostBase;
+
+    nat32 xp = x;
+    nat32 yp = y;
+    bit done = false;
+    switch (i)
+    {
+     case 0: ++xp; if (xp==index->Width()) done = true; break;
+     case 1: ++yp; if (yp==index->Height()) done = true; break;
+     case 2: if (xp==0) done = true; else --xp; break;
+     case 3: if (yp==0) done = true; else --yp; break;
+    }
+    if (done) continue;
+
+    dscOcc->Left(xp,yp,pixB);
+    real32 diff = dscOcc->Cost(pixA,pixB);
+    pix->occCost[i] += diff * self->occCostMult;
+   }
+
+
+  // Fill in the sections...
+   for (nat32 i=0;i<sections;i++) *pix->GetSec(i) = ps[i];
+
+  // Fill in the matching costs taken from the DSC...
+  // (Because we allow matches outside the image range we have to do bound checking.)
+   nat32 offset = 0;
+   for (nat32 i=0;i<pix->sections;i++)
+   {
+    int32 end = ps[i].startDisp + int32(ps[i].runLength);
+    for (int32 d=ps[i].startDisp;d<end;d++)
+    {
+     int32 ux2 = int32(x) + d;
+     int32 x2 = math::Clamp(ux2,int32(0),int32(dsc->WidthRight())-1);
+     pix->Start()[offset] = dsc->Cost(x,x2,y) + self->occCostBase*math::Abs(ux2-x2);
+     ++offset;
+    }
+   }
+
+  // Null the messages...
+   for (nat32 i=pix->msgSize;i<pix->msgSize*5;i++) pix->Start()[i] = 0.0;
+ }
+}
+
+void EBP::UnionJob::Do(nat32 y,nat32 thread)
+{
+ for (nat32 x=0;x<to->Width();x++)
+ {
+  nat32 fromX = x*2;
+  nat32 fromY = y*2;
+
+  bit okX = (fromX+1)!=from->Width();
+  bit okY = (fromY+1)!=from->Height();
+
+  Pixel * pix[4];
+
+  pix[0] = from->Get(fromX,fromY);
+  if (okX) pix[1] = from->Get(fromX+1,fromY);
+      else pix[1] = null<Pixel*>();
+  if (okY) pix[2] = from->Get(fromX,fromY+1);
+      else pix[2] = null<Pixel*>();
+  if (okX&&okY) pix[3] = from->Get(fromX+1,fromY+1);
+           else pix[3] = null<Pixel*>();
+
+  to->Get(x,y) = self->Union(pix,(*packer)[thread]);
+ }
+}
+
+void EBP::IterJob::Do(nat32 y,nat32)
+{
+ self->IterRow(*index,iter,y);
+}
+
+void EBP::MessageJob::Do(nat32 y,nat32)
+{
+ for (nat32 x=0;x<to->Width();x++)
+ {
+  if (to->Get(x,y)) self->GetMessages(to->Get(x,y),from->Get(x/2,y/2));
+ }
+}
+
+void EBP::ExtractJob::Do(nat32 y,nat32)
+{
+ nat32 outCount = self->outCount;
+ Scanline & out = self->disp[y];
+ ds::PriorityQueue<Match> dispHeap(outCount);
+ ds::Array<Match> dispArray(outCount);
+
+ // First pass to count how many disparities we will actually be outputting,
+ // for this scanline. Index is filled in during this process...
+  out.index.Size(index->Width()+1);
+  out.index[0] = 0;
+  for (nat32 x=0;x<index->Width();x++)
+  {
+   if (index->Get(x,y)) out.index[x+1] = out.index[x] + math::Min(index->Get(x,y)->msgSize,outCount);
+                   else out.index[x+1] = out.index[x];
+  }
+
+
+ // Second pass to fill in the data structure with the actual disparities
+ // and costs...
+  out.data.Size(out.index[out.index.Size()-1]);
+  for (nat32 x=0;x<index->Width();x++)
+  {
+   Pixel * targ = index->Get(x,y);
+   if ((targ!=null<Pixel*>())&&(targ->sections!=0))
+   {
+    // Find the best matches...
+     dispHeap.MakeEmpty();
+     DispIter di;
+     targ->MakeIter(di);
+
+     for (nat32 i=0;i<targ->msgSize;i++)
+     {
+      real32 cost = di.Value(0) + di.Value(1) + di.Value(2) + di.Value(3) + di.Value(4);
+      if (dispHeap.Size()<outCount)
+      {
+       // No competition - just store it...
+        Match m;
+        m.disp = di.Disparity();
+        m.cost = cost;
+        dispHeap.Add(m);
+      }
+      else
+      {
+       // Check if its good enough to be included, and include it if so, removing the member it superceded...
+        if (cost<dispHeap.Peek().cost)
+        {
+         dispHeap.Rem();
+         Match m;
+         m.disp = di.Disparity();
+         m.cost = cost;
+         dispHeap.Add(m);
+        }
+      }
+      di.ToNext();
+     }
+
+
+    // Sort them by disparity...
+     nat32 num = 0;
+     while (dispHeap.Size()!=0)
+     {
+      dispArray[num] = dispHeap.Peek();
+      ++num;
+      dispHeap.Rem();
+     }
+
+     dispArray.SortRange<DispSort>(0,num-1);
+
+
+    // Write them into the correct scanline positions...
+     for (nat32 i=0;i<num;i++)
+     {
+      out.data[out.index[x]+i] = dispArray[i];
+     }
+   }
+  }
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -20,7 +20,7 @@
 
 /// \file ebp.h
 /// A belief propagation implimentation, you provide it with a DSI to indicate,
-/// per pixel, the search range. Heavilly optimised.
+/// per pixel, the search range. Heavilly optimised, and multithreaded.
 
 #include "eos/types.h"
 #include "eos/time/progress.h"
@@ -29,6 +29,7 @@
 #include "eos/stereo/dsi.h"
 #include "eos/stereo/dsr.h"
 #include "eos/mem/packer.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -40,6 +41,12 @@ namespace eos
 /// However, it takes a DSR as input, and searches disparities in the ranges
 /// given.
 /// This makes things rather more complicated.
+///
+/// Building the hierachy, message passing and extracting the results are all
+/// done a row at a time on mt::SharedPool(), with a memory allocator per
+/// thread. The checkerboard pattern means the pixels updated in an iteration
+/// only write to pixels that are not, so the output does not depend on the
+/// thread count.
 class EOS_CLASS EBP : public DSI
 {
  public:
@@ -106,6 +113,7 @@ class EOS_CLASS EBP : public DSI
 
  private:
   static const nat32 blockSize = 16*1024*1024; // For the memory managment system used.
+  static const nat32 serialSize = 4096; // Layers with fewer pixels than this are iterated without the thread pool.
  
   // In...
    real32 occCostBase;
@@ -236,7 +244,11 @@ class EOS_CLASS EBP : public DSI
 
    // Method to do a single iteration, given the index of a layer.
    // Also given the iteration number, to suport a checkerboard message passing pattern.
+   // Small layers are done directly, larger ones a row at a time in parallel.
     void Iter(ds::Array2D<Pixel*> & index,nat32 iter);
+
+   // Does the pixels of a single row for Iter.
+    void IterRow(ds::Array2D<Pixel*> & index,nat32 iter,nat32 y);
     
    // This method unions upto 4 Pixels, returning a new pixel allocated with 
    // the given mem::Packer. Given pointers can be null, they will not then be
@@ -249,6 +261,61 @@ class EOS_CLASS EBP : public DSI
    // the from pixel was created by unioning the to pixel with others previously.
    // (The reverse of union basically.)
     void GetMessages(Pixel * to,Pixel * from);
+
+
+   // Jobs, each of which does a row of a layer as a unit...
+    // Fills in the base layer, from the search ranges extracted from the dsr...
+     class BaseJob : public mt::Job
+     {
+      public:
+       EBP * self;
+       ds::Array2D<Pixel*> * index;
+       const nat32 * secIndex; // Per pixel offset into sec, with dummy at end.
+       const Section * sec;
+       ds::ArrayPtr<mem::Packer> * packer; // Per thread.
+       byte * scratch; // Two dscOcc pixels per thread.
+       void Do(nat32 y,nat32 thread);
+     };
+
+    // Unions 2x2 blocks of a layer to make the layer above...
+     class UnionJob : public mt::Job
+     {
+      public:
+       EBP * self;
+       ds::Array2D<Pixel*> * from;
+       ds::Array2D<Pixel*> * to;
+       ds::ArrayPtr<mem::Packer> * packer; // Per thread.
+       void Do(nat32 y,nat32 thread);
+     };
+
+    // Does a row of an iteration...
+     class IterJob : public mt::Job
+     {
+      public:
+       EBP * self;
+       ds::Array2D<Pixel*> * index;
+       nat32 iter;
+       void Do(nat32 y,nat32 thread);
+     };
+
+    // Transfers messages from the layer above to a layer...
+     class MessageJob : public mt::Job
+     {
+      public:
+       EBP * self;
+       ds::Array2D<Pixel*> * from;
+       ds::Array2D<Pixel*> * to;
+       void Do(nat32 y,nat32 thread);
+     };
+
+    // Extracts the best disparities into a scanline of the output...
+     class ExtractJob : public mt::Job
+     {
+      public:
+       EBP * self;
+       ds::Array2D<Pixel*> * index;
+       void Do(nat32 y,nat32 thread);
+     };
 };
 
 //------------------------------------------------------------------------------
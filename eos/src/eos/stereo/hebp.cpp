@@ -137,6 +137,7 @@ void HEBP::Run(time::Progress * prog)
   // Do the rest...
    for (int32 i=ll.Size()-2;i>=0;i--)
    {
+    if (prog->Cancelling()) break;
     prog->Report(ll.Size()-1-i,ll.Size());
     const DSC & here = hdsc.Level(i);
    
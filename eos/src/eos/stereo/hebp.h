@@ -34,6 +34,9 @@ namespace eos
 /// This uses the EBP algorithm in a hierarchy so that a DSR is not required.
 /// Simply runs the algorithm as multiple resolutions starting at a low 
 /// resolution bootstrapping each run with the previous lower resolution run.
+/// As each run depends on the one before they are done in turn, but each run,
+/// and the spreading of the search ranges passed between them, is
+/// multithreaded.
 class EOS_CLASS HEBP : public DSI
 {
  public:
@@ -59,7 +62,8 @@ class EOS_CLASS HEBP : public DSI
    void Set(const svt::Field<bit> & leftMask,const svt::Field<bit> & rightMask);
 
 
-  /// Runs the algorithm.
+  /// Runs the algorithm. Stops early if prog is cancelled, in which case the
+  /// output is invalid.
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
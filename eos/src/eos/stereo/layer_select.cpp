@@ -100,10 +100,17 @@ bit LayerSelect::Run(time::Progress * prog)
 
 
  // Initialise and build the warp image, with all the segments/layers...
+  mt::Pool & pool = mt::SharedPool();
+  WarpInc::Move * move = new WarpInc::Move[pool.Threads()];
+
   WarpInc warp(right,segCount);
   warp.SetMask(rightMask);
   warp.Weights(occCost);
-  for (nat32 i=0;i<segCount;i++) RenderSegment(warp,i);
+  for (nat32 i=0;i<segCount;i++)
+  {
+   RenderSegment(move[0],i,layerMaker->SegToLayer(i));
+   warp.Apply(move[0]);
+  }
 
  // Create a graph so we can iterate the adjacent segments of any one segment quickly.
   filter::SegGraph segGraph(segs,segCount);
@@ -122,8 +129,8 @@ bit LayerSelect::Run(time::Progress * prog)
    }
   }
 
- // A tempory lump of memory used below for keeping track of which layers we need to try...
-  bit * layF = new bit[layerMaker->Layers()];
+ // A tempory lump of memory used below for keeping track of which layers we need to try, per thread...
+  bit * layF = new bit[layerMaker->Layers()*pool.Threads()];
 
  // A tempory lump of memory, this once for tracking the new layer for each segment, we have
  // two, due to tracking the last few and using the last best when no improvment happens for x.
@@ -139,53 +146,19 @@ bit LayerSelect::Run(time::Progress * prog)
  // Iterate until no changes found...
   while (bailOut<checkRuns)
   {
-   // For each segment try layer re-alignments, set it to the one which reduces
-   // the cost the most...
-    for (nat32 i=0;i<segCount;i++)
+   // For each segment try layer re-alignments, against the current state
+   // of all other segments, and record the one which reduces the cost the
+   // most...
     {
-     // Work out which layers we need to try...
-      for (nat32 j=0;j<layerMaker->Layers();j++) layF[j] = false;
-      for (nat32 j=0;j<segGraph.NeighbourCount(i);j++)
-      {
-       layF[layerMaker->SegToLayer(segGraph.Neighbour(i,j))] = true;
-      }
-      layF[layerMaker->SegToLayer(i)] = false;
-
-     // For each layer check if its an improvment on the last...
-      nat32 startLayer = layerMaker->SegToLayer(i);
-      nat32 bestLayer = startLayer;
-      real32 bestScore = warp.Score() + discCount*disCost;
-
-      for (nat32 j=0;j<layerMaker->Layers();j++)
-      {
-       if (layF[j])
-       {
-	// We have a layer to try out, update the warp image as required...
-	 warp.Remove(i);
-	 discCount += DiscDelta(segGraph,i,j);
-	 layerMaker->SegToLayer(i) = j;
-	 RenderSegment(warp,i);
-
-	// If the score has improved, record it, otherwise we don't give a dam...
-	 real32 score = warp.Score() + discCount*disCost;
-
-	 if (score<bestScore)
-         {
-	  bestLayer = j;
-	  bestScore = score;
-         }
-       }
-      }
-
-     // Store the change for future application and revert to the starting state...
-      useLay[i] = bestLayer;
-      if (layerMaker->SegToLayer(i)!=startLayer)
-      {
-       warp.Remove(i);
-       discCount += DiscDelta(segGraph,i,startLayer);
-       layerMaker->SegToLayer(i) = startLayer;
-       RenderSegment(warp,i);
-      }
+     SelectJob job;
+     job.self = this;
+     job.warp = &warp;
+     job.segGraph = &segGraph;
+     job.discCount = discCount;
+     job.move = move;
+     job.layF = layF;
+     job.useLay = useLay;
+     pool.Run(job,segCount);
     }
     prog->Report(segCount,segCount);
 
@@ -195,10 +168,10 @@ bit LayerSelect::Run(time::Progress * prog)
     {
      if (layerMaker->SegToLayer(i)!=useLay[i])
      {
-      warp.Remove(i);
       discCount += DiscDelta(segGraph,i,useLay[i]);
       layerMaker->SegToLayer(i) = useLay[i];
-      RenderSegment(warp,i);
+      RenderSegment(move[0],i,useLay[i]);
+      warp.Apply(move[0]);
      }
     }
 
@@ -227,6 +200,7 @@ bit LayerSelect::Run(time::Progress * prog)
  // Clean up...
   delete[] useLay;
   delete[] layF;
+  delete[] move;
 
   for (nat32 i=0;i<segCount;i++)
   {
@@ -244,11 +218,12 @@ bit LayerSelect::Run(time::Progress * prog)
  return ret;
 }
 
-void LayerSelect::RenderSegment(WarpInc & warp,nat32 segment)
+void LayerSelect::RenderSegment(WarpInc::Move & move,nat32 segment,nat32 layer)
 {
+ move.Reset(segment);
  Node * targ = sed[segment];
- const bs::PlaneABC & plane = layerMaker->Plane(layerMaker->SegToLayer(segment));
- nat32 width = warp.Width();
+ const bs::PlaneABC & plane = layerMaker->Plane(layer);
+ nat32 width = right.Size(0);
  while (targ)
  {
   if (targ->paired)
@@ -273,7 +248,7 @@ void LayerSelect::RenderSegment(WarpInc & warp,nat32 segment)
       colour.g = (1.0-t)*targ->colour.g + t*targ->next->colour.g;
       colour.b = (1.0-t)*targ->colour.b + t*targ->next->colour.b;
 
-     warp.Add(i,targ->y,plane.Z(targ->x+t,targ->y),colour,segment);
+     move.Add(i,targ->y,plane.Z(targ->x+t,targ->y),colour);
     }
   }
   targ = targ->next;
@@ -304,6 +279,42 @@ int32 LayerSelect::DiscDelta(filter::SegGraph & segGraph,nat32 seg,nat32 toLayer
  return ret;
 }
 
+//------------------------------------------------------------------------------
+void LayerSelect::SelectJob::Do(nat32 seg,nat32 thread)
+{
+ LayerMaker * layerMaker = self->layerMaker;
+ bit * lf = layF + thread*layerMaker->Layers();
+
+ // Work out which layers we need to try...
+  for (nat32 j=0;j<layerMaker->Layers();j++) lf[j] = false;
+  for (nat32 j=0;j<segGraph->NeighbourCount(seg);j++)
+  {
+   lf[layerMaker->SegToLayer(segGraph->Neighbour(seg,j))] = true;
+  }
+  lf[layerMaker->SegToLayer(seg)] = false;
+
+ // For each layer check if its an improvment on the last...
+  nat32 bestLayer = layerMaker->SegToLayer(seg);
+  real32 bestScore = warp->Score() + discCount*self->disCost;
+
+  for (nat32 j=0;j<layerMaker->Layers();j++)
+  {
+   if (lf[j])
+   {
+    self->RenderSegment(move[thread],seg,j);
+    real32 score = warp->Score(move[thread]) + real32(int32(discCount) + self->DiscDelta(*segGraph,seg,j))*self->disCost;
+
+    if (score<bestScore)
+    {
+     bestLayer = j;
+     bestScore = score;
+    }
+   }
+  }
+
+ useLay[seg] = bestLayer;
+}
+
 //------------------------------------------------------------------------------
  };
 };
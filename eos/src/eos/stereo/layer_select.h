@@ -31,6 +31,7 @@
 #include "eos/filter/seg_graph.h"
 #include "eos/time/progress.h"
 #include "eos/bs/colours.h"
+#include "eos/mt/pool.h"
 
 namespace eos
 {
@@ -46,6 +47,9 @@ namespace eos
 /// this a re-fitting of the layers is ushally recomended then a repeat of this
 /// algorithm etc until no change happens. It indicates no change in its return
 /// value from running.
+/// Each pass of the greedy algorithm scores every segment against the same
+/// state, so segments are done in parallel on mt::SharedPool(), testing their
+/// candidate layers with WarpInc::Score without changing the warp.
 class EOS_CLASS LayerSelect
 {
  public:
@@ -116,12 +120,28 @@ class EOS_CLASS LayerSelect
    };
    Node ** sed; // Array of segCount size, points to first in each list.
 
-  // Renders the given segment...
-   void RenderSegment(WarpInc & warp,nat32 segment);
+  // Renders the given segment with the given layer into a move...
+   void RenderSegment(WarpInc::Move & move,nat32 segment,nat32 layer);
 
   // Given various bits of information calculates the change in discontinuity
   // count given a segment changing its layer to another...
    int32 DiscDelta(filter::SegGraph & segGraph,nat32 seg,nat32 toLayer);
+
+  // Finds the best layer for each segment, given all others keep their
+  // current layer...
+   class SelectJob : public mt::Job
+   {
+    public:
+     LayerSelect * self;
+     const WarpInc * warp;
+     filter::SegGraph * segGraph;
+     nat32 discCount;
+     WarpInc::Move * move; // One per thread.
+     bit * layF; // Layers() per thread, for marking the layers to try.
+     nat32 * useLay; // Output.
+
+     void Do(nat32 seg,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
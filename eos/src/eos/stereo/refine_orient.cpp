@@ -111,42 +111,27 @@ void RefineOrient::Run(time::Progress * prog)
   }
   else
   {
-   // We are without normals, plane fit each segment...
-    // Count how many segments we have...
-     nat32 segCount = 1;
-     for (nat32 y=0;y<seg.Size(1);y++)
-     {
-      for (nat32 x=0;x<seg.Size(0);x++) segCount = math::Max(segCount,seg.Get(x,y)+1);
-     }
-
-    // Create plane fitters for each segment...
-     ds::ArrayDel<alg::LinePlaneFit> planeFit(segCount);
-    
-    // Fill in the data...
-     for (nat32 y=0;y<seg.Size(1);y++)
-     {
-      for (nat32 x=0;x<seg.Size(0);x++) planeFit[seg.Get(x,y)].Add(data.Get(x,y),data.Get(x,y),1.0);
-     }
-
-    // Run the fitters...
-     prog->Push();
-      for (nat32 i=0;i<segCount;i++)
-      {
-       prog->Report(i,segCount);
-       planeFit[i].Run();
-      }
-     prog->Pop();
-
-    // Assign the normals...
-     for (nat32 y=0;y<seg.Size(1);y++)
-     {
-      for (nat32 x=0;x<seg.Size(0);x++)
-      {
-       norm.Get(x,y) = planeFit[seg.Get(x,y)].Plane().n;
-       norm.Get(x,y).Normalise();
-       if (norm.Get(x,y)[2]<0.0) norm.Get(x,y) *= -1.0;
-      }
-     }
+   // We are without normals, plane fit each segment, in parallel...
+    filter::SegPixels pixels(seg);
+    ds::Array<nat32> order;
+    pixels.Order(order);
+
+    ds::Array<bs::Normal> segNorm(pixels.Segments());
+
+    NormJob job;
+    job.pixels = &pixels;
+    job.order = &order;
+    job.pos = &data;
+    job.segNorm = &segNorm;
+    prog->Push();
+     mt::SharedPool().Run(job,pixels.Segments(),prog);
+    prog->Pop();
+
+   // Assign the normals...
+    for (nat32 y=0;y<seg.Size(1);y++)
+    {
+     for (nat32 x=0;x<seg.Size(0);x++) norm.Get(x,y) = segNorm[seg.Get(x,y)];
+    }
   }
 
 
@@ -210,49 +195,25 @@ void RefineOrient::Run(time::Progress * prog)
 
    // Iterate the entire image and calculate the weight assigned to each pixel, 
    // as we don't want to have to calcalate such a thing repeatedly in the 
-   // below...
-    for (nat32 y=0;y<out->Height();y++)
-    {
-     prog->Report(y,out->Height()*2);
-     for (nat32 x=0;x<out->Width();x++)
-     {
-      if ((duds==false)||(seg.Get(x,y)!=0))
-      {
-       // Project to the right image to discover the disparity...
-        math::Vect<3> pp;
-        math::MultVect(projRight,in->Get(x,y),pp);
-        pp /= pp[2];
-        int32 disp = int32(math::Round(pp[0]-real32(x)));
-        
-       // If the disparity doesn't match the cached disparity we need to
-       // re-calculate the weight...
-        if (prevDisp.Get(x,y)!=disp)
-        {
-         prevDisp.Get(x,y) = disp;
-         
-         weight.Get(x,y) = math::Infinity<real32>();
-         for (nat32 j=0;j<dsi->Size(x,y);j++)
-         {
-          real32 cost = dsi->Cost(x,y,j) + stepCost*math::Abs(dsi->Disp(x,y,j)-real32(disp));
-          weight.Get(x,y) = math::Min(weight.Get(x,y),cost);
-         }
-         weight.Get(x,y) = math::Exp(-weight.Get(x,y));
-        }
-      }
-     }
-    }
-
-
-   // Iterate the entire image and for each pixel optimise its position...
-    for (nat32 y=0;y<out->Height();y++)
-    {
-     prog->Report(out->Height()+y,out->Height()*2);
-     for (nat32 x=0;x<out->Width();x++)
-     {
-      if (duds&&(seg.Get(x,y)==0)) out->Get(x,y) = in->Get(x,y);
-                              else CalcPos(x,y,*in,norm,leftCentre,weight,out->Get(x,y));
-     }
-    }
+   // below, then for each pixel optimise its position. Both are done a row at
+   // a time in parallel, the second only once the first has finished...
+    IterJob job;
+    job.self = this;
+    job.in = in;
+    job.out = out;
+    job.norm = &norm;
+    job.leftCentre = &leftCentre;
+    job.projRight = &projRight;
+    job.prevDisp = &prevDisp;
+    job.weight = &weight;
+
+    job.pass = 0;
+    prog->Report(0,2);
+    mt::SharedPool().Run(job,out->Height());
+
+    job.pass = 1;
+    prog->Report(1,2);
+    mt::SharedPool().Run(job,out->Height());
    prog->Pop();
   }
   prog->Pop();
@@ -445,6 +406,74 @@ void RefineOrient::CalcPos(nat32 x,nat32 y,
   }
 }
 
+void RefineOrient::NormJob::Do(nat32 unit,nat32)
+{
+ nat32 s = (*order)[unit];
+
+ // Fill in the fitter, in raster order...
+  alg::LinePlaneFit planeFit;
+  for (nat32 i=0;i<pixels->Size(s);i++)
+  {
+   const bs::Vertex & v = pos->Get(pixels->X(s,i),pixels->Y(s,i));
+   planeFit.Add(v,v,1.0);
+  }
+
+ // Run it and extract the normal, facing the camera...
+  planeFit.Run();
+  bs::Normal & targ = (*segNorm)[s];
+  targ = planeFit.Plane().n;
+  targ.Normalise();
+  if (targ[2]<0.0) targ *= -1.0;
+}
+
+void RefineOrient::IterJob::Do(nat32 y,nat32)
+{
+ const svt::Field<nat32> & seg = self->seg;
+ bit duds = self->duds;
+
+ if (pass==0)
+ {
+  const DSI * dsi = self->dsi;
+  real32 stepCost = self->stepCost;
+
+  for (nat32 x=0;x<out->Width();x++)
+  {
+   if ((duds==false)||(seg.Get(x,y)!=0))
+   {
+    // Project to the right image to discover the disparity...
+     math::Vect<3> pp;
+     math::MultVect(*projRight,in->Get(x,y),pp);
+     pp /= pp[2];
+     int32 disp = int32(math::Round(pp[0]-real32(x)));
+        
+    // If the disparity doesn't match the cached disparity we need to
+    // re-calculate the weight...
+     if (prevDisp->Get(x,y)!=disp)
+     {
+      prevDisp->Get(x,y) = disp;
+         
+      real32 & w = weight->Get(x,y);
+      w = math::Infinity<real32>();
+      for (nat32 j=0;j<dsi->Size(x,y);j++)
+      {
+       real32 cost = dsi->Cost(x,y,j) + stepCost*math::Abs(dsi->Disp(x,y,j)-real32(disp));
+       w = math::Min(w,cost);
+      }
+      w = math::Exp(-w);
+     }
+   }
+  }
+ }
+ else
+ {
+  for (nat32 x=0;x<out->Width();x++)
+  {
+   if (duds&&(seg.Get(x,y)==0)) out->Get(x,y) = in->Get(x,y);
+                           else self->CalcPos(x,y,*in,*norm,*leftCentre,*weight,out->Get(x,y));
+  }
+ }
+}
+
 //------------------------------------------------------------------------------
  };
 };
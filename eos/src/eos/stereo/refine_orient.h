@@ -24,6 +24,8 @@
 /// are correct, iterates till convergance.
 
 #include "eos/types.h"
+#include "eos/mt/pool.h"
+#include "eos/filter/seg_pixels.h"
 #include "eos/stereo/dsi_ms.h"
 
 namespace eos
@@ -83,6 +85,8 @@ class EOS_CLASS RefineOrient
   /// Runs the algorithm.
   /// Can be called a second time after setting the needle map, at which point 
   /// it will start from its converged position the first time.
+  /// The per-segment plane fits and each pass of every iteration are spread
+  /// across mt::SharedPool().
    void Run(time::Progress * prog = null<time::Progress*>());
 
 
@@ -126,6 +130,37 @@ class EOS_CLASS RefineOrient
                 const ds::Array2D<bs::Vertex> & pos,const ds::Array2D<bs::Normal> & norm,
                 const math::Vect<4> & centre,const ds::Array2D<real32> & weight,
                 bs::Vertex & out) const;
+
+  // Plane fits one segment per unit to get the normal for all its pixels, the
+  // segments being handed out largest first...
+   class NormJob : public mt::Job
+   {
+    public:
+     const filter::SegPixels * pixels;
+     const ds::Array<nat32> * order;
+     const ds::Array2D<bs::Vertex> * pos;
+     ds::Array<bs::Normal> * segNorm;
+
+     void Do(nat32 unit,nat32 thread);
+   };
+
+  // Does one row of an iteration per unit, either updating the weights (pass
+  // 0) or calculating the new positions given the weights (pass 1)...
+   class IterJob : public mt::Job
+   {
+    public:
+     RefineOrient * self;
+     nat32 pass;
+     const ds::Array2D<bs::Vertex> * in;
+     ds::Array2D<bs::Vertex> * out;
+     const ds::Array2D<bs::Normal> * norm;
+     const math::Vect<4> * leftCentre;
+     const math::Mat<3,4> * projRight;
+     ds::Array2D<int32> * prevDisp;
+     ds::Array2D<real32> * weight;
+
+     void Do(nat32 row,nat32 thread);
+   };
 };
 
 //------------------------------------------------------------------------------
@@ -175,6 +175,7 @@ void WarpInc::Add(nat32 x,nat32 y,real32 disp,const bs::ColourRGB & colour,nat32
   nn->head = head;
   nn->colour = colour;
   nn->disp = disp;
+  nn->segment = segment;
 
  // Update the scores...
   if (targ==head) // Its the top dog.
@@ -248,6 +249,111 @@ void WarpInc::Remove(nat32 segment)
  }
 }
 
+void WarpInc::Apply(const Move & move)
+{
+ Remove(move.segment);
+ for (nat32 i=0;i<move.writes;i++)
+ {
+  const Move::Write & w = move.write[i];
+  Add(w.x,w.y,w.disp,w.colour,move.segment);
+ }
+}
+
+real32 WarpInc::Score(Move & move) const
+{
+ // Collect every pixel touched, by both the nodes of the segment being replaced
+ // and the writes of the move, ignoring masked pixels...
+  nat32 touches = move.writes;
+  for (Node * targ=segs[move.segment];targ;targ=targ->segNext) ++touches;
+  if (move.touch.Size()<touches) move.touch.Size(touches);
+
+  touches = 0;
+  for (Node * targ=segs[move.segment];targ;targ=targ->segNext)
+  {
+   move.touch[touches].pixel = targ->head - pixel;
+   move.touch[touches].index = nat32(-1);
+   ++touches;
+  }
+
+  for (nat32 i=0;i<move.writes;i++)
+  {
+   nat32 p = move.write[i].y*width + move.write[i].x;
+   if (pixel[p].count)
+   {
+    move.touch[touches].pixel = p;
+    move.touch[touches].index = i;
+    ++touches;
+   }
+  }
+
+ // Sort, so each pixel is visited once, with its writes in the order they
+ // would be added...
+  if (touches>1) move.touch.SortRangeNorm(0,touches-1);
+
+ // For each pixel remove its current contribution to the score and add in the
+ // contribution it would have after the move...
+  real32 diffDelta = 0.0;
+  int32 occDelta = 0;
+
+  nat32 i = 0;
+  while (i<touches)
+  {
+   Node * head = &pixel[move.touch[i].pixel];
+
+   // Find the write that would come out on top, the first with the largest
+   // disparity, as Add puts later writes behind equal earlier ones...
+    const Move::Write * best = null<const Move::Write*>();
+    real32 bestDisp = 0.0;
+    nat32 added = 0;
+    for (;(i<touches)&&(&pixel[move.touch[i].pixel]==head);i++)
+    {
+     if (move.touch[i].index==nat32(-1)) continue;
+     const Move::Write & w = move.write[move.touch[i].index];
+     ++added;
+     if ((best==null<const Move::Write*>())||(math::Abs(w.disp)>bestDisp))
+     {
+      best = &w;
+      bestDisp = math::Abs(w.disp);
+     }
+    }
+
+   // Count the nodes before and after, noting the top node that survives...
+    nat32 before = 0;
+    nat32 after = added;
+    Node * keep = null<Node*>();
+    for (Node * targ=head->next;targ!=head;targ=targ->next)
+    {
+     ++before;
+     if (targ->segment!=move.segment)
+     {
+      ++after;
+      if (keep==null<Node*>()) keep = targ;
+     }
+    }
+
+   // Remove the current contribution...
+    if (before==0) occDelta -= 1;
+    else
+    {
+     const bs::ColourRGB & col = head->next->colour;
+     diffDelta -= math::Abs(col.r-head->colour.r) + math::Abs(col.g-head->colour.g) + math::Abs(col.b-head->colour.b);
+     occDelta -= int32(before-1);
+    }
+
+   // Add in the new contribution - a surviving node wins ties, as it would be
+   // in front of the new writes...
+    if (after==0) occDelta += 1;
+    else
+    {
+     const bs::ColourRGB & col = ((keep!=null<Node*>())&&((best==null<const Move::Write*>())||(keep->disp>=bestDisp))) ? keep->colour : best->colour;
+     diffDelta += math::Abs(col.r-head->colour.r) + math::Abs(col.g-head->colour.g) + math::Abs(col.b-head->colour.b);
+     occDelta += int32(after-1);
+    }
+  }
+
+ return (diffSum + diffDelta) + real32(int32(occCount)+occDelta)*occCost;
+}
+
 real32 WarpInc::Score() const
 {
  return diffSum + real32(occCount)*occCost;
@@ -308,6 +414,32 @@ void WarpInc::GetImage(svt::Field<bs::ColourRGB> & out)
  }
 }
 
+//------------------------------------------------------------------------------
+WarpInc::Move::Move()
+:segment(0),writes(0)
+{}
+
+WarpInc::Move::~Move()
+{}
+
+void WarpInc::Move::Reset(nat32 seg)
+{
+ segment = seg;
+ writes = 0;
+}
+
+void WarpInc::Move::Add(nat32 x,nat32 y,real32 disp,const bs::ColourRGB & colour)
+{
+ if (writes==write.Size()) write.Size(math::Max<nat32>(2*write.Size(),64));
+
+ Write & w = write[writes];
+ w.x = x;
+ w.y = y;
+ w.disp = disp;
+ w.colour = colour;
+ ++writes;
+}
+
 //------------------------------------------------------------------------------
  };
 };
@@ -28,6 +28,7 @@
 #include "eos/svt/field.h"
 #include "eos/bs/colours.h"
 #include "eos/mem/preempt.h"
+#include "eos/ds/arrays.h"
 
 namespace eos
 {
@@ -53,9 +54,73 @@ EOS_FUNC void ForwardWarp(const svt::Field<bs::ColourRGB> & image,const svt::Fie
 /// The cost function consists of the following terms:
 /// - Sum of absolute differences of actual image, the difference between the true colour and rendered colour. (Excluding areas with no pixels.)
 /// - Sum of occlusion weight multiplied by the number of occlusions in both the left and right images.
+///
+/// As well as making changes you can ask what the score would be after
+/// re-rendering a segment, without doing it, by filling in a Move and passing
+/// it to Score. This only reads the WarpInc, so many threads can evaluate
+/// candidate moves at once, each with its own Move object.
 class EOS_CLASS WarpInc
 {
  public:
+  /// A candidate change, the complete re-rendering of a single segment as the
+  /// list of pixel writes it would make. Filled in with the same calls you
+  /// would make to WarpInc::Add, then either scored with WarpInc::Score or
+  /// made with WarpInc::Apply. Keeps its memory between uses, so reuse them.
+   class EOS_CLASS Move
+   {
+    public:
+     /// &nbsp;
+      Move();
+
+     /// &nbsp;
+      ~Move();
+
+
+     /// Empties the move, setting the segment that it re-renders.
+      void Reset(nat32 segment);
+
+     /// Adds a pixel write, as for WarpInc::Add.
+      void Add(nat32 x,nat32 y,real32 disp,const bs::ColourRGB & colour);
+
+
+     /// Returns the segment re-rendered.
+      nat32 Segment() const {return segment;}
+
+     /// Returns the number of pixel writes.
+      nat32 Size() const {return writes;}
+
+
+     /// &nbsp;
+      inline cstrconst TypeString() const {return "eos::stereo::WarpInc::Move";}
+
+
+    private:
+     friend class WarpInc;
+
+     struct Write
+     {
+      nat32 x;
+      nat32 y;
+      real32 disp;
+      bs::ColourRGB colour;
+     };
+
+     struct Touch
+     {
+      nat32 pixel; // Index into WarpInc::pixel.
+      nat32 index; // Index of the write, or nat32(-1) for a node of the segment being replaced.
+
+      bit operator < (const Touch & rhs) const {return (pixel<rhs.pixel)||((pixel==rhs.pixel)&&(index<rhs.index));}
+     };
+
+     nat32 segment;
+     nat32 writes;
+     ds::Array<Write> write; // Grows as needed, only the first writes entries are in use.
+     ds::Array<Touch> touch; // Workspace for WarpInc::Score.
+   };
+
+
+
   /// Sets the size of the image and the 'true colour' data, and initialises
   /// the score. You also give it the number of segments.
    WarpInc(const svt::Field<bs::ColourRGB> & base,nat32 segments);
@@ -92,10 +157,19 @@ class EOS_CLASS WarpInc
   /// Removes all pixels in a segment.
    void Remove(nat32 segment);
 
+  /// Makes a move, removing all pixels of its segment and then adding its
+  /// writes.
+   void Apply(const Move & move);
+
 
   /// Returns the score for the class in its current state.
    real32 Score() const;
 
+  /// Returns what the score would be if the given move was applied, without
+  /// changing anything, so it can be called by many threads at once. Only
+  /// visits the pixels the move touches. The move is used as workspace.
+   real32 Score(Move & move) const;
+
   /// Returns the score for just the absolute colour difference.
    real32 ScoreDiff() const;
 
@@ -129,6 +203,7 @@ class EOS_CLASS WarpInc
     bs::ColourRGB colour; // True colour if in the dummy node.
     bit count; // True to count it, false to ignore this pixel for costs. Relevant for dummy only.
     real32 disp;
+    nat32 segment; // Segment the node belongs to. Irrelevant for dummy.
    };
 
   // A memory allocator - used by the code to speed up memory allocations, as there bloody slow otherwise...
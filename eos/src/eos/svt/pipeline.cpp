@@ -0,0 +1,393 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/svt/pipeline.h"
+
+#include "eos/svt/node.h"
+#include "eos/data/checksums.h"
+#include "eos/mt/locks.h"
+#include "eos/file/csv.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+// Adapts an md5 to the virtual stream Node::Write wants, so a source can be
+// hashed without writing it anywhere...
+class PipelineHash : public io::OutVirt<io::Binary>
+{
+ public:
+  PipelineHash(data::Md5 & m):md5(m) {}
+
+  nat32 Write(const void * in,nat32 bytes) {return md5.Write((void*)in,bytes);}
+  nat32 Pad(nat32 bytes) {return md5.Pad(bytes);}
+
+  cstrconst TypeString() const {return "eos::svt::PipelineHash";}
+
+ private:
+  data::Md5 & md5;
+};
+
+//------------------------------------------------------------------------------
+Pipeline::Pipeline()
+:pool(null<mt::Pool*>()),ownPool(null<mt::Pool*>()),ran(0),next(0)
+{}
+
+Pipeline::~Pipeline()
+{
+ for (nat32 i=0;i<step.Size();i++) Free(*step[i]);
+ delete ownPool;
+}
+
+nat32 Pipeline::AddSource(Node * node)
+{
+ nat32 ret = step.Size();
+ step.Size(ret+1);
+ step[ret] = new Step();
+
+ Step & targ = *step[ret];
+ targ.meta = null<const MetaAlgorithm*>();
+ targ.out.Size(1);
+ targ.users.Size(1);
+ targ.out[0] = node;
+ targ.keep = false;
+ targ.cache = true;
+ targ.valid = false;
+
+ return ret;
+}
+
+void Pipeline::SetSource(nat32 source,Node * node)
+{
+ log::Assert(step[source]->meta==null<const MetaAlgorithm*>());
+ step[source]->out[0] = node;
+}
+
+nat32 Pipeline::AddStep(const MetaAlgorithm & meta)
+{
+ nat32 ret = step.Size();
+ step.Size(ret+1);
+ step[ret] = new Step();
+
+ Step & targ = *step[ret];
+ targ.meta = &meta;
+ targ.in.Size(meta.Inputs());
+ for (nat32 i=0;i<targ.in.Size();i++)
+ {
+  targ.in[i].step = nat32(-1);
+  targ.in[i].output = 0;
+ }
+ targ.out.Size(meta.Outputs());
+ targ.users.Size(meta.Outputs());
+ for (nat32 i=0;i<targ.out.Size();i++) targ.out[i] = null<Node*>();
+ targ.keep = false;
+ targ.cache = false;
+ targ.valid = false;
+
+ return ret;
+}
+
+void Pipeline::Connect(nat32 s,nat32 input,nat32 from,nat32 output)
+{
+ log::Assert(output<step[from]->out.Size());
+ step[s]->in[input].step = from;
+ step[s]->in[input].output = output;
+}
+
+void Pipeline::Keep(nat32 s,bit keep)
+{
+ step[s]->keep = keep;
+}
+
+void Pipeline::Cache(nat32 s,bit cache)
+{
+ step[s]->cache = cache;
+ if (!cache) Free(*step[s]);
+}
+
+bit Pipeline::Run(time::Progress * prog)
+{
+ LogBlock("bit eos::svt::Pipeline::Run(...)","{steps}" << LogDiv() << step.Size());
+ ran = 0;
+
+ // Get the order, failing if there is a cycle...
+  ds::Array<nat32> topo;
+  if (!Sort(topo))
+  {
+   LogAlways("[svt.pipeline] Failed: cycle");
+   return false;
+  }
+
+ // Reset, and remove the outputs of uncached steps, which only live for one
+ // run...
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   Step & targ = *step[i];
+   targ.need = false;
+   targ.run = false;
+   targ.done = 0;
+   for (nat32 j=0;j<targ.users.Size();j++) targ.users[j] = 0;
+   targ.failed = false;
+   if (!targ.cache) Free(targ);
+  }
+
+ // Calculate the keys, working forwards...
+  for (nat32 i=0;i<topo.Size();i++)
+  {
+   Step & targ = *step[topo[i]];
+   data::Md5 md5;
+   if (targ.meta==null<const MetaAlgorithm*>())
+   {
+    if (targ.out[0])
+    {
+     PipelineHash ph(md5);
+     targ.out[0]->Write(ph);
+    }
+   }
+   else
+   {
+    md5.Write((void*)targ.meta->Name(),str::Length(targ.meta->Name()));
+    for (nat32 j=0;j<targ.in.Size();j++)
+    {
+     nat32 v[5] = {0,0,0,0,0};
+     if (targ.in[j].step!=nat32(-1))
+     {
+      const Step & from = *step[targ.in[j].step];
+      for (nat32 k=0;k<4;k++) v[k] = from.key[k];
+      v[4] = targ.in[j].output;
+     }
+     md5.Write(v,sizeof(v));
+    }
+   }
+   md5.Get(targ.key);
+  }
+
+ // Work out what needs running, working backwards from the kept steps -
+ // a step is run if its outputs are needed and it has no outputs for its key...
+  for (nat32 i=topo.Size();i>0;i--)
+  {
+   Step & targ = *step[topo[i-1]];
+   targ.need = targ.need || targ.keep;
+   if ((!targ.need)||(targ.meta==null<const MetaAlgorithm*>())) continue;
+
+   targ.run = !targ.valid;
+   for (nat32 k=0;k<4;k++) targ.run = targ.run || (targ.key[k]!=targ.oldKey[k]);
+   if (!targ.run) continue;
+
+   Free(targ);
+   for (nat32 j=0;j<targ.in.Size();j++)
+   {
+    if (targ.in[j].step==nat32(-1)) continue;
+    Step & from = *step[targ.in[j].step];
+    from.need = true;
+    from.users[targ.in[j].output] += 1;
+   }
+  }
+
+ // Run them, in topological order, as a job...
+  order.Size(0);
+  for (nat32 i=0;i<topo.Size();i++)
+  {
+   if (step[topo[i]]->run)
+   {
+    order.Size(order.Size()+1);
+    order[order.Size()-1] = topo[i];
+   }
+  }
+  ran = order.Size();
+
+  if (ran!=0)
+  {
+   if (pool==null<mt::Pool*>())
+   {
+    ownPool = new mt::Pool();
+    pool = ownPool;
+   }
+
+   next = 0;
+   RunJob job;
+   job.self = this;
+
+   prog->Push();
+   pool->Run(job,ran,prog);
+   prog->Pop();
+  }
+
+ // Check for failure...
+  bit ret = true;
+  for (nat32 i=0;i<order.Size();i++) ret = ret && (!step[order[i]]->failed);
+  return ret;
+}
+
+Node * Pipeline::Output(nat32 s,nat32 output) const
+{
+ return step[s]->out[output];
+}
+
+void Pipeline::ClearCache()
+{
+ for (nat32 i=0;i<step.Size();i++) Free(*step[i]);
+}
+
+void Pipeline::Free(Step & s)
+{
+ if (s.meta==null<const MetaAlgorithm*>()) return;
+ for (nat32 i=0;i<s.out.Size();i++)
+ {
+  delete s.out[i];
+  s.out[i] = null<Node*>();
+ }
+ s.valid = false;
+}
+
+void Pipeline::Release(Step & s,nat32 output)
+{
+ if (mt::AtomicAdd(s.users[output],nat32(-1))!=1) return;
+ if (s.keep||s.cache||(s.meta==null<const MetaAlgorithm*>())) return;
+
+ delete s.out[output];
+ s.out[output] = null<Node*>();
+}
+
+bit Pipeline::Sort(ds::Array<nat32> & out) const
+{
+ // Count the inputs each step is waiting on...
+  ds::Array<nat32> waiting(step.Size());
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   waiting[i] = 0;
+   for (nat32 j=0;j<step[i]->in.Size();j++)
+   {
+    if (step[i]->in[j].step!=nat32(-1)) waiting[i] += 1;
+   }
+  }
+
+ // Kahn's algorithm, using out as the queue...
+  out.Size(step.Size());
+  nat32 head = 0;
+  nat32 tail = 0;
+  for (nat32 i=0;i<step.Size();i++)
+  {
+   if (waiting[i]==0) {out[tail] = i; ++tail;}
+  }
+
+  while (head<tail)
+  {
+   nat32 from = out[head];
+   ++head;
+   for (nat32 i=0;i<step.Size();i++)
+   {
+    for (nat32 j=0;j<step[i]->in.Size();j++)
+    {
+     if (step[i]->in[j].step!=from) continue;
+     waiting[i] -= 1;
+     if (waiting[i]==0) {out[tail] = i; ++tail;}
+    }
+   }
+  }
+
+ return tail==step.Size();
+}
+
+//------------------------------------------------------------------------------
+void Pipeline::RunJob::Do(nat32,nat32)
+{
+ // Take the next step - steps are taken in topological order, so everything
+ // a step waits on has allready been taken by a running thread...
+  nat32 ind = self->order[mt::AtomicAdd(self->next,1)];
+  Step & targ = *self->step[ind];
+
+ // Wait for the steps providing its inputs...
+  for (nat32 j=0;j<targ.in.Size();j++)
+  {
+   if (targ.in[j].step==nat32(-1)) continue;
+   const Step & from = *self->step[targ.in[j].step];
+   if (from.run)
+   {
+    while (from.done==0) mt::Sleep(1);
+   }
+  }
+  mt::Barrier();
+
+ // Make and run the algorithm, checking inputs and outputs...
+  bit ok = true;
+  Algorithm * alg = targ.meta->Make();
+  for (nat32 j=0;j<targ.in.Size();j++)
+  {
+   Node * node = null<Node*>();
+   if (targ.in[j].step!=nat32(-1))
+   {
+    const Step & from = *self->step[targ.in[j].step];
+    if (from.failed) ok = false;
+                else node = from.out[targ.in[j].output];
+   }
+   if ((node==null<Node*>())&&(!targ.meta->InputOptional(j))) ok = false;
+   alg->SetInput(j,node);
+  }
+
+  if (ok)
+  {
+   alg->Run();
+   for (nat32 i=0;i<targ.out.Size();i++)
+   {
+    targ.out[i] = alg->GetOutput(i);
+    if ((targ.out[i]==null<Node*>())&&(!targ.meta->OutputOptional(i))) ok = false;
+   }
+  }
+  delete alg;
+
+  if (ok)
+  {
+   targ.valid = targ.cache;
+   for (nat32 k=0;k<4;k++) targ.oldKey[k] = targ.key[k];
+
+   // Outputs nothing is going to use can go straight away...
+    if ((!targ.keep)&&(!targ.cache))
+    {
+     for (nat32 i=0;i<targ.out.Size();i++)
+     {
+      if (targ.users[i]==0)
+      {
+       delete targ.out[i];
+       targ.out[i] = null<Node*>();
+      }
+     }
+    }
+  }
+  else
+  {
+   LogAlways("[svt.pipeline] Step failed {step,algorithm}" << LogDiv() << ind << LogDiv() << targ.meta->Name());
+   self->Free(targ);
+   targ.failed = true;
+  }
+
+ // Release the inputs, deleting uncached outputs once nothing else needs
+ // them...
+  for (nat32 j=0;j<targ.in.Size();j++)
+  {
+   if (targ.in[j].step==nat32(-1)) continue;
+   self->Release(*self->step[targ.in[j].step],targ.in[j].output);
+  }
+
+ mt::Barrier();
+ targ.done = 1;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
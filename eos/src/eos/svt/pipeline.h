@@ -0,0 +1,178 @@
+#ifndef EOS_SVT_PIPELINE_H
+#define EOS_SVT_PIPELINE_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file pipeline.h
+/// Provides an execution engine for graphs of svt::Algorithm, as created by
+/// the MetaAlgorithm factories, with the outputs of some steps wired to the
+/// inputs of others. Runs independent steps in parallel and remembers results,
+/// so running again after changing a parameter only recomputes what depends on
+/// it.
+
+#include "eos/types.h"
+#include "eos/svt/calculation.h"
+#include "eos/ds/arrays.h"
+#include "eos/mt/pool.h"
+#include "eos/time/progress.h"
+
+namespace eos
+{
+ namespace svt
+ {
+//------------------------------------------------------------------------------
+/// A directed acyclic graph of algorithms, and the machinery to run it. Nodes
+/// are either sources, svt Node objects supplied by the user (Data and
+/// parameters alike.), or steps, each of which makes and runs an Algorithm
+/// from a MetaAlgorithm. A source has a single output, output 0. Any output can
+/// feed any number of inputs.
+///
+/// When run the steps are handed to a thread pool in topological order, each
+/// waiting for the steps it depends on before running, so independent steps
+/// run concurrently. As a Node can be the input of several steps at once
+/// algorithms must not modify there inputs.
+///
+/// Every step is given a key, the md5 of its algorithm name and the keys of
+/// the outputs feeding it, with sources keyed by the md5 of there content as
+/// written by Node::Write. A step whose key matches that of its last run is not
+/// run again, its outputs being reused, and steps whose outputs are not needed
+/// by anything that runs are not run at all. So rerunning after editing one
+/// source recomputes only the steps downstream of it. This requires the
+/// outputs of a step to be kept between runs, which is only done for steps
+/// marked as cached. Otherwise each output of a step that is not kept is
+/// deleted as soon as the last step using it has finished, so a run only holds
+/// the intermediates still waiting on a consumer, at the price of uncached
+/// steps allways being rerun when anything after them is.
+class EOS_CLASS Pipeline
+{
+ public:
+  /// &nbsp;
+   Pipeline();
+
+  /// Deletes all outputs, but not the sources or MetaAlgorithm objects.
+   ~Pipeline();
+
+
+  /// Adds a source, returning its index, which is used as a step index for
+  /// Connect. The node is not owned, and must remain valid whilst Run is in
+  /// use. It may be edited between runs, as its content is hashed each run.
+   nat32 AddSource(Node * node);
+
+  /// Replaces the node of a source.
+   void SetSource(nat32 source,Node * node);
+
+  /// Adds a step, returning its index. The MetaAlgorithm must outlive the
+  /// Pipeline. By default a step is neither cached nor kept.
+   nat32 AddStep(const MetaAlgorithm & meta);
+
+  /// Connects the given input of a step to the given output of another step,
+  /// or source. Inputs left unconnected are given null, which is an error if
+  /// the input is not optional.
+   void Connect(nat32 step,nat32 input,nat32 from,nat32 output = 0);
+
+  /// Marks a step as wanted, so its outputs are computed by Run and remain
+  /// available via Output afterwards. Only kept steps, and the steps they
+  /// depend on, are ever run.
+   void Keep(nat32 step,bit keep = true);
+
+  /// Sets if the outputs of a step are cached between runs, defaults to false.
+   void Cache(nat32 step,bit cache);
+
+  /// Sets the pool used to run steps. Defaults to a pool created for the
+  /// Pipeline on first use, rather than mt::SharedPool(), so the algorithms
+  /// themselves can still make use of the shared pool.
+   void SetPool(mt::Pool & p) {pool = &p;}
+
+
+  /// Runs the graph. Returns false if it contains a cycle, or if any step had
+  /// a required input that was null or failed to provide a required output, in
+  /// which case steps that depended on it are also not run.
+   bit Run(time::Progress * prog = null<time::Progress*>());
+
+  /// Returns an output of a step after Run, null if not available - only
+  /// kept and cached steps that were needed are guaranteed to have outputs. The
+  /// returned Node remains owned by the Pipeline, and is valid till the next
+  /// call to Run. For a source returns the source.
+   Node * Output(nat32 step,nat32 output = 0) const;
+
+  /// Returns how many steps were actually run by the last call to Run.
+   nat32 Ran() const {return ran;}
+
+  /// Deletes all cached outputs, so the next Run recomputes everything.
+   void ClearCache();
+
+
+  /// &nbsp;
+   static inline cstrconst TypeString() {return "eos::svt::Pipeline";}
+
+
+ private:
+  // Where an input comes from...
+   struct Link
+   {
+    nat32 step; // nat32(-1) if unconnected.
+    nat32 output;
+   };
+
+  // A source or step...
+   struct Step
+   {
+    const MetaAlgorithm * meta; // null for a source.
+    ds::Array<Link> in;
+    ds::Array<Node*> out; // Owned, except for a source.
+    bit keep;
+    bit cache;
+
+    bit valid; // true if out contains the outputs for oldKey.
+    nat32 oldKey[4];
+
+    // State for the current run...
+     nat32 key[4];
+     bit need; // Outputs are needed.
+     bit run; // Needs to be run to get them.
+     volatile nat32 done; // Set to 1 when run, or failed.
+     ds::Array<nat32> users; // Per output, steps yet to finish with it.
+     bit failed;
+   };
+
+  ds::ArrayPtr<Step> step;
+  mt::Pool * pool;
+  mt::Pool * ownPool;
+  nat32 ran;
+
+  // For the job...
+   ds::Array<nat32> order; // Steps to run, in topological order.
+   volatile nat32 next; // Next entry in order to run.
+
+   class RunJob : public mt::Job
+   {
+    public:
+     Pipeline * self;
+     void Do(nat32 unit,nat32 thread);
+   };
+
+  // Helpers...
+   void Free(Step & s);
+   void Release(Step & s,nat32 output); // Called as a consumer of an output finishes.
+   bit Sort(ds::Array<nat32> & out) const;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
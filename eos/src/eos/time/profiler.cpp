@@ -0,0 +1,388 @@
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "eos/time/profiler.h"
+
+#include "eos/time/times.h"
+#include "eos/mt/threads.h"
+#include "eos/mt/locks.h"
+#include "eos/file/csv.h"
+#include "eos/str/functions.h"
+
+#include <stdio.h>
+
+namespace eos
+{
+ namespace time
+ {
+//------------------------------------------------------------------------------
+// A minimal growing array, for the per-thread records - kept simple as it
+// sits underneath the logging system...
+template <typename T>
+class ProfileVec
+{
+ public:
+  ProfileVec():size(0),cap(0),data(null<T*>()) {}
+  ~ProfileVec() {delete[] data;}
+
+  void Push(const T & v)
+  {
+   if (size==cap)
+   {
+    cap = (cap==0)?64:(cap*2);
+    T * nd = new T[cap];
+    for (nat32 i=0;i<size;i++) nd[i] = data[i];
+    delete[] data;
+    data = nd;
+   }
+   data[size] = v;
+   ++size;
+  }
+
+  T & operator[] (nat32 i) {return data[i];}
+  const T & operator[] (nat32 i) const {return data[i];}
+
+  nat32 size;
+  nat32 cap;
+  T * data;
+};
+
+// A node in a call tree, 0 being the root...
+struct ProfileNode
+{
+ cstrconst name;
+ nat32 child; // First child, 0 if none.
+ nat32 sibling; // Next sibling, 0 if none.
+ nat32 calls;
+ real64 total; // Inclusive time.
+ real64 children; // Time spent in children.
+};
+
+// An open span...
+struct ProfileOpen
+{
+ nat32 node;
+ ProfileKind kind;
+ real64 start;
+};
+
+// A closed span, for the trace...
+struct ProfileEvent
+{
+ cstrconst name;
+ real64 start;
+ real64 end;
+};
+
+// Everything recorded for a thread...
+struct ProfileThread
+{
+ ProfileThread * next;
+ nat32 id;
+ ProfileVec<ProfileNode> node;
+ ProfileVec<ProfileOpen> open;
+ ProfileVec<ProfileEvent> event;
+
+ void Clear()
+ {
+  ProfileNode root;
+   root.name = "root";
+   root.child = 0;
+   root.sibling = 0;
+   root.calls = 0;
+   root.total = 0.0;
+   root.children = 0.0;
+  node.size = 0;
+  node.Push(root);
+  open.size = 0;
+  event.size = 0;
+ }
+};
+
+//------------------------------------------------------------------------------
+EOS_VAR_DEF bit profileActive = false;
+
+static bit profileTrace = false;
+static real64 profileBase = 0.0; // Time trace timestamps are relative to.
+static ProfileThread * profileThreads = null<ProfileThread*>(); // Never freed, as threads may outlive anything.
+static mt::OwnedLock profileLock; // For the above.
+
+static const nat32 profileMax = 256; // Threads with a higher mt::ThreadIndex() are not recorded.
+static ProfileThread * profileSlot[profileMax]; // Indexed by mt::ThreadIndex().
+
+// Returns the calling threads record, registering it if need be. Returns null
+// if there are too many threads...
+inline ProfileThread * ProfileThis()
+{
+ nat32 ind = mt::ThreadIndex();
+ if (ind>=profileMax) return null<ProfileThread*>();
+ if (profileSlot[ind]==null<ProfileThread*>())
+ {
+  ProfileThread * pt = new ProfileThread();
+  pt->id = mt::ThreadID();
+  pt->Clear();
+
+  profileLock.Lock();
+   pt->next = profileThreads;
+   profileThreads = pt;
+  profileLock.Unlock();
+
+  profileSlot[ind] = pt;
+ }
+ return profileSlot[ind];
+}
+
+// Closes the innermost span of a thread...
+inline void ProfileClose(ProfileThread * pt,real64 now)
+{
+ pt->open.size -= 1;
+ const ProfileOpen & o = pt->open[pt->open.size];
+ real64 taken = now - o.start;
+
+ ProfileNode & targ = pt->node[o.node];
+ targ.calls += 1;
+ targ.total += taken;
+
+ nat32 parent = (pt->open.size==0)?0:pt->open[pt->open.size-1].node;
+ pt->node[parent].children += taken;
+
+ if (profileTrace)
+ {
+  ProfileEvent e;
+   e.name = targ.name;
+   e.start = o.start;
+   e.end = now;
+  pt->event.Push(e);
+ }
+}
+
+//------------------------------------------------------------------------------
+EOS_FUNC void ProfileEnable(bit enable,bit trace)
+{
+ if (enable&&(!profileActive)&&(profileBase==0.0)) profileBase = UltraTime();
+ profileTrace = trace;
+ profileActive = enable;
+}
+
+EOS_FUNC void ProfileReset()
+{
+ profileLock.Lock();
+  for (ProfileThread * pt = profileThreads;pt;pt = pt->next) pt->Clear();
+  profileBase = UltraTime();
+ profileLock.Unlock();
+}
+
+EOS_FUNC void ProfileBegin(cstrconst name,ProfileKind kind)
+{
+ if (!profileActive) return;
+ ProfileThread * pt = ProfileThis();
+ if (pt==null<ProfileThread*>()) return;
+
+ // Find the node, creating it if need be...
+  nat32 parent = (pt->open.size==0)?0:pt->open[pt->open.size-1].node;
+  nat32 n = pt->node[parent].child;
+  while ((n!=0)&&(pt->node[n].name!=name)) n = pt->node[n].sibling;
+  if (n==0)
+  {
+   ProfileNode nn;
+    nn.name = name;
+    nn.child = 0;
+    nn.sibling = pt->node[parent].child;
+    nn.calls = 0;
+    nn.total = 0.0;
+    nn.children = 0.0;
+   n = pt->node.size;
+   pt->node.Push(nn);
+   pt->node[parent].child = n;
+  }
+
+ // Open the span...
+  ProfileOpen o;
+   o.node = n;
+   o.kind = kind;
+   o.start = UltraTime();
+  pt->open.Push(o);
+}
+
+EOS_FUNC void ProfileEnd(ProfileKind kind)
+{
+ nat32 ind = mt::ThreadIndex();
+ if (ind>=profileMax) return;
+ ProfileThread * pt = profileSlot[ind];
+ if ((pt==null<ProfileThread*>())||(pt->open.size==0)) return;
+ real64 now = UltraTime();
+
+ if (kind==profile_progress)
+ {
+  if (pt->open[pt->open.size-1].kind==profile_progress) ProfileClose(pt,now);
+ }
+ else
+ {
+  nat32 i = pt->open.size;
+  while ((i>0)&&(pt->open[i-1].kind!=profile_block)) --i;
+  if (i==0) return;
+  while (pt->open.size>=i) ProfileClose(pt,now);
+ }
+}
+
+//------------------------------------------------------------------------------
+// Merges a node of a threads tree into the given child of the merged tree,
+// recursively...
+static void ProfileMerge(ProfileVec<ProfileNode> & out,nat32 outNode,const ProfileVec<ProfileNode> & in,nat32 inNode)
+{
+ for (nat32 c = in[inNode].child;c!=0;c = in[c].sibling)
+ {
+  nat32 n = out[outNode].child;
+  while ((n!=0)&&(str::Compare(out[n].name,in[c].name)!=0)) n = out[n].sibling;
+  if (n==0)
+  {
+   ProfileNode nn;
+    nn.name = in[c].name;
+    nn.child = 0;
+    nn.sibling = out[outNode].child;
+    nn.calls = 0;
+    nn.total = 0.0;
+    nn.children = 0.0;
+   n = out.size;
+   out.Push(nn);
+   out[outNode].child = n;
+  }
+
+  out[n].calls += in[c].calls;
+  out[n].total += in[c].total;
+  out[n].children += in[c].children;
+  ProfileMerge(out,n,in,c);
+ }
+}
+
+// Writes a node and its children, biggest first...
+static void ProfileWrite(file::Csv & po,const ProfileVec<ProfileNode> & tree,nat32 node,nat32 depth)
+{
+ ProfileVec<nat32> kids;
+ for (nat32 c = tree[node].child;c!=0;c = tree[c].sibling)
+ {
+  kids.Push(c);
+  for (nat32 i=kids.size-1;(i>0)&&(tree[kids[i]].total>tree[kids[i-1]].total);i--)
+  {
+   nat32 t = kids[i]; kids[i] = kids[i-1]; kids[i-1] = t;
+  }
+ }
+
+ for (nat32 i=0;i<kids.size;i++)
+ {
+  const ProfileNode & targ = tree[kids[i]];
+  po << depth << file::EndField()
+     << targ.name << file::EndField()
+     << targ.calls << file::EndField()
+     << targ.total << file::EndField()
+     << (targ.total-targ.children) << file::EndField()
+     << ((targ.calls!=0)?(targ.total/real64(targ.calls)):0.0) << file::EndRow(); // Spans still open have no calls.
+  ProfileWrite(po,tree,kids[i],depth+1);
+ }
+}
+
+EOS_FUNC bit ProfileReport(cstrconst fn)
+{
+ file::Csv po(fn,true);
+ if (!po.Active()) return false;
+
+ ProfileVec<ProfileNode> tree;
+ {
+  ProfileNode root;
+   root.name = "root";
+   root.child = 0;
+   root.sibling = 0;
+   root.calls = 0;
+   root.total = 0.0;
+   root.children = 0.0;
+  tree.Push(root);
+ }
+
+ nat32 threads = 0;
+ profileLock.Lock();
+  for (ProfileThread * pt = profileThreads;pt;pt = pt->next)
+  {
+   ProfileMerge(tree,0,pt->node,0);
+   ++threads;
+  }
+ profileLock.Unlock();
+
+ po << "threads = " << threads << file::EndRow();
+ po << "depth" << file::EndField()
+    << "span" << file::EndField()
+    << "calls" << file::EndField()
+    << "inclusive" << file::EndField()
+    << "exclusive" << file::EndField()
+    << "mean" << file::EndRow();
+ ProfileWrite(po,tree,0,0);
+
+ return true;
+}
+
+//------------------------------------------------------------------------------
+// Writes a string to a json file, escaped...
+static void ProfileJsonStr(FILE * f,cstrconst s)
+{
+ fputc('"',f);
+ for (;*s;++s)
+ {
+  switch (*s)
+  {
+   case '"': fputs("\\\"",f); break;
+   case '\\': fputs("\\\\",f); break;
+   default:
+    if (byte(*s)<32) fprintf(f,"\\u%04x",int(byte(*s)));
+                else fputc(*s,f);
+   break;
+  }
+ }
+ fputc('"',f);
+}
+
+EOS_FUNC bit ProfileTrace(cstrconst fn)
+{
+ FILE * f = fopen(fn,"w");
+ if (f==null<FILE*>()) return false;
+
+ fputs("{\"traceEvents\":[\n",f);
+ bit first = true;
+ profileLock.Lock();
+  for (ProfileThread * pt = profileThreads;pt;pt = pt->next)
+  {
+   for (nat32 i=0;i<pt->event.size;i++)
+   {
+    const ProfileEvent & e = pt->event[i];
+    if (!first) fputs(",\n",f);
+    first = false;
+
+    fputs("{\"name\":",f);
+    ProfileJsonStr(f,e.name);
+    fprintf(f,",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            pt->id,(e.start-profileBase)*1e6,(e.end-e.start)*1e6);
+   }
+  }
+ profileLock.Unlock();
+ fputs("\n],\"displayTimeUnit\":\"ms\"}\n",f);
+
+ bit ok = ferror(f)==0;
+ fclose(f);
+ return ok;
+}
+
+//------------------------------------------------------------------------------
+ };
+};
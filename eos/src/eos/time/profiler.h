@@ -0,0 +1,102 @@
+#ifndef EOS_TIME_PROFILER_H
+#define EOS_TIME_PROFILER_H
+//------------------------------------------------------------------------------
+// Copyright 2009 Tom Haines
+
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// \file profiler.h
+/// A hierarchical profiler, fed from the places the code allready marks out
+/// its structure - every LogBlock/LogTime and every time::Progress Push/Pop
+/// opens and closes a span. Spans are recorded per thread, each thread having
+/// its own stack of open spans and its own call tree, so recording never takes
+/// a lock once a thread is registered. When switched off, the default, a span
+/// costs a single test of a global flag. The call trees of all threads can be
+/// written out merged, with inclusive time, exclusive time and call counts, and
+/// if asked for every individual span can be kept to be exported as a Chrome
+/// trace (Load it in chrome://tracing.) for a timeline of each thread.
+///
+/// Only includes types.h, as its used by the logging system. Threads are told
+/// apart with mt::ThreadIndex(), up to 256 of them.
+
+#include "eos/types.h"
+
+namespace eos
+{
+ namespace time
+ {
+//------------------------------------------------------------------------------
+/// The kinds of span, so closes can be matched to opens. Progress Push/Pop is
+/// not exception safe (Anything that throws goes straight past the Pop.) so a
+/// block closing also closes any progress spans left open within it, whilst a
+/// progress Pop that does not match is ignored.
+enum ProfileKind {profile_block = 0, ///< LogBlock, LogTime and ProfileSpan.
+                  profile_progress = 1 ///< time::Progress Push/Pop.
+                 };
+
+//------------------------------------------------------------------------------
+/// true when spans are being recorded. Do not set directly, use ProfileEnable.
+EOS_VAR bit profileActive;
+
+/// Switches span recording on or off. If trace is true every span is also
+/// kept individually, for ProfileTrace, which uses memory in proportion to the
+/// number of spans.
+EOS_FUNC void ProfileEnable(bit enable = true,bit trace = false);
+
+/// Discards everything recorded, including open spans. Must not be called
+/// whilst other threads are recording.
+EOS_FUNC void ProfileReset();
+
+/// Opens a span with the given name on the calling thread. The name must be a
+/// constant string, as only the pointer is kept. Does nothing if not active.
+EOS_FUNC void ProfileBegin(cstrconst name,ProfileKind kind = profile_block);
+
+/// Closes the innermost span of the given kind on the calling thread, see
+/// ProfileKind for how mismatches are handled.
+EOS_FUNC void ProfileEnd(ProfileKind kind = profile_block);
+
+/// Writes the call tree, merged over all threads by name, to a csv file - a
+/// row per node in depth first order with children sorted by inclusive time.
+/// Times are in seconds. Should be called when no other thread is recording.
+/// Returns false on failure to write the file.
+EOS_FUNC bit ProfileReport(cstrconst fn);
+
+/// Writes every span recorded with trace enabled to a file as Chrome
+/// trace-event json, one track per thread. Same conditions as ProfileReport.
+EOS_FUNC bit ProfileTrace(cstrconst fn);
+
+//------------------------------------------------------------------------------
+/// Opens a block span on construction and closes it on destruction, this is
+/// what LogBlock and LogTime create. Only closes if it opened, so switching
+/// the profiler on or off midway is harmless.
+class EOS_CLASS ProfileSpan
+{
+ public:
+  /// &nbsp;
+   ProfileSpan(cstrconst name):open(profileActive) {if (open) ProfileBegin(name,profile_block);}
+
+  /// &nbsp;
+   ~ProfileSpan() {if (open) ProfileEnd(profile_block);}
+
+
+ private:
+  bit open;
+};
+
+//------------------------------------------------------------------------------
+ };
+};
+#endif
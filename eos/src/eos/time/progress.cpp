@@ -19,6 +19,7 @@
 
 #include "eos/mem/alloc.h"
 #include "eos/file/csv.h"
+#include "eos/time/profiler.h"
 
 namespace eos
 {
@@ -26,7 +27,7 @@ namespace eos
  {
 //------------------------------------------------------------------------------
 Progress::Progress(nat32 d,bit sp)
-:paused(false),time(0.0),size(0),depth(0),data(null< Pair<nat32,nat32>* >())
+:paused(false),time(0.0),size(0),depth(0),data(null< Pair<nat32,nat32>* >()),cancel(false)
 {
  Reset(d,sp);	
 }
@@ -42,6 +43,7 @@ void Progress::Reset(nat32 d,bit startPaused)
  {
   delete[] data;
   data = new Pair<nat32,nat32>[d];	 
+  size = d;
  }
  
  data[0].first = 0;
@@ -51,10 +53,30 @@ void Progress::Reset(nat32 d,bit startPaused)
  paused = startPaused;
  if (paused) time = 0.0;
         else time = UltraTime();	
+ cancel = false;
 }
 
-void Progress::Push()
+void Progress::CopyFrom(Progress & rhs)
 {
+ if (size<rhs.depth+1)
+ {
+  delete[] data;
+  size = rhs.depth+1;
+  data = new Pair<nat32,nat32>[size];
+ }
+ 
+ depth = rhs.depth;
+ for (nat32 i=0;i<=depth;i++) data[i] = rhs.data[i];
+ 
+ paused = rhs.paused;
+ time = rhs.time;
+ 
+ OnChange();
+}
+
+void Progress::Push(cstrconst name)
+{
+ if (profileActive) ProfileBegin(name?name:"progress",profile_progress);
  if (this==null<Progress*>()) return;
  ++depth;
  
@@ -75,6 +97,7 @@ void Progress::Push()
 
 void Progress::Pop()
 {
+ if (profileActive) ProfileEnd(profile_progress);
  if (this==null<Progress*>()) return;
  --depth;
 }
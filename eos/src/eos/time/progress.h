@@ -55,16 +55,24 @@ class EOS_CLASS Progress
   /// The depth value indicates how deep you recon the progress sub-levels 
   /// will get, in the event of an overflow it is resized, but its obviously
   /// more efficient to avoid this scenario. Note that the moment this is 
-  /// called the timer starts ticking.
+  /// called the timer starts ticking. Clears any cancellation.
    void Reset(nat32 depth = 8,bit startPaused = false);
+
+  /// Makes this a copy of another progress object, the levels and the timer,
+  /// then calls OnChange. Used to show the progress of an algorithm running in
+  /// another thread, by copying a snapshot of its progress object into the one
+  /// being displayed. The cancellation state is not copied.
+   void CopyFrom(Progress & rhs);
   
    
   /// Push to indicate entering a sub-level of proccessing.  
-  /// Safe when this is set to null.
-   void Push();
+  /// Safe when this is set to null. Also opens a span in the profiler (See
+  /// time/profiler.h.), even when null, under the given name, which must be a
+  /// constant string - unnamed levels are recorded as "progress".
+   void Push(cstrconst name = null<cstrconst>());
    
   /// Pop to indicate exiting a sub-level of proccessing.
-  /// Safe when this is set to null.
+  /// Safe when this is set to null. Closes the profiler span.
    void Pop();
   
   /// This is to be called by proccessing code to indicate progress so far.
@@ -80,6 +88,17 @@ class EOS_CLASS Progress
   /// Move the incriments the number of work modules done by 1, a useful conveniance
   /// as the number of work moduels to be done itself ushally dosn't change so much.
    void Next();
+
+
+  /// Requests that the algorithm being monitored stops early. Can be called
+  /// from any thread, unlike everything else. Nothing is thrown - algorithms
+  /// that can stop poll Cancelling at points where they can tidy up and
+  /// return, and there output should then be considered invalid.
+   void Cancel() {cancel = true;}
+   
+  /// Returns true if Cancel has been called since the last Reset. Safe when
+  /// this is set to null, returning false.
+   bit Cancelling() const {return (this!=null<Progress*>())&&cancel;}
   
    
   /// Returns the progress, factoring in all the avaliable information, a value
@@ -139,6 +158,8 @@ class EOS_CLASS Progress
   nat32 depth; // How deep in the stack we currently are.
   
   Pair<nat32,nat32> * data; // first is x, second is y.
+  
+  volatile bit cancel;
 };
 
 //------------------------------------------------------------------------------
@@ -74,7 +74,9 @@ EOS_FUNC real64 UltraTime()
   val = 0;
   rdtsc(s.low,s.high);
   return real64(val)/real64();*/
-  return real64(MilliTime())/1000.0; // Tempory, until I find a better way.
+  struct timeval tv;
+  gettimeofday(&tv,0);
+  return real64(tv.tv_sec) + real64(tv.tv_usec)*1e-6;
  #endif
 }
 EOS_FUNC void ThreadTime(real64 & user,real64 & system)